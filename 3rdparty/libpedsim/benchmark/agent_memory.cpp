@@ -0,0 +1,113 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+// Measures the heap bytes per agent of the simulation core for a large
+// population. Only libpedsim is needed; from the library directory, build it
+// with the library sources (one command) and pass the number of agents:
+//   g++ -std=c++11 -O2 -pthread -Iinclude/pedsim -o agent_memory
+//       benchmark/agent_memory.cpp src/*.cpp
+//   ./agent_memory 100000
+// Only Ped::Tagent and the scene's per-agent structures are measured. The
+// simulator's Agent, a QObject with its forces, state machine and planner,
+// is not covered and adds its own allocations on top.
+//
+
+#include "ped_includes.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+// every allocation carries its size in front so that the live bytes can be
+// tracked without any allocator specific calls
+static const size_t headerSize = 16;
+static size_t liveBytes = 0;
+static size_t liveAllocations = 0;
+
+void* operator new(size_t size) {
+  char* block = static_cast<char*>(malloc(size + headerSize));
+  if (block == nullptr) throw bad_alloc();
+  *reinterpret_cast<size_t*>(block) = size;
+  liveBytes += size;
+  liveAllocations++;
+  return block + headerSize;
+}
+
+void operator delete(void* p) noexcept {
+  if (p == nullptr) return;
+  char* block = static_cast<char*>(p) - headerSize;
+  liveBytes -= *reinterpret_cast<size_t*>(block);
+  liveAllocations--;
+  free(block);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
+/// Agent with a fixed destination, as plain as an agent of the simulator
+/// without its Qt view.
+class BenchmarkAgent : public Ped::Tagent {
+ public:
+  BenchmarkAgent(Ped::Twaypoint* destinationIn) : destination(destinationIn) {}
+  Ped::Twaypoint* getCurrentWaypoint() const { return destination; }
+
+ private:
+  Ped::Twaypoint* destination;
+};
+
+static void report(const char* stage, size_t bytes, size_t allocations,
+                   int agentCount) {
+  printf("%-24s %10.1f bytes/agent %6.2f allocations/agent\n", stage,
+         double(bytes) / agentCount, double(allocations) / agentCount);
+}
+
+int main(int argc, char* argv[]) {
+  int agentCount = (argc > 1) ? atoi(argv[1]) : 100000;
+  if (agentCount <= 0) {
+    fprintf(stderr, "usage: %s [agent count]\n", argv[0]);
+    return 1;
+  }
+
+  // square area with a density of about one agent per 4 m²
+  double side = 2.0 * sqrt(double(agentCount));
+  Ped::Tscene* scene = new Ped::Tscene(-side / 2, -side / 2, side, side);
+  Ped::Twaypoint* east = new Ped::Twaypoint(side, 0);
+  Ped::Twaypoint* west = new Ped::Twaypoint(-side, 0);
+  east->setRadius(1);
+  west->setRadius(1);
+  scene->addWaypoint(east);
+  scene->addWaypoint(west);
+
+  size_t baseBytes = liveBytes;
+  size_t baseAllocations = liveAllocations;
+
+  int columns = int(ceil(sqrt(double(agentCount))));
+  for (int i = 0; i < agentCount; ++i) {
+    BenchmarkAgent* agent = new BenchmarkAgent((i % 2) ? east : west);
+    agent->setPosition(-side / 2 + 1 + 2 * (i % columns),
+                       -side / 2 + 1 + 2 * (i / columns));
+    scene->addAgent(agent);
+  }
+
+  printf("%d agents, sizeof(Ped::Tagent) = %zu bytes\n", agentCount,
+         sizeof(Ped::Tagent));
+  report("after adding", liveBytes - baseBytes,
+         liveAllocations - baseAllocations, agentCount);
+
+  // the neighbor spans and the per-tick arena only exist while moving
+  const int ticks = 2;
+  for (int i = 0; i < ticks; ++i) scene->moveAgents(0.1);
+  report("after moving", liveBytes - baseBytes,
+         liveAllocations - baseAllocations, agentCount);
+
+  // the scene owns the agents and waypoints from here on
+  scene->clear();
+  delete scene;
+  return 0;
+}
@@ -14,14 +14,70 @@
 
 #include "ped_vector.h"
 
+#include <cstddef>
 #include <deque>
 #include <set>
 
 using namespace std;
 
 namespace Ped {
+class Tagent;
 class Tscene;
 class Twaypoint;
+class TvisibilityGraph;
+class TorcaModel;
+
+/// Range over the neighbors of an agent, as found in the last call of
+/// Tagent::computeForces(). The neighbors live in an arena shared by all
+/// agents of a Tscene, which is reset every time step. Agents removed from
+/// the scene since then are skipped.
+/// \tparam T The agent class the neighbors are converted to. All agents in
+/// the scene must be of this type.
+template <typename T>
+class TneighborRange {
+ public:
+  class iterator {
+   public:
+    iterator(const Tagent* const* currentIn, const Tagent* const* endIn)
+        : current(currentIn), end(endIn) {
+      skipRemoved();
+    }
+
+    const T* operator*() const { return static_cast<const T*>(*current); }
+    iterator& operator++() {
+      ++current;
+      skipRemoved();
+      return *this;
+    }
+    bool operator==(const iterator& other) const {
+      return current == other.current;
+    }
+    bool operator!=(const iterator& other) const {
+      return current != other.current;
+    }
+
+   private:
+    void skipRemoved() {
+      while ((current != end) && (*current == nullptr)) ++current;
+    }
+
+    const Tagent* const* current;
+    const Tagent* const* end;
+  };
+
+  TneighborRange(const Tagent* const* beginIn, size_t countIn)
+      : first(beginIn), count(countIn) {}
+
+  iterator begin() const { return iterator(first, first + count); }
+  iterator end() const { return iterator(first + count, first + count); }
+  /// Upper bound for the number of neighbors (removed agents are counted)
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+ private:
+  const Tagent* const* first;
+  size_t count;
+};
 
 /// \example example.cpp
 
@@ -39,6 +95,8 @@ class Twaypoint;
 /// \author  chgloor
 /// \date    2003-12-26
 class LIBEXPORT Tagent {
+  friend class TorcaModel;
+
  public:
   enum AgentType { ADULT = 0, CHILD = 1, ROBOT = 2, ELDER = 3 };
 
@@ -47,8 +105,11 @@ class LIBEXPORT Tagent {
 
   virtual void updateState(){};
   virtual void computeForces();
+  void updateNeighbors();
   virtual void move(double stepSizeIn);
   virtual Tvector desiredForce();
+  virtual bool updateRouteTarget(TvisibilityGraph& graph,
+                                 const Twaypoint& waypoint);
   virtual Tvector socialForce() const;
   virtual Tvector obstacleForce() const;
   virtual Tvector myForce(Tvector desired) const;
@@ -57,16 +118,23 @@ class LIBEXPORT Tagent {
   virtual void setPosition(double px, double py, double pz = 0);
   virtual void setType(AgentType typeIn) { type = typeIn; };
   virtual void setVmax(double vmax);
+  void setSpeedFactor(double factor);
   virtual void SetRadius(double radius) { agentRadius = radius; }
 
   void setTeleop(bool opstatus) { teleop = opstatus; }
+  /// Radius within which neighbors are looked up, and so the reach of the
+  /// social force, 10 m by default
+  void setNeighborhoodRadius(double radius) { neighborhoodRadius = radius; }
   void setRobotPosDiffScalingFactor(double scalingFactor);
 
   int getId() const { return id; };
   AgentType getType() const { return type; };
-  double getVmax() const { return vmax; };
+  double getVmax() const { return vmax * speedFactor; };
+  double getSpeedFactor() const { return speedFactor; };
   double getRelaxationTime() const { return relaxationTime; };
+  double getRadius() const { return agentRadius; };
   bool getTeleop() { return teleop; }
+  double getNeighborhoodRadius() const { return neighborhoodRadius; };
   double getRobotPosDiffScalingFactor() const { return robotPosDiffScalingFactor; };
 
   // these getter should replace the ones later (returning the individual vector
@@ -74,6 +142,8 @@ class LIBEXPORT Tagent {
   const Tvector& getPosition() const { return p; }
   const Tvector& getVelocity() const { return v; }
   const Tvector& getAcceleration() const { return a; }
+  /// Position before the last move(), or where the agent was placed
+  const Tvector& getLastPosition() const { return lastPosition; }
 
   double getx() const { return p.x; };
   double gety() const { return p.y; };
@@ -95,18 +165,31 @@ class LIBEXPORT Tagent {
   void assignScene(Tscene* sceneIn);
   void removeAgentFromNeighbors(const Tagent* agentIn);
 
+  /// Typed iteration over the current neighbors, e.g.
+  /// for (const Agent* other : agent->getNeighborRange<Agent>())
+  template <typename T = Tagent>
+  TneighborRange<T> getNeighborRange() const {
+    return TneighborRange<T>(neighborsBegin(), neighborCount);
+  }
+
  protected:
   int id;
   Tvector p;  ///< current position of the agent
   Tvector v;  ///< current velocity of the agent
   Tvector a;  ///< current acceleration of the agent
+  Tvector lastPosition;  ///< position before the last step
   AgentType type;
   double vmax;
+  double speedFactor;
   double agentRadius;
   double relaxationTime;
   bool teleop;
+  double neighborhoodRadius;
   double robotPosDiffScalingFactor;
 
+  const Tagent* const* neighborsBegin() const;
+  void keepPosition();
+
   double forceFactorDesired;
   double forceFactorSocial;
   double forceFactorObstacle;
@@ -115,7 +198,15 @@ class LIBEXPORT Tagent {
   Ped::Tscene* scene;
 
   Ped::Tvector desiredDirection;
-  set<const Ped::Tagent*> neighbors;
+  // intermediate corner towards the current waypoint, see TvisibilityGraph
+  Ped::Tvector routeTarget;
+  bool hasRouteTarget;
+  const Ped::Twaypoint* routeDestination;
+  // span of this agent's neighbors in the scene's neighbor arena, valid
+  // in the scene's neighborEpoch it was looked up in
+  size_t neighborOffset;
+  size_t neighborCount;
+  unsigned long neighborEpoch;
 
   Ped::Tvector desiredforce;
   Ped::Tvector socialforce;
@@ -0,0 +1,94 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#ifndef _ped_arena_h_
+#define _ped_arena_h_ 1
+
+#ifdef WIN32
+#define LIBEXPORT __declspec(dllexport)
+#else
+#define LIBEXPORT
+#endif
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+namespace Ped {
+
+/// Monotonic memory arena for data that only lives during one time step.
+/// Allocations just bump a pointer; nothing is freed individually. reset()
+/// releases everything at once. When a step needed more than one block, the
+/// blocks are merged into a single one on reset, so that in steady state the
+/// arena does not call the system allocator at all.
+/// The arena is not thread-safe.
+class LIBEXPORT Tarena {
+ public:
+  explicit Tarena(size_t initialSize = 64 * 1024);
+  virtual ~Tarena();
+
+  void* allocate(size_t bytes, size_t alignment);
+  void reset();
+
+  size_t getUsedBytes() const { return usedBytes; };
+  size_t getCapacity() const;
+  /// Number of blocks requested from the system since the last reset
+  size_t getSystemAllocations() const { return systemAllocations; };
+
+ private:
+  Tarena(const Tarena&);
+  Tarena& operator=(const Tarena&);
+
+  struct Tblock {
+    char* data;
+    size_t size;
+  };
+
+  void addBlock(size_t minimumSize);
+
+  vector<Tblock> blocks;
+  size_t currentBlock;
+  size_t offset;
+  size_t usedBytes;
+  size_t systemAllocations;
+};
+
+/// Standard allocator adaptor drawing from a Tarena. deallocate() is a no-op;
+/// memory is reclaimed when the arena is reset. Containers using it must not
+/// outlive the current time step.
+template <typename T>
+class TarenaAllocator {
+ public:
+  typedef T value_type;
+
+  TarenaAllocator(Tarena& arenaIn) : arena(&arenaIn) {}
+  template <typename U>
+  TarenaAllocator(const TarenaAllocator<U>& other) : arena(other.arena) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T*, size_t) {}
+
+  Tarena* arena;
+};
+
+template <typename T, typename U>
+bool operator==(const TarenaAllocator<T>& a, const TarenaAllocator<U>& b) {
+  return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const TarenaAllocator<T>& a, const TarenaAllocator<U>& b) {
+  return a.arena != b.arena;
+}
+
+/// Vector living in a Tarena, e.g. for per-step scratch lists
+template <typename T>
+using TarenaVector = vector<T, TarenaAllocator<T> >;
+}
+
+#endif
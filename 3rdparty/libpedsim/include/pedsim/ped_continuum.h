@@ -0,0 +1,143 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#ifndef _ped_continuum_h_
+#define _ped_continuum_h_ 1
+
+#ifdef WIN32
+#define LIBEXPORT __declspec(dllexport)
+#else
+#define LIBEXPORT
+#endif
+
+#include "ped_vector.h"
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+namespace Ped {
+
+class Tscene;
+class Twaypoint;
+
+/// Macroscopic crowd model for the regions nobody looks at closely. Outside
+/// the region of interest, pedestrians are represented by their number per
+/// grid cell, one density layer per population (all pedestrians heading to
+/// the same destination). Each time step, every layer is advected towards
+/// its destination (along the destination's flow field if it has one) with
+/// a speed following a density-speed relation (Weidmann's fundamental
+/// diagram). Flows between cells are limited by the sending and receiving
+/// capacity of the cells (cell transmission scheme), so jams form and
+/// dissolve, and no cell is filled beyond the maximal density. Mass doesn't
+/// flow across walls and polygons (see updatePassages()), nor across the
+/// border of the grid, so it is conserved.
+/// Mass crossing into the region of interest is collected; each whole
+/// pedestrian is returned by takeEntering() so it can be turned back into an
+/// agent. Mass reaching the destination is returned by takeArrived().
+class LIBEXPORT Tcontinuum {
+ public:
+  /// A pedestrian that crossed into the region of interest
+  struct Tentry {
+    size_t population;
+    Tvector position;  ///< center of the cell it entered
+    Tvector velocity;  ///< mean velocity of the mass that entered
+  };
+
+  Tcontinuum(double left, double top, double width, double height,
+             double cellSize = 1.0);
+  virtual ~Tcontinuum();
+
+  size_t addPopulation(const Twaypoint* destination);
+  size_t getPopulationCount() const { return populations.size(); };
+  const Twaypoint* getDestination(size_t population) const;
+
+  void setRegionOfInterest(double left, double top, double width,
+                           double height);
+  bool isInRegionOfInterest(double x, double y) const;
+  bool isFarFromRegionOfInterest(double x, double y) const;
+
+  void updatePassages(const Tscene& scene);
+  void updatePassages(const Tscene& scene, const Tvector& areaMin,
+                      const Tvector& areaMax);
+
+  void setVmax(double vmaxIn);
+  void setMaxDensity(double densityIn);
+
+  bool deposit(size_t population, double x, double y, double mass = 1.0);
+  void advance(double h);
+  void takeEntering(vector<Tentry>& outputList);
+  double takeArrived(size_t population);
+
+  double getDensity(double x, double y) const;
+  Tvector getVelocity(double x, double y) const;
+  double getMass(size_t population) const;
+  double getTotalMass() const;
+
+  double getCellSize() const { return cellSize; };
+  int getColumns() const { return columns; };
+  int getRows() const { return rows; };
+
+ protected:
+  struct Tpopulation {
+    const Twaypoint* destination;
+    vector<double> mass;        ///< pedestrians per cell
+    vector<double> entering;    ///< mass entered per region cell
+    vector<Tvector> momentum;   ///< entered mass times its velocity
+    double arrived;             ///< mass reached the destination
+  };
+
+  int getCellIndex(int column, int row) const {
+    return row * columns + column;
+  };
+  bool getCell(double x, double y, int* columnOut, int* rowOut) const;
+  bool isInRegionOfInterest(int column, int row) const {
+    return (column >= roiLeft) && (column <= roiRight) && (row >= roiTop) &&
+           (row <= roiBottom);
+  };
+  bool isPassable(int column, int row, int targetColumn, int targetRow) const;
+  Tvector getCellCenter(int column, int row) const;
+  Tvector getDirection(const Tpopulation& population, int column,
+                       int row) const;
+  double getSpeed(double density) const;
+  void updateSpeeds();
+  void updateCriticalDensity();
+
+ protected:
+  double left;
+  double top;
+  double cellSize;
+  int columns;
+  int rows;
+
+  double vmax;
+  double maxDensity;
+  double criticalDensity;  ///< density of the maximal flow
+  double maxFlow;          ///< pedestrians per meter and second
+
+  // region of interest, in cells
+  int roiLeft;
+  int roiTop;
+  int roiRight;
+  int roiBottom;
+
+  vector<Tpopulation> populations;
+
+  // per cell: whether mass can flow to the right (PASSAGE_RIGHT) and the
+  // lower (PASSAGE_DOWN) neighbor, and back
+  enum { PASSAGE_RIGHT = 1, PASSAGE_DOWN = 2 };
+  vector<unsigned char> passages;
+
+  // buffers reused every step
+  vector<double> totals;
+  vector<double> speeds;
+  vector<double> inflow;
+  vector<double> admission;
+  vector<double> next;
+};
+}
+
+#endif
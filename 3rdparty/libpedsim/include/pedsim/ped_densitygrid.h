@@ -0,0 +1,88 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#ifndef _ped_densitygrid_h_
+#define _ped_densitygrid_h_ 1
+
+#ifdef WIN32
+#define LIBEXPORT __declspec(dllexport)
+#else
+#define LIBEXPORT
+#endif
+
+#include "ped_vector.h"
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace Ped {
+
+class Tagent;
+
+/// Number of agents and their mean velocity on a regular grid. Each agent is
+/// counted in the cell it stands in. The grid is kept up to date
+/// incrementally: Tscene reports every agent that moved, and only its old
+/// and new cell change. Queries are constant time lookups.
+/// Agents outside the grid aren't counted.
+class LIBEXPORT TdensityGrid {
+ public:
+  TdensityGrid(double left, double top, double width, double height,
+               double cellSize = 1.0);
+  virtual ~TdensityGrid();
+
+  void clear();
+  void addAgent(const Tagent* agent);
+  bool removeAgent(const Tagent* agent);
+  void moveAgent(const Tagent* agent);
+
+  double getDensity(double x, double y) const;
+  Tvector getMeanVelocity(double x, double y) const;
+
+  /// Indices (row * columns + column) of the cells with agents in them
+  const vector<int>& getOccupiedCells() const { return occupiedCells; };
+  int getCount(int index) const { return cells[index].count; };
+  double getDensity(int index) const;
+  Tvector getMeanVelocity(int index) const;
+
+  double getLeft() const { return left; };
+  double getTop() const { return top; };
+  double getCellSize() const { return cellSize; };
+  int getColumns() const { return columns; };
+  int getRows() const { return rows; };
+
+ protected:
+  struct Tcell {
+    int count;
+    Tvector velocitySum;
+    int occupiedSlot;  ///< position in occupiedCells, -1 if empty
+  };
+
+  /// What an agent contributed at its last update
+  struct Tcontribution {
+    int cell;  ///< -1 if outside the grid
+    Tvector velocity;
+  };
+
+  int getCellIndex(double x, double y) const;
+  void addToCell(int index, const Tvector& velocity);
+  void removeFromCell(int index, const Tvector& velocity);
+
+ protected:
+  double left;
+  double top;
+  double cellSize;
+  int columns;
+  int rows;
+
+  vector<Tcell> cells;
+  vector<int> occupiedCells;
+  unordered_map<const Tagent*, Tcontribution> contributions;
+};
+}
+
+#endif
@@ -0,0 +1,116 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#ifndef _ped_flowfield_h_
+#define _ped_flowfield_h_ 1
+
+#ifdef WIN32
+#define LIBEXPORT __declspec(dllexport)
+#else
+#define LIBEXPORT
+#endif
+
+#include "ped_vector.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace Ped {
+
+class Tobstacle;
+class Tpolygons;
+
+/// A navigation flow field towards one target area. The field stores the
+/// geodesic distance to the target on a regular grid, going around the
+/// obstacles, and the walking direction derived from its gradient. All agents
+/// heading to the same target share one field; a query is a constant time
+/// lookup.
+/// Cells closer than the clearance to an obstacle, or within a polygon, are
+/// treated as blocked.
+/// When obstacles move, update() repairs only the distances that depend on
+/// the cells around them.
+class LIBEXPORT TflowField {
+ public:
+  TflowField(double left, double top, double width, double height,
+             double cellSize = 0.25);
+  virtual ~TflowField();
+
+  void setTarget(const Tvector& targetIn, double radiusIn);
+  void compute(const vector<Tobstacle*>& obstacles, double clearance,
+               const Tpolygons* polygons = NULL);
+  void update(const vector<Tobstacle*>& obstacles, double clearance,
+              const Tvector& changedMin, const Tvector& changedMax,
+              const Tpolygons* polygons = NULL);
+
+  uint64_t getFingerprint(const vector<Tobstacle*>& obstacles,
+                          double clearance,
+                          const Tpolygons* polygons = NULL) const;
+  bool save(const string& fileName, uint64_t fingerprint) const;
+  bool load(const string& fileName, uint64_t fingerprint);
+
+  bool isValid() const { return valid; };
+  bool getDirection(const Tvector& position, Tvector* directionOut) const;
+  double getDistance(const Tvector& position) const;
+
+  Tvector getTarget() const { return target; };
+  double getCellSize() const { return cellSize; };
+  int getColumns() const { return columns; };
+  int getRows() const { return rows; };
+
+ protected:
+  /// A rectangle of cells, inclusive. Empty if column0 > column1.
+  struct Twindow {
+    int column0, row0, column1, row1;
+    Twindow() : column0(0), row0(0), column1(-1), row1(-1){};
+    bool isEmpty() const { return (column0 > column1) || (row0 > row1); };
+    void include(int column, int row);
+  };
+
+  int getCellIndex(int column, int row) const {
+    return row * columns + column;
+  };
+  bool getCell(const Tvector& position, int* columnOut, int* rowOut) const;
+  Tvector getCellCenter(int column, int row) const;
+
+  Twindow getWindow(double minX, double minY, double maxX, double maxY) const;
+  Twindow getAllCells() const {
+    Twindow window;
+    window.column1 = columns - 1;
+    window.row1 = rows - 1;
+    return window;
+  };
+  void rasterizeObstacles(const vector<Tobstacle*>& obstacles,
+                          double clearance, const Twindow& window);
+  void rasterizePolygons(const Tpolygons& polygons, double clearance,
+                         const Twindow& window);
+  void computeDistances();
+  bool repairDistances(const vector<int>& blockedCells,
+                       const vector<int>& freedCells, Twindow* changedOut);
+  void propagateDistances(vector<pair<float, int> >& open,
+                          Twindow* changedOut);
+  void computeDirections(const Twindow& window);
+
+ protected:
+  double left;
+  double top;
+  double cellSize;
+  int columns;
+  int rows;
+
+  Tvector target;
+  double radius;
+
+  vector<float> distances;   ///< geodesic distance per cell, inf if unreachable
+  vector<float> directions;  ///< x/y walking direction per cell
+  vector<char> blocked;      ///< obstacle raster, empty for loaded fields
+  bool valid;
+};
+}
+
+#endif
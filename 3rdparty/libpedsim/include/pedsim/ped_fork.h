@@ -0,0 +1,142 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#ifndef _ped_fork_h_
+#define _ped_fork_h_ 1
+
+#ifdef WIN32
+#define LIBEXPORT __declspec(dllexport)
+#else
+#define LIBEXPORT
+#endif
+
+#include "ped_agent.h"
+#include "ped_polygons.h"
+#include "ped_scene.h"
+#include "ped_segmentgrid.h"
+#include "ped_vector.h"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace Ped {
+
+class TmotionModel;
+class Tobstacle;
+class Twaypoint;
+
+/// Agent in a TsceneSnapshot or TsceneFork
+class LIBEXPORT TforkAgent : public Tagent {
+ public:
+  TforkAgent(const Tagent& agentIn, const Twaypoint* waypointIn);
+
+  Twaypoint* getCurrentWaypoint() const {
+    return const_cast<Twaypoint*>(waypoint);
+  };
+  Tvector myForce(Tvector) const { return noise; };
+  void setNoise(const Tvector& noiseIn) { noise = noiseIn; };
+
+ protected:
+  const Twaypoint* waypoint;
+  Tvector noise;
+};
+
+/// Frozen copy of a scene, the common starting point of TsceneFork
+/// instances. It is taken on the thread owning the scene and never changes
+/// afterwards, so forks on other threads can share it. Obstacles, polygons
+/// and waypoints are copied; the copied waypoints share their flow fields
+/// with the scene and keep them alive, see Twaypoint::getFlowField(). The
+/// agents are stored in pages, which forks copy only when they change them.
+class LIBEXPORT TsceneSnapshot {
+  friend class TsceneFork;
+
+ public:
+  TsceneSnapshot(const Tscene& scene, size_t pageSize = 256);
+  virtual ~TsceneSnapshot();
+
+  size_t getAgentCount() const { return agentCount; };
+  size_t getPageSize() const { return pageSize; };
+
+ protected:
+  typedef vector<TforkAgent> Tpage;
+
+  vector<Tobstacle*> obstacles;
+  TsegmentGrid obstacleIndex;
+  Tpolygons polygons;
+  map<const Twaypoint*, Twaypoint*> waypoints;
+  vector<TmotionModel*> motionModels;  ///< prototypes, by agent type
+  vector<shared_ptr<const Tpage> > pages;
+  size_t pageSize;
+  size_t agentCount;
+
+  // area for the forks' quadtrees
+  double left;
+  double top;
+  double width;
+  double height;
+};
+
+/// Independent continuation of a TsceneSnapshot, e.g. to try out a robot
+/// action. Creating a fork copies no agents; an agent page is copied when
+/// the fork steps or changes an agent on it. With an active region, only
+/// the agents starting in it are simulated, and pages without such agents
+/// are never copied. Forks of the same snapshot can be stepped on different
+/// threads. Each fork has its own random number stream for the noise force.
+/// Agents keep heading to their current waypoint; they don't switch to the
+/// next one, and the simulator's additional forces aren't applied.
+class LIBEXPORT TsceneFork {
+ public:
+  TsceneFork(const shared_ptr<const TsceneSnapshot>& snapshotIn,
+             unsigned int seed);
+  TsceneFork(const shared_ptr<const TsceneSnapshot>& snapshotIn,
+             unsigned int seed, const Tvector& center, double radius);
+  virtual ~TsceneFork();
+
+  size_t getAgentCount() const { return snapshot->getAgentCount(); };
+  size_t findAgent(int id) const;
+  const Tagent& getAgent(size_t index) const;
+  Tagent& getAgentForWriting(size_t index);
+  bool isActive(size_t index) const { return active[index]; };
+
+  void setNoise(double sigmaIn) { noiseSigma = sigmaIn; };
+  default_random_engine& getRandomEngine() { return randomEngine; };
+
+  void step(double h);
+  double getTime() const { return time; };
+  size_t getCopiedPageCount() const;
+
+  static void run(const vector<TsceneFork*>& forks, double duration, double h,
+                  unsigned int threadCount = 0);
+
+ protected:
+  TforkAgent& getWritable(size_t index);
+  void setup();
+
+ protected:
+  typedef TsceneSnapshot::Tpage Tpage;
+
+  shared_ptr<const TsceneSnapshot> snapshot;
+  vector<shared_ptr<const Tpage> > pages;
+  vector<Tpage*> copiedPages;  ///< NULL while the page is shared
+  vector<bool> active;
+
+  // created at the first step
+  unique_ptr<Tscene> scene;
+  vector<TmotionModel*> motionModels;
+  vector<TforkAgent*> activeAgents;
+
+  default_random_engine randomEngine;
+  normal_distribution<double> noiseDistribution;
+  double noiseSigma;
+  double time;
+};
+}
+
+#endif
@@ -2,9 +2,21 @@
 #define _ped_includes_h_ 1
 
 #include "ped_agent.h"
+#include "ped_arena.h"
+#include "ped_continuum.h"
+#include "ped_densitygrid.h"
+#include "ped_flowfield.h"
+#include "ped_fork.h"
+#include "ped_motionmodel.h"
 #include "ped_obstacle.h"
+#include "ped_orca.h"
+#include "ped_polygons.h"
+#include "ped_rollout.h"
 #include "ped_scene.h"
+#include "ped_segmentgrid.h"
+#include "ped_visibilitygraph.h"
 #include "ped_waypoint.h"
+#include "ped_workerpool.h"
 
 namespace Ped {
 const double LIBEXPORT LIBPEDSIM_VERSION = 2.2;
@@ -0,0 +1,49 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#ifndef _ped_motionmodel_h_
+#define _ped_motionmodel_h_ 1
+
+#ifdef WIN32
+#define LIBEXPORT __declspec(dllexport)
+#else
+#define LIBEXPORT
+#endif
+
+#include <vector>
+
+using namespace std;
+
+namespace Ped {
+
+class Tagent;
+
+/// Interface of a local motion model. Tscene::moveAgents() hands every model
+/// the agents it is selected for (see Tscene::setMotionModel()) once per time
+/// step. The model sets the agents' forces; the agents are moved afterwards
+/// by Tagent::move(), so all models see the same positions.
+/// Agents without a model use the social force model.
+class LIBEXPORT TmotionModel {
+ public:
+  virtual ~TmotionModel() {}
+
+  /// \param   agents the agents driven by this model
+  /// \param   h the length of the coming time step
+  virtual void computeForces(const vector<Tagent*>& agents, double h) = 0;
+
+  /// A new model with the same parameters, but none of the state
+  virtual TmotionModel* clone() const = 0;
+};
+
+/// The social force model (desired, social, obstacle and additional forces),
+/// as implemented by Tagent::computeForces().
+class LIBEXPORT TsocialForceModel : public TmotionModel {
+ public:
+  virtual void computeForces(const vector<Tagent*>& agents, double h);
+  virtual TmotionModel* clone() const { return new TsocialForceModel(); };
+};
+}
+
+#endif
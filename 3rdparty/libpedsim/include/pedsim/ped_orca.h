@@ -0,0 +1,107 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#ifndef _ped_orca_h_
+#define _ped_orca_h_ 1
+
+#ifdef WIN32
+#define LIBEXPORT __declspec(dllexport)
+#else
+#define LIBEXPORT
+#endif
+
+#include "ped_motionmodel.h"
+#include "ped_vector.h"
+#include "ped_workerpool.h"
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace Ped {
+
+class Tobstacle;
+
+/// Optimal reciprocal collision avoidance (ORCA, van den Berg et al. 2011).
+/// Every neighbor and every nearby obstacle restricts the agent's next
+/// velocity to a half-plane; the velocity closest to the preferred one (the
+/// agent's desired direction at full speed) is selected by a 2D linear
+/// program. Neighbors come from the scene's quadtree, obstacles from its
+/// obstacle index. Walls, and polygons, are approximated by their closest
+/// point.
+/// The velocities of all agents are computed in parallel, on threads kept by
+/// the model. Then the agents' forces are set so that Tagent::move() reaches
+/// the new velocity.
+class LIBEXPORT TorcaModel : public TmotionModel {
+ public:
+  TorcaModel(double timeHorizon = 2.0, double obstacleTimeHorizon = 1.0,
+             size_t maxNeighbors = 10, unsigned int threadCount = 0);
+  virtual ~TorcaModel();
+
+  virtual void computeForces(const vector<Tagent*>& agents, double h);
+  virtual TmotionModel* clone() const;
+
+  void setTimeHorizon(double timeHorizonIn) { timeHorizon = timeHorizonIn; };
+  void setObstacleTimeHorizon(double timeHorizonIn) {
+    obstacleTimeHorizon = timeHorizonIn;
+  };
+  void setMaxNeighbors(size_t maxNeighborsIn) {
+    maxNeighbors = maxNeighborsIn;
+  };
+  void setThreadCount(unsigned int threadCountIn);
+
+ protected:
+  struct Tline {
+    Tvector point;
+    Tvector direction;
+  };
+
+  /// Per-thread scratch space, kept between time steps
+  struct Tscratch {
+    vector<Tline> lines;
+    vector<Tline> projectedLines;
+    vector<pair<double, const Tagent*> > neighbors;
+    vector<const Tobstacle*> obstacles;
+    vector<Tvector> polygonPoints;
+  };
+
+  void computeVelocities(const vector<Tagent*>& agents, size_t begin,
+                         size_t end, double h, Tscratch& scratch);
+  Tvector computeVelocity(const Tagent& agent,
+                          const Tvector& preferredVelocity, double h,
+                          Tscratch& scratch) const;
+  Tline getAvoidanceLine(const Tvector& velocity,
+                         const Tvector& relativePosition,
+                         const Tvector& relativeVelocity,
+                         double combinedRadius, double horizon, double h,
+                         double responsibility) const;
+
+  static bool linearProgram1(const vector<Tline>& lines, size_t lineNo,
+                             double radius, const Tvector& optVelocity,
+                             bool directionOpt, Tvector& result);
+  static size_t linearProgram2(const vector<Tline>& lines, double radius,
+                               const Tvector& optVelocity, bool directionOpt,
+                               Tvector& result);
+  static void linearProgram3(const vector<Tline>& lines, size_t numObstLines,
+                             size_t beginLine, double radius, Tvector& result,
+                             vector<Tline>& projectedLines);
+
+ protected:
+  double timeHorizon;
+  double obstacleTimeHorizon;
+  size_t maxNeighbors;
+  unsigned int threadCount;
+  unique_ptr<TworkerPool> workers;
+
+  vector<Tvector> preferredVelocities;
+  vector<Tvector> newVelocities;
+  vector<Tscratch> scratchSpaces;
+};
+}
+
+#endif
@@ -0,0 +1,78 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#ifndef _ped_polygons_h_
+#define _ped_polygons_h_ 1
+
+#ifdef WIN32
+#define LIBEXPORT __declspec(dllexport)
+#else
+#define LIBEXPORT
+#endif
+
+#include "ped_vector.h"
+
+#include <vector>
+
+using namespace std;
+
+namespace Ped {
+
+class Tobstacle;
+
+/// Closed polygonal obstacles, e.g. shops and pillars. Unlike Tobstacle
+/// walls, a polygon has an inside that agents are kept out of.
+/// All polygons are stored in a few contiguous arrays with one entry per
+/// edge, so the nearest edge is found in one pass over plain numbers that
+/// the compiler vectorizes. Users that need individual walls (routing,
+/// visualization) expand them with getEdges().
+class LIBEXPORT Tpolygons {
+ public:
+  Tpolygons();
+
+  void clear();
+  size_t addPolygon(const vector<Tvector>& corners);
+
+  bool isEmpty() const { return minX.empty(); };
+  size_t getPolygonCount() const { return minX.size(); };
+  size_t getEdgeCount() const { return startX.size(); };
+  vector<Tvector> getCorners(size_t polygon) const;
+  void getEdges(vector<Tobstacle*>& outputList, size_t polygon) const;
+  void getBounds(size_t polygon, Tvector* minOut, Tvector* maxOut) const;
+  bool isNear(size_t polygon, const Tvector& point, double distance) const;
+
+  bool contains(const Tvector& point) const;
+  bool contains(size_t polygon, const Tvector& point) const;
+  bool intersects(const Tvector& from, const Tvector& to) const;
+  bool getClosestPoint(const Tvector& point, double maxDistance,
+                       Tvector* closestOut) const;
+  void getClosestPoints(vector<Tvector>& outputList, const Tvector& point,
+                        double maxDistance) const;
+  double getDistance(size_t polygon, const Tvector& point) const;
+  bool keepOutside(Tvector* point, Tvector* normalOut) const;
+
+ protected:
+  size_t getClosestEdge(size_t polygon, const Tvector& point,
+                        double* distanceSquaredOut) const;
+  Tvector getPointOnEdge(size_t edge, const Tvector& point) const;
+
+ protected:
+  // per edge: start point, vector to the end point, 1 / its squared length
+  vector<double> startX;
+  vector<double> startY;
+  vector<double> edgeX;
+  vector<double> edgeY;
+  vector<double> inverseLengthSquared;
+
+  // per polygon: its edges are [firstEdge[i], firstEdge[i + 1]), bounds
+  vector<size_t> firstEdge;
+  vector<double> minX;
+  vector<double> minY;
+  vector<double> maxX;
+  vector<double> maxY;
+};
+}
+
+#endif
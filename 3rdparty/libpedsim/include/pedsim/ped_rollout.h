@@ -0,0 +1,70 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#ifndef _ped_rollout_h_
+#define _ped_rollout_h_ 1
+
+#ifdef WIN32
+#define LIBEXPORT __declspec(dllexport)
+#else
+#define LIBEXPORT
+#endif
+
+#include "ped_scene.h"
+#include "ped_vector.h"
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+namespace Ped {
+
+class Tagent;
+class TmotionModel;
+class Tobstacle;
+
+/// Predicts the trajectories of a group of agents by simulating copies of
+/// them in a private scene. The copies are taken on the thread owning the
+/// live scene (addAgent(), addObstacle(), addPolygon(), setMotionModel());
+/// run() can then be called on any thread, as it touches nothing but the
+/// copies. Copying
+/// an agent neither draws random numbers nor allocates agent ids.
+/// The copies keep heading to a copy of their current waypoint (without its
+/// flow field, see Twaypoint::clone()); they don't switch to the next one.
+class LIBEXPORT Trollout {
+ public:
+  Trollout();
+  virtual ~Trollout();
+
+  void clear();
+  void addAgent(const Tagent& agent);
+  void addObstacle(const Tobstacle& obstacle);
+  void addPolygon(const vector<Tvector>& corners);
+  void setMotionModel(int agentType, const TmotionModel& model);
+
+  void run(double horizon, double h, double sampleInterval);
+
+  size_t getAgentCount() const { return agentIds.size(); };
+  int getAgentId(size_t index) const { return agentIds[index]; };
+  int getAgentType(size_t index) const { return agentTypes[index]; };
+  /// Positions at sampleInterval, 2 * sampleInterval, ... after the start
+  const vector<Tvector>& getTrajectory(size_t index) const {
+    return trajectories[index];
+  };
+  double getSampleInterval() const { return sampleInterval; };
+
+ protected:
+  Tscene scene;
+  vector<TmotionModel*> motionModels;
+
+  vector<int> agentIds;
+  vector<int> agentTypes;
+  vector<vector<Tvector> > trajectories;
+  double sampleInterval;
+};
+}
+
+#endif
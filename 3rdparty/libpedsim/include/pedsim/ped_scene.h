@@ -12,6 +12,10 @@
 #define LIBEXPORT
 #endif
 
+#include "ped_arena.h"
+#include "ped_polygons.h"
+#include "ped_segmentgrid.h"
+
 #include <list>
 #include <map>
 #include <set>
@@ -22,9 +26,12 @@ using namespace std;
 namespace Ped {
 
 class Tagent;
+class TdensityGrid;
 class Tobstacle;
 class Twaypoint;
 class Ttree;
+class TmotionModel;
+class TvisibilityGraph;
 
 /// The Tscene class contains the spatial representation of the "world" the
 /// agents live in.
@@ -74,12 +81,50 @@ class LIBEXPORT Tscene {
   virtual bool removeAgent(Tagent* a);
   virtual bool removeObstacle(Tobstacle* o);
   virtual bool removeWaypoint(Twaypoint* w);
+  virtual void updateObstacle(Tobstacle* o);
 
   virtual void cleanup();
   virtual void moveAgents(double h);
 
   set<const Ped::Tagent*> getNeighbors(double x, double y, double dist) const;
   const vector<Tagent*>& getAllAgents() const { return agents; };
+  const vector<Tobstacle*>& getAllObstacles() const { return obstacles; };
+
+  /// Closed polygons, see Tpolygons. Agents walk around them like around
+  /// walls, and are moved out again if they end up inside.
+  virtual size_t addPolygon(const vector<Tvector>& corners);
+  const Tpolygons& getPolygons() const { return *polygonLookup; };
+  void getObstacles(vector<const Tobstacle*>& outputList, double x, double y,
+                    double dist) const;
+  bool isVisible(const Tvector& from, const Tvector& to) const;
+
+  /// Scratch memory for the current time step, see Tarena. The owner of the
+  /// simulation loop resets it once per step.
+  Tarena& getTickArena() { return tickArena; };
+
+  /// Optional routing around obstacles, see TvisibilityGraph. The scene keeps
+  /// the graph up to date when obstacles are added or removed, but doesn't
+  /// own it.
+  TvisibilityGraph* getVisibilityGraph() const { return visibilityGraph; };
+  void setVisibilityGraph(TvisibilityGraph* graphIn);
+
+  /// Optional crowd density and mean velocity grid, see TdensityGrid. The
+  /// scene updates it for every agent that is added, moved or removed, but
+  /// doesn't own it.
+  const TdensityGrid* getDensityGrid() const { return densityGrid; };
+  void setDensityGrid(TdensityGrid* gridIn);
+
+  /// The motion model that drives the agents of the given type, see
+  /// TmotionModel. NULL (the default) uses the social force model. The scene
+  /// doesn't own the models.
+  TmotionModel* getMotionModel(int agentType) const;
+  void setMotionModel(int agentType, TmotionModel* model);
+
+  /// Number of steps the neighbors of an agent are reused before they are
+  /// looked up again, at least 1 (the default). Forces still use the
+  /// current positions of the neighbors, only the set may be outdated.
+  size_t getNeighborReuse() const { return neighborReuse; };
+  void setNeighborReuse(size_t steps);
 
  protected:
   vector<Tagent*> agents;
@@ -87,6 +132,30 @@ class LIBEXPORT Tscene {
   vector<Twaypoint*> waypoints;
   map<const Ped::Tagent*, Ttree*> treehash;
   Ttree* tree;
+  TvisibilityGraph* visibilityGraph;
+  TdensityGrid* densityGrid;
+  TsegmentGrid obstacleIndex;
+  // index used by getObstacles(): obstacleIndex, or one shared with other
+  // scenes (see TsceneFork)
+  const TsegmentGrid* obstacleLookup;
+  Tpolygons polygons;
+  // polygons used by the agents: polygons, or shared ones like above
+  const Tpolygons* polygonLookup;
+  // the polygons' edges as walls, only while the visibility graph needs them
+  vector<Tobstacle*> polygonEdges;
+  vector<TmotionModel*> motionModels;
+  // agents handed to a motion model, reused between steps
+  vector<Tagent*> modelAgents;
+
+  // neighbors of all agents for the current time step; each agent refers
+  // to its own span. Cleared, but not freed, every neighborReuse steps,
+  // which starts a new neighborEpoch.
+  vector<const Ped::Tagent*> neighborArena;
+  size_t neighborReuse;
+  size_t neighborAge;
+  unsigned long neighborEpoch;
+
+  Tarena tickArena;
 
   void placeAgent(const Ped::Tagent* a);
   void moveAgent(const Ped::Tagent* a);
@@ -0,0 +1,68 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#ifndef _ped_segmentgrid_h_
+#define _ped_segmentgrid_h_ 1
+
+#ifdef WIN32
+#define LIBEXPORT __declspec(dllexport)
+#else
+#define LIBEXPORT
+#endif
+
+#include "ped_vector.h"
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace Ped {
+
+class Tobstacle;
+
+/// Spatial index for obstacles. The plane is divided into square cells; each
+/// obstacle is stored in all cells its bounding box touches. Line-of-sight
+/// checks only test the obstacles in the cells the line passes through.
+/// Obstacles can be added, moved and removed individually.
+class LIBEXPORT TsegmentGrid {
+ public:
+  explicit TsegmentGrid(double cellSize = 2.0);
+  virtual ~TsegmentGrid();
+
+  void clear();
+  void addObstacle(const Tobstacle* obstacle);
+  bool removeObstacle(const Tobstacle* obstacle);
+  void updateObstacle(const Tobstacle* obstacle);
+
+  bool isVisible(const Tvector& from, const Tvector& to) const;
+  void getObstacles(vector<const Tobstacle*>& outputList, double x, double y,
+                    double dist) const;
+
+  double getCellSize() const { return cellSize; };
+  size_t getObstacleCount() const { return obstacleCells.size(); };
+
+  static bool intersects(const Tvector& a, const Tvector& b,
+                         const Tobstacle* obstacle);
+  static bool intersects(const Tvector& a, const Tvector& b, const Tvector& c,
+                         const Tvector& d);
+
+ protected:
+  typedef uint64_t Tkey;
+  Tkey getKey(int column, int row) const {
+    return ((uint64_t)(uint32_t)column << 32) | (uint32_t)row;
+  };
+  int getCellCoordinate(double value) const;
+
+ protected:
+  double cellSize;
+  unordered_map<Tkey, vector<const Tobstacle*> > cells;
+  map<const Tobstacle*, vector<Tkey> > obstacleCells;
+};
+}
+
+#endif
@@ -36,6 +36,8 @@ class LIBEXPORT Ttree {
 
   virtual set<const Ped::Tagent*> getAgents() const;
   virtual void getAgents(vector<const Ped::Tagent*>& outputList) const;
+  virtual void getAgents(vector<const Ped::Tagent*>& outputList, double px,
+                         double py, double pr) const;
 
   virtual bool intersects(double px, double py, double pr) const;
 
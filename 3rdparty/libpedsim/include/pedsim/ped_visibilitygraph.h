@@ -0,0 +1,127 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#ifndef _ped_visibilitygraph_h_
+#define _ped_visibilitygraph_h_ 1
+
+#ifdef WIN32
+#define LIBEXPORT __declspec(dllexport)
+#else
+#define LIBEXPORT
+#endif
+
+#include "ped_segmentgrid.h"
+#include "ped_vector.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace Ped {
+
+class Tobstacle;
+class Twaypoint;
+
+/// Visibility graph over the corners of the obstacles. Each wall endpoint
+/// that forms a corner gets a node placed the clearance away from the walls;
+/// nodes that see each other are connected. Shortest routes towards a
+/// waypoint are computed once per waypoint and memoized. Adding, moving or
+/// removing an obstacle only reconnects the nodes and edges it affects, and
+/// only drops the routes that used them.
+/// A lighter alternative to TflowField: agents walk straight towards the next
+/// corner on their route. The graph is not thread-safe.
+class LIBEXPORT TvisibilityGraph {
+ public:
+  explicit TvisibilityGraph(double clearance = 0.8);
+  virtual ~TvisibilityGraph();
+
+  void clear();
+  void build(const vector<Tobstacle*>& obstacles);
+  void addObstacle(const Tobstacle* obstacle);
+  bool removeObstacle(const Tobstacle* obstacle);
+  void updateObstacle(const Tobstacle* obstacle);
+  void removeWaypoint(const Twaypoint* waypoint);
+
+  bool isVisible(const Tvector& from, const Tvector& to) const {
+    return segments.isVisible(from, to);
+  };
+  bool getNextTarget(const Tvector& position, const Twaypoint& destination,
+                     Tvector* targetOut);
+  const vector<Tvector>& getRoute(const Twaypoint& from, const Twaypoint& to);
+  void precomputeRoutes(const vector<Twaypoint*>& waypoints);
+
+  double getClearance() const { return clearance; };
+  size_t getNodeCount() const;
+  size_t getEdgeCount() const;
+  const TsegmentGrid& getSegmentGrid() const { return segments; };
+
+ protected:
+  struct Tnode {
+    Tvector anchor;    ///< the wall endpoint
+    Tvector position;  ///< the corner point agents walk to
+    vector<const Tobstacle*> obstacles;  ///< walls ending at the anchor
+    vector<pair<int, double> > edges;    ///< visible nodes and distance
+    bool active;
+  };
+
+  /// Shortest routes from all nodes towards one destination
+  struct Troutes {
+    Tvector destination;
+    vector<double> distance;
+    vector<int> next;  ///< next node on the route, -1: the destination
+  };
+
+  /// What one obstacle update changed, see updateRoutes()
+  struct Tchanges {
+    vector<int> nodes;  ///< nodes that moved, appeared or disappeared
+    vector<pair<int, int> > removedEdges;
+    vector<pair<int, int> > addedEdges;
+    vector<pair<Tvector, Tvector> > removedWalls;
+    vector<pair<Tvector, Tvector> > addedWalls;
+  };
+
+  typedef pair<long long, long long> TanchorKey;
+  TanchorKey getAnchorKey(const Tvector& point) const;
+  int getNode(const Tvector& anchor);
+  void detachObstacle(const Tobstacle* obstacle, vector<int>& affectedNodes);
+  void attachObstacle(const Tobstacle* obstacle, vector<int>& affectedNodes);
+  void collectNearbyNodes(const Tvector& a, const Tvector& b,
+                          vector<int>& affectedNodes) const;
+  void unblock(const Tobstacle* obstacle, Tchanges& changes);
+  void block(const Tobstacle* obstacle, Tchanges& changes);
+  void replaceNodes(const vector<int>& affectedNodes, Tchanges& changes);
+  void connectHiddenPairs(const Tvector& a, const Tvector& b,
+                          Tchanges& changes);
+  void placeNode(int index);
+  void connectNode(int index, Tchanges& changes);
+  void disconnectNode(int index, Tchanges& changes);
+  bool isConnected(int first, int second) const;
+  void connect(int first, int second, double distance);
+
+  const Troutes& getRoutes(const Twaypoint& destination);
+  int findEntryNode(const Tvector& position, const Troutes& routes) const;
+  void invalidateRoutes();
+  void updateRoutes(const Tchanges& changes);
+  bool updateRouteTable(Troutes& table, const Tchanges& changes,
+                        bool* changedOut);
+  bool isRouteValid(const Twaypoint& from, const vector<Tvector>& route,
+                    const Troutes* table, const Tchanges& changes) const;
+
+ protected:
+  double clearance;
+  TsegmentGrid segments;
+  vector<Tnode> nodes;
+  map<TanchorKey, int> anchors;
+  map<const Tobstacle*, pair<Tvector, Tvector> > obstacleEnds;
+
+  // memoized routing results, updated or dropped when an obstacle changes
+  map<const Twaypoint*, Troutes> routeTables;
+  map<pair<const Twaypoint*, const Twaypoint*>, vector<Tvector> > routes;
+};
+}
+
+#endif
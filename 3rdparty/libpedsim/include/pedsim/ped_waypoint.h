@@ -13,6 +13,7 @@
 #endif
 
 #include <cstddef>
+#include <memory>
 #include "ped_vector.h"
 
 using namespace std;
@@ -20,6 +21,7 @@ using namespace std;
 namespace Ped {
 // Forward Declarations
 class Tagent;
+class TflowField;
 
 /// The waypoint class
 /// \author  chgloor
@@ -54,12 +56,26 @@ class LIBEXPORT Twaypoint {
   void setType(WaypointType t) { type = t; };
   void setBehavior(Behavior b) { behavior = b; };
 
+  /// Shared navigation field towards this waypoint, see TflowField.
+  /// Copies of the waypoint keep it alive, so whoever computed it has to
+  /// replace rather than change it while copies exist. Without one,
+  /// agents head straight for the waypoint.
+  const TflowField* getFlowField() const { return flowField.get(); };
+  void setFlowField(const shared_ptr<const TflowField>& fieldIn) {
+    flowField = fieldIn;
+  };
+
   virtual Tvector getForce(const Tagent& agent,
                            Ped::Tvector* desiredDirectionOut = NULL,
                            bool* reached = NULL) const;
   virtual Tvector closestPoint(const Tvector& p,
                                bool* withinWaypoint = NULL) const;
 
+  /// Detached copy that attracts agents like this waypoint, for rollouts
+  /// and forks. Subclasses that change getForce() or closestPoint() return
+  /// a copy of their own. The caller owns the copy.
+  virtual Twaypoint* clone() const { return new Twaypoint(*this); }
+
  protected:
   static int staticid;                   ///< last waypoint number
   int id;                                ///< waypoint number
@@ -67,6 +83,7 @@ class LIBEXPORT Twaypoint {
   WaypointType type;                     ///< type of the waypoint
   Behavior behavior = Behavior::SIMPLE;  ///< behavior of the waypoint
   double radius;                          ///< radius of the waypoint
+  shared_ptr<const TflowField> flowField;  ///< shared navigation field
 };
 }
 
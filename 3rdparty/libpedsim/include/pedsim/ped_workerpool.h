@@ -0,0 +1,65 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#ifndef _ped_workerpool_h_
+#define _ped_workerpool_h_ 1
+
+#ifdef WIN32
+#define LIBEXPORT __declspec(dllexport)
+#else
+#define LIBEXPORT
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace Ped {
+
+/// Threads kept alive between time steps, for work that is split into
+/// independent items every step. The calling thread takes part in the work,
+/// so a pool of n threads starts n - 1 of its own, when it is first used.
+/// run() must only be called from one thread at a time, and the items must
+/// not throw.
+class LIBEXPORT TworkerPool {
+ public:
+  explicit TworkerPool(unsigned int threadCount = 0);
+  virtual ~TworkerPool();
+
+  unsigned int getThreadCount() const { return threadCount; };
+
+  void run(size_t itemCount, const function<void(size_t)>& item);
+
+ private:
+  TworkerPool(const TworkerPool&);
+  TworkerPool& operator=(const TworkerPool&);
+
+  void start();
+  void work();
+  void loop();
+
+  unsigned int threadCount;
+  vector<thread> threads;
+
+  mutex lock;
+  condition_variable wakeUp;
+  condition_variable finished;
+  unsigned long generation;  ///< number of run() calls handed to the threads
+  unsigned int busyCount;    ///< threads still working on the current run()
+  bool stopping;
+
+  const function<void(size_t)>* currentItem;
+  size_t itemCount;
+  atomic<size_t> nextItem;
+};
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include "ped_agent.h"
 #include "ped_obstacle.h"
 #include "ped_scene.h"
+#include "ped_visibilitygraph.h"
 #include "ped_waypoint.h"
 
 #include <algorithm>
@@ -29,10 +30,17 @@ Ped::Tagent::Tagent() {
   type = ADULT;
   scene = nullptr;
   teleop = false;
+  neighborhoodRadius = 10.0;
+  neighborOffset = 0;
+  neighborCount = 0;
+  neighborEpoch = 0;
+  hasRouteTarget = false;
+  routeDestination = nullptr;
 
   // assign random maximal speed in m/s
   normal_distribution<double> distribution(1.34, 0.26);
   vmax = distribution(generator);
+  speedFactor = 1.0;
 
   forceFactorDesired = 1.0;
   forceFactorSocial = 2.1;
@@ -56,9 +64,21 @@ Ped::Tagent::~Tagent() {}
 void Ped::Tagent::assignScene(Ped::Tscene* sceneIn) { scene = sceneIn; }
 
 void Ped::Tagent::removeAgentFromNeighbors(const Ped::Tagent* agentIn) {
-  // search agent in neighbors, and remove him
-  set<const Ped::Tagent*>::iterator foundNeighbor = neighbors.find(agentIn);
-  if (foundNeighbor != neighbors.end()) neighbors.erase(foundNeighbor);
+  if (neighborCount == 0) return;
+
+  // search agent in neighbors, and mark his entry as removed
+  vector<const Ped::Tagent*>& arena = scene->neighborArena;
+  replace(arena.begin() + neighborOffset,
+          arena.begin() + neighborOffset + neighborCount, agentIn,
+          static_cast<const Ped::Tagent*>(nullptr));
+}
+
+/// Returns the first entry of this agent's neighbor span. The pointer is
+/// only valid until the neighbor arena grows, i.e. until the next agent
+/// updates its neighbors.
+const Ped::Tagent* const* Ped::Tagent::neighborsBegin() const {
+  if (neighborCount == 0) return nullptr;
+  return scene->neighborArena.data() + neighborOffset;
 }
 
 /// Sets the maximum velocity of an agent (vmax). Even if pushed by other
@@ -67,6 +87,13 @@ void Ped::Tagent::removeAgentFromNeighbors(const Ped::Tagent* agentIn) {
 /// by the simulation's precision h.
 void Ped::Tagent::setVmax(double pvmax) { vmax = pvmax; }
 
+/// Scales the maximum velocity temporarily, e.g. to slow down in dense
+/// crowds. getVmax() returns the scaled value.
+/// \param   factor between 0 and 1; 1 restores the full speed
+void Ped::Tagent::setSpeedFactor(double factor) {
+  speedFactor = max(0.0, min(1.0, factor));
+}
+
 /// Defines how much the position difference between this agent
 /// and a robot is scaled: the bigger the number is, the smaller
 /// the position based force contribution will be.
@@ -87,6 +114,8 @@ void Ped::Tagent::setPosition(double px, double py, double pz) {
   p.x = px;
   p.y = py;
   p.z = pz;
+  // → being placed isn't a step
+  lastPosition = p;
 }
 
 /// Sets the factor by which the desired force is multiplied. Values between 0
@@ -119,12 +148,49 @@ Ped::Tvector Ped::Tagent::desiredForce() {
     return antiMove;
   }
 
+  // head for an intermediate corner while the waypoint is hidden
+  // note: flow fields lead around obstacles on their own
+  TvisibilityGraph* graph = scene->getVisibilityGraph();
+  if ((graph != NULL) && (waypoint->getFlowField() == NULL) &&
+      updateRouteTarget(*graph, *waypoint)) {
+    desiredDirection = (routeTarget - p).normalized();
+    return (desiredDirection * getVmax() - v) / relaxationTime;
+  }
+
   // compute force
   Tvector force = waypoint->getForce(*this, &desiredDirection);
 
   return force;
 }
 
+/// Updates the corner the agent walks to on its way to the waypoint. The
+/// corner is kept as long as it is visible and still a bit away, so the route
+/// is only looked up again when a line-of-sight check fails or the corner is
+/// (almost) reached. Walls keep agents from reaching it exactly.
+/// \return  true if the agent should walk to routeTarget, false if it can
+/// head straight for the waypoint
+/// \param   graph the visibility graph of the scene
+/// \param   waypoint the agent's current destination
+bool Ped::Tagent::updateRouteTarget(Ped::TvisibilityGraph& graph,
+                                    const Ped::Twaypoint& waypoint) {
+  // a new destination requires a new route
+  if (routeDestination != &waypoint) {
+    routeDestination = &waypoint;
+    hasRouteTarget = false;
+  }
+
+  if (hasRouteTarget) {
+    const double reachedDistance = 2 * graph.getClearance();
+    const bool reached = (routeTarget - p).length() < reachedDistance;
+    if (!reached && graph.isVisible(p, routeTarget)) return true;
+  } else if (graph.isVisible(p, waypoint.getPosition())) {
+    return false;
+  }
+
+  hasRouteTarget = graph.getNextTarget(p, waypoint, &routeTarget);
+  return hasRouteTarget;
+}
+
 /// Calculates the social force between this agent and all the other agents
 /// belonging to the same scene.
 /// It iterates over all agents inside the scene, has therefore the complexity
@@ -151,12 +217,15 @@ Ped::Tvector Ped::Tagent::socialForce() const {
   const double n_prime = 3;
 
   Tvector force;
-  for (const Ped::Tagent* other : neighbors) {
+  const double cutoffSquared = neighborhoodRadius * neighborhoodRadius;
+  for (const Ped::Tagent* other : getNeighborRange()) {
     // don't compute social force to yourself
     if (other->id == id) continue;
 
     // compute difference between both agents' positions
+    // → the tree returns whole leaves, some of them beyond the radius
     Tvector diff = other->p - p;
+    if (diff.lengthSquared() > cutoffSquared) continue;
 
     if(other->getType() == ROBOT) diff /= robotPosDiffScalingFactor;
 
@@ -216,6 +285,14 @@ Ped::Tvector Ped::Tagent::obstacleForce() const {
     }
   }
 
+  // → polygons only if one is closer than the closest wall
+  Ped::Tvector closestPoint;
+  if (scene->getPolygons().getClosestPoint(p, sqrt(minDistanceSquared),
+                                           &closestPoint)) {
+    minDiff = p - closestPoint;
+    minDistanceSquared = minDiff.lengthSquared();
+  }
+
   double distance = sqrt(minDistanceSquared) - agentRadius;
   double forceAmount = exp(-distance / forceSigmaObstacle);
   return forceAmount * minDiff.normalized();
@@ -232,11 +309,21 @@ Ped::Tvector Ped::Tagent::myForce(Ped::Tvector e) const {
   return Ped::Tvector();
 }
 
+/// Looks up the agents around this one and stores them in the scene's
+/// neighbor arena. Called by computeForces() and by motion models.
+void Ped::Tagent::updateNeighbors() {
+  // → the span may still be reused, see Tscene::setNeighborReuse()
+  if (neighborEpoch == scene->neighborEpoch) return;
+  neighborEpoch = scene->neighborEpoch;
+
+  vector<const Ped::Tagent*>& arena = scene->neighborArena;
+  neighborOffset = arena.size();
+  scene->getNeighbors(arena, p.x, p.y, neighborhoodRadius);
+  neighborCount = arena.size() - neighborOffset;
+}
+
 void Ped::Tagent::computeForces() {
-  // update neighbors
-  // NOTE - have a config value for the neighbor range
-  const double neighborhoodRange = 10.0;
-  neighbors = scene->getNeighbors(p.x, p.y, neighborhoodRange);
+  updateNeighbors();
 
   // update forces
   desiredforce = desiredForce();
@@ -253,6 +340,8 @@ void Ped::Tagent::computeForces() {
 /// \param   stepSizeIn This tells the simulation how far the agent should
 /// proceed
 void Ped::Tagent::move(double stepSizeIn) {
+  lastPosition = p;
+
   // sum of all forces --> acceleration
   a = forceFactorDesired * desiredforce + forceFactorSocial * socialforce +
       forceFactorObstacle * obstacleforce + myforce;
@@ -264,11 +353,24 @@ void Ped::Tagent::move(double stepSizeIn) {
 
   // don't exceed maximal speed
   double speed = v.length();
-  if (speed > vmax) v = v.normalized() * vmax;
+  if (speed > getVmax()) v = v.normalized() * getVmax();
 
   // internal position update = actual move
   p += stepSizeIn * v;
 
+  // never end up inside a polygon, and stop walking into it
+  Ped::Tvector normal;
+  if (scene->getPolygons().keepOutside(&p, &normal)) {
+    double inward = Ped::Tvector::scalar(v, normal);
+    if (inward < 0) v -= inward * normal;
+  }
+
   // notice scene of movement
   scene->moveAgent(this);
 }
+
+/// Used instead of move() by agents whose position is set from outside,
+/// e.g. a robot following its pose source. Only tells the scene where the
+/// agent is; the position is neither integrated nor kept out of polygons,
+/// which would make it disagree with its source.
+void Ped::Tagent::keepPosition() { scene->moveAgent(this); }
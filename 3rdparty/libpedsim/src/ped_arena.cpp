@@ -0,0 +1,79 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#include "ped_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+/// \param   initialSize the size of the first block in bytes. The arena grows
+/// beyond it if required.
+Ped::Tarena::Tarena(size_t initialSize)
+    : currentBlock(0), offset(0), usedBytes(0), systemAllocations(0) {
+  addBlock(initialSize);
+  systemAllocations = 0;
+}
+
+Ped::Tarena::~Tarena() {
+  for (Tblock& block : blocks) delete[] block.data;
+}
+
+/// Returns uninitialized memory that stays valid until the next reset().
+/// \param   bytes the number of bytes requested
+/// \param   alignment the required alignment, a power of two
+void* Ped::Tarena::allocate(size_t bytes, size_t alignment) {
+  while (true) {
+    Tblock& block = blocks[currentBlock];
+    uintptr_t start = reinterpret_cast<uintptr_t>(block.data) + offset;
+    size_t padding = (alignment - (start % alignment)) % alignment;
+
+    if (offset + padding + bytes <= block.size) {
+      offset += padding + bytes;
+      usedBytes += padding + bytes;
+      return block.data + offset - bytes;
+    }
+
+    // → continue in the next block, or get a new one
+    if (currentBlock + 1 == blocks.size()) addBlock(bytes + alignment);
+    currentBlock++;
+    offset = 0;
+  }
+}
+
+/// Releases all allocations at once. Blocks added during the last step are
+/// merged, so the next step fits into a single block.
+void Ped::Tarena::reset() {
+  if (blocks.size() > 1) {
+    size_t totalSize = getCapacity();
+    for (Tblock& block : blocks) delete[] block.data;
+    blocks.clear();
+    addBlock(totalSize);
+  }
+
+  currentBlock = 0;
+  offset = 0;
+  usedBytes = 0;
+  systemAllocations = 0;
+}
+
+size_t Ped::Tarena::getCapacity() const {
+  size_t capacity = 0;
+  for (const Tblock& block : blocks) capacity += block.size;
+  return capacity;
+}
+
+void Ped::Tarena::addBlock(size_t minimumSize) {
+  // grow geometrically to keep the number of blocks per step small
+  size_t size = blocks.empty() ? minimumSize : blocks.back().size * 2;
+  size = max(size, minimumSize);
+
+  Tblock block;
+  block.data = new char[size];
+  block.size = size;
+  blocks.push_back(block);
+  systemAllocations++;
+}
@@ -0,0 +1,490 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#include "ped_continuum.h"
+#include "ped_flowfield.h"
+#include "ped_scene.h"
+#include "ped_waypoint.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+// mass below this is treated as empty cell
+const double CONTINUUM_EPSILON = 1e-9;
+}
+
+/// \param   leftIn, topIn the corner of the area covered by the grid
+/// \param   widthIn, heightIn the size of the area
+/// \param   cellSizeIn the edge length of a cell, in meters
+Ped::Tcontinuum::Tcontinuum(double leftIn, double topIn, double widthIn,
+                            double heightIn, double cellSizeIn)
+    : left(leftIn),
+      top(topIn),
+      cellSize(cellSizeIn),
+      vmax(1.34),
+      maxDensity(5.4),
+      roiLeft(0),
+      roiTop(0),
+      roiRight(-1),
+      roiBottom(-1) {
+  columns = max(1, (int)ceil(widthIn / cellSize));
+  rows = max(1, (int)ceil(heightIn / cellSize));
+
+  const size_t cellCount = columns * rows;
+  totals.resize(cellCount);
+  speeds.resize(cellCount);
+  inflow.resize(cellCount);
+  admission.resize(cellCount);
+  next.resize(cellCount);
+
+  // → open everywhere but at the border of the grid
+  passages.assign(cellCount, PASSAGE_RIGHT | PASSAGE_DOWN);
+  for (int row = 0; row < rows; ++row)
+    passages[getCellIndex(columns - 1, row)] &= ~PASSAGE_RIGHT;
+  for (int column = 0; column < columns; ++column)
+    passages[getCellIndex(column, rows - 1)] &= ~PASSAGE_DOWN;
+
+  updateCriticalDensity();
+}
+
+Ped::Tcontinuum::~Tcontinuum() {}
+
+/// Adds a density layer for the pedestrians heading to the given destination.
+/// \return  the index of the population
+size_t Ped::Tcontinuum::addPopulation(const Ped::Twaypoint* destination) {
+  Tpopulation population;
+  population.destination = destination;
+  population.mass.assign(columns * rows, 0);
+  population.entering.assign(columns * rows, 0);
+  population.momentum.assign(columns * rows, Ped::Tvector());
+  population.arrived = 0;
+  populations.push_back(population);
+  return populations.size() - 1;
+}
+
+/// \param   vmaxIn the speed of pedestrians in an empty cell
+void Ped::Tcontinuum::setVmax(double vmaxIn) {
+  vmax = vmaxIn;
+  updateCriticalDensity();
+}
+
+/// \param   densityIn pedestrians per square meter at which they stop
+void Ped::Tcontinuum::setMaxDensity(double densityIn) {
+  maxDensity = densityIn;
+  updateCriticalDensity();
+}
+
+const Ped::Twaypoint* Ped::Tcontinuum::getDestination(
+    size_t population) const {
+  if (population >= populations.size()) return NULL;
+  return populations[population].destination;
+}
+
+/// Sets the area that is simulated microscopically. Cells whose center lies
+/// inside never hold any mass: mass already there becomes entering mass,
+/// returned by takeEntering(). Fractions of entering mass left in cells that
+/// are outside now become mass again.
+void Ped::Tcontinuum::setRegionOfInterest(double leftIn, double topIn,
+                                          double widthIn, double heightIn) {
+  const int oldLeft = roiLeft, oldTop = roiTop;
+  const int oldRight = roiRight, oldBottom = roiBottom;
+  roiLeft = (int)ceil((leftIn - left) / cellSize - 0.5);
+  roiTop = (int)ceil((topIn - top) / cellSize - 0.5);
+  roiRight = (int)floor((leftIn + widthIn - left) / cellSize - 0.5);
+  roiBottom = (int)floor((topIn + heightIn - top) / cellSize - 0.5);
+
+  const double cellArea = cellSize * cellSize;
+  for (Tpopulation& population : populations) {
+    for (int row = max(0, oldTop); row <= min(rows - 1, oldBottom); ++row) {
+      for (int column = max(0, oldLeft); column <= min(columns - 1, oldRight);
+           ++column) {
+        if (isInRegionOfInterest(column, row)) continue;
+
+        const int index = getCellIndex(column, row);
+        population.mass[index] += population.entering[index];
+        population.entering[index] = 0;
+        population.momentum[index] = Ped::Tvector();
+      }
+    }
+
+    for (int row = max(0, roiTop); row <= min(rows - 1, roiBottom); ++row) {
+      for (int column = max(0, roiLeft); column <= min(columns - 1, roiRight);
+           ++column) {
+        const int index = getCellIndex(column, row);
+        const double mass = population.mass[index];
+        if (mass < CONTINUUM_EPSILON) continue;
+
+        // → it keeps walking the way it did in the continuum
+        const double speed = getSpeed(mass / cellArea);
+        population.entering[index] += mass;
+        population.momentum[index] +=
+            mass * speed * getDirection(population, column, row);
+        population.mass[index] = 0;
+      }
+    }
+  }
+}
+
+bool Ped::Tcontinuum::isInRegionOfInterest(double x, double y) const {
+  int column, row;
+  if (!getCell(x, y, &column, &row)) return false;
+
+  return isInRegionOfInterest(column, row);
+}
+
+/// Whether an agent at x/y can be handed over to the continuum. There is a
+/// margin of one cell around the region of interest, so agents walking along
+/// its border don't switch back and forth.
+bool Ped::Tcontinuum::isFarFromRegionOfInterest(double x, double y) const {
+  int column, row;
+  if (!getCell(x, y, &column, &row)) return false;
+
+  return (column < roiLeft - 1) || (column > roiRight + 1) ||
+         (row < roiTop - 1) || (row > roiBottom + 1);
+}
+
+/// Blocks the flow between neighboring cells whose centers are separated by
+/// a wall or a polygon of the scene.
+void Ped::Tcontinuum::updatePassages(const Ped::Tscene& scene) {
+  const Ped::Tvector areaMax(left + columns * cellSize, top + rows * cellSize);
+  updatePassages(scene, Ped::Tvector(left, top), areaMax);
+}
+
+/// Like updatePassages(scene), for the passages across the given area
+/// only, e.g. around an obstacle that moved.
+void Ped::Tcontinuum::updatePassages(const Ped::Tscene& scene,
+                                     const Ped::Tvector& areaMin,
+                                     const Ped::Tvector& areaMax) {
+  // → a passage starts in the cell left of or above the area, too
+  const int firstColumn =
+      max(0, (int)floor((areaMin.x - left) / cellSize) - 1);
+  const int firstRow = max(0, (int)floor((areaMin.y - top) / cellSize) - 1);
+  const int lastColumn =
+      min(columns - 1, (int)floor((areaMax.x - left) / cellSize));
+  const int lastRow = min(rows - 1, (int)floor((areaMax.y - top) / cellSize));
+
+  for (int row = firstRow; row <= lastRow; ++row) {
+    for (int column = firstColumn; column <= lastColumn; ++column) {
+      const Ped::Tvector center = getCellCenter(column, row);
+      unsigned char open = 0;
+      if ((column + 1 < columns) &&
+          scene.isVisible(center, getCellCenter(column + 1, row)))
+        open |= PASSAGE_RIGHT;
+      if ((row + 1 < rows) &&
+          scene.isVisible(center, getCellCenter(column, row + 1)))
+        open |= PASSAGE_DOWN;
+      passages[getCellIndex(column, row)] = open;
+    }
+  }
+}
+
+/// Adds pedestrians to a cell. Within the region of interest, they are
+/// entering mass, returned by takeEntering(), e.g. pedestrians that reached
+/// a waypoint there and continue their route as agents.
+/// \return  false if x/y is outside the grid
+bool Ped::Tcontinuum::deposit(size_t population, double x, double y,
+                              double mass) {
+  if (population >= populations.size()) return false;
+
+  int column, row;
+  if (!getCell(x, y, &column, &row)) return false;
+
+  const int index = getCellIndex(column, row);
+  if (isInRegionOfInterest(column, row))
+    populations[population].entering[index] += mass;
+  else
+    populations[population].mass[index] += mass;
+  return true;
+}
+
+/// Moves all populations by one time step. Each cell passes mass to its
+/// horizontal and vertical neighbors in the walking direction (first-order
+/// upwind scheme); the mass a cell receives is limited by its free capacity.
+/// \param   h the length of the time step, should be below cellSize/vmax
+void Ped::Tcontinuum::advance(double h) {
+  updateSpeeds();
+
+  const double capacity = maxDensity * cellSize * cellSize;
+  const size_t cellCount = columns * rows;
+
+  // → what the cells would receive
+  fill(inflow.begin(), inflow.end(), 0.0);
+  for (const Tpopulation& population : populations) {
+    for (int row = 0; row < rows; ++row) {
+      for (int column = 0; column < columns; ++column) {
+        const int index = getCellIndex(column, row);
+        const double mass = population.mass[index];
+        if (mass < CONTINUUM_EPSILON) continue;
+
+        Ped::Tvector direction = getDirection(population, column, row);
+        double fraction = speeds[index] * h / cellSize;
+        double fx = fraction * fabs(direction.x);
+        double fy = fraction * fabs(direction.y);
+        if (fx + fy > 1) {
+          fx /= fx + fy;
+          fy = 1 - fx;
+        }
+
+        int targetColumn = column + ((direction.x > 0) ? 1 : -1);
+        if ((fx > 0) && isPassable(column, row, targetColumn, row))
+          inflow[getCellIndex(targetColumn, row)] += mass * fx;
+        int targetRow = row + ((direction.y > 0) ? 1 : -1);
+        if ((fy > 0) && isPassable(column, row, column, targetRow))
+          inflow[getCellIndex(column, targetRow)] += mass * fy;
+      }
+    }
+  }
+
+  // → share of it they accept
+  // → a congested cell takes in only what its own flow passes on (supply)
+  const double cellArea = cellSize * cellSize;
+  for (size_t i = 0; i < cellCount; ++i) {
+    const double density = totals[i] / cellArea;
+    const double supply =
+        (density <= criticalDensity) ? maxFlow : density * getSpeed(density);
+    const double accepted =
+        min(max(0.0, capacity - totals[i]), supply * cellSize * h);
+    admission[i] = (inflow[i] > accepted) ? accepted / inflow[i] : 1;
+  }
+
+  // → actually move the mass
+  for (Tpopulation& population : populations) {
+    next = population.mass;
+    const Ped::Twaypoint* destination = population.destination;
+    const double reach = max(destination->getRadius(), 0.75 * cellSize);
+
+    for (int row = 0; row < rows; ++row) {
+      for (int column = 0; column < columns; ++column) {
+        const int index = getCellIndex(column, row);
+        const double mass = population.mass[index];
+        if (mass < CONTINUUM_EPSILON) continue;
+
+        // pedestrians at their destination leave the continuum
+        Ped::Tvector center = getCellCenter(column, row);
+        if ((center - destination->getPosition()).length() < reach) {
+          population.arrived += mass;
+          next[index] -= mass;
+          continue;
+        }
+
+        Ped::Tvector direction = getDirection(population, column, row);
+        Ped::Tvector velocity =
+            getSpeed(totals[index] / (cellSize * cellSize)) * direction;
+        double fraction = speeds[index] * h / cellSize;
+        double fx = fraction * fabs(direction.x);
+        double fy = fraction * fabs(direction.y);
+        if (fx + fy > 1) {
+          fx /= fx + fy;
+          fy = 1 - fx;
+        }
+
+        const int targets[2][2] = {
+            {column + ((direction.x > 0) ? 1 : -1), row},
+            {column, row + ((direction.y > 0) ? 1 : -1)}};
+        const double fractions[2] = {fx, fy};
+        for (int k = 0; k < 2; ++k) {
+          if (fractions[k] <= 0) continue;
+
+          // → blocked by a wall or the border, the mass stays
+          const int targetColumn = targets[k][0];
+          const int targetRow = targets[k][1];
+          if (!isPassable(column, row, targetColumn, targetRow)) continue;
+
+          const int target = getCellIndex(targetColumn, targetRow);
+          if (isInRegionOfInterest(targetColumn, targetRow)) {
+            // → the region of interest has no capacity limit here, the
+            // agents created from it avoid each other
+            const double amount = mass * fractions[k];
+            population.entering[target] += amount;
+            population.momentum[target] += amount * velocity;
+            next[index] -= amount;
+          } else {
+            const double amount = mass * fractions[k] * admission[target];
+            next[target] += amount;
+            next[index] -= amount;
+          }
+        }
+      }
+    }
+
+    population.mass.swap(next);
+  }
+}
+
+/// Returns the pedestrians that entered the region of interest as whole
+/// persons; fractions stay until they add up to one.
+/// \param   outputList the pedestrians are appended to this list
+void Ped::Tcontinuum::takeEntering(vector<Tentry>& outputList) {
+  if ((roiLeft > roiRight) || (roiTop > roiBottom)) return;
+
+  // → mass flows in at the border of the region, but the whole region
+  //   holds entering mass after it grew (see setRegionOfInterest())
+  const int firstRow = max(0, roiTop), lastRow = min(rows - 1, roiBottom);
+  const int firstColumn = max(0, roiLeft),
+            lastColumn = min(columns - 1, roiRight);
+  for (size_t p = 0; p < populations.size(); ++p) {
+    Tpopulation& population = populations[p];
+    for (int row = firstRow; row <= lastRow; ++row) {
+      for (int column = firstColumn; column <= lastColumn; ++column) {
+        const int index = getCellIndex(column, row);
+        double& entering = population.entering[index];
+        if (entering < 1) continue;
+
+        Tentry entry;
+        entry.population = p;
+        entry.position = getCellCenter(column, row);
+        entry.velocity = population.momentum[index] / entering;
+        while (entering >= 1) {
+          outputList.push_back(entry);
+          population.momentum[index] -= entry.velocity;
+          entering -= 1;
+        }
+      }
+    }
+  }
+}
+
+/// \return  the mass that reached the destination of the population since the
+/// last call
+double Ped::Tcontinuum::takeArrived(size_t population) {
+  if (population >= populations.size()) return 0;
+
+  double arrived = populations[population].arrived;
+  populations[population].arrived = 0;
+  return arrived;
+}
+
+/// \return  the number of pedestrians per square meter at x/y, summed over
+/// all populations (zero inside the region of interest)
+double Ped::Tcontinuum::getDensity(double x, double y) const {
+  int column, row;
+  if (!getCell(x, y, &column, &row)) return 0;
+
+  const int index = getCellIndex(column, row);
+  double mass = 0;
+  for (const Tpopulation& population : populations)
+    mass += population.mass[index];
+
+  return mass / (cellSize * cellSize);
+}
+
+/// \return  the mean velocity of the pedestrians at x/y
+Ped::Tvector Ped::Tcontinuum::getVelocity(double x, double y) const {
+  int column, row;
+  if (!getCell(x, y, &column, &row)) return Ped::Tvector();
+
+  const int index = getCellIndex(column, row);
+  double mass = 0;
+  Ped::Tvector momentum;
+  for (const Tpopulation& population : populations) {
+    if (population.mass[index] < CONTINUUM_EPSILON) continue;
+
+    mass += population.mass[index];
+    momentum += population.mass[index] * getDirection(population, column, row);
+  }
+  if (mass < CONTINUUM_EPSILON) return Ped::Tvector();
+
+  return getSpeed(mass / (cellSize * cellSize)) / mass * momentum;
+}
+
+double Ped::Tcontinuum::getMass(size_t population) const {
+  if (population >= populations.size()) return 0;
+
+  double mass = 0;
+  for (double cellMass : populations[population].mass) mass += cellMass;
+  return mass;
+}
+
+double Ped::Tcontinuum::getTotalMass() const {
+  double mass = 0;
+  for (size_t p = 0; p < populations.size(); ++p) mass += getMass(p);
+  return mass;
+}
+
+bool Ped::Tcontinuum::getCell(double x, double y, int* columnOut,
+                              int* rowOut) const {
+  int column = (int)floor((x - left) / cellSize);
+  int row = (int)floor((y - top) / cellSize);
+  if ((column < 0) || (column >= columns) || (row < 0) || (row >= rows))
+    return false;
+
+  *columnOut = column;
+  *rowOut = row;
+  return true;
+}
+
+/// \return  whether mass can flow between the two neighboring cells
+bool Ped::Tcontinuum::isPassable(int column, int row, int targetColumn,
+                                 int targetRow) const {
+  if ((targetColumn < 0) || (targetColumn >= columns) || (targetRow < 0) ||
+      (targetRow >= rows))
+    return false;
+
+  if (targetColumn != column) {
+    const int index = getCellIndex(min(column, targetColumn), row);
+    return (passages[index] & PASSAGE_RIGHT) != 0;
+  }
+  const int index = getCellIndex(column, min(row, targetRow));
+  return (passages[index] & PASSAGE_DOWN) != 0;
+}
+
+Ped::Tvector Ped::Tcontinuum::getCellCenter(int column, int row) const {
+  return Ped::Tvector(left + (column + 0.5) * cellSize,
+                      top + (row + 0.5) * cellSize);
+}
+
+/// The walking direction of a population in a cell: along the flow field of
+/// the destination, or straight towards it.
+Ped::Tvector Ped::Tcontinuum::getDirection(const Tpopulation& population,
+                                           int column, int row) const {
+  const Ped::Tvector center = getCellCenter(column, row);
+  const Ped::TflowField* field = population.destination->getFlowField();
+  Ped::Tvector direction;
+  if ((field != NULL) && field->getDirection(center, &direction))
+    return direction;
+
+  return (population.destination->getPosition() - center).normalized();
+}
+
+/// Walking speed at the given density (pedestrians per square meter),
+/// according to Weidmann's fundamental diagram.
+double Ped::Tcontinuum::getSpeed(double density) const {
+  if (density < CONTINUUM_EPSILON) return vmax;
+  if (density >= maxDensity) return 0;
+
+  return vmax * (1 - exp(-1.913 * (1 / density - 1 / maxDensity)));
+}
+
+/// The speed mass leaves the cells with. Beyond the critical density, a cell
+/// sends the maximal flow (demand), so jams dissolve from their front.
+void Ped::Tcontinuum::updateSpeeds() {
+  fill(totals.begin(), totals.end(), 0.0);
+  for (const Tpopulation& population : populations) {
+    for (size_t i = 0; i < totals.size(); ++i) totals[i] += population.mass[i];
+  }
+
+  const double cellArea = cellSize * cellSize;
+  for (size_t i = 0; i < totals.size(); ++i) {
+    const double density = totals[i] / cellArea;
+    speeds[i] = (density <= criticalDensity) ? getSpeed(density)
+                                             : maxFlow / density;
+  }
+}
+
+/// Finds the density with the maximal flow (density times speed).
+void Ped::Tcontinuum::updateCriticalDensity() {
+  criticalDensity = 0;
+  maxFlow = 0;
+  for (double density = 0.01; density < maxDensity; density += 0.01) {
+    const double flow = density * getSpeed(density);
+    if (flow > maxFlow) {
+      maxFlow = flow;
+      criticalDensity = density;
+    }
+  }
+}
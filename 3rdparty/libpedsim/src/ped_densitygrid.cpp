@@ -0,0 +1,142 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#include "ped_densitygrid.h"
+#include "ped_agent.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+/// \param   leftIn, topIn the corner of the area covered by the grid
+/// \param   widthIn, heightIn the size of the area
+/// \param   cellSizeIn the edge length of a cell, in meters
+Ped::TdensityGrid::TdensityGrid(double leftIn, double topIn, double widthIn,
+                                double heightIn, double cellSizeIn)
+    : left(leftIn), top(topIn), cellSize(cellSizeIn) {
+  columns = max(1, (int)ceil(widthIn / cellSize));
+  rows = max(1, (int)ceil(heightIn / cellSize));
+  clear();
+}
+
+Ped::TdensityGrid::~TdensityGrid() {}
+
+void Ped::TdensityGrid::clear() {
+  Tcell emptyCell;
+  emptyCell.count = 0;
+  emptyCell.occupiedSlot = -1;
+  cells.assign(columns * rows, emptyCell);
+  occupiedCells.clear();
+  contributions.clear();
+}
+
+void Ped::TdensityGrid::addAgent(const Ped::Tagent* agent) {
+  Tcontribution contribution;
+  contribution.cell = getCellIndex(agent->getx(), agent->gety());
+  contribution.velocity = agent->getVelocity();
+  if (contribution.cell >= 0)
+    addToCell(contribution.cell, contribution.velocity);
+
+  contributions[agent] = contribution;
+}
+
+bool Ped::TdensityGrid::removeAgent(const Ped::Tagent* agent) {
+  unordered_map<const Ped::Tagent*, Tcontribution>::iterator iter =
+      contributions.find(agent);
+  if (iter == contributions.end()) return false;
+
+  if (iter->second.cell >= 0)
+    removeFromCell(iter->second.cell, iter->second.velocity);
+  contributions.erase(iter);
+  return true;
+}
+
+/// Updates the cell of an agent after it moved. If it is still in the same
+/// cell, only the velocity sum changes.
+void Ped::TdensityGrid::moveAgent(const Ped::Tagent* agent) {
+  unordered_map<const Ped::Tagent*, Tcontribution>::iterator iter =
+      contributions.find(agent);
+  if (iter == contributions.end()) {
+    addAgent(agent);
+    return;
+  }
+
+  Tcontribution& contribution = iter->second;
+  const int cell = getCellIndex(agent->getx(), agent->gety());
+  const Ped::Tvector& velocity = agent->getVelocity();
+  if ((cell == contribution.cell) && (cell >= 0)) {
+    cells[cell].velocitySum += velocity - contribution.velocity;
+  } else {
+    if (contribution.cell >= 0)
+      removeFromCell(contribution.cell, contribution.velocity);
+    if (cell >= 0) addToCell(cell, velocity);
+  }
+
+  contribution.cell = cell;
+  contribution.velocity = velocity;
+}
+
+/// \return  the number of agents per square meter around x/y
+double Ped::TdensityGrid::getDensity(double x, double y) const {
+  const int index = getCellIndex(x, y);
+  if (index < 0) return 0;
+
+  return getDensity(index);
+}
+
+/// \return  the mean velocity of the agents around x/y
+Ped::Tvector Ped::TdensityGrid::getMeanVelocity(double x, double y) const {
+  const int index = getCellIndex(x, y);
+  if (index < 0) return Ped::Tvector();
+
+  return getMeanVelocity(index);
+}
+
+double Ped::TdensityGrid::getDensity(int index) const {
+  return cells[index].count / (cellSize * cellSize);
+}
+
+Ped::Tvector Ped::TdensityGrid::getMeanVelocity(int index) const {
+  const Tcell& cell = cells[index];
+  if (cell.count == 0) return Ped::Tvector();
+
+  return cell.velocitySum / cell.count;
+}
+
+int Ped::TdensityGrid::getCellIndex(double x, double y) const {
+  const int column = (int)floor((x - left) / cellSize);
+  const int row = (int)floor((y - top) / cellSize);
+  if ((column < 0) || (column >= columns) || (row < 0) || (row >= rows))
+    return -1;
+
+  return row * columns + column;
+}
+
+void Ped::TdensityGrid::addToCell(int index, const Ped::Tvector& velocity) {
+  Tcell& cell = cells[index];
+  if (cell.count == 0) {
+    cell.occupiedSlot = occupiedCells.size();
+    occupiedCells.push_back(index);
+  }
+  ++cell.count;
+  cell.velocitySum += velocity;
+}
+
+void Ped::TdensityGrid::removeFromCell(int index,
+                                       const Ped::Tvector& velocity) {
+  Tcell& cell = cells[index];
+  --cell.count;
+  cell.velocitySum -= velocity;
+  if (cell.count > 0) return;
+
+  // → the cell is empty, reset it and swap it out of the occupied list
+  cell.velocitySum = Ped::Tvector();
+  const int lastCell = occupiedCells.back();
+  occupiedCells[cell.occupiedSlot] = lastCell;
+  cells[lastCell].occupiedSlot = cell.occupiedSlot;
+  occupiedCells.pop_back();
+  cell.occupiedSlot = -1;
+}
@@ -0,0 +1,587 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#include "ped_flowfield.h"
+#include "ped_obstacle.h"
+#include "ped_polygons.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <queue>
+
+using namespace std;
+
+namespace {
+const uint32_t FLOWFIELD_MAGIC = 0x31464650;  // "PFF1"
+const float UNREACHABLE = numeric_limits<float>::infinity();
+
+// 8-neighborhood: column offset, row offset
+const int NEIGHBOR_COLUMNS[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+const int NEIGHBOR_ROWS[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+/// FNV-1a over the raw bytes of a value
+template <typename T>
+void hashValue(uint64_t& hash, const T& value) {
+  unsigned char bytes[sizeof(T)];
+  memcpy(bytes, &value, sizeof(T));
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+}
+}
+
+/// \param   left the smallest x coordinate covered by the field
+/// \param   top the smallest y coordinate covered by the field
+/// \param   width the extent of the field in x direction
+/// \param   height the extent of the field in y direction
+/// \param   cellSize the edge length of one grid cell
+Ped::TflowField::TflowField(double leftIn, double topIn, double width,
+                            double height, double cellSizeIn)
+    : left(leftIn),
+      top(topIn),
+      cellSize(cellSizeIn),
+      radius(0),
+      valid(false) {
+  columns = max(1, (int)ceil(width / cellSize));
+  rows = max(1, (int)ceil(height / cellSize));
+}
+
+Ped::TflowField::~TflowField() {}
+
+/// Sets the area the field leads to. Invalidates the field.
+/// \param   targetIn the center of the target area
+/// \param   radiusIn the radius of the target area
+void Ped::TflowField::setTarget(const Ped::Tvector& targetIn, double radiusIn) {
+  target = targetIn;
+  radius = radiusIn;
+  valid = false;
+}
+
+/// Computes the geodesic distances and walking directions. This is expensive
+/// and meant to be done once per target, not per time step.
+/// \param   obstacles the walls to walk around
+/// \param   clearance the distance agents keep from walls
+void Ped::TflowField::compute(const vector<Ped::Tobstacle*>& obstacles,
+                              double clearance,
+                              const Ped::Tpolygons* polygons) {
+  Twindow all = getAllCells();
+  blocked.assign(columns * rows, 0);
+  rasterizeObstacles(obstacles, clearance, all);
+  if (polygons != NULL) rasterizePolygons(*polygons, clearance, all);
+  computeDistances();
+  computeDirections(all);
+  valid = true;
+}
+
+/// Brings the field up to date after obstacles moved. Only the cells within
+/// the changed area are rasterized again, and only the distances depending
+/// on them are repaired; the result matches compute(), up to rounding.
+/// \param   obstacles all walls, at their new positions
+/// \param   clearance the distance agents keep from walls
+/// \param   changedMin, changedMax the corners of an area covering the moved
+///          obstacles, before and after they moved
+/// \param   polygons the closed polygons, if any
+void Ped::TflowField::update(const vector<Ped::Tobstacle*>& obstacles,
+                             double clearance,
+                             const Ped::Tvector& changedMin,
+                             const Ped::Tvector& changedMax,
+                             const Ped::Tpolygons* polygons) {
+  // → fields loaded from a file don't know their walls
+  if (!valid || blocked.empty()) {
+    compute(obstacles, clearance, polygons);
+    return;
+  }
+
+  double range = max(clearance, 0.75 * cellSize);
+  Twindow window = getWindow(changedMin.x - range, changedMin.y - range,
+                             changedMax.x + range, changedMax.y + range);
+  if (window.isEmpty()) return;
+
+  // rasterize the window again, remembering what it was before
+  vector<char> previous;
+  for (int row = window.row0; row <= window.row1; ++row) {
+    for (int column = window.column0; column <= window.column1; ++column) {
+      char& cell = blocked[getCellIndex(column, row)];
+      previous.push_back(cell);
+      cell = 0;
+    }
+  }
+  rasterizeObstacles(obstacles, clearance, window);
+  if (polygons != NULL) rasterizePolygons(*polygons, clearance, window);
+
+  vector<int> blockedCells;
+  vector<int> freedCells;
+  size_t i = 0;
+  for (int row = window.row0; row <= window.row1; ++row) {
+    for (int column = window.column0; column <= window.column1; ++column) {
+      int index = getCellIndex(column, row);
+      char before = previous[i++];
+      if (blocked[index] && !before) blockedCells.push_back(index);
+      if (!blocked[index] && before) freedCells.push_back(index);
+    }
+  }
+  if (blockedCells.empty() && freedCells.empty()) return;
+
+  Twindow changed;
+  if (!repairDistances(blockedCells, freedCells, &changed)) {
+    computeDistances();
+    computeDirections(getAllCells());
+    return;
+  }
+  for (int index : blockedCells)
+    changed.include(index % columns, index / columns);
+  for (int index : freedCells)
+    changed.include(index % columns, index / columns);
+
+  // → directions are derived from the neighbors' distances as well
+  changed.column0 = max(0, changed.column0 - 1);
+  changed.row0 = max(0, changed.row0 - 1);
+  changed.column1 = min(columns - 1, changed.column1 + 1);
+  changed.row1 = min(rows - 1, changed.row1 + 1);
+  computeDirections(changed);
+}
+
+/// Returns a hash of all inputs of compute(). Used to validate cached fields.
+uint64_t Ped::TflowField::getFingerprint(
+    const vector<Ped::Tobstacle*>& obstacles, double clearance,
+    const Ped::Tpolygons* polygons) const {
+  uint64_t hash = 14695981039346656037ULL;
+  hashValue(hash, FLOWFIELD_MAGIC);
+  hashValue(hash, left);
+  hashValue(hash, top);
+  hashValue(hash, cellSize);
+  hashValue(hash, columns);
+  hashValue(hash, rows);
+  hashValue(hash, target.x);
+  hashValue(hash, target.y);
+  hashValue(hash, radius);
+  hashValue(hash, clearance);
+  for (const Ped::Tobstacle* obstacle : obstacles) {
+    hashValue(hash, obstacle->getax());
+    hashValue(hash, obstacle->getay());
+    hashValue(hash, obstacle->getbx());
+    hashValue(hash, obstacle->getby());
+  }
+  for (size_t i = 0; polygons != NULL && i < polygons->getPolygonCount();
+       ++i) {
+    hashValue(hash, i);
+    for (const Ped::Tvector& corner : polygons->getCorners(i)) {
+      hashValue(hash, corner.x);
+      hashValue(hash, corner.y);
+    }
+  }
+  return hash;
+}
+
+/// Writes the distances to a file. Directions are derived again on load.
+/// \return  true on success
+bool Ped::TflowField::save(const string& fileName, uint64_t fingerprint) const {
+  if (!valid) return false;
+
+  ofstream file(fileName.c_str(), ios::binary | ios::trunc);
+  if (!file) return false;
+
+  file.write(reinterpret_cast<const char*>(&FLOWFIELD_MAGIC),
+             sizeof(FLOWFIELD_MAGIC));
+  file.write(reinterpret_cast<const char*>(&fingerprint), sizeof(fingerprint));
+  file.write(reinterpret_cast<const char*>(&columns), sizeof(columns));
+  file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+  file.write(reinterpret_cast<const char*>(distances.data()),
+             distances.size() * sizeof(float));
+  return file.good();
+}
+
+/// Reads distances written by save().
+/// \return  true if the file exists and matches the fingerprint
+bool Ped::TflowField::load(const string& fileName, uint64_t fingerprint) {
+  ifstream file(fileName.c_str(), ios::binary);
+  if (!file) return false;
+
+  uint32_t magic = 0;
+  uint64_t storedFingerprint = 0;
+  int storedColumns = 0;
+  int storedRows = 0;
+  file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+  file.read(reinterpret_cast<char*>(&storedFingerprint),
+            sizeof(storedFingerprint));
+  file.read(reinterpret_cast<char*>(&storedColumns), sizeof(storedColumns));
+  file.read(reinterpret_cast<char*>(&storedRows), sizeof(storedRows));
+  if (!file || (magic != FLOWFIELD_MAGIC) ||
+      (storedFingerprint != fingerprint) || (storedColumns != columns) ||
+      (storedRows != rows))
+    return false;
+
+  distances.resize(columns * rows);
+  file.read(reinterpret_cast<char*>(distances.data()),
+            distances.size() * sizeof(float));
+  if (!file) return false;
+
+  blocked.clear();
+  computeDirections(getAllCells());
+  valid = true;
+  return true;
+}
+
+/// Returns the walking direction at the given position, interpolated between
+/// the surrounding cells.
+/// \return  false if the field can't guide the agent there, i.e. outside the
+/// grid, unreachable, or already within the target area. The caller should
+/// head straight for the target then.
+bool Ped::TflowField::getDirection(const Ped::Tvector& position,
+                                   Ped::Tvector* directionOut) const {
+  if (!valid) return false;
+
+  int column, row;
+  if (!getCell(position, &column, &row)) return false;
+  if (distances[getCellIndex(column, row)] == 0) return false;
+
+  // bilinear interpolation between the centers of the four closest cells
+  double u = (position.x - left) / cellSize - 0.5;
+  double v = (position.y - top) / cellSize - 0.5;
+  int column0 = (int)floor(u);
+  int row0 = (int)floor(v);
+  double fu = u - column0;
+  double fv = v - row0;
+
+  double dx = 0;
+  double dy = 0;
+  for (int i = 0; i < 4; ++i) {
+    int c = column0 + (i & 1);
+    int r = row0 + (i >> 1);
+    if ((c < 0) || (c >= columns) || (r < 0) || (r >= rows)) continue;
+
+    double weight = ((i & 1) ? fu : 1 - fu) * ((i >> 1) ? fv : 1 - fv);
+    int index = getCellIndex(c, r);
+    dx += weight * directions[2 * index];
+    dy += weight * directions[2 * index + 1];
+  }
+
+  Ped::Tvector direction(dx, dy);
+  if (direction.lengthSquared() < 1e-12) return false;
+
+  *directionOut = direction.normalized();
+  return true;
+}
+
+/// \return  the geodesic distance to the target area, infinite if unknown
+double Ped::TflowField::getDistance(const Ped::Tvector& position) const {
+  int column, row;
+  if (!valid || !getCell(position, &column, &row))
+    return numeric_limits<double>::infinity();
+
+  return distances[getCellIndex(column, row)];
+}
+
+bool Ped::TflowField::getCell(const Ped::Tvector& position, int* columnOut,
+                              int* rowOut) const {
+  int column = (int)floor((position.x - left) / cellSize);
+  int row = (int)floor((position.y - top) / cellSize);
+  if ((column < 0) || (column >= columns) || (row < 0) || (row >= rows))
+    return false;
+
+  *columnOut = column;
+  *rowOut = row;
+  return true;
+}
+
+Ped::Tvector Ped::TflowField::getCellCenter(int column, int row) const {
+  return Ped::Tvector(left + (column + 0.5) * cellSize,
+                      top + (row + 0.5) * cellSize);
+}
+
+/// \return  the cells overlapping the given area, clipped to the grid
+Ped::TflowField::Twindow Ped::TflowField::getWindow(double minX, double minY,
+                                                    double maxX,
+                                                    double maxY) const {
+  Twindow window;
+  window.column0 = max(0, (int)floor((minX - left) / cellSize));
+  window.column1 = min(columns - 1, (int)floor((maxX - left) / cellSize));
+  window.row0 = max(0, (int)floor((minY - top) / cellSize));
+  window.row1 = min(rows - 1, (int)floor((maxY - top) / cellSize));
+  return window;
+}
+
+void Ped::TflowField::Twindow::include(int column, int row) {
+  if (isEmpty()) {
+    column0 = column1 = column;
+    row0 = row1 = row;
+    return;
+  }
+  column0 = min(column0, column);
+  column1 = max(column1, column);
+  row0 = min(row0, row);
+  row1 = max(row1, row);
+}
+
+/// Marks all cells within the window whose center is within the clearance of
+/// an obstacle. Only the cells within the bounding box of each obstacle are
+/// tested. The cells of the window must be cleared before.
+void Ped::TflowField::rasterizeObstacles(
+    const vector<Ped::Tobstacle*>& obstacles, double clearance,
+    const Twindow& window) {
+  // walls must not leak between diagonal cells
+  double range = max(clearance, 0.75 * cellSize);
+
+  for (const Ped::Tobstacle* obstacle : obstacles) {
+    Twindow cells =
+        getWindow(min(obstacle->getax(), obstacle->getbx()) - range,
+                  min(obstacle->getay(), obstacle->getby()) - range,
+                  max(obstacle->getax(), obstacle->getbx()) + range,
+                  max(obstacle->getay(), obstacle->getby()) + range);
+    cells.column0 = max(cells.column0, window.column0);
+    cells.column1 = min(cells.column1, window.column1);
+    cells.row0 = max(cells.row0, window.row0);
+    cells.row1 = min(cells.row1, window.row1);
+
+    for (int row = cells.row0; row <= cells.row1; ++row) {
+      for (int column = cells.column0; column <= cells.column1; ++column) {
+        Ped::Tvector center = getCellCenter(column, row);
+        Ped::Tvector diff = obstacle->closestPoint(center) - center;
+        if (diff.lengthSquared() <= range * range)
+          blocked[getCellIndex(column, row)] = 1;
+      }
+    }
+  }
+}
+
+/// Marks all cells within the window whose center is inside a polygon or
+/// within the clearance of its outline.
+void Ped::TflowField::rasterizePolygons(const Ped::Tpolygons& polygons,
+                                        double clearance,
+                                        const Twindow& window) {
+  double range = max(clearance, 0.75 * cellSize);
+
+  for (size_t polygon = 0; polygon < polygons.getPolygonCount(); ++polygon) {
+    Ped::Tvector minCorner, maxCorner;
+    polygons.getBounds(polygon, &minCorner, &maxCorner);
+    Twindow cells = getWindow(minCorner.x - range, minCorner.y - range,
+                              maxCorner.x + range, maxCorner.y + range);
+    cells.column0 = max(cells.column0, window.column0);
+    cells.column1 = min(cells.column1, window.column1);
+    cells.row0 = max(cells.row0, window.row0);
+    cells.row1 = min(cells.row1, window.row1);
+
+    for (int row = cells.row0; row <= cells.row1; ++row) {
+      for (int column = cells.column0; column <= cells.column1; ++column) {
+        int index = getCellIndex(column, row);
+        if (blocked[index]) continue;
+
+        Ped::Tvector center = getCellCenter(column, row);
+        if (polygons.contains(polygon, center) ||
+            (polygons.getDistance(polygon, center) <= range))
+          blocked[index] = 1;
+      }
+    }
+  }
+}
+
+/// Dijkstra on the 8-connected grid, starting from all free cells within the
+/// target area.
+void Ped::TflowField::computeDistances() {
+  distances.assign(columns * rows, UNREACHABLE);
+
+  vector<pair<float, int> > open;
+
+  // seed the target area
+  // → at least the cell containing the target, even if it touches a wall
+  double seedRadius = max(radius, 0.5 * cellSize);
+  Twindow seeds = getWindow(target.x - seedRadius, target.y - seedRadius,
+                            target.x + seedRadius, target.y + seedRadius);
+  for (int row = seeds.row0; row <= seeds.row1; ++row) {
+    for (int column = seeds.column0; column <= seeds.column1; ++column) {
+      int index = getCellIndex(column, row);
+      Ped::Tvector diff = getCellCenter(column, row) - target;
+      if (blocked[index] || (diff.length() > seedRadius)) continue;
+
+      distances[index] = 0;
+      open.push_back(make_pair(0.0f, index));
+    }
+  }
+  int targetColumn, targetRow;
+  if (open.empty() && getCell(target, &targetColumn, &targetRow)) {
+    int index = getCellIndex(targetColumn, targetRow);
+    distances[index] = 0;
+    open.push_back(make_pair(0.0f, index));
+  }
+
+  propagateDistances(open, NULL);
+}
+
+/// Repairs the distances after the given cells were blocked or freed.
+/// Distances that led through newly blocked cells are dropped first; then
+/// the free cells bordering them, and the freed cells, are expanded again.
+/// \return  false if the target area is affected; compute from scratch then
+bool Ped::TflowField::repairDistances(const vector<int>& blockedCells,
+                                      const vector<int>& freedCells,
+                                      Twindow* changedOut) {
+  const float diagonal = (float)(sqrt(2.0) * cellSize);
+  const float tolerance = (float)(1e-3 * cellSize);
+  auto forNeighbors = [this](int index, const function<void(int, int)>& f) {
+    int column = index % columns;
+    int row = index / columns;
+    for (int i = 0; i < 8; ++i) {
+      int c = column + NEIGHBOR_COLUMNS[i];
+      int r = row + NEIGHBOR_ROWS[i];
+      if ((c < 0) || (c >= columns) || (r < 0) || (r >= rows)) continue;
+      f(getCellIndex(c, r), i);
+    }
+  };
+
+  for (int index : blockedCells) {
+    if (distances[index] == 0) return false;
+  }
+  double seedRadius = max(radius, 0.5 * cellSize);
+  for (int index : freedCells) {
+    Ped::Tvector diff =
+        getCellCenter(index % columns, index / columns) - target;
+    if (diff.length() <= seedRadius) return false;
+  }
+
+  // drop the distances that may depend on newly blocked cells
+  // → their neighbors too, diagonal steps past a blocked cell are forbidden
+  vector<int> pending;
+  for (int index : blockedCells) {
+    pending.push_back(index);
+    forNeighbors(index, [&pending](int neighbor, int) {
+      pending.push_back(neighbor);
+    });
+  }
+  vector<int> dropped;
+  while (!pending.empty()) {
+    int index = pending.back();
+    pending.pop_back();
+    float distance = distances[index];
+    if ((distance == UNREACHABLE) || (distance == 0)) continue;
+
+    distances[index] = UNREACHABLE;
+    dropped.push_back(index);
+    forNeighbors(index, [&](int neighbor, int i) {
+      float step = (i >= 4) ? diagonal : (float)cellSize;
+      if (distances[neighbor] >= distance + step - tolerance)
+        pending.push_back(neighbor);
+    });
+  }
+
+  // expand again from the cells that kept their distance
+  // → freed cells may shorten paths, also diagonally past them
+  vector<pair<float, int> > open;
+  auto reopen = [&](int index) {
+    if (distances[index] != UNREACHABLE)
+      open.push_back(make_pair(distances[index], index));
+  };
+  for (int index : dropped) {
+    changedOut->include(index % columns, index / columns);
+    forNeighbors(index, [&reopen](int neighbor, int) { reopen(neighbor); });
+  }
+  for (int index : freedCells) {
+    forNeighbors(index, [&reopen](int neighbor, int) { reopen(neighbor); });
+  }
+
+  propagateDistances(open, changedOut);
+  return true;
+}
+
+/// Expands the given cells in order of their distance, lowering the distance
+/// of their neighbors where a shorter path is found.
+/// \param   changedOut extended by all cells with a new distance, if given
+void Ped::TflowField::propagateDistances(vector<pair<float, int> >& seeds,
+                                         Twindow* changedOut) {
+  typedef pair<float, int> Tentry;
+  priority_queue<Tentry, vector<Tentry>, greater<Tentry> > open(
+      greater<Tentry>(), std::move(seeds));
+
+  const float diagonal = (float)(sqrt(2.0) * cellSize);
+  while (!open.empty()) {
+    Tentry entry = open.top();
+    open.pop();
+    int index = entry.second;
+    if (entry.first > distances[index]) continue;
+
+    int column = index % columns;
+    int row = index / columns;
+    for (int i = 0; i < 8; ++i) {
+      int c = column + NEIGHBOR_COLUMNS[i];
+      int r = row + NEIGHBOR_ROWS[i];
+      if ((c < 0) || (c >= columns) || (r < 0) || (r >= rows)) continue;
+
+      int neighbor = getCellIndex(c, r);
+      if (blocked[neighbor]) continue;
+
+      // → don't cut corners
+      bool isDiagonal = (i >= 4);
+      if (isDiagonal && (blocked[getCellIndex(c, row)] ||
+                         blocked[getCellIndex(column, r)]))
+        continue;
+
+      float distance =
+          distances[index] + (isDiagonal ? diagonal : (float)cellSize);
+      if (distance < distances[neighbor]) {
+        distances[neighbor] = distance;
+        open.push(Tentry(distance, neighbor));
+        if (changedOut != NULL) changedOut->include(c, r);
+      }
+    }
+  }
+}
+
+/// Derives the walking direction as the negative distance gradient. Cells
+/// without a clear gradient point to their closest neighbor instead; this
+/// also leads agents out of blocked cells next to walls.
+/// \param   window the cells to derive again, the others are kept
+void Ped::TflowField::computeDirections(const Twindow& window) {
+  directions.resize(2 * columns * rows, 0);
+
+  auto distanceAt = [this](int c, int r, float fallback) {
+    if ((c < 0) || (c >= columns) || (r < 0) || (r >= rows)) return fallback;
+    float distance = distances[getCellIndex(c, r)];
+    return (distance == UNREACHABLE) ? fallback : distance;
+  };
+
+  for (int row = window.row0; row <= window.row1; ++row) {
+    for (int column = window.column0; column <= window.column1; ++column) {
+      int index = getCellIndex(column, row);
+      directions[2 * index] = 0;
+      directions[2 * index + 1] = 0;
+      float distance = distances[index];
+      // → target area: no guidance required
+      if (distance == 0) continue;
+
+      Ped::Tvector direction;
+      if (distance != UNREACHABLE) {
+        direction.x = distanceAt(column - 1, row, distance) -
+                      distanceAt(column + 1, row, distance);
+        direction.y = distanceAt(column, row - 1, distance) -
+                      distanceAt(column, row + 1, distance);
+      }
+
+      // a central difference has a length of about two cells; much less
+      // means a ridge (e.g. right behind a wall), where the sides disagree
+      if (direction.length() < cellSize) {
+        // → head for the closest neighbor
+        direction = Ped::Tvector();
+        float minDistance = distance;
+        for (int i = 0; i < 8; ++i) {
+          int c = column + NEIGHBOR_COLUMNS[i];
+          int r = row + NEIGHBOR_ROWS[i];
+          float neighborDistance = distanceAt(c, r, UNREACHABLE);
+          if (neighborDistance < minDistance) {
+            minDistance = neighborDistance;
+            direction = Ped::Tvector(NEIGHBOR_COLUMNS[i], NEIGHBOR_ROWS[i]);
+          }
+        }
+      }
+
+      if (direction.lengthSquared() < 1e-12) continue;
+      direction.normalize();
+      directions[2 * index] = (float)direction.x;
+      directions[2 * index + 1] = (float)direction.y;
+    }
+  }
+}
@@ -0,0 +1,276 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#include "ped_fork.h"
+#include "ped_motionmodel.h"
+#include "ped_obstacle.h"
+#include "ped_waypoint.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+using namespace std;
+
+namespace {
+/// Scene of a fork; it uses the snapshot's obstacles, obstacle index and
+/// polygons instead of its own copies.
+class TforkScene : public Ped::Tscene {
+ public:
+  TforkScene(double left, double top, double width, double height,
+             const vector<Ped::Tobstacle*>& obstaclesIn,
+             const Ped::TsegmentGrid& obstacleIndexIn,
+             const Ped::Tpolygons& polygonsIn)
+      : Ped::Tscene(left, top, width, height) {
+    obstacles = obstaclesIn;
+    obstacleLookup = &obstacleIndexIn;
+    polygonLookup = &polygonsIn;
+  }
+};
+}
+
+Ped::TforkAgent::TforkAgent(const Ped::Tagent& agentIn,
+                            const Ped::Twaypoint* waypointIn)
+    : Ped::Tagent(agentIn), waypoint(waypointIn) {
+  // the copy belongs to no scene until a fork adds it to its own
+  scene = NULL;
+  neighborOffset = 0;
+  neighborCount = 0;
+  neighborEpoch = 0;
+  hasRouteTarget = false;
+  routeDestination = NULL;
+}
+
+/// Takes a snapshot of the scene's agents, obstacles and motion models.
+/// \param   scene the live scene
+/// \param   pageSizeIn number of agents that are copied together
+Ped::TsceneSnapshot::TsceneSnapshot(const Ped::Tscene& scene,
+                                    size_t pageSizeIn)
+    : pageSize(max<size_t>(pageSizeIn, 1)), agentCount(0) {
+  double minX = 0, minY = 0, maxX = 0, maxY = 0;
+  bool empty = true;
+  auto extend = [&](const Tvector& point) {
+    if (empty) {
+      minX = maxX = point.x;
+      minY = maxY = point.y;
+      empty = false;
+      return;
+    }
+    minX = min(minX, point.x);
+    maxX = max(maxX, point.x);
+    minY = min(minY, point.y);
+    maxY = max(maxY, point.y);
+  };
+
+  for (const Tobstacle* obstacle : scene.getAllObstacles()) {
+    Tobstacle* copy = new Tobstacle(*obstacle);
+    obstacles.push_back(copy);
+    obstacleIndex.addObstacle(copy);
+    extend(copy->getStartPoint());
+    extend(copy->getEndPoint());
+  }
+  // → stored contiguously, a plain copy
+  polygons = scene.getPolygons();
+  for (size_t i = 0; i < polygons.getPolygonCount(); ++i) {
+    for (const Tvector& corner : polygons.getCorners(i)) extend(corner);
+  }
+
+  // → order the agents by cell, so that the agents of a page are close to
+  //   each other and forks with an active region copy few pages
+  vector<const Tagent*> agents(scene.getAllAgents().begin(),
+                               scene.getAllAgents().end());
+  const double cellSize = 10;
+  auto cellOf = [cellSize](const Tagent* agent) {
+    return make_pair(floor(agent->gety() / cellSize),
+                     floor(agent->getx() / cellSize));
+  };
+  stable_sort(agents.begin(), agents.end(),
+              [&](const Tagent* a, const Tagent* b) {
+                return cellOf(a) < cellOf(b);
+              });
+
+  agentCount = agents.size();
+  int maxType = 0;
+  Tpage page;
+  page.reserve(pageSize);
+  for (const Tagent* agent : agents) {
+    // → waypoints are copied once, the flow fields are shared
+    const Twaypoint* waypoint = agent->getCurrentWaypoint();
+    Twaypoint* waypointCopy = NULL;
+    if (waypoint != NULL) {
+      auto iter = waypoints.find(waypoint);
+      if (iter == waypoints.end())
+        iter = waypoints.insert(make_pair(waypoint, waypoint->clone())).first;
+      waypointCopy = iter->second;
+    }
+
+    page.push_back(TforkAgent(*agent, waypointCopy));
+    if (page.size() == pageSize) {
+      pages.push_back(make_shared<const Tpage>(move(page)));
+      page = Tpage();
+      page.reserve(pageSize);
+    }
+
+    extend(agent->getPosition());
+    maxType = max(maxType, (int)agent->getType());
+  }
+  if (!page.empty()) pages.push_back(make_shared<const Tpage>(move(page)));
+
+  for (int type = 0; type <= maxType; ++type) {
+    const TmotionModel* model = scene.getMotionModel(type);
+    motionModels.push_back((model != NULL) ? model->clone() : NULL);
+  }
+
+  // → leave room for the agents to walk
+  const double margin = 20;
+  left = minX - margin;
+  top = minY - margin;
+  width = maxX - minX + 2 * margin;
+  height = maxY - minY + 2 * margin;
+}
+
+Ped::TsceneSnapshot::~TsceneSnapshot() {
+  for (TmotionModel* model : motionModels) delete model;
+  for (auto& waypoint : waypoints) delete waypoint.second;
+  for (Tobstacle* obstacle : obstacles) delete obstacle;
+}
+
+/// Creates a fork in which all agents of the snapshot move.
+/// \param   snapshotIn the common starting point
+/// \param   seed start of the fork's random number stream
+Ped::TsceneFork::TsceneFork(
+    const shared_ptr<const Ped::TsceneSnapshot>& snapshotIn, unsigned int seed)
+    : snapshot(snapshotIn),
+      pages(snapshotIn->pages),
+      copiedPages(snapshotIn->pages.size(), NULL),
+      active(snapshotIn->getAgentCount(), true),
+      randomEngine(seed),
+      noiseSigma(0),
+      time(0) {}
+
+/// Creates a fork in which only the agents starting within the given
+/// circle move. The others are neither simulated nor seen by the moving
+/// agents, so the radius should exceed the agents' interaction range.
+/// \param   snapshotIn the common starting point
+/// \param   seed start of the fork's random number stream
+/// \param   center center of the active region, e.g. the robot's position
+/// \param   radius radius of the active region
+Ped::TsceneFork::TsceneFork(
+    const shared_ptr<const Ped::TsceneSnapshot>& snapshotIn, unsigned int seed,
+    const Ped::Tvector& center, double radius)
+    : TsceneFork(snapshotIn, seed) {
+  const double radiusSquared = radius * radius;
+  for (size_t i = 0; i < active.size(); ++i) {
+    const Tvector diff = getAgent(i).getPosition() - center;
+    active[i] = (diff.x * diff.x + diff.y * diff.y <= radiusSquared);
+  }
+}
+
+Ped::TsceneFork::~TsceneFork() {
+  // the scene must go before the agents and models it refers to
+  scene.reset();
+  for (TmotionModel* model : motionModels) delete model;
+}
+
+/// \return  the index of the agent with the given id, or getAgentCount()
+size_t Ped::TsceneFork::findAgent(int id) const {
+  const size_t count = getAgentCount();
+  for (size_t i = 0; i < count; ++i)
+    if (getAgent(i).getId() == id) return i;
+  return count;
+}
+
+const Ped::Tagent& Ped::TsceneFork::getAgent(size_t index) const {
+  const size_t pageSize = snapshot->getPageSize();
+  return (*pages[index / pageSize])[index % pageSize];
+}
+
+/// Gives access to an agent, e.g. to apply a candidate robot action, and
+/// copies its page if it is still shared. Changes to agents outside the
+/// active region have no effect on the simulation.
+Ped::Tagent& Ped::TsceneFork::getAgentForWriting(size_t index) {
+  return getWritable(index);
+}
+
+Ped::TforkAgent& Ped::TsceneFork::getWritable(size_t index) {
+  const size_t pageSize = snapshot->getPageSize();
+  const size_t pageIndex = index / pageSize;
+  if (copiedPages[pageIndex] == NULL) {
+    shared_ptr<Tpage> copy = make_shared<Tpage>(*pages[pageIndex]);
+    copiedPages[pageIndex] = copy.get();
+    pages[pageIndex] = copy;
+  }
+  return (*copiedPages[pageIndex])[index % pageSize];
+}
+
+size_t Ped::TsceneFork::getCopiedPageCount() const {
+  return count_if(copiedPages.begin(), copiedPages.end(),
+                  [](const Tpage* page) { return page != NULL; });
+}
+
+/// Copies the pages of the active agents and puts these into the fork's own
+/// scene.
+void Ped::TsceneFork::setup() {
+  scene.reset(new TforkScene(snapshot->left, snapshot->top, snapshot->width,
+                             snapshot->height, snapshot->obstacles,
+                             snapshot->obstacleIndex, snapshot->polygons));
+
+  for (size_t type = 0; type < snapshot->motionModels.size(); ++type) {
+    const TmotionModel* prototype = snapshot->motionModels[type];
+    if (prototype == NULL) continue;
+    TmotionModel* model = prototype->clone();
+    motionModels.push_back(model);
+    scene->setMotionModel(type, model);
+  }
+
+  for (size_t i = 0; i < active.size(); ++i) {
+    if (!active[i]) continue;
+    TforkAgent* agent = &getWritable(i);
+    activeAgents.push_back(agent);
+    scene->addAgent(agent);
+  }
+}
+
+/// Moves the active agents one time step ahead.
+void Ped::TsceneFork::step(double h) {
+  if (scene == NULL) setup();
+
+  if (noiseSigma > 0) {
+    for (TforkAgent* agent : activeAgents) {
+      const double noiseX = noiseSigma * noiseDistribution(randomEngine);
+      const double noiseY = noiseSigma * noiseDistribution(randomEngine);
+      agent->setNoise(Tvector(noiseX, noiseY));
+    }
+  }
+
+  scene->moveAgents(h);
+  time += h;
+}
+
+/// Steps several forks of the same snapshot, spread over threads.
+/// \param   forks the forks to step
+/// \param   duration how far to step them, in seconds
+/// \param   h the time step
+/// \param   threadCount number of threads, 0 for one per hardware thread
+void Ped::TsceneFork::run(const vector<Ped::TsceneFork*>& forks,
+                          double duration, double h,
+                          unsigned int threadCount) {
+  if (threadCount == 0) threadCount = max(1u, thread::hardware_concurrency());
+  threadCount = (unsigned int)min<size_t>(threadCount, forks.size());
+
+  atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < forks.size(); i = next++) {
+      const double end = forks[i]->getTime() + duration - 1e-9;
+      while (forks[i]->getTime() < end) forks[i]->step(h);
+    }
+  };
+
+  vector<thread> threads;
+  for (unsigned int i = 1; i < threadCount; ++i) threads.emplace_back(worker);
+  worker();
+  for (thread& t : threads) t.join();
+}
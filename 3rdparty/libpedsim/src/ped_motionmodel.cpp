@@ -0,0 +1,12 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#include "ped_motionmodel.h"
+#include "ped_agent.h"
+
+void Ped::TsocialForceModel::computeForces(const vector<Ped::Tagent*>& agents,
+                                           double) {
+  for (Ped::Tagent* agent : agents) agent->computeForces();
+}
@@ -0,0 +1,374 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#include "ped_orca.h"
+#include "ped_agent.h"
+#include "ped_obstacle.h"
+#include "ped_scene.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+const double ORCA_EPSILON = 1e-5;
+
+/// determinant of the 2x2 matrix [a b]
+double det(const Ped::Tvector& a, const Ped::Tvector& b) {
+  return a.x * b.y - a.y * b.x;
+}
+
+double dot(const Ped::Tvector& a, const Ped::Tvector& b) {
+  return a.x * b.x + a.y * b.y;
+}
+
+// don't wake up threads for only a few agents
+const size_t MIN_AGENTS_PER_THREAD = 64;
+}
+
+/// \param   timeHorizonIn how far ahead (in seconds) collisions with other
+/// agents are avoided
+/// \param   obstacleTimeHorizonIn the same for obstacles
+/// \param   maxNeighborsIn the number of closest neighbors taken into account
+/// \param   threadCountIn the number of threads, 0 for one per core
+Ped::TorcaModel::TorcaModel(double timeHorizonIn, double obstacleTimeHorizonIn,
+                            size_t maxNeighborsIn, unsigned int threadCountIn)
+    : timeHorizon(timeHorizonIn),
+      obstacleTimeHorizon(obstacleTimeHorizonIn),
+      maxNeighbors(maxNeighborsIn) {
+  setThreadCount(threadCountIn);
+}
+
+Ped::TorcaModel::~TorcaModel() {}
+
+/// The copy runs on a single thread; it is meant for rollouts, which are
+/// parallelized as a whole.
+Ped::TmotionModel* Ped::TorcaModel::clone() const {
+  return new TorcaModel(timeHorizon, obstacleTimeHorizon, maxNeighbors, 1);
+}
+
+void Ped::TorcaModel::setThreadCount(unsigned int threadCountIn) {
+  workers.reset(new TworkerPool(threadCountIn));
+  threadCount = workers->getThreadCount();
+  scratchSpaces.resize(threadCount);
+}
+
+void Ped::TorcaModel::computeForces(const vector<Ped::Tagent*>& agents,
+                                    double h) {
+  // preferred velocities and neighbors
+  // note: waypoint handling isn't thread-safe, so do this first
+  preferredVelocities.resize(agents.size());
+  for (size_t i = 0; i < agents.size(); ++i) {
+    Ped::Tagent* agent = agents[i];
+    agent->updateNeighbors();
+    agent->desiredforce = agent->desiredForce();
+    preferredVelocities[i] = agent->desiredDirection * agent->getVmax();
+  }
+
+  // new velocities, in parallel
+  newVelocities.resize(agents.size());
+  size_t workerCount = min<size_t>(
+      threadCount, max<size_t>(1, agents.size() / MIN_AGENTS_PER_THREAD));
+  size_t chunkSize = (agents.size() + workerCount - 1) / workerCount;
+  // → one chunk per scratch space
+  workers->run(workerCount, [&](size_t w) {
+    size_t begin = w * chunkSize;
+    size_t end = min(agents.size(), begin + chunkSize);
+    computeVelocities(agents, begin, end, h, scratchSpaces[w]);
+  });
+
+  // express the velocity change as force, Tagent::move() applies it
+  // → the desired force is kept for visualization and compensated
+  for (size_t i = 0; i < agents.size(); ++i) {
+    Ped::Tagent* agent = agents[i];
+    agent->socialforce = Ped::Tvector();
+    agent->obstacleforce = Ped::Tvector();
+    agent->myforce = (newVelocities[i] - agent->v) / h -
+                     agent->forceFactorDesired * agent->desiredforce;
+  }
+}
+
+void Ped::TorcaModel::computeVelocities(const vector<Ped::Tagent*>& agents,
+                                        size_t begin, size_t end, double h,
+                                        Tscratch& scratch) {
+  for (size_t i = begin; i < end; ++i)
+    newVelocities[i] =
+        computeVelocity(*agents[i], preferredVelocities[i], h, scratch);
+}
+
+/// Selects the new velocity of one agent. Only reads the state of the agents,
+/// so it can run for several agents at once.
+Ped::Tvector Ped::TorcaModel::computeVelocity(const Ped::Tagent& agent,
+                                              const Ped::Tvector& preferred,
+                                              double h,
+                                              Tscratch& scratch) const {
+  const Ped::Tvector& p = agent.p;
+  const Ped::Tvector& v = agent.v;
+  const double radius = agent.agentRadius;
+  const double maxSpeed = agent.getVmax();
+  vector<Tline>& lines = scratch.lines;
+  lines.clear();
+
+  // obstacles first, they are hard constraints
+  // → a wall is represented by its point closest to the agent
+  const double obstacleRange = obstacleTimeHorizon * maxSpeed + radius;
+  scratch.obstacles.clear();
+  agent.scene->getObstacles(scratch.obstacles, p.x, p.y, obstacleRange);
+  for (const Ped::Tobstacle* obstacle : scratch.obstacles) {
+    Ped::Tvector relativePosition = obstacle->closestPoint(p) - p;
+    if (relativePosition.lengthSquared() > obstacleRange * obstacleRange)
+      continue;
+
+    lines.push_back(getAvoidanceLine(v, relativePosition, v, radius,
+                                     obstacleTimeHorizon, h, 1.0));
+  }
+  scratch.polygonPoints.clear();
+  agent.scene->getPolygons().getClosestPoints(scratch.polygonPoints, p,
+                                              obstacleRange);
+  for (const Ped::Tvector& point : scratch.polygonPoints) {
+    lines.push_back(getAvoidanceLine(v, point - p, v, radius,
+                                     obstacleTimeHorizon, h, 1.0));
+  }
+  const size_t numObstLines = lines.size();
+
+  // the closest neighbors
+  const double neighborRange = timeHorizon * 2 * maxSpeed + 2 * radius;
+  scratch.neighbors.clear();
+  for (const Ped::Tagent* other : agent.getNeighborRange()) {
+    if (other == &agent) continue;
+
+    double distanceSquared = (other->p - p).lengthSquared();
+    if (distanceSquared < neighborRange * neighborRange)
+      scratch.neighbors.push_back(make_pair(distanceSquared, other));
+  }
+  if (scratch.neighbors.size() > maxNeighbors) {
+    nth_element(scratch.neighbors.begin(),
+                scratch.neighbors.begin() + maxNeighbors,
+                scratch.neighbors.end());
+    scratch.neighbors.resize(maxNeighbors);
+  }
+
+  for (const pair<double, const Ped::Tagent*>& neighbor : scratch.neighbors) {
+    const Ped::Tagent& other = *neighbor.second;
+    // externally driven agents don't avoid anybody; take all the effort
+    const double responsibility = other.teleop ? 1.0 : 0.5;
+    lines.push_back(getAvoidanceLine(v, other.p - p, v - other.v,
+                                     radius + other.agentRadius, timeHorizon,
+                                     h, responsibility));
+  }
+
+  // select the velocity closest to the preferred one
+  Ped::Tvector result;
+  size_t lineFail = linearProgram2(lines, maxSpeed, preferred, false, result);
+  if (lineFail < lines.size())
+    linearProgram3(lines, numObstLines, lineFail, maxSpeed, result,
+                   scratch.projectedLines);
+
+  return result;
+}
+
+/// Computes the half-plane of permitted velocities with respect to one other
+/// agent or obstacle point.
+/// \param   velocity the agent's current velocity
+/// \param   relativePosition position of the other one, relative to the agent
+/// \param   relativeVelocity the agent's velocity relative to the other one
+/// \param   combinedRadius the distance at which both collide
+/// \param   horizon the time ahead collisions are avoided
+/// \param   h the length of the time step, used when already colliding
+/// \param   responsibility the share of the avoidance the agent takes
+Ped::TorcaModel::Tline Ped::TorcaModel::getAvoidanceLine(
+    const Ped::Tvector& velocity, const Ped::Tvector& relativePosition,
+    const Ped::Tvector& relativeVelocity, double combinedRadius,
+    double horizon, double h, double responsibility) const {
+  Tline line;
+  Ped::Tvector u;
+  const double distanceSquared = relativePosition.lengthSquared();
+  const double combinedRadiusSquared = combinedRadius * combinedRadius;
+
+  if (distanceSquared > combinedRadiusSquared) {
+    // no collision yet
+    const double invHorizon = 1.0 / horizon;
+    // → vector from the cutoff center to the relative velocity
+    Ped::Tvector w = relativeVelocity - invHorizon * relativePosition;
+    const double wLengthSquared = w.lengthSquared();
+    const double dotProduct = dot(w, relativePosition);
+
+    if ((dotProduct < 0) &&
+        (dotProduct * dotProduct > combinedRadiusSquared * wLengthSquared)) {
+      // → project on the cutoff circle
+      const double wLength = sqrt(wLengthSquared);
+      Ped::Tvector unitW = w / wLength;
+      line.direction = Ped::Tvector(unitW.y, -unitW.x);
+      u = (combinedRadius * invHorizon - wLength) * unitW;
+    } else {
+      // → project on the legs of the cone
+      const double leg = sqrt(distanceSquared - combinedRadiusSquared);
+      if (det(relativePosition, w) > 0) {
+        // left leg
+        line.direction = Ped::Tvector(
+            relativePosition.x * leg - relativePosition.y * combinedRadius,
+            relativePosition.x * combinedRadius + relativePosition.y * leg);
+      } else {
+        // right leg
+        line.direction = -Ped::Tvector(
+            relativePosition.x * leg + relativePosition.y * combinedRadius,
+            -relativePosition.x * combinedRadius + relativePosition.y * leg);
+      }
+      line.direction /= distanceSquared;
+      u = dot(relativeVelocity, line.direction) * line.direction -
+          relativeVelocity;
+    }
+  } else {
+    // already colliding: resolve within one time step
+    const double invTimeStep = 1.0 / h;
+    Ped::Tvector w = relativeVelocity - invTimeStep * relativePosition;
+    const double wLength = w.length();
+    Ped::Tvector unitW =
+        (wLength > ORCA_EPSILON) ? w / wLength : -relativePosition.normalized();
+    line.direction = Ped::Tvector(unitW.y, -unitW.x);
+    u = (combinedRadius * invTimeStep - wLength) * unitW;
+  }
+
+  line.point = velocity + responsibility * u;
+  return line;
+}
+
+/// Solves a one-dimensional linear program on the given line, subject to the
+/// lines before it and the speed circle.
+/// \return  false if the program is infeasible
+bool Ped::TorcaModel::linearProgram1(const vector<Tline>& lines, size_t lineNo,
+                                     double radius,
+                                     const Ped::Tvector& optVelocity,
+                                     bool directionOpt, Ped::Tvector& result) {
+  const Tline& line = lines[lineNo];
+  const double dotProduct = dot(line.point, line.direction);
+  const double discriminant =
+      dotProduct * dotProduct + radius * radius - line.point.lengthSquared();
+
+  // the speed circle fully invalidates the line
+  if (discriminant < 0) return false;
+
+  const double sqrtDiscriminant = sqrt(discriminant);
+  double tLeft = -dotProduct - sqrtDiscriminant;
+  double tRight = -dotProduct + sqrtDiscriminant;
+
+  for (size_t i = 0; i < lineNo; ++i) {
+    const double denominator = det(line.direction, lines[i].direction);
+    const double numerator =
+        det(lines[i].direction, line.point - lines[i].point);
+
+    if (fabs(denominator) <= ORCA_EPSILON) {
+      // → parallel lines
+      if (numerator < 0) return false;
+      continue;
+    }
+
+    const double t = numerator / denominator;
+    if (denominator >= 0)
+      tRight = min(tRight, t);
+    else
+      tLeft = max(tLeft, t);
+
+    if (tLeft > tRight) return false;
+  }
+
+  if (directionOpt) {
+    // optimize direction
+    if (dot(optVelocity, line.direction) > 0)
+      result = line.point + tRight * line.direction;
+    else
+      result = line.point + tLeft * line.direction;
+  } else {
+    // optimize closest point
+    const double t = dot(line.direction, optVelocity - line.point);
+    if (t < tLeft)
+      result = line.point + tLeft * line.direction;
+    else if (t > tRight)
+      result = line.point + tRight * line.direction;
+    else
+      result = line.point + t * line.direction;
+  }
+
+  return true;
+}
+
+/// Solves the two-dimensional linear program: the velocity closest to
+/// optVelocity within the speed circle that satisfies all lines.
+/// \return  the number of the line it fails on, lines.size() on success
+size_t Ped::TorcaModel::linearProgram2(const vector<Tline>& lines,
+                                       double radius,
+                                       const Ped::Tvector& optVelocity,
+                                       bool directionOpt,
+                                       Ped::Tvector& result) {
+  if (directionOpt) {
+    // optVelocity is a unit vector here
+    result = optVelocity * radius;
+  } else if (optVelocity.lengthSquared() > radius * radius) {
+    result = optVelocity.normalized() * radius;
+  } else {
+    result = optVelocity;
+  }
+
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (det(lines[i].direction, lines[i].point - result) > 0) {
+      // the result violates line i
+      const Ped::Tvector tempResult = result;
+      if (!linearProgram1(lines, i, radius, optVelocity, directionOpt,
+                          result)) {
+        result = tempResult;
+        return i;
+      }
+    }
+  }
+
+  return lines.size();
+}
+
+/// Fallback if the program is infeasible: minimizes the maximal violation of
+/// the agent lines, keeping the obstacle lines satisfied.
+void Ped::TorcaModel::linearProgram3(const vector<Tline>& lines,
+                                     size_t numObstLines, size_t beginLine,
+                                     double radius, Ped::Tvector& result,
+                                     vector<Tline>& projectedLines) {
+  double distance = 0;
+
+  for (size_t i = beginLine; i < lines.size(); ++i) {
+    if (det(lines[i].direction, lines[i].point - result) <= distance) continue;
+
+    // the result violates line i more than the current distance
+    projectedLines.assign(lines.begin(), lines.begin() + numObstLines);
+
+    for (size_t j = numObstLines; j < i; ++j) {
+      Tline line;
+      const double determinant = det(lines[i].direction, lines[j].direction);
+
+      if (fabs(determinant) <= ORCA_EPSILON) {
+        // → parallel lines
+        if (dot(lines[i].direction, lines[j].direction) > 0) continue;
+        line.point = 0.5 * (lines[i].point + lines[j].point);
+      } else {
+        line.point = lines[i].point +
+                     (det(lines[j].direction, lines[i].point - lines[j].point) /
+                      determinant) *
+                         lines[i].direction;
+      }
+
+      line.direction = (lines[j].direction - lines[i].direction).normalized();
+      projectedLines.push_back(line);
+    }
+
+    const Ped::Tvector tempResult = result;
+    const Ped::Tvector optDirection(-lines[i].direction.y,
+                                    lines[i].direction.x);
+    if (linearProgram2(projectedLines, radius, optDirection, true, result) <
+        projectedLines.size()) {
+      // should not happen, the result is in the feasible region already
+      result = tempResult;
+    }
+
+    distance = det(lines[i].direction, lines[i].point - result);
+  }
+}
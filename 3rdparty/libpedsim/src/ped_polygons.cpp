@@ -0,0 +1,266 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#include "ped_polygons.h"
+#include "ped_obstacle.h"
+#include "ped_segmentgrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+namespace {
+// edges evaluated per batch, see getClosestEdge()
+const size_t BATCH_SIZE = 16;
+}
+
+Ped::Tpolygons::Tpolygons() { firstEdge.push_back(0); }
+
+void Ped::Tpolygons::clear() {
+  startX.clear();
+  startY.clear();
+  edgeX.clear();
+  edgeY.clear();
+  inverseLengthSquared.clear();
+  firstEdge.assign(1, 0);
+  minX.clear();
+  minY.clear();
+  maxX.clear();
+  maxY.clear();
+}
+
+/// Adds a closed ring; the last corner is connected to the first one.
+/// \param   corners at least three corners, in either orientation
+/// \return  the index of the polygon
+size_t Ped::Tpolygons::addPolygon(const vector<Ped::Tvector>& corners) {
+  double left = numeric_limits<double>::infinity();
+  double top = left;
+  double right = -left;
+  double bottom = -left;
+  for (size_t i = 0; i < corners.size(); ++i) {
+    const Ped::Tvector& a = corners[i];
+    const Ped::Tvector& b = corners[(i + 1) % corners.size()];
+    Ped::Tvector edge = b - a;
+    // → repeated corners add nothing
+    if (edge.lengthSquared() < 1e-12) continue;
+
+    startX.push_back(a.x);
+    startY.push_back(a.y);
+    edgeX.push_back(edge.x);
+    edgeY.push_back(edge.y);
+    inverseLengthSquared.push_back(1.0 / edge.lengthSquared());
+    left = min(left, a.x);
+    top = min(top, a.y);
+    right = max(right, a.x);
+    bottom = max(bottom, a.y);
+  }
+
+  firstEdge.push_back(startX.size());
+  minX.push_back(left);
+  minY.push_back(top);
+  maxX.push_back(right);
+  maxY.push_back(bottom);
+  return minX.size() - 1;
+}
+
+vector<Ped::Tvector> Ped::Tpolygons::getCorners(size_t polygon) const {
+  vector<Ped::Tvector> corners;
+  for (size_t i = firstEdge[polygon]; i < firstEdge[polygon + 1]; ++i)
+    corners.push_back(Ped::Tvector(startX[i], startY[i]));
+  return corners;
+}
+
+/// Expands a polygon into walls, one per edge. The caller owns them.
+void Ped::Tpolygons::getEdges(vector<Ped::Tobstacle*>& outputList,
+                              size_t polygon) const {
+  for (size_t i = firstEdge[polygon]; i < firstEdge[polygon + 1]; ++i) {
+    outputList.push_back(new Ped::Tobstacle(
+        startX[i], startY[i], startX[i] + edgeX[i], startY[i] + edgeY[i]));
+  }
+}
+
+/// \return  true if the point is inside any of the polygons
+bool Ped::Tpolygons::contains(const Ped::Tvector& point) const {
+  for (size_t polygon = 0; polygon < minX.size(); ++polygon) {
+    if (contains(polygon, point)) return true;
+  }
+  return false;
+}
+
+/// Even-odd rule: counts the edges crossed by a ray towards +x.
+bool Ped::Tpolygons::contains(size_t polygon, const Ped::Tvector& point) const {
+  if (!isNear(polygon, point, 0)) return false;
+
+  bool inside = false;
+  for (size_t i = firstEdge[polygon]; i < firstEdge[polygon + 1]; ++i) {
+    double ay = startY[i];
+    double by = ay + edgeY[i];
+    if ((ay > point.y) == (by > point.y)) continue;
+
+    double crossingX = startX[i] + (point.y - ay) / edgeY[i] * edgeX[i];
+    if (point.x < crossingX) inside = !inside;
+  }
+  return inside;
+}
+
+/// \return  true if the line from/to crosses the outline of any polygon
+bool Ped::Tpolygons::intersects(const Ped::Tvector& from,
+                                const Ped::Tvector& to) const {
+  for (size_t polygon = 0; polygon < minX.size(); ++polygon) {
+    if ((max(from.x, to.x) < minX[polygon]) ||
+        (min(from.x, to.x) > maxX[polygon]) ||
+        (max(from.y, to.y) < minY[polygon]) ||
+        (min(from.y, to.y) > maxY[polygon]))
+      continue;
+
+    for (size_t i = firstEdge[polygon]; i < firstEdge[polygon + 1]; ++i) {
+      Ped::Tvector start(startX[i], startY[i]);
+      Ped::Tvector end(startX[i] + edgeX[i], startY[i] + edgeY[i]);
+      if (Ped::TsegmentGrid::intersects(from, to, start, end)) return true;
+    }
+  }
+  return false;
+}
+
+/// Finds the closest point on the outline of any polygon.
+/// \param   maxDistance polygons farther away are skipped
+/// \return  false if there is no polygon within maxDistance
+bool Ped::Tpolygons::getClosestPoint(const Ped::Tvector& point,
+                                     double maxDistance,
+                                     Ped::Tvector* closestOut) const {
+  double bestDistanceSquared = maxDistance * maxDistance;
+  size_t bestEdge = startX.size();
+  for (size_t polygon = 0; polygon < minX.size(); ++polygon) {
+    if (!isNear(polygon, point, maxDistance)) continue;
+
+    double distanceSquared;
+    size_t edge = getClosestEdge(polygon, point, &distanceSquared);
+    if (distanceSquared <= bestDistanceSquared) {
+      bestDistanceSquared = distanceSquared;
+      bestEdge = edge;
+    }
+  }
+
+  if (bestEdge == startX.size()) return false;
+  *closestOut = getPointOnEdge(bestEdge, point);
+  return true;
+}
+
+/// Finds the closest point on the outline of each polygon within
+/// maxDistance. Polygons act like walls represented by that point, see
+/// TorcaModel.
+void Ped::Tpolygons::getClosestPoints(vector<Ped::Tvector>& outputList,
+                                      const Ped::Tvector& point,
+                                      double maxDistance) const {
+  for (size_t polygon = 0; polygon < minX.size(); ++polygon) {
+    if (!isNear(polygon, point, maxDistance)) continue;
+
+    double distanceSquared;
+    size_t edge = getClosestEdge(polygon, point, &distanceSquared);
+    if (distanceSquared <= maxDistance * maxDistance)
+      outputList.push_back(getPointOnEdge(edge, point));
+  }
+}
+
+/// \return  the distance to the outline of the polygon, also from inside
+double Ped::Tpolygons::getDistance(size_t polygon,
+                                   const Ped::Tvector& point) const {
+  double distanceSquared;
+  getClosestEdge(polygon, point, &distanceSquared);
+  return sqrt(distanceSquared);
+}
+
+/// Moves a point that ended up inside a polygon onto its closest edge.
+/// \param   normalOut the direction the point was moved in, if it was
+/// \return  true if the point was moved
+bool Ped::Tpolygons::keepOutside(Ped::Tvector* point,
+                                 Ped::Tvector* normalOut) const {
+  for (size_t polygon = 0; polygon < minX.size(); ++polygon) {
+    if (!contains(polygon, *point)) continue;
+
+    double distanceSquared;
+    size_t edge = getClosestEdge(polygon, *point, &distanceSquared);
+    Ped::Tvector outline = getPointOnEdge(edge, *point);
+    // → slightly beyond the outline, so that it tests as outside
+    Ped::Tvector normal = (outline - *point).normalized();
+    if (normal.lengthSquared() < 1e-12) {
+      // → on the outline already, leave perpendicular to the edge
+      normal = Ped::Tvector(edgeY[edge], -edgeX[edge]).normalized();
+      if (contains(polygon, outline + 1e-3 * normal)) normal = -normal;
+    }
+    *point = outline + 1e-3 * normal;
+    *normalOut = normal;
+    return true;
+  }
+  return false;
+}
+
+void Ped::Tpolygons::getBounds(size_t polygon, Ped::Tvector* minOut,
+                               Ped::Tvector* maxOut) const {
+  *minOut = Ped::Tvector(minX[polygon], minY[polygon]);
+  *maxOut = Ped::Tvector(maxX[polygon], maxY[polygon]);
+}
+
+/// \return  true if the point is within distance of the polygon's bounds
+bool Ped::Tpolygons::isNear(size_t polygon, const Ped::Tvector& point,
+                            double distance) const {
+  return (point.x >= minX[polygon] - distance) &&
+         (point.x <= maxX[polygon] + distance) &&
+         (point.y >= minY[polygon] - distance) &&
+         (point.y <= maxY[polygon] + distance);
+}
+
+/// The distances to a batch of edges are computed without branches into a
+/// small buffer first; that loop is vectorized (see the compile flags in
+/// CMakeLists.txt), the selection of the minimum afterwards isn't.
+size_t Ped::Tpolygons::getClosestEdge(size_t polygon,
+                                      const Ped::Tvector& point,
+                                      double* distanceSquaredOut) const {
+  const size_t end = firstEdge[polygon + 1];
+  size_t bestEdge = firstEdge[polygon];
+  double bestDistanceSquared = numeric_limits<double>::infinity();
+
+  double distancesSquared[BATCH_SIZE];
+  for (size_t first = firstEdge[polygon]; first < end; first += BATCH_SIZE) {
+    const size_t count = min(BATCH_SIZE, end - first);
+    const double* sx = &startX[first];
+    const double* sy = &startY[first];
+    const double* ex = &edgeX[first];
+    const double* ey = &edgeY[first];
+    const double* il = &inverseLengthSquared[first];
+    for (size_t i = 0; i < count; ++i) {
+      double px = point.x - sx[i];
+      double py = point.y - sy[i];
+      double t = (px * ex[i] + py * ey[i]) * il[i];
+      t = (t > 0.0) ? t : 0.0;
+      t = (t < 1.0) ? t : 1.0;
+      double dx = px - t * ex[i];
+      double dy = py - t * ey[i];
+      distancesSquared[i] = dx * dx + dy * dy;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+      if (distancesSquared[i] < bestDistanceSquared) {
+        bestDistanceSquared = distancesSquared[i];
+        bestEdge = first + i;
+      }
+    }
+  }
+
+  *distanceSquaredOut = bestDistanceSquared;
+  return bestEdge;
+}
+
+Ped::Tvector Ped::Tpolygons::getPointOnEdge(size_t edge,
+                                            const Ped::Tvector& point) const {
+  double px = point.x - startX[edge];
+  double py = point.y - startY[edge];
+  double t = (px * edgeX[edge] + py * edgeY[edge]) * inverseLengthSquared[edge];
+  t = max(0.0, min(1.0, t));
+  return Ped::Tvector(startX[edge] + t * edgeX[edge],
+                      startY[edge] + t * edgeY[edge]);
+}
@@ -0,0 +1,123 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#include "ped_rollout.h"
+#include "ped_agent.h"
+#include "ped_motionmodel.h"
+#include "ped_obstacle.h"
+#include "ped_waypoint.h"
+
+#include <cmath>
+
+using namespace std;
+
+namespace {
+/// Copy of an agent heading to a copy of its current waypoint
+class TrolloutAgent : public Ped::Tagent {
+ public:
+  TrolloutAgent(const Ped::Tagent& agentIn) : Ped::Tagent(agentIn) {
+    // the copy belongs to no scene until it is added to one
+    scene = NULL;
+    neighborOffset = 0;
+    neighborCount = 0;
+    neighborEpoch = 0;
+    hasRouteTarget = false;
+    routeDestination = NULL;
+
+    const Ped::Twaypoint* waypointIn = agentIn.getCurrentWaypoint();
+    if (waypointIn != NULL) {
+      waypoint = waypointIn->clone();
+      waypoint->setFlowField(nullptr);
+    } else {
+      waypoint = NULL;
+    }
+  }
+
+  Ped::Twaypoint* getCurrentWaypoint() const { return waypoint; }
+  Ped::Twaypoint* takeWaypoint() {
+    Ped::Twaypoint* result = waypoint;
+    waypoint = NULL;
+    return result;
+  }
+
+ private:
+  Ped::Twaypoint* waypoint;
+};
+}
+
+Ped::Trollout::Trollout() : sampleInterval(0) {}
+
+Ped::Trollout::~Trollout() { clear(); }
+
+void Ped::Trollout::clear() {
+  // the scene deletes the agents, obstacles and waypoints
+  scene.clear();
+  for (TmotionModel* model : motionModels) delete model;
+  motionModels.clear();
+
+  agentIds.clear();
+  agentTypes.clear();
+  trajectories.clear();
+}
+
+/// Adds a copy of the agent, with its current position, velocity,
+/// parameters and waypoint.
+void Ped::Trollout::addAgent(const Ped::Tagent& agent) {
+  TrolloutAgent* copy = new TrolloutAgent(agent);
+
+  // → the scene takes the waypoint copy, too
+  Ped::Twaypoint* waypoint = copy->getCurrentWaypoint();
+  if (waypoint != NULL) scene.addWaypoint(waypoint);
+  scene.addAgent(copy);
+
+  agentIds.push_back(agent.getId());
+  agentTypes.push_back(agent.getType());
+}
+
+void Ped::Trollout::addObstacle(const Ped::Tobstacle& obstacle) {
+  scene.addObstacle(new Ped::Tobstacle(obstacle));
+}
+
+void Ped::Trollout::addPolygon(const vector<Ped::Tvector>& corners) {
+  scene.addPolygon(corners);
+}
+
+/// Uses a copy of the given motion model for the agents of a type, like
+/// Tscene::setMotionModel().
+void Ped::Trollout::setMotionModel(int agentType,
+                                   const Ped::TmotionModel& model) {
+  TmotionModel* copy = model.clone();
+  motionModels.push_back(copy);
+  scene.setMotionModel(agentType, copy);
+}
+
+/// Simulates the copies.
+/// \param   horizon how far to look ahead, in seconds
+/// \param   h the time step
+/// \param   sampleIntervalIn time between two trajectory points
+void Ped::Trollout::run(double horizon, double h, double sampleIntervalIn) {
+  sampleInterval = sampleIntervalIn;
+
+  const vector<Tagent*>& agents = scene.getAllAgents();
+  const size_t sampleCount = (size_t)floor(horizon / sampleInterval + 1e-9);
+  trajectories.assign(agents.size(), vector<Tvector>());
+  for (vector<Tvector>& trajectory : trajectories)
+    trajectory.reserve(sampleCount);
+
+  double time = 0;
+  double nextSample = sampleInterval;
+  for (size_t sample = 0; sample < sampleCount;) {
+    scene.moveAgents(h);
+    time += h;
+
+    // → record all samples passed in this step
+    while ((sample < sampleCount) && (time + 1e-9 >= nextSample)) {
+      for (size_t i = 0; i < agents.size(); ++i)
+        trajectories[i].push_back(agents[i]->getPosition());
+      ++sample;
+      nextSample += sampleInterval;
+    }
+  }
+}
@@ -5,20 +5,30 @@
 
 #include "ped_scene.h"
 #include "ped_agent.h"
+#include "ped_densitygrid.h"
+#include "ped_motionmodel.h"
 #include "ped_obstacle.h"
 #include "ped_tree.h"
+#include "ped_visibilitygraph.h"
 #include "ped_waypoint.h"
 
 #include <algorithm>
 #include <cstddef>
-#include <stack>
 
 using namespace std;
 
 /// Default constructor. If this constructor is used, there will be no quadtree
 /// created.
 /// This is faster for small scenarios or less than 1000 Tagents.
-Ped::Tscene::Tscene() : tree(NULL) {}
+Ped::Tscene::Tscene()
+    : tree(NULL),
+      visibilityGraph(NULL),
+      densityGrid(NULL),
+      obstacleLookup(&obstacleIndex),
+      polygonLookup(&polygons),
+      neighborReuse(1),
+      neighborAge(0),
+      neighborEpoch(1) {}
 
 /// Constructor used to create a quadtree statial representation of the Tagents.
 /// Use this
@@ -35,25 +45,43 @@ Ped::Tscene::Tscene() : tree(NULL) {}
 /// right.
 /// \param height is the total height of the boundary. Basically from top to
 /// down.
-Ped::Tscene::Tscene(double left, double top, double width, double height) {
+Ped::Tscene::Tscene(double left, double top, double width, double height)
+    : visibilityGraph(NULL),
+      densityGrid(NULL),
+      obstacleLookup(&obstacleIndex),
+      polygonLookup(&polygons),
+      neighborReuse(1),
+      neighborAge(0),
+      neighborEpoch(1) {
   tree = new Ped::Ttree(this, 0, left, top, width, height);
 }
 
 /// Destructor
-Ped::Tscene::~Tscene() { delete tree; }
+Ped::Tscene::~Tscene() {
+  delete tree;
+  for (Ped::Tobstacle* edge : polygonEdges) delete edge;
+}
 
 void Ped::Tscene::clear() {
   // clear tree
   treehash.clear();
-  tree->clear();
+  if (tree != NULL) tree->clear();
 
   // remove all agents
   for (Ped::Tagent* currentAgent : agents) delete currentAgent;
   agents.clear();
+  neighborArena.clear();
+  ++neighborEpoch;
+  if (densityGrid != NULL) densityGrid->clear();
 
   // remove all obstacles
+  if (visibilityGraph != NULL) visibilityGraph->clear();
+  obstacleIndex.clear();
   for (Ped::Tobstacle* currentObstacle : obstacles) delete currentObstacle;
   obstacles.clear();
+  for (Ped::Tobstacle* edge : polygonEdges) delete edge;
+  polygonEdges.clear();
+  polygons.clear();
 
   // remove all waypoints
   for (Ped::Twaypoint* currentWaypoint : waypoints) delete currentWaypoint;
@@ -70,6 +98,24 @@ void Ped::Tscene::addAgent(Ped::Tagent* a) {
   agents.push_back(a);
   a->assignScene(this);
   if (tree != NULL) tree->addAgent(a);
+  if (densityGrid != NULL) densityGrid->addAgent(a);
+}
+
+/// Adds a closed polygon, see Tpolygons.
+/// \param   corners the corners of the ring, at least three
+/// \return  the index of the polygon
+size_t Ped::Tscene::addPolygon(const vector<Ped::Tvector>& corners) {
+  size_t polygon = polygons.addPolygon(corners);
+
+  // route around it
+  if (visibilityGraph != NULL) {
+    size_t first = polygonEdges.size();
+    polygons.getEdges(polygonEdges, polygon);
+    for (size_t i = first; i < polygonEdges.size(); ++i)
+      visibilityGraph->addObstacle(polygonEdges[i]);
+  }
+
+  return polygon;
 }
 
 /// Used to add a Tobstacle to the Tscene.
@@ -81,6 +127,10 @@ void Ped::Tscene::addObstacle(Ped::Tobstacle* o) {
   // add obstacle to scene
   // (take responsibility for object deletion)
   obstacles.push_back(o);
+  obstacleIndex.addObstacle(o);
+
+  // route around it
+  if (visibilityGraph != NULL) visibilityGraph->addObstacle(o);
 }
 
 void Ped::Tscene::addWaypoint(Ped::Twaypoint* w) {
@@ -97,10 +147,13 @@ bool Ped::Tscene::removeAgent(Ped::Tagent* a) {
   if (agentIter == agents.end()) return false;
 
   // remove agent as potential neighbor
-  for (Tagent* currentAgent : agents) currentAgent->removeAgentFromNeighbors(a);
+  replace(neighborArena.begin(), neighborArena.end(),
+          static_cast<const Ped::Tagent*>(a),
+          static_cast<const Ped::Tagent*>(nullptr));
 
   // remove agent from the tree
   if (tree != NULL) tree->removeAgent(a);
+  if (densityGrid != NULL) densityGrid->removeAgent(a);
 
   // remove agent from the scene and delete it, report succesful removal
   agents.erase(agentIter);
@@ -117,6 +170,8 @@ bool Ped::Tscene::removeObstacle(Ped::Tobstacle* o) {
   if (obstacleIter == obstacles.end()) return false;
 
   // remove obstacle from the scene and delete it, report succesful removal
+  if (visibilityGraph != NULL) visibilityGraph->removeObstacle(o);
+  obstacleIndex.removeObstacle(o);
   obstacles.erase(obstacleIter);
   delete o;
   return true;
@@ -131,12 +186,70 @@ bool Ped::Tscene::removeWaypoint(Ped::Twaypoint* w) {
   if (waypointIter == waypoints.end()) return false;
 
   // remove waypoint from the scene and delete it, report succesful removal
+  if (visibilityGraph != NULL) visibilityGraph->removeWaypoint(w);
   waypoints.erase(waypointIter);
   delete w;
 
   return true;
 }
 
+/// Has to be called after an obstacle of the scene has been moved, so the
+/// obstacle index and the visibility graph follow it.
+/// \param   *o the obstacle that has been moved
+void Ped::Tscene::updateObstacle(Ped::Tobstacle* o) {
+  obstacleIndex.updateObstacle(o);
+  if (visibilityGraph != NULL) visibilityGraph->updateObstacle(o);
+}
+
+/// Assigns a visibility graph for routing around obstacles, and builds it for
+/// the obstacles of the scene. NULL disables routing.
+/// \param   graphIn the graph, owned by the caller
+void Ped::Tscene::setVisibilityGraph(Ped::TvisibilityGraph* graphIn) {
+  visibilityGraph = graphIn;
+
+  // → the graph knows walls only; polygons are expanded while it's used
+  for (Ped::Tobstacle* edge : polygonEdges) delete edge;
+  polygonEdges.clear();
+  if (visibilityGraph == NULL) return;
+
+  for (size_t i = 0; i < polygons.getPolygonCount(); ++i)
+    polygons.getEdges(polygonEdges, i);
+  vector<Ped::Tobstacle*> walls(obstacles);
+  walls.insert(walls.end(), polygonEdges.begin(), polygonEdges.end());
+  visibilityGraph->build(walls);
+}
+
+Ped::TmotionModel* Ped::Tscene::getMotionModel(int agentType) const {
+  if ((agentType < 0) || (agentType >= (int)motionModels.size())) return NULL;
+  return motionModels[agentType];
+}
+
+/// \param   agentType the type of the agents, see Tagent::AgentType
+/// \param   model the motion model, owned by the caller; NULL for social
+/// force
+void Ped::Tscene::setMotionModel(int agentType, Ped::TmotionModel* model) {
+  if (agentType < 0) return;
+  if (agentType >= (int)motionModels.size())
+    motionModels.resize(agentType + 1, NULL);
+  motionModels[agentType] = model;
+}
+
+/// \param   steps how many steps the neighbors are used, at least 1
+void Ped::Tscene::setNeighborReuse(size_t steps) {
+  neighborReuse = (steps < 1) ? 1 : steps;
+}
+
+/// Assigns a density grid and fills it with the agents of the scene. NULL
+/// disables it.
+/// \param   gridIn the grid, owned by the caller
+void Ped::Tscene::setDensityGrid(Ped::TdensityGrid* gridIn) {
+  densityGrid = gridIn;
+  if (densityGrid == NULL) return;
+
+  densityGrid->clear();
+  for (const Tagent* agent : agents) densityGrid->addAgent(agent);
+}
+
 /// This is a convenience method. It calls Ped::Tagent::move(double h) for all
 /// agents in the Tscene.
 /// \param   h This tells the simulation how far the agents should proceed.
@@ -146,7 +259,34 @@ void Ped::Tscene::moveAgents(double h) {
   for (Tagent* agent : agents) agent->updateState();
 
   // then update forces
-  for (Tagent* agent : agents) agent->computeForces();
+  // → neighbor spans of earlier steps are dropped every neighborReuse
+  //   steps; agents without a span of the current epoch look theirs up
+  if (++neighborAge >= neighborReuse) {
+    neighborArena.clear();
+    ++neighborEpoch;
+    neighborAge = 0;
+  }
+  for (Tagent* agent : agents) {
+    if (getMotionModel(agent->getType()) == NULL) agent->computeForces();
+  }
+
+  // → every other model gets all its agents at once
+  for (size_t i = 0; i < motionModels.size(); ++i) {
+    TmotionModel* model = motionModels[i];
+    if (model == NULL) continue;
+
+    // the same model can drive several agent types
+    if (find(motionModels.begin(), motionModels.begin() + i, model) !=
+        motionModels.begin() + i)
+      continue;
+
+    modelAgents.clear();
+    for (Tagent* agent : agents) {
+      if (getMotionModel(agent->getType()) == model)
+        modelAgents.push_back(agent);
+    }
+    if (!modelAgents.empty()) model->computeForces(modelAgents, h);
+  }
 
   // finally move agents according to their forces
   for (Tagent* agent : agents) agent->move(h);
@@ -165,6 +305,7 @@ void Ped::Tscene::placeAgent(const Ped::Tagent* agentIn) {
 /// \param   *agentIn the agent to move.
 void Ped::Tscene::moveAgent(const Ped::Tagent* agentIn) {
   if (tree != NULL) treehash[agentIn]->moveAgent(agentIn);
+  if (densityGrid != NULL) densityGrid->moveAgent(agentIn);
 }
 
 /// This triggers a cleanup of the tree structure. Unused leaf nodes are
@@ -200,19 +341,29 @@ set<const Ped::Tagent*> Ped::Tscene::getNeighbors(double x, double y,
 
 void Ped::Tscene::getNeighbors(vector<const Ped::Tagent*>& neighborList,
                                double x, double y, double dist) const {
-  stack<Ped::Ttree*> treestack;
-
-  treestack.push(tree);
-  while (!treestack.empty()) {
-    Ped::Ttree* t = treestack.top();
-    treestack.pop();
-    if (t->isleaf) {
-      t->getAgents(neighborList);
-    } else {
-      if (t->tree1->intersects(x, y, dist)) treestack.push(t->tree1);
-      if (t->tree2->intersects(x, y, dist)) treestack.push(t->tree2);
-      if (t->tree3->intersects(x, y, dist)) treestack.push(t->tree3);
-      if (t->tree4->intersects(x, y, dist)) treestack.push(t->tree4);
-    }
+  // without a tree, all agents are neighbors
+  if (tree == NULL) {
+    neighborList.insert(neighborList.end(), agents.begin(), agents.end());
+    return;
   }
+
+  tree->getAgents(neighborList, x, y, dist);
+}
+
+/// Returns the obstacles close to the point x/y, using the obstacle index.
+/// \param   outputList the obstacles are appended to this list
+/// \param   x the x coordinate
+/// \param   y the y coordinate
+/// \param   dist the distance around x/y that will be searched for obstacles
+/// (might return some further away)
+void Ped::Tscene::getObstacles(vector<const Ped::Tobstacle*>& outputList,
+                               double x, double y, double dist) const {
+  obstacleLookup->getObstacles(outputList, x, y, dist);
+}
+
+/// \return  true if neither a wall nor a polygon blocks the line from/to
+bool Ped::Tscene::isVisible(const Ped::Tvector& from,
+                            const Ped::Tvector& to) const {
+  return obstacleLookup->isVisible(from, to) &&
+         !polygonLookup->intersects(from, to);
 }
@@ -0,0 +1,181 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#include "ped_segmentgrid.h"
+#include "ped_obstacle.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+namespace {
+/// orientation of the triangle a/b/c: >0 counter-clockwise, <0 clockwise
+double orientation(const Ped::Tvector& a, const Ped::Tvector& b,
+                   const Ped::Tvector& c) {
+  return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+bool onSegment(const Ped::Tvector& a, const Ped::Tvector& b,
+               const Ped::Tvector& p) {
+  return (min(a.x, b.x) <= p.x) && (p.x <= max(a.x, b.x)) &&
+         (min(a.y, b.y) <= p.y) && (p.y <= max(a.y, b.y));
+}
+}
+
+/// \param   cellSizeIn the edge length of a grid cell. Should be in the order
+/// of the typical wall length.
+Ped::TsegmentGrid::TsegmentGrid(double cellSizeIn) : cellSize(cellSizeIn) {}
+
+Ped::TsegmentGrid::~TsegmentGrid() {}
+
+void Ped::TsegmentGrid::clear() {
+  cells.clear();
+  obstacleCells.clear();
+}
+
+void Ped::TsegmentGrid::addObstacle(const Ped::Tobstacle* obstacle) {
+  // don't add an obstacle twice
+  if (obstacleCells.count(obstacle) > 0) removeObstacle(obstacle);
+
+  int column0 = getCellCoordinate(min(obstacle->getax(), obstacle->getbx()));
+  int column1 = getCellCoordinate(max(obstacle->getax(), obstacle->getbx()));
+  int row0 = getCellCoordinate(min(obstacle->getay(), obstacle->getby()));
+  int row1 = getCellCoordinate(max(obstacle->getay(), obstacle->getby()));
+
+  vector<Tkey>& keys = obstacleCells[obstacle];
+  for (int row = row0; row <= row1; ++row) {
+    for (int column = column0; column <= column1; ++column) {
+      Tkey key = getKey(column, row);
+      cells[key].push_back(obstacle);
+      keys.push_back(key);
+    }
+  }
+}
+
+/// \return  true if the obstacle was part of the grid
+bool Ped::TsegmentGrid::removeObstacle(const Ped::Tobstacle* obstacle) {
+  auto obstacleIter = obstacleCells.find(obstacle);
+  if (obstacleIter == obstacleCells.end()) return false;
+
+  for (Tkey key : obstacleIter->second) {
+    auto cellIter = cells.find(key);
+    if (cellIter == cells.end()) continue;
+
+    vector<const Ped::Tobstacle*>& cell = cellIter->second;
+    cell.erase(remove(cell.begin(), cell.end(), obstacle), cell.end());
+    if (cell.empty()) cells.erase(cellIter);
+  }
+  obstacleCells.erase(obstacleIter);
+  return true;
+}
+
+/// Re-indexes an obstacle after its position changed.
+void Ped::TsegmentGrid::updateObstacle(const Ped::Tobstacle* obstacle) {
+  removeObstacle(obstacle);
+  addObstacle(obstacle);
+}
+
+/// Checks whether the straight line between two points is free of obstacles.
+/// The cells along the line are visited in order (Amanatides-Woo traversal).
+/// \return  true if no obstacle intersects the line
+bool Ped::TsegmentGrid::isVisible(const Ped::Tvector& from,
+                                  const Ped::Tvector& to) const {
+  int column = getCellCoordinate(from.x);
+  int row = getCellCoordinate(from.y);
+  const int endColumn = getCellCoordinate(to.x);
+  const int endRow = getCellCoordinate(to.y);
+
+  const double dx = to.x - from.x;
+  const double dy = to.y - from.y;
+  const int stepX = (dx > 0) ? 1 : ((dx < 0) ? -1 : 0);
+  const int stepY = (dy > 0) ? 1 : ((dy < 0) ? -1 : 0);
+  const double infinity = numeric_limits<double>::infinity();
+  // → line parameter at the next vertical/horizontal cell border
+  double tMaxX = infinity;
+  double tMaxY = infinity;
+  if (stepX != 0) tMaxX = ((column + (stepX > 0)) * cellSize - from.x) / dx;
+  if (stepY != 0) tMaxY = ((row + (stepY > 0)) * cellSize - from.y) / dy;
+  const double tDeltaX = (stepX != 0) ? cellSize / fabs(dx) : infinity;
+  const double tDeltaY = (stepY != 0) ? cellSize / fabs(dy) : infinity;
+
+  int remaining = abs(endColumn - column) + abs(endRow - row);
+  while (true) {
+    auto cellIter = cells.find(getKey(column, row));
+    if (cellIter != cells.end()) {
+      for (const Ped::Tobstacle* obstacle : cellIter->second) {
+        if (intersects(from, to, obstacle)) return false;
+      }
+    }
+
+    if (remaining-- <= 0) break;
+    if (tMaxX < tMaxY) {
+      column += stepX;
+      tMaxX += tDeltaX;
+    } else {
+      row += stepY;
+      tMaxY += tDeltaY;
+    }
+  }
+
+  return true;
+}
+
+/// Collects the obstacles stored in the cells within dist of x/y. Each
+/// obstacle is reported once.
+void Ped::TsegmentGrid::getObstacles(vector<const Ped::Tobstacle*>& outputList,
+                                     double x, double y, double dist) const {
+  const size_t offset = outputList.size();
+  const int column0 = getCellCoordinate(x - dist);
+  const int column1 = getCellCoordinate(x + dist);
+  const int row0 = getCellCoordinate(y - dist);
+  const int row1 = getCellCoordinate(y + dist);
+  for (int row = row0; row <= row1; ++row) {
+    for (int column = column0; column <= column1; ++column) {
+      auto cellIter = cells.find(getKey(column, row));
+      if (cellIter == cells.end()) continue;
+      outputList.insert(outputList.end(), cellIter->second.begin(),
+                        cellIter->second.end());
+    }
+  }
+
+  // obstacles spanning several cells are found more than once
+  sort(outputList.begin() + offset, outputList.end());
+  outputList.erase(unique(outputList.begin() + offset, outputList.end()),
+                   outputList.end());
+}
+
+/// \return  true if the line a/b touches the given obstacle
+bool Ped::TsegmentGrid::intersects(const Ped::Tvector& a, const Ped::Tvector& b,
+                                   const Ped::Tobstacle* obstacle) {
+  return intersects(a, b, obstacle->getStartPoint(), obstacle->getEndPoint());
+}
+
+/// \return  true if the line a/b touches the line c/d
+bool Ped::TsegmentGrid::intersects(const Ped::Tvector& a, const Ped::Tvector& b,
+                                   const Ped::Tvector& c,
+                                   const Ped::Tvector& d) {
+  double o1 = orientation(a, b, c);
+  double o2 = orientation(a, b, d);
+  double o3 = orientation(c, d, a);
+  double o4 = orientation(c, d, b);
+
+  if ((((o1 > 0) && (o2 < 0)) || ((o1 < 0) && (o2 > 0))) &&
+      (((o3 > 0) && (o4 < 0)) || ((o3 < 0) && (o4 > 0))))
+    return true;
+
+  // collinear and touching cases
+  if ((o1 == 0) && onSegment(a, b, c)) return true;
+  if ((o2 == 0) && onSegment(a, b, d)) return true;
+  if ((o3 == 0) && onSegment(c, d, a)) return true;
+  if ((o4 == 0) && onSegment(c, d, b)) return true;
+
+  return false;
+}
+
+int Ped::TsegmentGrid::getCellCoordinate(double value) const {
+  return (int)floor(value / cellSize);
+}
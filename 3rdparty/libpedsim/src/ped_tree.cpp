@@ -64,14 +64,9 @@ void Ped::Ttree::addAgent(const Ped::Tagent* a) {
     agents.insert(a);
     scene->treehash[a] = this;
   } else {
-    if ((a->getx() >= x + w / 2) && (a->gety() >= y + h / 2))
-      tree3->addAgent(a);  // 3
-    if ((a->getx() <= x + w / 2) && (a->gety() <= y + h / 2))
-      tree1->addAgent(a);  // 1
-    if ((a->getx() >= x + w / 2) && (a->gety() <= y + h / 2))
-      tree2->addAgent(a);  // 2
-    if ((a->getx() <= x + w / 2) && (a->gety() >= y + h / 2))
-      tree4->addAgent(a);  // 4
+    // → agents on a center line go to one child only, the one removeAgent()
+    //   looks in, so that neighbor queries don't return them twice
+    getChildByPosition(a->getx(), a->gety())->addAgent(a);
   }
 
   if (agents.size() > 8) {
@@ -79,14 +74,7 @@ void Ped::Ttree::addAgent(const Ped::Tagent* a) {
     addChildren();
     while (!agents.empty()) {
       const Ped::Tagent* a = (*agents.begin());
-      if ((a->getx() >= x + w / 2) && (a->gety() >= y + h / 2))
-        tree3->addAgent(a);  // 3
-      if ((a->getx() <= x + w / 2) && (a->gety() <= y + h / 2))
-        tree1->addAgent(a);  // 1
-      if ((a->getx() >= x + w / 2) && (a->gety() <= y + h / 2))
-        tree2->addAgent(a);  // 2
-      if ((a->getx() <= x + w / 2) && (a->gety() >= y + h / 2))
-        tree4->addAgent(a);  // 4
+      getChildByPosition(a->getx(), a->gety())->addAgent(a);
       agents.erase(a);
     }
   }
@@ -199,6 +187,24 @@ void Ped::Ttree::getAgents(vector<const Ped::Tagent*>& outputList) const {
   }
 }
 
+/// Appends the agents of all leaf nodes that intersect the square around
+/// px/py. Recursing instead of keeping an explicit stack avoids a heap
+/// allocation per neighbor query.
+/// \param   px The x co-ordinate of the point
+/// \param   py The y co-ordinate of the point
+/// \param   pr The search radius
+void Ped::Ttree::getAgents(vector<const Ped::Tagent*>& outputList, double px,
+                          double py, double pr) const {
+  if (isleaf) {
+    outputList.insert(outputList.end(), agents.begin(), agents.end());
+  } else {
+    if (tree1->intersects(px, py, pr)) tree1->getAgents(outputList, px, py, pr);
+    if (tree2->intersects(px, py, pr)) tree2->getAgents(outputList, px, py, pr);
+    if (tree3->intersects(px, py, pr)) tree3->getAgents(outputList, px, py, pr);
+    if (tree4->intersects(px, py, pr)) tree4->getAgents(outputList, px, py, pr);
+  }
+}
+
 /// Checks if a point x/y is within the space handled by the tree node, or
 /// within a given radius r
 /// \author  chgloor
@@ -0,0 +1,666 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#include "ped_visibilitygraph.h"
+#include "ped_obstacle.h"
+#include "ped_waypoint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+
+using namespace std;
+
+namespace {
+double distanceToLine(const Ped::Tvector& p, const Ped::Tvector& a,
+                      const Ped::Tvector& b) {
+  Ped::Tvector ab = b - a;
+  double lengthSquared = ab.lengthSquared();
+  double t = (lengthSquared > 0)
+                 ? Ped::Tvector::dotProduct(p - a, ab) / lengthSquared
+                 : 0;
+  t = max(0.0, min(1.0, t));
+  return (a + t * ab - p).length();
+}
+}
+
+/// \param   clearanceIn the distance between the corner points and the walls
+Ped::TvisibilityGraph::TvisibilityGraph(double clearanceIn)
+    : clearance(clearanceIn) {}
+
+Ped::TvisibilityGraph::~TvisibilityGraph() {}
+
+void Ped::TvisibilityGraph::clear() {
+  segments.clear();
+  nodes.clear();
+  anchors.clear();
+  obstacleEnds.clear();
+  invalidateRoutes();
+}
+
+/// Builds the graph for the given obstacles at once. Cheaper than adding them
+/// one by one, since every pair of nodes is tested only once.
+void Ped::TvisibilityGraph::build(const vector<Ped::Tobstacle*>& obstacles) {
+  clear();
+
+  vector<int> affectedNodes;
+  for (const Ped::Tobstacle* obstacle : obstacles) {
+    segments.addObstacle(obstacle);
+    attachObstacle(obstacle, affectedNodes);
+  }
+
+  for (size_t i = 0; i < nodes.size(); ++i) placeNode(i);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (!nodes[i].active) continue;
+    for (size_t j = i + 1; j < nodes.size(); ++j) {
+      if (!nodes[j].active) continue;
+      if (segments.isVisible(nodes[i].position, nodes[j].position))
+        connect(i, j, (nodes[i].position - nodes[j].position).length());
+    }
+  }
+}
+
+void Ped::TvisibilityGraph::addObstacle(const Ped::Tobstacle* obstacle) {
+  updateObstacle(obstacle);
+}
+
+/// \return  true if the obstacle was part of the graph
+bool Ped::TvisibilityGraph::removeObstacle(const Ped::Tobstacle* obstacle) {
+  if (obstacleEnds.count(obstacle) == 0) return false;
+
+  Tchanges changes;
+  unblock(obstacle, changes);
+  updateRoutes(changes);
+  return true;
+}
+
+/// Adds an obstacle or updates the graph after the obstacle moved. Only the
+/// corners near the old and new position of the obstacle, and the edges
+/// crossing either position are re-evaluated.
+void Ped::TvisibilityGraph::updateObstacle(const Ped::Tobstacle* obstacle) {
+  Tchanges changes;
+  // the obstacle can't block anything at its old position anymore
+  if (obstacleEnds.count(obstacle) > 0) unblock(obstacle, changes);
+  block(obstacle, changes);
+  updateRoutes(changes);
+}
+
+/// Forgets the memoized routes to and from a waypoint that is being removed.
+void Ped::TvisibilityGraph::removeWaypoint(const Ped::Twaypoint* waypoint) {
+  routeTables.erase(waypoint);
+  for (auto routeIter = routes.begin(); routeIter != routes.end();) {
+    if ((routeIter->first.first == waypoint) ||
+        (routeIter->first.second == waypoint))
+      routes.erase(routeIter++);
+    else
+      ++routeIter;
+  }
+}
+
+/// Returns the corner an agent at the given position should head for next.
+/// \return  false if the destination is visible, or can't be reached at all.
+/// The agent should head straight for the destination then.
+bool Ped::TvisibilityGraph::getNextTarget(const Ped::Tvector& position,
+                                          const Ped::Twaypoint& destination,
+                                          Ped::Tvector* targetOut) {
+  if (segments.isVisible(position, destination.getPosition())) return false;
+
+  int entryNode = findEntryNode(position, getRoutes(destination));
+  if (entryNode < 0) return false;
+
+  *targetOut = nodes[entryNode].position;
+  return true;
+}
+
+/// Returns the corners on the shortest route between two waypoints, followed
+/// by the destination itself. The route is memoized.
+/// \return  the route, empty if the destination can't be reached
+const vector<Ped::Tvector>& Ped::TvisibilityGraph::getRoute(
+    const Ped::Twaypoint& from, const Ped::Twaypoint& to) {
+  auto key = make_pair(&from, &to);
+  auto routeIter = routes.find(key);
+  if (routeIter != routes.end()) return routeIter->second;
+
+  vector<Ped::Tvector>& route = routes[key];
+  const Ped::Tvector start = from.getPosition();
+  if (segments.isVisible(start, to.getPosition())) {
+    route.push_back(to.getPosition());
+    return route;
+  }
+
+  const Troutes& table = getRoutes(to);
+  int current = findEntryNode(start, table);
+  if (current < 0) return route;
+
+  // follow the shortest path tree
+  while ((current >= 0) && (route.size() <= nodes.size())) {
+    route.push_back(nodes[current].position);
+    current = table.next[current];
+  }
+  route.push_back(to.getPosition());
+  return route;
+}
+
+/// Computes the routes between every pair of the given waypoints, e.g. when
+/// the scenario is loaded.
+void Ped::TvisibilityGraph::precomputeRoutes(
+    const vector<Ped::Twaypoint*>& waypoints) {
+  for (const Ped::Twaypoint* from : waypoints) {
+    for (const Ped::Twaypoint* to : waypoints) {
+      if (from != to) getRoute(*from, *to);
+    }
+  }
+}
+
+size_t Ped::TvisibilityGraph::getNodeCount() const {
+  size_t count = 0;
+  for (const Tnode& node : nodes) count += node.active ? 1 : 0;
+  return count;
+}
+
+size_t Ped::TvisibilityGraph::getEdgeCount() const {
+  size_t count = 0;
+  for (const Tnode& node : nodes) count += node.edges.size();
+  return count / 2;
+}
+
+/// Endpoints are matched with millimeter precision
+Ped::TvisibilityGraph::TanchorKey Ped::TvisibilityGraph::getAnchorKey(
+    const Ped::Tvector& point) const {
+  return TanchorKey(llround(point.x * 1000), llround(point.y * 1000));
+}
+
+/// \return  the index of the node at the given wall endpoint, created if
+/// necessary
+int Ped::TvisibilityGraph::getNode(const Ped::Tvector& anchor) {
+  TanchorKey key = getAnchorKey(anchor);
+  auto anchorIter = anchors.find(key);
+  if (anchorIter != anchors.end()) return anchorIter->second;
+
+  Tnode node;
+  node.anchor = anchor;
+  node.active = false;
+  nodes.push_back(node);
+  anchors[key] = nodes.size() - 1;
+  return nodes.size() - 1;
+}
+
+void Ped::TvisibilityGraph::detachObstacle(const Ped::Tobstacle* obstacle,
+                                           vector<int>& affectedNodes) {
+  auto endsIter = obstacleEnds.find(obstacle);
+  if (endsIter == obstacleEnds.end()) return;
+
+  Ped::Tvector ends[2] = {endsIter->second.first, endsIter->second.second};
+  for (const Ped::Tvector& end : ends) {
+    auto anchorIter = anchors.find(getAnchorKey(end));
+    if (anchorIter == anchors.end()) continue;
+
+    Tnode& node = nodes[anchorIter->second];
+    node.obstacles.erase(
+        remove(node.obstacles.begin(), node.obstacles.end(), obstacle),
+        node.obstacles.end());
+    affectedNodes.push_back(anchorIter->second);
+  }
+  obstacleEnds.erase(endsIter);
+}
+
+void Ped::TvisibilityGraph::attachObstacle(const Ped::Tobstacle* obstacle,
+                                           vector<int>& affectedNodes) {
+  Ped::Tvector start = obstacle->getStartPoint();
+  Ped::Tvector end = obstacle->getEndPoint();
+  obstacleEnds[obstacle] = make_pair(start, end);
+
+  int startNode = getNode(start);
+  nodes[startNode].obstacles.push_back(obstacle);
+  affectedNodes.push_back(startNode);
+
+  int endNode = getNode(end);
+  nodes[endNode].obstacles.push_back(obstacle);
+  affectedNodes.push_back(endNode);
+}
+
+/// Adds the nodes whose corner point may be affected by a wall between a and
+/// b. The output list is sorted and free of duplicates.
+void Ped::TvisibilityGraph::collectNearbyNodes(
+    const Ped::Tvector& a, const Ped::Tvector& b,
+    vector<int>& affectedNodes) const {
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (distanceToLine(nodes[i].anchor, a, b) <= 2 * clearance)
+      affectedNodes.push_back(i);
+  }
+  sort(affectedNodes.begin(), affectedNodes.end());
+  affectedNodes.erase(unique(affectedNodes.begin(), affectedNodes.end()),
+                      affectedNodes.end());
+}
+
+/// Takes an obstacle out of the graph: the corners around it are placed
+/// again, and node pairs it hid from each other are connected if they see
+/// each other now.
+void Ped::TvisibilityGraph::unblock(const Ped::Tobstacle* obstacle,
+                                    Tchanges& changes) {
+  const pair<Ped::Tvector, Ped::Tvector> ends = obstacleEnds[obstacle];
+  changes.removedWalls.push_back(ends);
+
+  vector<int> affectedNodes;
+  detachObstacle(obstacle, affectedNodes);
+  segments.removeObstacle(obstacle);
+  collectNearbyNodes(ends.first, ends.second, affectedNodes);
+
+  const size_t firstMoved = changes.nodes.size();
+  replaceNodes(affectedNodes, changes);
+  connectHiddenPairs(ends.first, ends.second, changes);
+  for (size_t i = firstMoved; i < changes.nodes.size(); ++i)
+    connectNode(changes.nodes[i], changes);
+}
+
+/// Puts an obstacle into the graph at its current position: the corners
+/// around it are placed again, and edges crossing it are removed.
+void Ped::TvisibilityGraph::block(const Ped::Tobstacle* obstacle,
+                                  Tchanges& changes) {
+  changes.addedWalls.push_back(
+      make_pair(obstacle->getStartPoint(), obstacle->getEndPoint()));
+
+  vector<int> affectedNodes;
+  segments.addObstacle(obstacle);
+  attachObstacle(obstacle, affectedNodes);
+  collectNearbyNodes(obstacle->getStartPoint(), obstacle->getEndPoint(),
+                     affectedNodes);
+
+  const size_t firstMoved = changes.nodes.size();
+  replaceNodes(affectedNodes, changes);
+
+  // edges crossing the new position are blocked now
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    vector<pair<int, double> >& edges = nodes[i].edges;
+    for (size_t k = 0; k < edges.size();) {
+      const int j = edges[k].first;
+      if (Ped::TsegmentGrid::intersects(nodes[i].position, nodes[j].position,
+                                        obstacle)) {
+        if ((int)i < j) changes.removedEdges.push_back(make_pair(i, j));
+        edges[k] = edges.back();
+        edges.pop_back();
+      } else {
+        ++k;
+      }
+    }
+  }
+
+  for (size_t i = firstMoved; i < changes.nodes.size(); ++i)
+    connectNode(changes.nodes[i], changes);
+}
+
+/// Places the affected nodes again. Nodes that moved, appeared or
+/// disappeared lose their edges and are added to the changes; the caller
+/// connects them again once the walls are final.
+void Ped::TvisibilityGraph::replaceNodes(const vector<int>& affectedNodes,
+                                         Tchanges& changes) {
+  for (int index : affectedNodes) {
+    const Tnode& node = nodes[index];
+    const bool wasActive = node.active;
+    const Ped::Tvector oldPosition = node.position;
+    placeNode(index);
+    if ((node.active == wasActive) &&
+        (!node.active || ((node.position.x == oldPosition.x) &&
+                          (node.position.y == oldPosition.y))))
+      continue;
+
+    disconnectNode(index, changes);
+    changes.nodes.push_back(index);
+  }
+}
+
+/// Connects the node pairs that were hidden from each other by a wall
+/// between a and b, and see each other now. Only pairs on opposite sides of
+/// the wall whose bounding box overlaps that of the wall can cross it; the
+/// nodes are sorted into buckets by side and position relative to the
+/// wall's bounding box, and only compatible buckets are paired.
+void Ped::TvisibilityGraph::connectHiddenPairs(const Ped::Tvector& a,
+                                               const Ped::Tvector& b,
+                                               Tchanges& changes) {
+  const double left = min(a.x, b.x);
+  const double right = max(a.x, b.x);
+  const double bottom = min(a.y, b.y);
+  const double top = max(a.y, b.y);
+  auto band = [](double value, double low, double high) {
+    return (value < low) ? 0 : ((value > high) ? 2 : 1);
+  };
+
+  // → bucket: side * 9 + row band * 3 + column band
+  vector<int> buckets[18];
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (!nodes[i].active) continue;
+    const Ped::Tvector& p = nodes[i].position;
+    const int side = (Ped::Tvector::crossProduct(b - a, p - a).z < 0) ? 0 : 1;
+    buckets[side * 9 + band(p.y, bottom, top) * 3 + band(p.x, left, right)]
+        .push_back(i);
+  }
+
+  for (int first = 0; first < 9; ++first) {
+    for (int second = 9; second < 18; ++second) {
+      // → both left, right, below or above: the bounding boxes can't overlap
+      const int firstColumn = first % 3;
+      const int secondColumn = second % 3;
+      const int firstRow = first / 3;
+      const int secondRow = (second - 9) / 3;
+      if ((firstColumn == secondColumn) && (firstColumn != 1)) continue;
+      if ((firstRow == secondRow) && (firstRow != 1)) continue;
+
+      for (int i : buckets[first]) {
+        for (int j : buckets[second]) {
+          const Ped::Tvector& p = nodes[i].position;
+          const Ped::Tvector& q = nodes[j].position;
+          if (!Ped::TsegmentGrid::intersects(p, q, a, b)) continue;
+          if (isConnected(i, j) || !segments.isVisible(p, q)) continue;
+          connect(i, j, (p - q).length());
+          changes.addedEdges.push_back(make_pair(i, j));
+        }
+      }
+    }
+  }
+}
+
+/// Places the corner point of a node, pointing away from all walls ending at
+/// its anchor. Nodes where walls just continue, or too close to other walls,
+/// are deactivated.
+void Ped::TvisibilityGraph::placeNode(int index) {
+  Tnode& node = nodes[index];
+  node.active = false;
+
+  Ped::Tvector outward;
+  for (const Ped::Tobstacle* obstacle : node.obstacles) {
+    Ped::Tvector start = obstacle->getStartPoint();
+    Ped::Tvector end = obstacle->getEndPoint();
+    Ped::Tvector otherEnd =
+        ((start - node.anchor).lengthSquared() >
+         (end - node.anchor).lengthSquared())
+            ? start
+            : end;
+    outward += (node.anchor - otherEnd).normalized();
+  }
+  if (outward.length() < 1e-3) return;
+
+  node.position = node.anchor + clearance * outward.normalized();
+
+  // the corner point must be free
+  vector<const Ped::Tobstacle*> nearbyObstacles;
+  segments.getObstacles(nearbyObstacles, node.position.x, node.position.y,
+                        clearance);
+  for (const Ped::Tobstacle* obstacle : nearbyObstacles) {
+    Ped::Tvector diff = obstacle->closestPoint(node.position) - node.position;
+    if (diff.length() < 0.99 * clearance) return;
+  }
+
+  node.active = true;
+}
+
+void Ped::TvisibilityGraph::connectNode(int index, Tchanges& changes) {
+  if (!nodes[index].active) return;
+
+  for (size_t j = 0; j < nodes.size(); ++j) {
+    if (((int)j == index) || !nodes[j].active || isConnected(index, j))
+      continue;
+
+    const Ped::Tvector& a = nodes[index].position;
+    const Ped::Tvector& b = nodes[j].position;
+    if (segments.isVisible(a, b)) {
+      connect(index, j, (a - b).length());
+      changes.addedEdges.push_back(make_pair(index, j));
+    }
+  }
+}
+
+void Ped::TvisibilityGraph::disconnectNode(int index, Tchanges& changes) {
+  for (const pair<int, double>& edge : nodes[index].edges) {
+    changes.removedEdges.push_back(make_pair(index, edge.first));
+    vector<pair<int, double> >& otherEdges = nodes[edge.first].edges;
+    for (size_t k = 0; k < otherEdges.size(); ++k) {
+      if (otherEdges[k].first == index) {
+        otherEdges[k] = otherEdges.back();
+        otherEdges.pop_back();
+        break;
+      }
+    }
+  }
+  nodes[index].edges.clear();
+}
+
+bool Ped::TvisibilityGraph::isConnected(int first, int second) const {
+  for (const pair<int, double>& edge : nodes[first].edges) {
+    if (edge.first == second) return true;
+  }
+  return false;
+}
+
+void Ped::TvisibilityGraph::connect(int first, int second, double distance) {
+  nodes[first].edges.push_back(make_pair(second, distance));
+  nodes[second].edges.push_back(make_pair(first, distance));
+}
+
+/// Returns the shortest routes from all nodes to the destination (Dijkstra,
+/// starting at the nodes that see the destination). Memoized.
+const Ped::TvisibilityGraph::Troutes& Ped::TvisibilityGraph::getRoutes(
+    const Ped::Twaypoint& destination) {
+  const Ped::Tvector target = destination.getPosition();
+
+  Troutes& table = routeTables[&destination];
+  if ((table.distance.size() == nodes.size()) &&
+      (table.destination.x == target.x) && (table.destination.y == target.y))
+    return table;
+
+  table.destination = target;
+  table.distance.assign(nodes.size(), numeric_limits<double>::infinity());
+  table.next.assign(nodes.size(), -1);
+
+  typedef pair<double, int> Tentry;
+  priority_queue<Tentry, vector<Tentry>, greater<Tentry> > open;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (!nodes[i].active || !segments.isVisible(nodes[i].position, target))
+      continue;
+
+    table.distance[i] = (nodes[i].position - target).length();
+    open.push(Tentry(table.distance[i], i));
+  }
+
+  while (!open.empty()) {
+    Tentry entry = open.top();
+    open.pop();
+    int index = entry.second;
+    if (entry.first > table.distance[index]) continue;
+
+    for (const pair<int, double>& edge : nodes[index].edges) {
+      double distance = entry.first + edge.second;
+      if (distance < table.distance[edge.first]) {
+        table.distance[edge.first] = distance;
+        table.next[edge.first] = index;
+        open.push(Tentry(distance, edge.first));
+      }
+    }
+  }
+
+  return table;
+}
+
+/// Finds the visible node with the shortest route from the given position.
+/// Nodes are tested in the order of their route length, so usually only a
+/// few line-of-sight checks are needed.
+/// \return  the node index, -1 if none is visible
+int Ped::TvisibilityGraph::findEntryNode(const Ped::Tvector& position,
+                                         const Troutes& table) const {
+  vector<pair<double, int> > candidates;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (!nodes[i].active || std::isinf(table.distance[i])) continue;
+
+    double length = (nodes[i].position - position).length() + table.distance[i];
+    candidates.push_back(make_pair(length, i));
+  }
+  sort(candidates.begin(), candidates.end());
+
+  for (const pair<double, int>& candidate : candidates) {
+    if (segments.isVisible(position, nodes[candidate.second].position))
+      return candidate.second;
+  }
+  return -1;
+}
+
+void Ped::TvisibilityGraph::invalidateRoutes() {
+  routeTables.clear();
+  routes.clear();
+}
+
+/// Brings the memoized routes up to date after an obstacle update. Route
+/// tables that used a removed edge or a moved node are dropped; new edges
+/// and walls that disappeared can only shorten routes, which is applied in
+/// place. Routes between waypoints are dropped when their table changed or
+/// a changed wall affects them.
+void Ped::TvisibilityGraph::updateRoutes(const Tchanges& changes) {
+  vector<const Ped::Twaypoint*> changedDestinations;
+  for (auto tableIter = routeTables.begin(); tableIter != routeTables.end();) {
+    bool changed = false;
+    if (!updateRouteTable(tableIter->second, changes, &changed)) {
+      changedDestinations.push_back(tableIter->first);
+      routeTables.erase(tableIter++);
+      continue;
+    }
+    if (changed) changedDestinations.push_back(tableIter->first);
+    ++tableIter;
+  }
+
+  for (auto routeIter = routes.begin(); routeIter != routes.end();) {
+    const Ped::Twaypoint* to = routeIter->first.second;
+    auto tableIter = routeTables.find(to);
+    const Troutes* table =
+        (tableIter != routeTables.end()) ? &tableIter->second : NULL;
+    if ((find(changedDestinations.begin(), changedDestinations.end(), to) !=
+         changedDestinations.end()) ||
+        !isRouteValid(*routeIter->first.first, routeIter->second, table,
+                      changes))
+      routes.erase(routeIter++);
+    else
+      ++routeIter;
+  }
+}
+
+/// \param   changedOut set if routes got shorter
+/// \return  false if the table has to be computed again
+bool Ped::TvisibilityGraph::updateRouteTable(Troutes& table,
+                                             const Tchanges& changes,
+                                             bool* changedOut) {
+  const Ped::Tvector& target = table.destination;
+  vector<double>& distance = table.distance;
+  vector<int>& next = table.next;
+  // → nodes created by the update aren't reachable yet
+  distance.resize(nodes.size(), numeric_limits<double>::infinity());
+  next.resize(nodes.size(), -1);
+
+  // routes through moved nodes or removed edges get longer or break
+  for (int index : changes.nodes) {
+    if (!std::isinf(distance[index])) return false;
+  }
+  for (const pair<int, int>& edge : changes.removedEdges) {
+    if ((next[edge.first] == edge.second) || (next[edge.second] == edge.first))
+      return false;
+  }
+  for (const pair<Ped::Tvector, Ped::Tvector>& wall : changes.addedWalls) {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      if ((next[i] == -1) && !std::isinf(distance[i]) &&
+          Ped::TsegmentGrid::intersects(nodes[i].position, target, wall.first,
+                                        wall.second))
+        return false;
+    }
+  }
+
+  // everything else can only get shorter
+  typedef pair<double, int> Tentry;
+  priority_queue<Tentry, vector<Tentry>, greater<Tentry> > open;
+  auto relax = [&](int index, double length, int nextIndex) {
+    if (length >= distance[index] - 1e-9) return;
+    distance[index] = length;
+    next[index] = nextIndex;
+    open.push(Tentry(length, index));
+  };
+
+  for (const pair<int, int>& edge : changes.addedEdges) {
+    // → moving an obstacle may add an edge and remove it again
+    if (!isConnected(edge.first, edge.second)) continue;
+    const double length =
+        (nodes[edge.first].position - nodes[edge.second].position).length();
+    relax(edge.second, distance[edge.first] + length, edge.first);
+    relax(edge.first, distance[edge.second] + length, edge.second);
+  }
+  // → nodes that see the destination now
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (!nodes[i].active || (next[i] == -1 && !std::isinf(distance[i])))
+      continue;
+    bool candidate = find(changes.nodes.begin(), changes.nodes.end(),
+                          (int)i) != changes.nodes.end();
+    for (size_t k = 0; !candidate && (k < changes.removedWalls.size()); ++k) {
+      candidate = Ped::TsegmentGrid::intersects(
+          nodes[i].position, target, changes.removedWalls[k].first,
+          changes.removedWalls[k].second);
+    }
+    if (candidate && segments.isVisible(nodes[i].position, target))
+      relax(i, (nodes[i].position - target).length(), -1);
+  }
+
+  *changedOut = !open.empty();
+  while (!open.empty()) {
+    Tentry entry = open.top();
+    open.pop();
+    int index = entry.second;
+    if (entry.first > distance[index]) continue;
+
+    for (const pair<int, double>& edge : nodes[index].edges)
+      relax(edge.first, entry.first + edge.second, index);
+  }
+  return true;
+}
+
+/// Checks a memoized route between waypoints whose route table didn't
+/// change. It stays valid unless an added wall crosses it, or a removed
+/// wall opens a shorter way from the start.
+bool Ped::TvisibilityGraph::isRouteValid(const Ped::Twaypoint& from,
+                                         const vector<Ped::Tvector>& route,
+                                         const Troutes* table,
+                                         const Tchanges& changes) const {
+  const Ped::Tvector start = from.getPosition();
+  if (route.empty()) return changes.removedWalls.empty();
+
+  double length = 0;
+  Ped::Tvector previous = start;
+  for (const Ped::Tvector& point : route) {
+    for (const pair<Ped::Tvector, Ped::Tvector>& wall : changes.addedWalls) {
+      if (Ped::TsegmentGrid::intersects(previous, point, wall.first,
+                                        wall.second))
+        return false;
+    }
+    length += (point - previous).length();
+    previous = point;
+  }
+
+  // → the route is straight already
+  if ((route.size() == 1) || changes.removedWalls.empty()) return true;
+
+  const Ped::Tvector& destination = route.back();
+  for (const pair<Ped::Tvector, Ped::Tvector>& wall : changes.removedWalls) {
+    if (Ped::TsegmentGrid::intersects(start, destination, wall.first,
+                                      wall.second) &&
+        segments.isVisible(start, destination))
+      return false;
+    if (table == NULL) continue;
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      if (!nodes[i].active || std::isinf(table->distance[i])) continue;
+      const Ped::Tvector& corner = nodes[i].position;
+      if (((corner - start).length() + table->distance[i] < length - 1e-9) &&
+          Ped::TsegmentGrid::intersects(start, corner, wall.first,
+                                        wall.second) &&
+          segments.isVisible(start, corner))
+        return false;
+    }
+  }
+  return true;
+}
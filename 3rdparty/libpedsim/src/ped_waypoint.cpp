@@ -5,6 +5,7 @@
 
 #include "ped_waypoint.h"
 #include "ped_agent.h"
+#include "ped_flowfield.h"
 
 // initialize static variables
 int Ped::Twaypoint::staticid = 0;
@@ -40,7 +41,11 @@ Ped::Tvector Ped::Twaypoint::getForce(const Ped::Tagent& agent,
   Ped::Tvector destination = closestPoint(agentPos, reachedOut);
   Ped::Tvector diff = destination - agentPos;
 
-  Ped::Tvector desiredDirection = diff.normalized();
+  // follow the flow field around obstacles, if there is one
+  Ped::Tvector desiredDirection;
+  if ((flowField == NULL) ||
+      !flowField->getDirection(agentPos, &desiredDirection))
+    desiredDirection = diff.normalized();
   Tvector force = (desiredDirection * agent.getVmax() - agent.getVelocity()) /
                   agent.getRelaxationTime();
 
@@ -0,0 +1,89 @@
+//
+// pedsim - A microscopic pedestrian simulation system.
+// Copyright (c) 2003 - 2012 by Christian Gloor
+//
+
+#include "ped_workerpool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/// \param   threadCountIn the number of threads including the calling one,
+/// 0 for one per core
+Ped::TworkerPool::TworkerPool(unsigned int threadCountIn)
+    : threadCount(threadCountIn),
+      generation(0),
+      busyCount(0),
+      stopping(false),
+      currentItem(NULL),
+      itemCount(0),
+      nextItem(0) {
+  if (threadCount == 0) threadCount = max(1u, thread::hardware_concurrency());
+}
+
+Ped::TworkerPool::~TworkerPool() {
+  {
+    lock_guard<mutex> guard(lock);
+    stopping = true;
+  }
+  wakeUp.notify_all();
+  for (thread& t : threads) t.join();
+}
+
+/// Calls item(0) to item(itemCount - 1), spread over the threads, and returns
+/// once all of them are done.
+void Ped::TworkerPool::run(size_t itemCountIn,
+                           const function<void(size_t)>& item) {
+  // not worth waking up the threads
+  if ((threadCount == 1) || (itemCountIn <= 1)) {
+    for (size_t i = 0; i < itemCountIn; ++i) item(i);
+    return;
+  }
+
+  if (threads.empty()) start();
+  {
+    lock_guard<mutex> guard(lock);
+    currentItem = &item;
+    itemCount = itemCountIn;
+    nextItem = 0;
+    busyCount = (unsigned int)threads.size();
+    ++generation;
+  }
+  wakeUp.notify_all();
+
+  work();
+
+  unique_lock<mutex> guard(lock);
+  finished.wait(guard, [this]() { return busyCount == 0; });
+  currentItem = NULL;
+}
+
+void Ped::TworkerPool::start() {
+  for (unsigned int i = 1; i < threadCount; ++i)
+    threads.emplace_back(&Ped::TworkerPool::loop, this);
+}
+
+/// Takes items until there are none left
+void Ped::TworkerPool::work() {
+  for (size_t i = nextItem++; i < itemCount; i = nextItem++) (*currentItem)(i);
+}
+
+/// Main loop of the pool's own threads
+void Ped::TworkerPool::loop() {
+  unsigned long done = 0;
+  while (true) {
+    {
+      unique_lock<mutex> guard(lock);
+      wakeUp.wait(guard,
+                  [this, done]() { return stopping || (generation != done); });
+      if (stopping) return;
+      done = generation;
+    }
+
+    work();
+
+    lock_guard<mutex> guard(lock);
+    if (--busyCount == 0) finished.notify_one();
+  }
+}
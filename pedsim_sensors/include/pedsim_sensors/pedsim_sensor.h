@@ -76,8 +76,12 @@ class PedsimSensor {
       ROS_FATAL_STREAM("Sensor FoV cannot be null.");
     }
     fov_ = fov;
-    // Set up robot odometry subscriber.
-    sub_robot_odom_ = nh_.subscribe("/pedsim_simulator/robot_position", 1,
+    // Set up robot odometry subscriber, of the robot the sensor is mounted
+    // on. With several robots, each publishes <name>/robot_position.
+    std::string robot_odom_topic;
+    nh_.param<std::string>("robot_odom_topic", robot_odom_topic,
+                           "/pedsim_simulator/robot_position");
+    sub_robot_odom_ = nh_.subscribe(robot_odom_topic, 1,
                                     &PedsimSensor::callbackRobotOdom, this);
 
     transform_listener_ = boost::make_shared<tf::TransformListener>();
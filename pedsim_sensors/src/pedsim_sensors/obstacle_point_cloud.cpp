@@ -138,7 +138,8 @@ void ObstaclePointCloud::broadcast() {
     pub_signals_global_.publish(pcd_global);
   }
 
-  q_obstacles_.pop();
+  // walls are only published when they change, keep the latest ones
+  if (q_obstacles_.size() > 1) q_obstacles_.pop();
 };
 
 void ObstaclePointCloud::run() {
@@ -204,7 +204,8 @@ void PointCloud::broadcast() {
     pub_signals_global_.publish(pcd_global);
   }
 
-  q_obstacles_.pop();
+  // walls are only published when they change, keep the latest ones
+  if (q_obstacles_.size() > 1) q_obstacles_.pop();
   q_agents_.pop();
 };
 
@@ -32,7 +32,7 @@
 #ifndef _agentstatemachine_h_
 #define _agentstatemachine_h_
 
-#include <QObject>
+#include <QString>
 
 // Forward Declarations
 class Agent;
@@ -42,9 +42,7 @@ class QueueingWaypointPlanner;
 class GroupWaypointPlanner;
 class ShoppingPlanner;
 
-class AgentStateMachine : public QObject {
-  Q_OBJECT
-
+class AgentStateMachine {
   // Enums
   // TODO - switch to enum classes
  public:
@@ -62,15 +60,9 @@ class AgentStateMachine : public QObject {
   AgentStateMachine(Agent* agentIn);
   virtual ~AgentStateMachine();
 
-  // Signals
- signals:
-  void stateChanged(AgentState newState);
-
- public slots:
-  void loseAttraction();
-
   // Methods
  public:
+  void loseAttraction();
   void doStateTransition();
   AgentState getCurrentState();
 
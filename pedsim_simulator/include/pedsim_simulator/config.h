@@ -34,6 +34,8 @@
 
 #include <QMap>
 #include <QObject>
+#include <string>
+#include <vector>
 
 #include <pedsim_simulator/utilities.h>
 
@@ -55,14 +57,9 @@ class Config : public QObject {
  signals:
   // → Forces
   void forceFactorChanged(QString name, double value);
-  void forceFactorObstacleChanged(double value);
-  void forceSigmaObstacleChanged(double value);
-  void forceFactorSocialChanged(double value);
-  void forceFactorGroupGazeChanged(double value);
-  void forceFactorGroupCoherenceChanged(double value);
-  void forceFactorGroupRepulsionChanged(double value);
-  void forceFactorRandomChanged(double value);
-  void forceFactorAlongWallChanged(double value);
+
+  // → Agent types
+  void agentProfileChanged(int type);
 
   // Slots
  public slots:
@@ -75,12 +72,21 @@ class Config : public QObject {
   void setGroupRepulsionForce(double valueIn);
   void setRandomForce(double valueIn);
   void setAlongWallForce(double valueIn);
+  void setSuppressedForces(unsigned int forcesIn);
 
   // Methods
  public:
   // TODO - change to std::unordered_map
   QMap<QString, double> getForceMap() const;
 
+  // → force parameter block
+  const ForceParameters& forces() const { return activeForces; }
+  bool commitForceParameters();
+
+  // → agent type profiles
+  const AgentProfile& getAgentProfile(int type) const;
+  void setAgentProfile(int type, const AgentProfile& profileIn);
+
   double getTimeStepSize() { return simulationFactor / updateRate; }
 
   // Attributes
@@ -89,16 +95,6 @@ class Config : public QObject {
   double updateRate;
   double simulationFactor;
 
-  // Forces
-  double forceObstacle;
-  double sigmaObstacle;
-  double forceSocial;
-  double forceGroupGaze;
-  double forceGroupCoherence;
-  double forceGroupRepulsion;
-  double forceRandom;
-  double forceAlongWall;
-
   // robot control
   RobotMode robot_mode;
   int robot_wait_time;
@@ -117,6 +113,98 @@ class Config : public QObject {
 
   // simulation visualization mode
   VisualMode visual_mode;
+
+  // navigation flow fields towards the waypoints
+  bool flow_fields_enabled;
+  double flow_field_resolution;
+  double flow_field_clearance;
+  std::string flow_field_cache_dir;
+
+  // visibility graph routing around obstacles
+  bool visibility_graph_enabled;
+  double visibility_graph_clearance;
+
+  // ORCA motion model, for agent types selecting it
+  double orca_time_horizon;
+  double orca_obstacle_time_horizon;
+  int orca_max_neighbors;
+  int orca_threads;
+
+  // crowd density grid, and slowing down in dense crowds
+  bool density_grid_enabled;
+  double density_grid_resolution;
+  bool density_speed_scaling;
+
+  // trajectory prediction around the robot
+  bool prediction_enabled;
+  double prediction_horizon;
+  double prediction_radius;
+  double prediction_sample_interval;
+
+  // dataset export, see DatasetExporter
+  bool export_enabled;
+  std::string export_directory;
+  std::string export_format;
+  double export_interval;
+  int export_chunk_frames;
+  std::vector<double> export_regions;  ///< x, y, width, height per region
+
+  // source of the pose of externally driven robots: tf, odometry or pose
+  std::string robot_pose_source;
+  std::string robot_pose_topic;
+  double robot_velocity_smoothing;
+
+  // detail given up when ticks overrun their budget, see OverrunController
+  bool overrun_control_enabled;
+  double overrun_degrade_time;
+  double overrun_restore_time;
+  double overrun_restore_load;
+
+  // kinematic robots: diff_drive or holonomic, commanded on cmd_vel
+  std::string robot_kinematics;
+  std::string robot_cmd_vel_topic;
+
+  // safety and comfort measures of the robot's run, see RobotMetrics
+  bool metrics_enabled;
+  double metrics_personal_space;
+  double metrics_publish_interval;
+  std::string metrics_file;
+  std::vector<double> metrics_goal;  ///< x, y
+  double metrics_goal_tolerance;
+
+  // counting gates and zones of the scenario, see FlowCounter
+  double flow_publish_interval;
+  double flow_dwell_bin_width;
+  int flow_dwell_bins;
+
+  // heatmaps accumulated over the run, see HeatmapAccumulator
+  bool heatmap_enabled;
+  double heatmap_cell_size;
+  double heatmap_stop_speed;
+  std::string heatmap_directory;
+
+  // record and replay of runs, see RunRecorder and RunReplayer
+  std::string record_file;
+  double record_keyframe_interval;
+  std::string replay_file;
+  double replay_speed;
+
+  // hybrid mode, microscopic only inside the region of interest
+  bool hybrid_enabled;
+  double hybrid_cell_size;
+  double hybrid_region_x;
+  double hybrid_region_y;
+  double hybrid_region_width;
+  double hybrid_region_height;
+
+ protected:
+  // force weights used in the current tick, and the ones for the next
+  ForceParameters activeForces;
+  ForceParameters pendingForces;
+  bool forcesChanged;
+
+  // agent type profiles, indexed by agent type
+  std::vector<AgentProfile> agentProfiles;
 };
 
 #endif
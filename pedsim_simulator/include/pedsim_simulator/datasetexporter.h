@@ -0,0 +1,139 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _datasetexporter_h_
+#define _datasetexporter_h_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// -----------------------------------------------------------------
+/// \class DatasetExporter
+/// \brief Streams agent states to disk from a background thread
+/// \details The simulation thread appends one frame per export tick
+/// (beginFrame(), addAgent(), endFrame()), which only copies the values
+/// into column buffers. Full chunks are handed to a worker thread that
+/// compresses and writes them. If the worker falls behind, chunks are
+/// dropped rather than stalling the simulation (see getDroppedChunks()).
+///
+/// Formats:
+/// - COLUMNAR: one file chunk_<n>.pts per chunk. After a 32 byte header
+///   ("PTSC", version, frame count, row count, compressed and raw payload
+///   size), the zlib-compressed payload holds the columns back to back:
+///   frame times (float64), first row of each frame (uint32), and per row
+///   id (int32), type (uint8), x, y, vx, vy (float32). All little-endian.
+/// - ETH_UCY: one text file trajectories.txt with a tab-separated
+///   "frame id x y" line per agent and frame.
+/// -----------------------------------------------------------------
+class DatasetExporter {
+ public:
+  enum class Format { COLUMNAR, ETH_UCY };
+
+  DatasetExporter();
+  virtual ~DatasetExporter();
+
+  bool open(const std::string& directory, Format format, size_t chunkFrames);
+  void close();
+  bool isOpen() const { return opened; }
+
+  /// Only agents inside one of the regions are exported; without regions,
+  /// all agents are.
+  void addRegion(double x, double y, double width, double height);
+  void clearRegions() { regions.clear(); }
+
+  void beginFrame(double time);
+  void addAgent(int id, int type, double x, double y, double vx, double vy);
+  void endFrame();
+
+  size_t getDroppedChunks();
+
+ protected:
+  struct Region {
+    double x, y, width, height;
+  };
+
+  struct Chunk {
+    uint64_t index;
+    uint64_t firstFrame;
+    std::vector<double> times;
+    std::vector<uint32_t> frameOffsets;
+    std::vector<int32_t> ids;
+    std::vector<uint8_t> types;
+    std::vector<float> x, y, vx, vy;
+
+    void clear();
+    void reserve(size_t frames, size_t rows);
+    size_t getFrameCount() const { return times.size(); }
+    size_t getRowCount() const { return ids.size(); }
+  };
+
+  bool isInRegion(double x, double y) const;
+  void submitChunk();
+  void run();
+  bool writeColumnar(const Chunk& chunk);
+  bool writeEthUcy(const Chunk& chunk);
+
+  // Attributes
+ protected:
+  bool opened;
+  std::string directory;
+  Format format;
+  size_t chunkFrames;
+  std::vector<Region> regions;
+
+  // → filled by the simulation thread
+  std::unique_ptr<Chunk> current;
+  uint64_t chunkCount;
+  uint64_t frameCount;
+
+  // → shared with the worker
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool stopping;
+  std::deque<std::unique_ptr<Chunk>> queue;
+  std::vector<std::unique_ptr<Chunk>> spareChunks;
+  size_t droppedChunks;
+
+  // → used by the worker only
+  std::ofstream textFile;
+  std::vector<unsigned char> payload;
+  std::vector<unsigned char> compressed;
+  std::vector<char> line;
+};
+
+#endif
@@ -35,15 +35,17 @@
 #include <pedsim/ped_agent.h>
 #include <pedsim_simulator/element/scenarioelement.h>
 
+#include <QPointF>
+
 #ifndef Q_MOC_RUN
 #include <ros/ros.h>
-#include <QGraphicsRectItem>  // TODO -remove qgraphics dependencies
 #endif
 
 // Forward Declarations
 class AgentGroup;
 class AgentStateMachine;
 class Force;
+class RobotDrive;
 class Waypoint;
 class WaypointPlanner;
 
@@ -97,6 +99,14 @@ class Agent : public ScenarioElement, public Ped::Tagent {
   WaypointPlanner* getWaypointPlanner() const;
   void setWaypointPlanner(WaypointPlanner* plannerIn);
 
+  // → name, given to robots of the scenario
+  const QString& getName() const;
+  void setName(const QString& nameIn);
+
+  // → kinematic model of a robot, not owned
+  RobotDrive* getDrive() const;
+  void setDrive(RobotDrive* driveIn);
+
   // → direction, forces, neighbors
  public:
   Ped::Tvector getDesiredDirection() const;
@@ -107,6 +117,9 @@ class Agent : public ScenarioElement, public Ped::Tagent {
   QList<const Agent*> getNeighbors() const;
   void disableForce(const QString& forceNameIn);
   void enableAllForces();
+  bool isForceEnabled(int forceType) const {
+    return ((disabledForces & (1u << forceType)) == 0);
+  }
 
   // → Ped::Tagent Overrides/Overloads
  public:
@@ -122,6 +135,7 @@ class Agent : public ScenarioElement, public Ped::Tagent {
   void setX(double xIn);
   void setY(double yIn);
   void setType(Ped::Tagent::AgentType typeIn);
+  void applyTypeProfile();
 
   // → VisibleScenarioElement Overrides/Overloads
  public:
@@ -129,6 +143,10 @@ class Agent : public ScenarioElement, public Ped::Tagent {
   virtual void setVisiblePosition(const QPointF& positionIn);
   QString toString() const;
 
+ protected:
+  bool emitsForceSignals() const;
+  void updateSpeedFactor();
+
   // Attributes
  protected:
   // → state machine
@@ -143,10 +161,21 @@ class Agent : public ScenarioElement, public Ped::Tagent {
 
   // → force
   QList<Force*> forces;
-  QStringList disabledForces;
+  // bit set of disabled Force::ForceType values
+  unsigned int disabledForces;
 
   // → waypoint planner
   WaypointPlanner* waypointplanner;
+
+  // → name
+  QString name;
+
+  // → robot drive
+  RobotDrive* drive;
+
+  // → maximal speed sampled at creation, used unless the type profile
+  //   overrides it
+  double sampledVmax;
 };
 
 #endif
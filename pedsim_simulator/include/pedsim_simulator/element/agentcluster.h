@@ -70,6 +70,8 @@ class AgentCluster : public ScenarioElement {
   void setY(double yIn);
   int getType() const;
   void setType(Ped::Tagent::AgentType typeIn);
+  const QString& getName() const;
+  void setName(const QString& nameIn);
   bool getShallCreateGroups() const;
   void setShallCreateGroups(bool shallCreateGroupsIn);
   QSizeF getDistribution() const;
@@ -90,6 +92,7 @@ class AgentCluster : public ScenarioElement {
   int count;
   QSizeF distribution;
   Ped::Tagent::AgentType agentType;
+  QString name;
   bool shallCreateGroups;
   QList<Waypoint*> waypoints;
 };
@@ -63,6 +63,7 @@ class AreaWaypoint : public Waypoint {
   // → Ped::Twaypoint Overrides
   virtual Ped::Tvector closestPoint(const Ped::Tvector& posIn,
                                     bool* withinWaypoint = NULL) const;
+  virtual Ped::Twaypoint* clone() const;
 
   // → ScenarioElement Overrides/Overloads
  public:
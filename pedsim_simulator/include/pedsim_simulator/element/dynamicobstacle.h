@@ -0,0 +1,98 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _dynamicobstacle_h_
+#define _dynamicobstacle_h_
+
+#include <pedsim_simulator/element/scenarioelement.h>
+
+#include <vector>
+
+class Obstacle;
+
+/// -----------------------------------------------------------------
+/// \class DynamicObstacle
+/// \brief Walls moved along scripted keyframes
+/// \details Sliding doors, rotating barriers or trolleys. The segments are
+/// given in the obstacle's own frame, the keyframes place that frame in the
+/// scene at given times; poses in between are interpolated linearly,
+/// including the angle, so a turn of 360° needs no intermediate keyframes.
+/// The segments are ordinary obstacles of the scene, which owns them once
+/// they are added; they are only moved when the pose changes.
+/// -----------------------------------------------------------------
+class DynamicObstacle : public ScenarioElement {
+  Q_OBJECT
+
+ public:
+  /// what happens after the last keyframe
+  enum class Repeat { ONCE, LOOP, PINGPONG };
+
+  struct Keyframe {
+    double time;
+    double x, y, theta;
+  };
+
+  // Constructor and Destructor
+ public:
+  DynamicObstacle(const QString& nameIn);
+  virtual ~DynamicObstacle();
+
+  // Methods
+ public:
+  QString getName() const { return name; }
+  void setRepeat(Repeat repeatIn) { repeat = repeatIn; }
+  void addSegment(double ax, double ay, double bx, double by);
+  /// \param   theta the orientation in radians
+  void addKeyframe(double time, double x, double y, double theta);
+
+  const std::vector<Obstacle*>& getObstacles() const { return obstacles; }
+  /// moves the segments to their pose at the given scene time
+  void update(double time);
+
+  // → ScenarioElement Overrides/Overloads
+ public:
+  QString toString() const;
+
+ protected:
+  Keyframe getPose(double time) const;
+
+  // Attributes
+ protected:
+  QString name;
+  Repeat repeat;
+  std::vector<Keyframe> keyframes;
+  // → segments in the obstacle's frame, and where they are placed
+  std::vector<double> segments;
+  std::vector<Obstacle*> obstacles;
+
+  bool placed;
+  Keyframe pose;
+};
+
+#endif
@@ -58,6 +58,7 @@ class QueueingWaypoint : public Waypoint {
                                 bool* reached = NULL) const;
   virtual Ped::Tvector closestPoint(const Ped::Tvector& posIn,
                                     bool* withinWaypoint = NULL) const;
+  virtual Ped::Twaypoint* clone() const;
 
   // → ScenarioElement Overrides/Overloads
  public:
@@ -92,6 +92,7 @@ class WaitingQueue : public Waypoint {
  public:
   virtual Ped::Tvector closestPoint(const Ped::Tvector& p,
                                     bool* withinWaypoint = NULL) const;
+  virtual Ped::Twaypoint* clone() const;
 
   // → ScenarioElement Overrides/Overloads
  public:
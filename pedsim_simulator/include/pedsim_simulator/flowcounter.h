@@ -0,0 +1,120 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _flowcounter_h_
+#define _flowcounter_h_
+
+#include <pedsim/ped_agent.h>
+#include <pedsim/ped_polygons.h>
+#include <pedsim/ped_segmentgrid.h>
+#include <pedsim/ped_vector.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Ped {
+class Tobstacle;
+}
+
+/// -----------------------------------------------------------------
+/// \class FlowCounter
+/// \brief Counts pedestrians crossing gates and staying in zones
+/// \details Gates are lines, e.g. doors; crossings are detected from each
+/// pedestrian's step of the tick (see Ped::Tagent::getLastPosition()),
+/// testing only the gates in the grid cells around it. Forward is from the
+/// right to the left of the line from the gate's first to its second point.
+/// Zones are polygons; a visit lasts from the tick a pedestrian is first
+/// seen inside to the tick it's seen outside or removed, and completed
+/// visits are sorted into a dwell time histogram. Robots aren't counted.
+/// -----------------------------------------------------------------
+class FlowCounter {
+ public:
+  struct Gate {
+    std::string name;
+    Ped::Tvector start;
+    Ped::Tvector end;
+    unsigned int forward;
+    unsigned int backward;
+  };
+
+  struct Visitor {
+    double entryTime;
+    uint64_t lastSeen;  ///< the update() it was last seen inside
+  };
+
+  struct Zone {
+    std::string name;
+    unsigned int entries;
+    unsigned int visits;
+    double dwellTimeSum;
+    /// the last bin also holds the longer visits
+    std::vector<unsigned int> dwellHistogram;
+    // → the pedestrians inside, by id; only entries and exits change it
+    std::unordered_map<int, Visitor> visitors;
+  };
+
+  FlowCounter();
+  virtual ~FlowCounter();
+
+  void clear();
+  void setDwellHistogram(double binWidth, size_t binCount);
+  void addGate(const std::string& name, const Ped::Tvector& start,
+               const Ped::Tvector& end);
+  void addZone(const std::string& name,
+               const std::vector<Ped::Tvector>& corners);
+
+  void update(double time, const std::vector<Ped::Tagent*>& agents);
+
+  bool isEmpty() const { return gates.empty() && zones.empty(); }
+  const std::vector<Gate>& getGates() const { return gates; }
+  const std::vector<Zone>& getZones() const { return zones; }
+  double getDwellBinWidth() const { return dwellBinWidth; }
+
+ protected:
+  void countCrossings(const Ped::Tvector& from, const Ped::Tvector& to);
+  void addVisit(Zone& zone, double duration);
+
+  // Attributes
+ protected:
+  std::vector<Gate> gates;
+  Ped::TsegmentGrid gateIndex;
+  std::vector<Ped::Tobstacle*> gateLines;
+  std::unordered_map<const Ped::Tobstacle*, size_t> gateLookup;
+
+  std::vector<Zone> zones;
+  Ped::Tpolygons zoneAreas;
+  double dwellBinWidth;
+  size_t dwellBinCount;
+
+  uint64_t updateCount;
+  std::vector<const Ped::Tobstacle*> candidates;
+};
+
+#endif
@@ -37,19 +37,15 @@
 #include <pedsim_simulator/force/force.h>
 
 class AlongWallForce : public Force {
-  Q_OBJECT
-
   // Constructor and Destructor
  public:
   AlongWallForce(Agent* agentIn);
 
-  // Slots
- public slots:
-  void onForceFactorChanged(double valueIn);
-
   // Methods
   // → Force Implementations
  public:
+  virtual ForceType getType() const { return ALONG_WALL; };
+  virtual double getFactor() const;
   virtual QString getName() const { return "AlongWall"; };
   virtual Ped::Tvector getForce(Ped::Tvector walkingDirection);
   virtual QString toString() const;
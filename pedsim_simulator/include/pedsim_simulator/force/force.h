@@ -36,23 +36,37 @@
 // → PedSim
 #include <pedsim/ped_vector.h>
 // → Qt
-#include <QObject>
+#include <QString>
 
 // Forward Declarations
 class Agent;
+struct ForceParameters;
 
-class Force : public QObject {
-  Q_OBJECT
-
+/// Additional force acting on a single agent. Forces are plain objects
+/// owned by their agent; they carry no Qt object bookkeeping.
+class Force {
   // Constructor and Destructor
  public:
   Force(Agent* agentIn);
+  virtual ~Force();
 
-  // Methods
-  void setFactor(double factorIn);
-  double getFactor() const;
+  // Force identifiers, used as bits to enable/disable forces per agent
+  enum ForceType {
+    DESIRED = 0,
+    SOCIAL = 1,
+    OBSTACLE = 2,
+    RANDOM = 3,
+    ALONG_WALL = 4,
+    GROUP_GAZE = 5,
+    GROUP_COHERENCE = 6,
+    GROUP_REPULSION = 7
+  };
+  static int typeFromName(const QString& nameIn);
 
+  // Methods
  public:
+  virtual ForceType getType() const = 0;
+  virtual double getFactor() const = 0;
   virtual QString getName() const = 0;
   virtual Ped::Tvector getForce(Ped::Tvector walkingDirection) = 0;
   virtual QString toString() const = 0;
@@ -60,7 +74,8 @@ class Force : public QObject {
   // Attributes
  protected:
   Agent* const agent;
-  double factor;
+  // shared force weights, see Config::forces()
+  const ForceParameters& parameters;
 };
 
 #endif
@@ -38,16 +38,10 @@
 #include <pedsim_simulator/force/force.h>
 
 class GroupCoherenceForce : public Force {
-  Q_OBJECT
-
   // Constructor and Destructor
  public:
   GroupCoherenceForce(Agent* agentIn);
 
-  // Slots
- public slots:
-  void onForceFactorGroupCoherenceChanged(double valueIn);
-
   // Methods
  public:
   void setGroup(AgentGroup* groupIn);
@@ -55,6 +49,8 @@ class GroupCoherenceForce : public Force {
 
   // → Force Implementations
  public:
+  virtual ForceType getType() const { return GROUP_COHERENCE; };
+  virtual double getFactor() const;
   virtual QString getName() const { return "GroupCoherence"; };
   virtual Ped::Tvector getForce(Ped::Tvector walkingDirection);
   virtual QString toString() const;
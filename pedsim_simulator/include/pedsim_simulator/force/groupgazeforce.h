@@ -38,16 +38,10 @@
 #include <pedsim_simulator/force/force.h>
 
 class GroupGazeForce : public Force {
-  Q_OBJECT
-
   // Constructor and Destructor
  public:
   GroupGazeForce(Agent* agentIn);
 
-  // Slots
- public slots:
-  void onForceFactorGroupGazeChanged(double valueIn);
-
   // Methods
  public:
   void setGroup(AgentGroup* groupIn);
@@ -55,6 +49,8 @@ class GroupGazeForce : public Force {
 
   // → Force Implementations
  public:
+  virtual ForceType getType() const { return GROUP_GAZE; };
+  virtual double getFactor() const;
   virtual QString getName() const { return "GroupGaze"; };
   virtual Ped::Tvector getForce(Ped::Tvector walkingDirection);
   virtual QString toString() const;
@@ -38,16 +38,10 @@
 #include <pedsim_simulator/force/force.h>
 
 class GroupRepulsionForce : public Force {
-  Q_OBJECT
-
   // Constructor and Destructor
  public:
   GroupRepulsionForce(Agent* agentIn);
 
-  // Slots
- public slots:
-  void onForceFactorGroupRepulsionChanged(double valueIn);
-
   // Methods
  public:
   void setGroup(AgentGroup* groupIn);
@@ -55,6 +49,8 @@ class GroupRepulsionForce : public Force {
 
   // → Force Implementations
  public:
+  virtual ForceType getType() const { return GROUP_REPULSION; };
+  virtual double getFactor() const;
   virtual QString getName() const { return "GroupRepulsion"; };
   virtual Ped::Tvector getForce(Ped::Tvector walkingDirection);
   virtual QString toString() const;
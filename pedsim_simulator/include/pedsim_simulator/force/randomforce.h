@@ -37,16 +37,10 @@
 #include <pedsim_simulator/force/force.h>
 
 class RandomForce : public Force {
-  Q_OBJECT
-
   // Constructor and Destructor
  public:
   RandomForce(Agent* agentIn);
 
-  // Slots
- public slots:
-  void onForceFactorChanged(double valueIn);
-
   // Methods
  public:
   void setFadingTime(double durationIn);
@@ -57,6 +51,8 @@ class RandomForce : public Force {
 
   // → Force Implementations
  public:
+  virtual ForceType getType() const { return RANDOM; };
+  virtual double getFactor() const;
   virtual QString getName() const { return "Random"; };
   virtual Ped::Tvector getForce(Ped::Tvector walkingDirection);
   virtual QString toString() const;
@@ -0,0 +1,128 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _heatmapaccumulator_h_
+#define _heatmapaccumulator_h_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// -----------------------------------------------------------------
+/// \class HeatmapAccumulator
+/// \brief Accumulates where pedestrians were, how fast they walked and
+/// where they stopped, over the whole run
+/// \details The simulation thread hands over one snapshot per tick
+/// (beginSnapshot(), addAgent(), endSnapshot()), which only copies the
+/// values. A worker thread at the lowest priority rasterizes them into the
+/// grids:
+/// - occupancy: agent-seconds spent in the cell
+/// - mean speed: time-weighted, of the agents in the cell
+/// - stops: agents slowing down below the stop speed in the cell
+/// If the worker falls behind, snapshots are dropped rather than stalling
+/// the simulation (see getDroppedSnapshots()). getGrids() waits for the
+/// queued snapshots, so the copy covers the run up to the last tick.
+/// -----------------------------------------------------------------
+class HeatmapAccumulator {
+ public:
+  struct Grids {
+    double originX, originY;  ///< corner of cell 0, 0
+    double cellSize;
+    size_t columns, rows;
+    double duration;  ///< simulation time accumulated
+    // → row by row, from originY upwards
+    std::vector<double> occupancy;
+    std::vector<double> meanSpeed;
+    std::vector<unsigned int> stops;
+  };
+
+  HeatmapAccumulator();
+  virtual ~HeatmapAccumulator();
+
+  bool open(double x, double y, double width, double height, double cellSize,
+            double stopSpeed);
+  void close();
+  bool isOpen() const { return opened; }
+
+  void beginSnapshot(double duration);
+  void addAgent(int id, double x, double y, double speed);
+  void endSnapshot();
+
+  size_t getDroppedSnapshots();
+  void getGrids(Grids& grids);
+
+  static bool writeCsv(const Grids& grids, const std::string& filename);
+  static bool writePng(const Grids& grids, const std::vector<double>& values,
+                       const std::string& filename);
+
+ protected:
+  struct Snapshot {
+    double duration;
+    std::vector<int> ids;
+    std::vector<float> x, y, speed;
+
+    void clear();
+  };
+
+  void run();
+  void accumulate(const Snapshot& snapshot);
+
+  // Attributes
+ protected:
+  bool opened;
+  double stopSpeed;
+
+  // → filled by the simulation thread
+  std::unique_ptr<Snapshot> current;
+
+  // → shared with the worker
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::condition_variable idleCondition;
+  bool stopping;
+  bool busy;
+  std::deque<std::unique_ptr<Snapshot>> queue;
+  std::vector<std::unique_ptr<Snapshot>> spareSnapshots;
+  size_t droppedSnapshots;
+  Grids grids;
+  // → time-weighted speed sum, mean speed = sum / occupancy
+  std::vector<double> speedSums;
+
+  // → used by the worker only: whether each agent was moving last time
+  std::unordered_map<int, bool> moving;
+  std::unordered_map<int, bool> nextMoving;
+};
+
+#endif
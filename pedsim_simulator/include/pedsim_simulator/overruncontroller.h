@@ -0,0 +1,83 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _overruncontroller_h_
+#define _overruncontroller_h_
+
+#include <cstddef>
+
+/// -----------------------------------------------------------------
+/// \class OverrunController
+/// \brief Trades simulation detail for keeping up with real time
+/// \details Each tick reports how long its work took. The load, the
+/// duration relative to the 1/update_rate budget smoothed over about a
+/// second, selects a degradation level: over budget for degradeTime, the
+/// level goes up by one; below restoreLoad for restoreTime, it goes down by
+/// one. Levels include the ones below them.
+/// -----------------------------------------------------------------
+class OverrunController {
+ public:
+  enum Level {
+    FULL = 0,
+    NO_OPTIONAL_FORCES = 1,   ///< random and along wall forces left out
+    NEIGHBOR_REUSE = 2,       ///< neighbors looked up every few ticks
+    REDUCED_FAR_DETAIL = 3,   ///< short neighbor range far from the robots
+    DECIMATED_PUBLISHING = 4  ///< crowd states published every few ticks
+  };
+  static const int maxLevel = DECIMATED_PUBLISHING;
+
+  OverrunController();
+
+  void reset(double budgetIn, double degradeTimeIn, double restoreTimeIn,
+             double restoreLoadIn);
+  void setBudget(double budgetIn) { budget = budgetIn; }
+  /// \return  true if the level changed
+  bool update(double duration);
+
+  int getLevel() const { return level; }
+  double getLoad() const { return load; }
+  double getBudget() const { return budget; }
+  size_t getOverruns() const { return overruns; }
+  static const char* getLevelName(int level);
+
+ protected:
+  double budget;
+  double degradeTime;
+  double restoreTime;
+  double restoreLoad;
+
+  int level;
+  double load;
+  // → how long the load has been over budget, or below restoreLoad
+  double overTime;
+  double underTime;
+  size_t overruns;
+};
+
+#endif
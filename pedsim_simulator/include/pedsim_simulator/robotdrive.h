@@ -0,0 +1,71 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _robotdrive_h_
+#define _robotdrive_h_
+
+/// -----------------------------------------------------------------
+/// \class RobotDrive
+/// \brief Kinematic model of a robot driven by velocity commands
+/// \details The command is given in the robot's frame, as for
+/// geometry_msgs/Twist on cmd_vel. A differential drive ignores the
+/// lateral velocity, a holonomic base follows it. Each step integrates the
+/// command exactly along the arc it describes, so the pose doesn't depend
+/// on the step size.
+/// -----------------------------------------------------------------
+class RobotDrive {
+ public:
+  enum class Kinematics { DIFFERENTIAL, HOLONOMIC };
+
+  RobotDrive(Kinematics kinematics, double x, double y, double theta);
+
+  Kinematics getKinematics() const { return kinematics; }
+  void setCommand(double forward, double lateral, double angular);
+  void step(double h);
+
+  double getx() const { return x; }
+  double gety() const { return y; }
+  double getTheta() const { return theta; }
+  /// mean velocity during the last step, in the simulation frame
+  double getvx() const { return vx; }
+  double getvy() const { return vy; }
+
+  // Attributes
+ protected:
+  Kinematics kinematics;
+  double x, y, theta;
+  double vx, vy;
+
+  // → the latest command
+  double forward;
+  double lateral;
+  double angular;
+};
+
+#endif
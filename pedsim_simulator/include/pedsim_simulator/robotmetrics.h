@@ -0,0 +1,105 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _robotmetrics_h_
+#define _robotmetrics_h_
+
+#include <pedsim/ped_agent.h>
+#include <pedsim/ped_vector.h>
+
+#include <ostream>
+#include <unordered_set>
+#include <vector>
+
+/// -----------------------------------------------------------------
+/// \class RobotMetrics
+/// \brief Safety and comfort measures of a robot run, kept up to date
+/// tick by tick
+/// \details Each tick only looks at the pedestrians within getRange() of
+/// the robot. Collisions and personal space intrusions are counted when a
+/// pedestrian comes closer than the threshold, and timed while it stays
+/// there (pedestrian-seconds). The path efficiency is the straight-line
+/// distance over the path length, from the start to the goal, or to the
+/// current position while the goal isn't reached.
+/// -----------------------------------------------------------------
+class RobotMetrics {
+ public:
+  RobotMetrics();
+
+  void reset(double personalSpaceRadius);
+  void setGoal(const Ped::Tvector& goal, double tolerance);
+  double getRange() const;
+
+  void update(double time, double h, const Ped::Tagent& robot,
+              const std::vector<const Ped::Tagent*>& neighbors);
+
+  bool hasStarted() const { return started; }
+  double getDuration() const { return duration; }
+  double getMinDistance() const { return minDistance; }
+  unsigned int getCollisions() const { return collisions; }
+  double getCollisionTime() const { return collisionTime; }
+  unsigned int getIntrusions() const { return intrusions; }
+  double getIntrusionTime() const { return intrusionTime; }
+  double getPathLength() const { return pathLength; }
+  double getPathEfficiency() const;
+  /// negative while the goal isn't reached
+  double getTimeToGoal() const { return timeToGoal; }
+
+  void writeSummary(std::ostream& output) const;
+
+  // Attributes
+ protected:
+  double personalSpaceRadius;
+  bool hasGoal;
+  Ped::Tvector goal;
+  double goalTolerance;
+
+  bool started;
+  double startTime;
+  Ped::Tvector start;
+  Ped::Tvector last;
+  Ped::Tvector end;
+
+  double duration;
+  double minDistance;
+  unsigned int collisions;
+  double collisionTime;
+  unsigned int intrusions;
+  double intrusionTime;
+  double pathLength;
+  double timeToGoal;
+
+  // → pedestrians in contact or in the personal space, last tick and now
+  std::unordered_set<int> contacts;
+  std::unordered_set<int> intruders;
+  std::unordered_set<int> nextContacts;
+  std::unordered_set<int> nextIntruders;
+};
+
+#endif
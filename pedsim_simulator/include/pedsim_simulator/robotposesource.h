@@ -0,0 +1,149 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _robotposesource_h_
+#define _robotposesource_h_
+
+#include <geometry_msgs/PoseStamped.h>
+#include <nav_msgs/Odometry.h>
+#include <ros/callback_queue.h>
+#include <ros/ros.h>
+
+#include <atomic>
+#include <string>
+
+/// Robot pose in the simulation frame
+struct RobotPose {
+  double stamp;
+  double x, y;
+  double vx, vy;
+};
+
+/// -----------------------------------------------------------------
+/// \class LatestValue
+/// \brief Hands the latest of a stream of values from one thread to another
+/// \details Triple buffer: the writer and the reader each own a buffer and
+/// swap it with the spare one through a single atomic. Neither side ever
+/// waits; values the reader misses are overwritten.
+/// -----------------------------------------------------------------
+template <typename T>
+class LatestValue {
+ public:
+  LatestValue() : writeIndex(0), spare(1), readIndex(2) {}
+
+  void store(const T& value) {
+    buffers[writeIndex] = value;
+    writeIndex = spare.exchange(writeIndex | freshFlag) & indexMask;
+  }
+
+  /// \return  false if there is no new value since the last call
+  bool take(T* value) {
+    if ((spare.load() & freshFlag) == 0) return false;
+    readIndex = spare.exchange(readIndex) & indexMask;
+    *value = buffers[readIndex];
+    return true;
+  }
+
+ protected:
+  static const int indexMask = 3;
+  static const int freshFlag = 4;
+
+  T buffers[3];
+  int writeIndex;
+  std::atomic<int> spare;  ///< index of the spare buffer, and freshFlag
+  int readIndex;
+};
+
+/// -----------------------------------------------------------------
+/// \class VelocityEstimator
+/// \brief Smoothed velocity from a sequence of stamped positions
+/// \details Positions with a stamp that isn't newer than the last one are
+/// ignored, so repeated stamps neither divide by zero nor reset the
+/// velocity. Finite differences are smoothed exponentially with the given
+/// time constant.
+/// -----------------------------------------------------------------
+class VelocityEstimator {
+ public:
+  explicit VelocityEstimator(double smoothingTime = 0.1);
+
+  void setSmoothingTime(double smoothingTimeIn) {
+    smoothingTime = smoothingTimeIn;
+  }
+  void reset() { initialized = false; }
+  /// \return  false if the position was ignored
+  bool update(double stamp, double x, double y);
+
+  double getvx() const { return vx; }
+  double getvy() const { return vy; }
+
+ protected:
+  double smoothingTime;
+  bool initialized;
+  double lastStamp;
+  double lastX, lastY;
+  double vx, vy;
+};
+
+/// -----------------------------------------------------------------
+/// \class RobotPoseSource
+/// \brief Receives the robot pose on its own thread
+/// \details Subscribes to nav_msgs/Odometry (velocity from the message) or
+/// geometry_msgs/PoseStamped (velocity estimated) on a private callback
+/// queue, spun by a separate thread. The simulation thread picks up the
+/// latest pose without waiting. Poses must be given in the simulation
+/// frame.
+/// -----------------------------------------------------------------
+class RobotPoseSource {
+ public:
+  enum class Type { ODOMETRY, POSE };
+
+  RobotPoseSource(const ros::NodeHandle& node, Type type,
+                  const std::string& topic, double smoothingTime);
+  virtual ~RobotPoseSource();
+
+  bool takeLatest(RobotPose* pose) { return latest.take(pose); }
+
+ protected:
+  void onOdometry(const nav_msgs::Odometry::ConstPtr& odometry);
+  void onPose(const geometry_msgs::PoseStamped::ConstPtr& msg);
+
+  // Attributes
+ protected:
+  ros::CallbackQueue queue;
+  ros::NodeHandle nh;
+  ros::Subscriber subscriber;
+  ros::AsyncSpinner spinner;
+
+  // → used by the spinner thread only
+  VelocityEstimator estimator;
+
+  LatestValue<RobotPose> latest;
+};
+
+#endif
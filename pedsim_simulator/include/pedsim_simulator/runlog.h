@@ -0,0 +1,181 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _runlog_h_
+#define _runlog_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// State of one agent in a recorded frame
+struct RecordedAgent {
+  int id;
+  int type;
+  int state;  ///< AgentStateMachine::AgentState
+  double x, y;
+  double vx, vy;
+};
+
+struct RecordedObstacle {
+  double ax, ay;
+  double bx, by;
+};
+
+/// Input injected into the simulation, kept for reference
+struct RecordedEvent {
+  enum Type { ROBOT_POSE = 0, SPAWN = 1 };
+
+  Type type;
+  double time;
+  double x, y;
+  double vx, vy;  ///< ROBOT_POSE only
+  int id;         ///< ROBOT_POSE only, the robot's agent id
+  int count;      ///< SPAWN only
+};
+
+/// -----------------------------------------------------------------
+/// \brief Binary log of a simulation run
+/// \details After the "PRUN" header (version, position and velocity
+/// quantum), the log is a sequence of records: type (uint8), time
+/// (float64), payload size (uint32), payload. Agent states are quantized
+/// to the quanta. A keyframe holds all agents; the frames in between only
+/// hold the change of each agent since the previous frame, as zigzag
+/// varints. Agents missing from a frame have been removed.
+/// -----------------------------------------------------------------
+namespace runlog {
+enum RecordType : uint8_t {
+  OBSTACLES = 1,
+  KEYFRAME = 2,
+  DELTA = 3,
+  EVENT = 4,
+};
+
+/// Quantized agent state, the base of the next delta
+struct QuantizedAgent {
+  int64_t x, y, vx, vy;
+  int type;
+  int state;
+  uint64_t frame;  ///< last frame the agent was part of
+};
+}
+
+/// -----------------------------------------------------------------
+/// \class RunRecorder
+/// \brief Writes a run log, see runlog
+/// -----------------------------------------------------------------
+class RunRecorder {
+ public:
+  RunRecorder();
+  virtual ~RunRecorder();
+
+  bool open(const std::string& filename, double keyframeInterval);
+  void close();
+  bool isOpen() const { return file.is_open(); }
+
+  void writeObstacles(double time,
+                      const std::vector<RecordedObstacle>& obstacles);
+  void writeFrame(double time, const std::vector<RecordedAgent>& agents);
+  void writeEvent(const RecordedEvent& event);
+
+ protected:
+  void writeRecord(runlog::RecordType type, double time);
+
+  // Attributes
+ protected:
+  std::ofstream file;
+  double keyframeInterval;
+  double lastKeyframeTime;
+  uint64_t frameCount;
+  std::unordered_map<int, runlog::QuantizedAgent> lastStates;
+  std::vector<uint8_t> payload;
+};
+
+/// -----------------------------------------------------------------
+/// \class RunReplayer
+/// \brief Reads a run log and reconstructs the agent states at any time
+/// \details The log is loaded into memory and indexed. advanceTo() moves
+/// forward from the current frame; going back or passing more than one
+/// keyframe restarts from the closest keyframe before the requested time
+/// (seek()).
+/// -----------------------------------------------------------------
+class RunReplayer {
+ public:
+  RunReplayer();
+  virtual ~RunReplayer();
+
+  bool open(const std::string& filename);
+  bool isOpen() const { return !records.empty(); }
+
+  double getStartTime() const;
+  double getEndTime() const;
+  double getTime() const { return time; }
+
+  void seek(double time);
+  void advanceTo(double time);
+
+  const std::vector<RecordedAgent>& getAgents() const { return agents; }
+  const std::vector<RecordedObstacle>& getObstacles() const {
+    return obstacles;
+  }
+  /// Events passed by advanceTo() since the last call
+  std::vector<RecordedEvent> takeEvents();
+
+ protected:
+  struct Record {
+    runlog::RecordType type;
+    double time;
+    size_t offset;
+    size_t size;
+  };
+
+  void apply(const Record& record, bool collectEvents);
+
+  // Attributes
+ protected:
+  std::vector<uint8_t> data;
+  std::vector<Record> records;
+  std::vector<size_t> keyframes;
+  double positionQuantum;
+  double velocityQuantum;
+
+  // → state after applying the records before nextRecord
+  size_t nextRecord;
+  double time;
+  uint64_t frameCount;
+  std::unordered_map<int, runlog::QuantizedAgent> lastStates;
+  std::vector<RecordedAgent> agents;
+  std::vector<RecordedObstacle> obstacles;
+  std::vector<RecordedEvent> events;
+};
+
+#endif
@@ -54,6 +54,11 @@ class ScenarioReader {
   QXmlStreamReader xmlReader;
 
   AgentCluster* currentAgents;
+  DynamicObstacle* currentDynamicObstacle;
+  // → corners of the <polygon> or <zone> being read
+  std::vector<Ped::Tvector> currentPolygon;
+  bool inPolygon;
+  QString currentZone;
   SpawnArea* currentSpawnArea;
 };
 
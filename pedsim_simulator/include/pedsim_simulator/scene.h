@@ -32,24 +32,41 @@
 #ifndef _scene_h_
 #define _scene_h_
 
+#include <pedsim/ped_agent.h>
+#include <pedsim/ped_continuum.h>
 #include <pedsim/ped_scene.h>
 #include <pedsim/ped_vector.h>
+#include <pedsim/ped_workerpool.h>
+#include <QHash>
 #include <QMap>
 #include <QObject>
 #include <QRectF>
 
+#include <memory>
+
+#include <pedsim_simulator/flowcounter.h>
+#include <pedsim_simulator/tickscheduler.h>
 #include <pedsim_simulator/utilities.h>
 
 // Forward Declarations
 class QGraphicsScene;
 class Agent;
 class Obstacle;
+class DynamicObstacle;
 class Waypoint;
 class AttractionArea;
 class AgentCluster;
 class AgentGroup;
 class WaitingQueue;
 
+namespace Ped {
+class TdensityGrid;
+class TflowField;
+class TorcaModel;
+class Trollout;
+class TsceneSnapshot;
+}
+
 struct SpawnArea {
   double x, y;
   int n;
@@ -61,6 +78,14 @@ struct SpawnArea {
       : x{xx}, y{yy}, n{nn}, dx{dxi}, dy{dyi} {}
 };
 
+/// Pedestrians of one type following the same route, aggregated in the
+/// continuum outside the region of interest. The first waypoint of the
+/// route is the current destination.
+struct ContinuumPopulation {
+  QList<Waypoint*> route;
+  Ped::Tagent::AgentType type;
+};
+
 class Scene : public QObject, protected Ped::Tscene {
   Q_OBJECT
 
@@ -102,6 +127,8 @@ class Scene : public QObject, protected Ped::Tscene {
   void moveAllAgents();
  protected slots:
   void cleanupScene();
+  void onAgentProfileChanged(int type);
+  void onObstacleMoved();
 
   // Methods
  public:
@@ -111,10 +138,16 @@ class Scene : public QObject, protected Ped::Tscene {
 
   // → elements
   const QList<Agent*>& getAgents() const;
+  const QList<Agent*>& getRobots() const;
   Agent* getAgentById(int idIn) const;
-  QList<AgentGroup*> getGroups();
+  const QList<AgentGroup*>& getGroups() const;
   QMap<QString, AttractionArea*> getAttractions();
   const QList<Obstacle*>& getObstacles() const;
+  const Ped::Tpolygons& getPolygons() const {
+    return Ped::Tscene::getPolygons();
+  }
+  /// changes whenever an obstacle is added, moved or removed
+  uint64_t getObstacleRevision() const { return obstacleRevision; }
   const QMap<QString, Waypoint*>& getWaypoints() const;
   const QMap<QString, AttractionArea*>& getAttractions() const;
   Waypoint* getWaypointById(int idIn) const;
@@ -127,16 +160,84 @@ class Scene : public QObject, protected Ped::Tscene {
   std::vector<SpawnArea*> getSpawnAreas() const { return spawn_areas; }
   void addSpawnArea(SpawnArea* sa) { spawn_areas.emplace_back(sa); }
 
-  // → simulation time
+  // → simulation time, derived from the tick counter
   double getTime() const;
   bool hasStarted() const;
+  uint64_t getTick() const { return tick; }
+  /// \return  the interval in whole ticks, at least one
+  uint64_t getTicks(double interval) const {
+    return scheduler.toTicks(interval);
+  }
+  TickScheduler& getScheduler() { return scheduler; }
+
+  // → navigation flow fields
+  void computeFlowFields();
+  void clearFlowFields();
+  void updateFlowFields();
+
+  // → visibility graph routing
+  void buildVisibilityGraph();
+  void clearVisibilityGraph();
+
+  // → agents within radius of center, from the neighbor index; reuse the
+  //   output vector to avoid allocating per query
+  void getNeighbors(std::vector<const Ped::Tagent*>& neighbors,
+                    const Ped::Tvector& center, double radius) const;
+
+  // → spatial queries for external planners, see Simulator::onQueryScene()
+  void getNearestAgents(std::vector<const Ped::Tagent*>& nearest,
+                        const Ped::Tvector& center, size_t count) const;
+  void getAgentsInPolygon(std::vector<const Ped::Tagent*>& inside,
+                          const std::vector<Ped::Tvector>& corners) const;
+  bool getNearestWall(const Ped::Tvector& point, double maxDistance,
+                      Ped::Tvector* closestOut) const;
+  bool isVisible(const Ped::Tvector& from, const Ped::Tvector& to) const {
+    return Ped::Tscene::isVisible(from, to);
+  }
+
+  // → trajectory prediction
+  std::unique_ptr<Ped::Trollout> createRollout(const Ped::Tvector& center,
+                                               double radius) const;
+  // → sampling-based planning, see Ped::TsceneFork
+  std::shared_ptr<const Ped::TsceneSnapshot> createSnapshot() const;
+
+  // → crowd density
+  void setupDensityGrid();
+  void clearDensityGrid();
+  const Ped::TdensityGrid* getDensityGrid() const {
+    return Ped::Tscene::getDensityGrid();
+  }
+
+  // → hybrid mode, continuum outside the region of interest
+  void setupContinuum();
+  void clearContinuum();
+  const Ped::Tcontinuum* getContinuum() const { return continuum; }
+
+  // → counting gates and zones, see FlowCounter
+  void addGate(const QString& name, const Ped::Tvector& start,
+               const Ped::Tvector& end);
+  void addZone(const QString& name, const std::vector<Ped::Tvector>& corners);
+  FlowCounter& getFlowCounter() { return flowCounter; }
+
+  // → level of detail, see OverrunController
+  void setNeighborReuse(size_t steps) { Ped::Tscene::setNeighborReuse(steps); }
+  void setReducedDetailDistance(double distance);
 
  protected:
   void dissolveClusters();
+  void updateNeighborhoods();
+  void schedulePeriodicTasks();
+  void applyMotionModel(int type);
+  void updateContinuum();
+  bool isAggregatable(const Agent* agent) const;
+  size_t getContinuumPopulation(const QList<Waypoint*>& route,
+                                Ped::Tagent::AgentType type);
 
  public:
   virtual void addAgent(Agent* agent);
   virtual void addObstacle(Obstacle* obstacle);
+  virtual void addDynamicObstacle(DynamicObstacle* obstacle);
+  virtual size_t addPolygon(const std::vector<Ped::Tvector>& corners);
   virtual void addWaypoint(Waypoint* waypoint);
   virtual void addAgentCluster(AgentCluster* clusterIn);
   virtual void addWaitingQueue(WaitingQueue* queueIn);
@@ -148,16 +249,19 @@ class Scene : public QObject, protected Ped::Tscene {
   virtual bool removeWaitingQueue(WaitingQueue* queueIn);
   virtual bool removeAttraction(AttractionArea* attractionInIn);
 
-  virtual std::set<const Ped::Tagent*> getNeighbors(double x, double y,
-                                                    double maxDist);
-
   // obstacle cell locations
   std::vector<Location> obstacle_cells_;
 
   // Attributes
  protected:
   QList<Agent*> agents;
+  // → the ROBOT agents among them, in the order they were added
+  QList<Agent*> robots;
   QList<Obstacle*> obstacles;
+  QList<DynamicObstacle*> dynamicObstacles;
+  // → where each obstacle was, to update what depends on it when it moves
+  QHash<Obstacle*, QRectF> obstacleBounds;
+  uint64_t obstacleRevision;
   QMap<QString, Waypoint*> waypoints;
   QMap<QString, AttractionArea*> attractions;
   QList<AgentCluster*> agentClusters;
@@ -165,8 +269,38 @@ class Scene : public QObject, protected Ped::Tscene {
 
   std::vector<SpawnArea*> spawn_areas;
 
+  // → flow fields, by waypoint name; shared by all agents heading there
+  //   and by the waypoint copies in snapshots
+  QMap<QString, std::shared_ptr<Ped::TflowField>> flowFields;
+  // → area covering the obstacles moved since the fields were updated
+  QRectF flowFieldChanges;
+  // → threads computing and repairing the fields, kept between ticks
+  Ped::TworkerPool flowFieldWorkers;
+
+  // → shared by all agent types using ORCA, created when first selected
+  Ped::TorcaModel* orcaModel;
+
+  // → agents farther from all robots only see close neighbors, 0 for off
+  double reducedDetailDistance;
+
+  // → far-away pedestrians, see setupContinuum()
+  Ped::Tcontinuum* continuum;
+  // → area covering the obstacles moved since its passages were updated
+  QRectF continuumChanges;
+  std::vector<ContinuumPopulation> continuumPopulations;
+  std::vector<Ped::Tcontinuum::Tentry> continuumEntries;
+
+  // → crossings and dwell times, updated every tick
+  FlowCounter flowCounter;
+
   // → simulated time
+  // note: the time isn't accumulated, it's tick * time step since the
+  //       time step last changed
+  uint64_t tick;
+  uint64_t epochTick;
+  double epochTime;
   double sceneTime;
+  TickScheduler scheduler;
 };
 
 #endif
@@ -34,38 +34,62 @@
 #include <ros/console.h>
 #include <ros/ros.h>
 
+#include <tf/transform_broadcaster.h>
 #include <tf/transform_listener.h>
 #include <functional>
 #include <memory>
 
 #include <pedsim_msgs/AgentForce.h>
+#include <pedsim_msgs/AgentSpawn.h>
 #include <pedsim_msgs/AgentGroup.h>
 #include <pedsim_msgs/AgentGroups.h>
 #include <pedsim_msgs/AgentState.h>
 #include <pedsim_msgs/AgentStates.h>
+#include <pedsim_msgs/AgentTrajectories.h>
+#include <pedsim_msgs/AgentTrajectory.h>
+#include <pedsim_msgs/DensityGrid.h>
+#include <pedsim_msgs/FlowMeasurements.h>
 #include <pedsim_msgs/LineObstacle.h>
 #include <pedsim_msgs/LineObstacles.h>
+#include <pedsim_msgs/RobotMetrics.h>
+#include <pedsim_msgs/SpatialQuery.h>
+#include <pedsim_msgs/SpatialQueryResult.h>
 #include <pedsim_msgs/Waypoint.h>
 #include <pedsim_msgs/Waypoints.h>
+#include <pedsim_srvs/QueryScene.h>
+#include <pedsim_srvs/SeekReplay.h>
 
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include <geometry_msgs/Point.h>
 #include <geometry_msgs/PoseStamped.h>
 #include <geometry_msgs/PoseWithCovariance.h>
+#include <geometry_msgs/Twist.h>
 #include <geometry_msgs/TwistWithCovariance.h>
+#include <nav_msgs/OccupancyGrid.h>
 #include <nav_msgs/Odometry.h>
 #include <std_msgs/Header.h>
 #include <std_srvs/Empty.h>
+#include <std_srvs/Trigger.h>
 
 #include <pedsim_simulator/agentstatemachine.h>
+#include <pedsim_simulator/allocationcounter.h>
 #include <pedsim_simulator/config.h>
+#include <pedsim_simulator/datasetexporter.h>
 #include <pedsim_simulator/element/agent.h>
 #include <pedsim_simulator/element/agentgroup.h>
 #include <pedsim_simulator/element/attractionarea.h>
 #include <pedsim_simulator/element/obstacle.h>
 #include <pedsim_simulator/element/waitingqueue.h>
 #include <pedsim_simulator/element/waypoint.h>
+#include <pedsim_simulator/heatmapaccumulator.h>
+#include <pedsim_simulator/overruncontroller.h>
+#include <pedsim_simulator/robotdrive.h>
+#include <pedsim_simulator/robotmetrics.h>
+#include <pedsim_simulator/robotposesource.h>
+#include <pedsim_simulator/runlog.h>
 #include <pedsim_simulator/scenarioreader.h>
 #include <pedsim_simulator/scene.h>
+#include <pedsim_simulator/trajectorypredictor.h>
 
 #include <dynamic_reconfigure/server.h>
 #include <pedsim_simulator/PedsimSimulatorConfig.h>
@@ -87,23 +111,83 @@ class Simulator {
                          std_srvs::Empty::Response& response);
   bool onUnpauseSimulation(std_srvs::Empty::Request& request,
                            std_srvs::Empty::Response& response);
+  bool onSeekReplay(pedsim_srvs::SeekReplay::Request& request,
+                    pedsim_srvs::SeekReplay::Response& response);
+  bool onQueryScene(pedsim_srvs::QueryScene::Request& request,
+                    pedsim_srvs::QueryScene::Response& response);
+  bool onDumpHeatmaps(std_srvs::Trigger::Request& request,
+                      std_srvs::Trigger::Response& response);
 
   void spawnCallback(const ros::TimerEvent& event);
+  void publishSpawn(const RecordedEvent& spawn);
 
  protected:
   void reconfigureCB(SimConfig& config, uint32_t level);
   dynamic_reconfigure::Server<SimConfig> server_;
 
  private:
-  void updateRobotPositionFromTF();
+  /// A robot of the scenario, with its own pose input, base frame and
+  /// odometry output. The first unnamed robot keeps the topics and frame
+  /// of single robot setups.
+  struct Robot {
+    Agent* agent;  ///< null while replaying
+    int id;
+    std::string name;
+    std::string base_frame_id;
+    ros::Publisher pub_position;
+    std::unique_ptr<RobotPoseSource> pose_source;
+    VelocityEstimator velocity_estimator;
+    geometry_msgs::Quaternion last_orientation;
+    // → kinematic robots only
+    std::unique_ptr<RobotDrive> drive;
+    ros::Subscriber sub_cmd_vel;
+  };
+
+  void loadAgentProfiles();
+  void setupRobots();
+  std::unique_ptr<Robot> createRobot(size_t index, Agent* agent);
+  void setupRobotDrive(Robot& robot, const std::string& prefix);
+  Robot* getRobotById(int id);
+  void updateRobotPosition(Robot& robot);
+  void updateRobotPositionFromTF(Robot& robot);
+  void setRobotPose(Robot& robot, const RobotPose& pose);
   void publishAgents();
   void publishGroups();
   void publishObstacles();
-  void publishRobotPosition();
+  void publishRobotPosition(Robot& robot, double x, double y, double vx,
+                            double vy);
   void publishWaypoints();
+  void publishDensityGrid();
+  void updatePredictions();
+  void publishPredictions(const Ped::Trollout& rollout);
+  void setupExport();
+  void exportFrame();
+  void setupRecording();
+  void recordObstacles();
+  void recordFrame();
+  bool initializeReplay();
+  void runReplay();
+  void publishReplayState();
+  void setupMetrics();
+  void updateMetrics();
+  void publishMetrics();
+  void writeMetrics();
+  void setupFlowMeasurements();
+  void publishFlowMeasurements();
+  void setupHeatmaps();
+  void accumulateHeatmaps();
+  void publishHeatmaps(const HeatmapAccumulator::Grids& grids);
+  bool writeHeatmaps(const HeatmapAccumulator::Grids& grids);
+  void setupOverrunControl();
+  void updateOverrunControl(double duration);
+  void applyDegradation(int level);
+  void publishDiagnostics(int previousLevel);
+  void answerQuery(const pedsim_msgs::SpatialQuery& query,
+                   pedsim_msgs::SpatialQueryResult& result) const;
 
  private:
   ros::NodeHandle nh_;
+  int queue_size_;
   bool paused_;
   ros::Timer spawn_timer_;
 
@@ -111,24 +195,77 @@ class Simulator {
   ros::Publisher pub_obstacles_;
   ros::Publisher pub_agent_states_;
   ros::Publisher pub_agent_groups_;
-  ros::Publisher pub_robot_position_;
   ros::Publisher pub_waypoints_;
+  ros::Publisher pub_density_grid_;
+  ros::Publisher pub_predicted_trajectories_;
+  ros::Publisher pub_robot_metrics_;
+  ros::Publisher pub_flow_measurements_;
+  ros::Publisher pub_agent_spawns_;
+  ros::Publisher pub_heatmap_occupancy_;
+  ros::Publisher pub_heatmap_speed_;
+  ros::Publisher pub_heatmap_stops_;
+  ros::Publisher pub_diagnostics_;
 
   // provided services
   ros::ServiceServer srv_pause_simulation_;
   ros::ServiceServer srv_unpause_simulation_;
+  ros::ServiceServer srv_seek_replay_;
+  ros::ServiceServer srv_query_scene_;
+  ros::ServiceServer srv_dump_heatmaps_;
 
   // frame ids
   std::string frame_id_;
-  std::string robot_base_frame_id_;
 
   // pointers and additional data
   std::unique_ptr<tf::TransformListener> transform_listener_;
-  Agent* robot_;
-  tf::StampedTransform last_robot_pose_;
-  geometry_msgs::Quaternion last_robot_orientation_;
+  std::unique_ptr<tf::TransformBroadcaster> transform_broadcaster_;
+
+  // robots, in the order of SCENE.getRobots()
+  std::vector<std::unique_ptr<Robot>> robots_;
+
+  // trajectory prediction around the first robot
+  TrajectoryPredictor trajectory_predictor_;
+  ros::Time prediction_stamp_;
+
+  // agent states streamed to disk
+  DatasetExporter dataset_exporter_;
+  double last_export_time_;
+
+  // record and replay of runs
+  RunRecorder run_recorder_;
+  std::vector<RecordedAgent> recorded_agents_;
+  RunReplayer run_replayer_;
+  bool replaying_;
+  double replay_time_;
+
+  // safety and comfort measures of the first robot's run
+  RobotMetrics robot_metrics_;
+  std::vector<const Ped::Tagent*> metrics_neighbors_;
+
+  // gate counts last published, for the rates
+  std::vector<std::pair<unsigned int, unsigned int>> published_gate_counts_;
+  double last_flow_publish_time_;
+
+  // occupancy, speed and stop heatmaps of the whole run
+  HeatmapAccumulator heatmap_accumulator_;
+
+  // detail given up when ticks overrun their budget
+  OverrunController overrun_controller_;
+  uint64_t publish_decimation_;
+
+  // walls last published, see Scene::getObstacleRevision()
+  uint64_t published_obstacle_revision_;
+  // walls last written to the run log
+  uint64_t recorded_obstacle_revision_;
+
+  // messages published every tick, reused so that they don't allocate
+  pedsim_msgs::AgentStates agent_states_msg_;
+  pedsim_msgs::AgentGroups agent_groups_msg_;
+  pedsim_msgs::Waypoints waypoints_msg_;
+  pedsim_msgs::DensityGrid density_grid_msg_;
+  ros::WallTime last_diagnostics_time_;
 
-  inline std::string agentStateToActivity(
+  inline const std::string& agentStateToActivity(
       const AgentStateMachine::AgentState& state) const;
 
   inline std_msgs::Header createMsgHeader() const;
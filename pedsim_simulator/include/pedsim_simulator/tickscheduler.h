@@ -0,0 +1,83 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef _tickscheduler_h_
+#define _tickscheduler_h_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <queue>
+#include <utility>
+#include <vector>
+
+/// -----------------------------------------------------------------
+/// \class TickScheduler
+/// \brief Runs periodic tasks on the ticks they are due
+/// \details Intervals are given in seconds and rounded to whole ticks of
+/// the time step, at least one. The due ticks are kept in a heap, so a tick
+/// without due tasks costs a single comparison. When the time step changes,
+/// the tasks keep their next due tick and continue with the new period.
+/// -----------------------------------------------------------------
+class TickScheduler {
+ public:
+  typedef std::function<void()> Task;
+
+  TickScheduler();
+
+  void setTimeStep(double h);
+  double getTimeStep() const { return timeStep; }
+  /// \return  the interval in whole ticks, at least one
+  uint64_t toTicks(double interval) const;
+
+  /// \param   firstTick  the first tick the task runs on
+  /// \return  id for cancel()
+  int schedule(double interval, const Task& task, uint64_t firstTick = 0);
+  bool cancel(int id);
+  void clear();
+
+  /// Runs the tasks due at the tick, or missed before it.
+  void run(uint64_t tick);
+
+ protected:
+  struct Entry {
+    double interval;
+    uint64_t period;
+    Task task;
+  };
+  typedef std::pair<uint64_t, int> Due;
+
+  double timeStep;
+  int lastId;
+  std::map<int, Entry> entries;
+  // → cancelled tasks stay in the heap until they come up
+  std::priority_queue<Due, std::vector<Due>, std::greater<Due>> due;
+};
+
+#endif
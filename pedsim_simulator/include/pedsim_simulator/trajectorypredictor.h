@@ -0,0 +1,78 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _trajectorypredictor_h_
+#define _trajectorypredictor_h_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Ped {
+class Trollout;
+}
+
+/// -----------------------------------------------------------------
+/// \class TrajectoryPredictor
+/// \brief Runs trajectory rollouts on a worker thread
+/// \details The simulation thread hands over a rollout (see
+/// Scene::createRollout()) and picks up the result in a later tick. One
+/// rollout runs at a time; the simulation never waits for it.
+/// -----------------------------------------------------------------
+class TrajectoryPredictor {
+ public:
+  TrajectoryPredictor();
+  virtual ~TrajectoryPredictor();
+
+  bool isBusy();
+  bool start(std::unique_ptr<Ped::Trollout> rollout, double horizon,
+             double stepSize, double sampleInterval);
+  std::unique_ptr<Ped::Trollout> takeResult();
+
+ protected:
+  void run();
+
+  // Attributes
+ protected:
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool stopping;
+
+  // → the rollout waiting for or in computation, and the last result
+  std::unique_ptr<Ped::Trollout> pending;
+  bool computing;
+  std::unique_ptr<Ped::Trollout> result;
+
+  double horizon;
+  double stepSize;
+  double sampleInterval;
+};
+
+#endif
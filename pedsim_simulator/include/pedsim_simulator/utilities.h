@@ -34,12 +34,69 @@
 /// --------------------------------------
 /// \enum RobotMode
 /// \brief Robot control mode
+/// \details KINEMATIC robots are driven by cmd_vel through a RobotDrive
+/// stepped with the crowd.
 /// --------------------------------------
-enum class RobotMode { CONTROLLED = 0, TELEOPERATION = 1, SOCIAL_DRIVE = 2 };
+enum class RobotMode {
+  CONTROLLED = 0,
+  TELEOPERATION = 1,
+  SOCIAL_DRIVE = 2,
+  KINEMATIC = 3
+};
 
 /// \brief Modes for running the simulator
 enum class VisualMode { HEADLESS = 0, MINIMAL = 1, FULL = 2 };
 
+/// \brief Local motion models agents can be driven by
+enum class MotionModel { SOCIAL_FORCE = 0, ORCA = 1 };
+
+/// --------------------------------------
+/// \struct ForceParameters
+/// \brief Force weights read by all force computations
+/// \details One block is shared by all agents. Changes are collected in
+/// a pending copy and become active at the next tick boundary, which also
+/// increments the version.
+/// --------------------------------------
+struct ForceParameters {
+  double obstacle;
+  double sigmaObstacle;
+  double social;
+  double groupGaze;
+  double groupCoherence;
+  double groupRepulsion;
+  double random;
+  double alongWall;
+  // bit set of Force::ForceType values left out, see OverrunController
+  unsigned int suppressed;
+  unsigned long version;
+};
+
+/// --------------------------------------
+/// \struct AgentProfile
+/// \brief Parameters shared by all agents of one type
+/// \details Applied to an agent once when its type is set, and again
+/// only when the profile itself changes. Force factors scale the global
+/// force weights from the configuration.
+/// --------------------------------------
+struct AgentProfile {
+  double vmax;                 ///< maximal speed, <= 0 keeps the sampled one
+  double radius;               ///< body radius used for obstacle forces
+  double forceFactorDesired;   ///< desired force factor
+  double forceFactorSocial;    ///< scales the global social force weight
+  double forceFactorObstacle;  ///< scales the global obstacle force weight
+  MotionModel motionModel;     ///< how the agents avoid each other
+
+  AgentProfile(double vmaxIn = -1, double radiusIn = 0.35,
+               double desiredIn = 1.0, double socialIn = 1.0,
+               double obstacleIn = 1.0)
+      : vmax(vmaxIn),
+        radius(radiusIn),
+        forceFactorDesired(desiredIn),
+        forceFactorSocial(socialIn),
+        forceFactorObstacle(obstacleIn),
+        motionModel(MotionModel::SOCIAL_FORCE) {}
+};
+
 /// --------------------------------------
 /// \struct Location
 /// \brief 2D location/cell
@@ -38,8 +38,6 @@
 class AgentGroup;
 
 class GroupWaypointPlanner : public WaypointPlanner {
-  Q_OBJECT
-
   // Constructor and Destructor
  public:
   GroupWaypointPlanner();
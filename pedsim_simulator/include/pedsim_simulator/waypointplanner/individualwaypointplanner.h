@@ -38,8 +38,6 @@
 class AgentGroup;
 
 class IndividualWaypointPlanner : public WaypointPlanner {
-  Q_OBJECT
-
   // Constructor and Destructor
  public:
   IndividualWaypointPlanner();
@@ -36,10 +36,12 @@
 #include <pedsim_simulator/rng.h>
 #include <pedsim_simulator/waypointplanner/waypointplanner.h>
 
+#include <QObject>
+
 // Forward Declarations
 class WaitingQueue;
 
-class QueueingWaypointPlanner : public WaypointPlanner {
+class QueueingWaypointPlanner : public QObject, public WaypointPlanner {
   Q_OBJECT
 
   // TODO - change to enum class
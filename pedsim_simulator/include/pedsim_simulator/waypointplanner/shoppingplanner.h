@@ -40,22 +40,15 @@ class Agent;
 class AttractionArea;
 
 class ShoppingPlanner : public WaypointPlanner {
-  Q_OBJECT
-
   // Constructor and Destructor
  public:
   ShoppingPlanner();
 
-  // Signals
- signals:
-  void lostAttraction();
-
- public slots:
-  void loseAttraction();
-
   // Methods
  public:
+  void loseAttraction();
   bool setAgent(Agent* agentIn);
+  void setInformGroup(bool informGroupIn);
 
   // → Waypoints
   AttractionArea* getAttraction() const;
@@ -84,6 +77,8 @@ class ShoppingPlanner : public WaypointPlanner {
   // → Waypoints
   Waypoint* currentWaypoint;
   double timeReached;
+  // → whether the group members lose the attraction with the agent
+  bool informGroup;
 };
 
 #endif
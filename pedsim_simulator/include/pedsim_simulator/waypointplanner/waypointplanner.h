@@ -32,16 +32,14 @@
 #ifndef _waypointplanner_h_
 #define _waypointplanner_h_
 
-#include <QObject>
+#include <QString>
 
 // Forward Declarations
 class Agent;
 class AgentGroup;
 class Waypoint;
 
-class WaypointPlanner : public QObject {
-  Q_OBJECT
-
+class WaypointPlanner {
   // Enums
  public:
   typedef enum { Individual, Group, All } Type;
@@ -50,6 +48,9 @@ class WaypointPlanner : public QObject {
  protected:
   WaypointPlanner();
 
+ public:
+  virtual ~WaypointPlanner();
+
   // Methods
  public:
   static Type getPlannerType();
@@ -206,22 +206,9 @@ void AgentStateMachine::activateState(AgentState stateIn) {
       agent->disableForce("GroupGaze");
 
       // keep other agents informed about the attraction
-      AgentGroup* group = agent->getGroup();
-      if (group != nullptr) {
-        foreach (Agent* member, group->getMembers()) {
-          if (member == agent) continue;
-
-          AgentStateMachine* memberStateMachine = member->getStateMachine();
-          connect(shoppingPlanner, SIGNAL(lostAttraction()), memberStateMachine,
-                  SLOT(loseAttraction()));
-        }
-      }
-
+      shoppingPlanner->setInformGroup(true);
       break;
   }
-
-  // inform users
-  emit stateChanged(state);
 }
 
 void AgentStateMachine::deactivateState(AgentState state) {
@@ -246,17 +233,7 @@ void AgentStateMachine::deactivateState(AgentState state) {
       shoppingPlanner->loseAttraction();
 
       // don't worry about other group members
-      AgentGroup* group = agent->getGroup();
-      if (group != nullptr) {
-        foreach (Agent* member, group->getMembers()) {
-          if (member == agent) continue;
-
-          AgentStateMachine* memberStateMachine = member->getStateMachine();
-          disconnect(shoppingPlanner, SIGNAL(lostAttraction()),
-                     memberStateMachine, SLOT(loseAttraction()));
-        }
-      }
-
+      shoppingPlanner->setInformGroup(false);
       break;
   }
 }
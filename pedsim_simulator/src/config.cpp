@@ -29,6 +29,7 @@
 * \author Sven Wehner <mail@svenwehner.de>
 */
 
+#include <pedsim/ped_agent.h>
 #include <pedsim_simulator/config.h>
 
 // initialize static value
@@ -38,15 +39,20 @@ Config::Config(QObject* parent) {
   updateRate = 25.0;
   simulationFactor = 1.0;
 
-  forceObstacle = 10.0;
-  sigmaObstacle = 0.2;
-  forceSocial = 5.1;
+  activeForces.obstacle = 10.0;
+  activeForces.sigmaObstacle = 0.2;
+  activeForces.social = 5.1;
 
-  forceGroupGaze = 3.0;
-  forceGroupCoherence = 2.0;
-  forceGroupRepulsion = 1.0;
-  forceRandom = 0.1;
-  forceAlongWall = 2.0;
+  activeForces.groupGaze = 3.0;
+  activeForces.groupCoherence = 2.0;
+  activeForces.groupRepulsion = 1.0;
+  activeForces.random = 0.1;
+  activeForces.alongWall = 2.0;
+  activeForces.suppressed = 0;
+  activeForces.version = 0;
+
+  pendingForces = activeForces;
+  forcesChanged = false;
 
   cell_width = 1.0;
   cell_height = 1.0;
@@ -60,6 +66,82 @@ Config::Config(QObject* parent) {
   wait_time_beta = 0.2;
 
   visual_mode = VisualMode::MINIMAL;
+
+  flow_fields_enabled = false;
+  flow_field_resolution = 0.25;
+  flow_field_clearance = 0.3;
+  flow_field_cache_dir = "";
+
+  visibility_graph_enabled = false;
+  visibility_graph_clearance = 0.8;
+
+  orca_time_horizon = 2.0;
+  orca_obstacle_time_horizon = 1.0;
+  orca_max_neighbors = 10;
+  orca_threads = 0;
+
+  density_grid_enabled = false;
+  density_grid_resolution = 1.0;
+  density_speed_scaling = false;
+
+  prediction_enabled = false;
+  prediction_horizon = 3.0;
+  prediction_radius = 10.0;
+  prediction_sample_interval = 0.2;
+
+  export_enabled = false;
+  export_directory = "";
+  export_format = "columnar";
+  export_interval = 0;
+  export_chunk_frames = 100;
+
+  robot_pose_source = "tf";
+  robot_pose_topic = "robot_pose";
+  robot_velocity_smoothing = 0.1;
+  overrun_control_enabled = false;
+  overrun_degrade_time = 1.0;
+  overrun_restore_time = 5.0;
+  overrun_restore_load = 0.7;
+
+  robot_kinematics = "diff_drive";
+  robot_cmd_vel_topic = "/pedbot/control/cmd_vel";
+
+  metrics_enabled = false;
+  metrics_personal_space = 1.2;
+  metrics_publish_interval = 1.0;
+  metrics_file = "";
+  metrics_goal_tolerance = 0.5;
+
+  flow_publish_interval = 5.0;
+  flow_dwell_bin_width = 10.0;
+  flow_dwell_bins = 30;
+
+  heatmap_enabled = false;
+  heatmap_cell_size = 0.5;
+  heatmap_stop_speed = 0.2;
+  heatmap_directory = "";
+
+  record_file = "";
+  record_keyframe_interval = 5.0;
+  replay_file = "";
+  replay_speed = 1.0;
+
+  hybrid_enabled = false;
+  hybrid_cell_size = 1.0;
+  hybrid_region_x = -25;
+  hybrid_region_y = -25;
+  hybrid_region_width = 50;
+  hybrid_region_height = 50;
+
+  // agent type profiles
+  // → ADULT, CHILD: sampled speed, default force factors
+  agentProfiles.resize(4);
+  agentProfiles[Ped::Tagent::ADULT] = AgentProfile();
+  agentProfiles[Ped::Tagent::CHILD] = AgentProfile();
+  // → ROBOT: tuned when the robot mode is known, see Simulator
+  agentProfiles[Ped::Tagent::ROBOT] = AgentProfile();
+  // → ELDER: old people are slow
+  agentProfiles[Ped::Tagent::ELDER] = AgentProfile(0.9, 0.35, 0.5);
 }
 
 Config& Config::getInstance() {
@@ -69,81 +151,131 @@ Config& Config::getInstance() {
 }
 
 void Config::setObstacleForce(double valueIn) {
-  forceObstacle = valueIn;
+  // takes effect at the next tick boundary
+  pendingForces.obstacle = valueIn;
+  forcesChanged = true;
 
   // inform users
   emit forceFactorChanged("obstacle", valueIn);
-  emit forceFactorObstacleChanged(valueIn);
 }
 
 void Config::setObstacleSigma(double valueIn) {
-  sigmaObstacle = valueIn;
+  // takes effect at the next tick boundary
+  pendingForces.sigmaObstacle = valueIn;
+  forcesChanged = true;
 
   // inform users
   emit forceFactorChanged("obstacle_sigma", valueIn);
-  emit forceSigmaObstacleChanged(valueIn);
 }
 
 void Config::setSocialForce(double valueIn) {
-  forceSocial = valueIn;
+  // takes effect at the next tick boundary
+  pendingForces.social = valueIn;
+  forcesChanged = true;
 
   // inform users
   emit forceFactorChanged("social", valueIn);
-  emit forceFactorSocialChanged(valueIn);
 }
 
 void Config::setGroupGazeForce(double valueIn) {
-  forceGroupGaze = valueIn;
+  // takes effect at the next tick boundary
+  pendingForces.groupGaze = valueIn;
+  forcesChanged = true;
 
   // inform users
   emit forceFactorChanged("group_gaze", valueIn);
-  emit forceFactorGroupGazeChanged(valueIn);
 }
 
 void Config::setGroupCoherenceForce(double valueIn) {
-  forceGroupCoherence = valueIn;
+  // takes effect at the next tick boundary
+  pendingForces.groupCoherence = valueIn;
+  forcesChanged = true;
 
   // inform users
   emit forceFactorChanged("group_coherence", valueIn);
-  emit forceFactorGroupCoherenceChanged(valueIn);
 }
 
 void Config::setGroupRepulsionForce(double valueIn) {
-  forceGroupRepulsion = valueIn;
+  // takes effect at the next tick boundary
+  pendingForces.groupRepulsion = valueIn;
+  forcesChanged = true;
 
   // inform users
   emit forceFactorChanged("group_repulsion", valueIn);
-  emit forceFactorGroupRepulsionChanged(valueIn);
 }
 
 void Config::setRandomForce(double valueIn) {
-  forceRandom = valueIn;
+  // takes effect at the next tick boundary
+  pendingForces.random = valueIn;
+  forcesChanged = true;
 
   // inform users
   emit forceFactorChanged("random", valueIn);
-  emit forceFactorRandomChanged(valueIn);
 }
 
 void Config::setAlongWallForce(double valueIn) {
-  forceAlongWall = valueIn;
+  // takes effect at the next tick boundary
+  pendingForces.alongWall = valueIn;
+  forcesChanged = true;
 
   // inform users
   emit forceFactorChanged("alongwall", valueIn);
-  emit forceFactorAlongWallChanged(valueIn);
 }
 
+void Config::setSuppressedForces(unsigned int forcesIn) {
+  // takes effect at the next tick boundary
+  pendingForces.suppressed = forcesIn;
+  forcesChanged = true;
+}
+
+/// Activates the pending force parameters. Called once per tick, before the
+/// agents are moved, so that all forces of one tick use the same values.
+/// \return true if the parameters changed
+bool Config::commitForceParameters() {
+  if (!forcesChanged) return false;
+
+  const unsigned long version = activeForces.version;
+  activeForces = pendingForces;
+  activeForces.version = version + 1;
+  forcesChanged = false;
+  return true;
+}
+
+/// The force weights in use for the current tick. Changes made since then
+/// only show up after the next commitForceParameters().
 QMap<QString, double> Config::getForceMap() const {
   // create output map
   QMap<QString, double> forceMap;
   // → fill map
-  forceMap["obstacle"] = forceObstacle;
-  forceMap["obstacle_sigma"] = sigmaObstacle;
-  forceMap["social"] = forceSocial;
-  forceMap["group_gaze"] = forceGroupGaze;
-  forceMap["group_coherence"] = forceGroupCoherence;
-  forceMap["group_repulsion"] = forceGroupRepulsion;
-  forceMap["random"] = forceRandom;
-  forceMap["alongwall"] = forceAlongWall;
+  forceMap["obstacle"] = activeForces.obstacle;
+  forceMap["obstacle_sigma"] = activeForces.sigmaObstacle;
+  forceMap["social"] = activeForces.social;
+  forceMap["group_gaze"] = activeForces.groupGaze;
+  forceMap["group_coherence"] = activeForces.groupCoherence;
+  forceMap["group_repulsion"] = activeForces.groupRepulsion;
+  forceMap["random"] = activeForces.random;
+  forceMap["alongwall"] = activeForces.alongWall;
 
   return forceMap;
 }
+
+const AgentProfile& Config::getAgentProfile(int type) const {
+  // unknown types behave like adults
+  if (type < 0 || type >= static_cast<int>(agentProfiles.size()))
+    return agentProfiles[Ped::Tagent::ADULT];
+
+  return agentProfiles[type];
+}
+
+void Config::setAgentProfile(int type, const AgentProfile& profileIn) {
+  // sanity checks
+  if (type < 0) return;
+
+  // custom types extend the table, gaps fall back to the adult profile
+  if (type >= static_cast<int>(agentProfiles.size()))
+    agentProfiles.resize(type + 1, agentProfiles[Ped::Tagent::ADULT]);
+  agentProfiles[type] = profileIn;
+
+  // inform users
+  emit agentProfileChanged(type);
+}
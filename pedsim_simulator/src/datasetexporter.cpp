@@ -0,0 +1,298 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <pedsim_simulator/datasetexporter.h>
+
+#include <ros/ros.h>
+#include <zlib.h>
+#include <QDir>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+// chunks waiting for the worker before new ones are dropped
+const size_t maxQueuedChunks = 4;
+
+template <typename T>
+void appendColumn(std::vector<unsigned char>& output,
+                  const std::vector<T>& column) {
+  const unsigned char* data =
+      reinterpret_cast<const unsigned char*>(column.data());
+  output.insert(output.end(), data, data + column.size() * sizeof(T));
+}
+
+template <typename T>
+void writeValue(std::ofstream& file, T value) {
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+}
+
+void DatasetExporter::Chunk::clear() {
+  times.clear();
+  frameOffsets.clear();
+  ids.clear();
+  types.clear();
+  x.clear();
+  y.clear();
+  vx.clear();
+  vy.clear();
+}
+
+void DatasetExporter::Chunk::reserve(size_t frames, size_t rows) {
+  times.reserve(frames);
+  frameOffsets.reserve(frames);
+  ids.reserve(rows);
+  types.reserve(rows);
+  x.reserve(rows);
+  y.reserve(rows);
+  vx.reserve(rows);
+  vy.reserve(rows);
+}
+
+DatasetExporter::DatasetExporter()
+    : opened(false),
+      format(Format::COLUMNAR),
+      chunkFrames(100),
+      chunkCount(0),
+      frameCount(0),
+      stopping(false),
+      droppedChunks(0) {}
+
+DatasetExporter::~DatasetExporter() { close(); }
+
+/// Starts exporting into the given directory, which is created if needed.
+/// \return  false if the directory or the text file can't be created
+bool DatasetExporter::open(const std::string& directoryIn, Format formatIn,
+                           size_t chunkFramesIn) {
+  close();
+
+  if (!QDir().mkpath(QString::fromStdString(directoryIn))) {
+    ROS_WARN_STREAM("Could not create export directory " << directoryIn);
+    return false;
+  }
+
+  directory = directoryIn;
+  format = formatIn;
+  chunkFrames = std::max<size_t>(chunkFramesIn, 1);
+  if (format == Format::ETH_UCY) {
+    textFile.open(directory + "/trajectories.txt", std::ios::trunc);
+    if (!textFile) {
+      ROS_WARN_STREAM("Could not create " << directory
+                                          << "/trajectories.txt");
+      return false;
+    }
+  }
+
+  current.reset(new Chunk());
+  chunkCount = 0;
+  frameCount = 0;
+  droppedChunks = 0;
+  stopping = false;
+  worker = std::thread(&DatasetExporter::run, this);
+  opened = true;
+  return true;
+}
+
+/// Writes the last, partial chunk and waits until everything is on disk.
+void DatasetExporter::close() {
+  if (!opened) return;
+
+  if (current->getFrameCount() > 0) submitChunk();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_one();
+  worker.join();
+
+  textFile.close();
+  current.reset();
+  spareChunks.clear();
+  opened = false;
+}
+
+void DatasetExporter::addRegion(double x, double y, double width,
+                                double height) {
+  regions.push_back(Region{x, y, width, height});
+}
+
+bool DatasetExporter::isInRegion(double x, double y) const {
+  if (regions.empty()) return true;
+
+  for (const Region& region : regions) {
+    if ((x >= region.x) && (x <= region.x + region.width) &&
+        (y >= region.y) && (y <= region.y + region.height))
+      return true;
+  }
+  return false;
+}
+
+void DatasetExporter::beginFrame(double time) {
+  if (!opened) return;
+
+  if (current->getFrameCount() == 0) current->firstFrame = frameCount;
+  current->times.push_back(time);
+  current->frameOffsets.push_back((uint32_t)current->getRowCount());
+}
+
+void DatasetExporter::addAgent(int id, int type, double x, double y,
+                               double vx, double vy) {
+  if (!opened || !isInRegion(x, y)) return;
+
+  current->ids.push_back(id);
+  current->types.push_back((uint8_t)type);
+  current->x.push_back((float)x);
+  current->y.push_back((float)y);
+  current->vx.push_back((float)vx);
+  current->vy.push_back((float)vy);
+}
+
+void DatasetExporter::endFrame() {
+  if (!opened) return;
+
+  ++frameCount;
+  if (current->getFrameCount() >= chunkFrames) submitChunk();
+}
+
+size_t DatasetExporter::getDroppedChunks() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return droppedChunks;
+}
+
+/// Hands the current chunk to the worker and continues with a spare one,
+/// so the buffers keep their capacity.
+void DatasetExporter::submitChunk() {
+  std::unique_ptr<Chunk> next;
+  size_t frames = 0, rows = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue.size() >= maxQueuedChunks) {
+      // → the worker is behind, drop this chunk and reuse its buffers
+      ++droppedChunks;
+      current->clear();
+      return;
+    }
+
+    frames = current->getFrameCount();
+    rows = current->getRowCount();
+    current->index = chunkCount++;
+    queue.push_back(std::move(current));
+    if (!spareChunks.empty()) {
+      next = std::move(spareChunks.back());
+      spareChunks.pop_back();
+    }
+  }
+  condition.notify_one();
+
+  if (next == nullptr) {
+    // → expect a chunk like the last one
+    next.reset(new Chunk());
+    next->reserve(frames, rows);
+  }
+  current = std::move(next);
+}
+
+void DatasetExporter::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    condition.wait(lock, [this] { return stopping || !queue.empty(); });
+    if (queue.empty()) return;
+
+    std::unique_ptr<Chunk> chunk = std::move(queue.front());
+    queue.pop_front();
+
+    // the chunk belongs to the worker now
+    lock.unlock();
+    const bool written = (format == Format::COLUMNAR) ? writeColumnar(*chunk)
+                                                      : writeEthUcy(*chunk);
+    if (!written)
+      ROS_WARN_STREAM("Could not write export chunk " << chunk->index);
+    chunk->clear();
+    lock.lock();
+
+    spareChunks.push_back(std::move(chunk));
+  }
+}
+
+bool DatasetExporter::writeColumnar(const Chunk& chunk) {
+  payload.clear();
+  appendColumn(payload, chunk.times);
+  appendColumn(payload, chunk.frameOffsets);
+  appendColumn(payload, chunk.ids);
+  appendColumn(payload, chunk.types);
+  appendColumn(payload, chunk.x);
+  appendColumn(payload, chunk.y);
+  appendColumn(payload, chunk.vx);
+  appendColumn(payload, chunk.vy);
+
+  // → fast compression, to keep up with large crowds
+  uLongf compressedSize = compressBound(payload.size());
+  compressed.resize(compressedSize);
+  if (compress2(compressed.data(), &compressedSize, payload.data(),
+                payload.size(), Z_BEST_SPEED) != Z_OK)
+    return false;
+
+  char filename[32];
+  snprintf(filename, sizeof(filename), "/chunk_%06llu.pts",
+           (unsigned long long)chunk.index);
+  std::ofstream file(directory + filename, std::ios::binary | std::ios::trunc);
+  if (!file) return false;
+
+  file.write("PTSC", 4);
+  writeValue<uint32_t>(file, 1);
+  writeValue<uint32_t>(file, (uint32_t)chunk.getFrameCount());
+  writeValue<uint32_t>(file, (uint32_t)chunk.getRowCount());
+  writeValue<uint64_t>(file, compressedSize);
+  writeValue<uint64_t>(file, payload.size());
+  file.write(reinterpret_cast<const char*>(compressed.data()), compressedSize);
+  return (bool)file;
+}
+
+bool DatasetExporter::writeEthUcy(const Chunk& chunk) {
+  for (size_t frame = 0; frame < chunk.getFrameCount(); ++frame) {
+    const size_t begin = chunk.frameOffsets[frame];
+    const size_t end = (frame + 1 < chunk.getFrameCount())
+                           ? chunk.frameOffsets[frame + 1]
+                           : chunk.getRowCount();
+    for (size_t row = begin; row < end; ++row) {
+      char text[80];
+      const int length =
+          snprintf(text, sizeof(text), "%llu\t%d\t%.3f\t%.3f\n",
+                   (unsigned long long)(chunk.firstFrame + frame),
+                   chunk.ids[row], chunk.x[row], chunk.y[row]);
+      line.insert(line.end(), text, text + length);
+    }
+  }
+
+  textFile.write(line.data(), line.size());
+  textFile.flush();
+  line.clear();
+  return (bool)textFile;
+}
@@ -29,20 +29,24 @@
 * \author Sven Wehner <mail@svenwehner.de>
 */
 
+#include <pedsim/ped_densitygrid.h>
 #include <pedsim_simulator/agentstatemachine.h>
 #include <pedsim_simulator/config.h>
 #include <pedsim_simulator/element/agent.h>
 #include <pedsim_simulator/element/waypoint.h>
 #include <pedsim_simulator/force/force.h>
+#include <pedsim_simulator/robotdrive.h>
 #include <pedsim_simulator/scene.h>
 #include <pedsim_simulator/waypointplanner/waypointplanner.h>
 
+#include <algorithm>
+#include <cmath>
+
 Agent::Agent() {
   // initialize
   Ped::Tagent::setType(Ped::Tagent::ADULT);
-  Ped::Tagent::setForceFactorObstacle(CONFIG.forceObstacle);
-  forceSigmaObstacle = CONFIG.sigmaObstacle;
-  Ped::Tagent::setForceFactorSocial(CONFIG.forceSocial);
+  sampledVmax = vmax;
+  applyTypeProfile();
   // waypoints
   currentDestination = nullptr;
   waypointplanner = nullptr;
@@ -50,6 +54,10 @@ Agent::Agent() {
   stateMachine = new AgentStateMachine(this);
   // group
   group = nullptr;
+  // forces
+  disabledForces = 0;
+  // robot drive
+  drive = nullptr;
 }
 
 Agent::~Agent() {
@@ -61,10 +69,10 @@ Agent::~Agent() {
 /// representation
 Ped::Tvector Agent::desiredForce() {
   Ped::Tvector force;
-  if (!disabledForces.contains("Desired")) force = Tagent::desiredForce();
+  if (isForceEnabled(Force::DESIRED)) force = Tagent::desiredForce();
 
   // inform users
-  emit desiredForceChanged(force.x, force.y);
+  if (emitsForceSignals()) emit desiredForceChanged(force.x, force.y);
 
   return force;
 }
@@ -73,10 +81,10 @@ Ped::Tvector Agent::desiredForce() {
 /// representation
 Ped::Tvector Agent::socialForce() const {
   Ped::Tvector force;
-  if (!disabledForces.contains("Social")) force = Tagent::socialForce();
+  if (isForceEnabled(Force::SOCIAL)) force = Tagent::socialForce();
 
   // inform users
-  emit socialForceChanged(force.x, force.y);
+  if (emitsForceSignals()) emit socialForceChanged(force.x, force.y);
 
   return force;
 }
@@ -85,10 +93,10 @@ Ped::Tvector Agent::socialForce() const {
 /// representation
 Ped::Tvector Agent::obstacleForce() const {
   Ped::Tvector force;
-  if (!disabledForces.contains("Obstacle")) force = Tagent::obstacleForce();
+  if (isForceEnabled(Force::OBSTACLE)) force = Tagent::obstacleForce();
 
   // inform users
-  emit obstacleForceChanged(force.x, force.y);
+  if (emitsForceSignals()) emit obstacleForceChanged(force.x, force.y);
 
   return force;
 }
@@ -96,11 +104,14 @@ Ped::Tvector Agent::obstacleForce() const {
 Ped::Tvector Agent::myForce(Ped::Tvector desired) const {
   // run additional forces
   Ped::Tvector forceValue;
+  const bool informUsers = emitsForceSignals();
+  const unsigned int suppressed = CONFIG.forces().suppressed;
   foreach (Force* force, forces) {
-    // skip disabled forces
-    if (disabledForces.contains(force->getName())) {
+    // skip disabled forces, and those left out to save time
+    if (!isForceEnabled(force->getType()) ||
+        ((suppressed & (1u << force->getType())) != 0)) {
       // update graphical representation
-      emit additionalForceChanged(force->getName(), 0, 0);
+      if (informUsers) emit additionalForceChanged(force->getName(), 0, 0);
       continue;
     }
 
@@ -114,12 +125,13 @@ Ped::Tvector Agent::myForce(Ped::Tvector desired) const {
     forceValue += currentForce;
 
     // update graphical representation
-    emit additionalForceChanged(force->getName(), currentForce.x,
-                                currentForce.y);
+    if (informUsers)
+      emit additionalForceChanged(force->getName(), currentForce.x,
+                                  currentForce.y);
   }
 
   // inform users
-  emit myForceChanged(forceValue.x, forceValue.y);
+  if (informUsers) emit myForceChanged(forceValue.x, forceValue.y);
 
   return forceValue;
 }
@@ -145,53 +157,73 @@ Ped::Twaypoint* Agent::updateDestination() {
 void Agent::updateState() {
   // check state
   stateMachine->doStateTransition();
+
+  // slow down in dense crowds
+  if (CONFIG.density_speed_scaling) updateSpeedFactor();
+}
+
+/// Reduces the maximal speed according to the local density, following
+/// Weidmann's fundamental diagram. The agent itself isn't counted. At jam
+/// density the diagram reaches zero; agents keep a minimal speed instead,
+/// otherwise a jammed cell would never empty.
+void Agent::updateSpeedFactor() {
+  const Ped::TdensityGrid* grid = SCENE.getDensityGrid();
+  if ((grid == nullptr) || (getType() == Ped::Tagent::ROBOT)) return;
+
+  const double cellArea = grid->getCellSize() * grid->getCellSize();
+  const double density =
+      std::max(0.0, grid->getDensity(getx(), gety()) - 1 / cellArea);
+  const double maxDensity = 5.4;
+  const double minFactor = 0.1;
+  if (density <= 0) {
+    setSpeedFactor(1);
+  } else if (density >= maxDensity) {
+    setSpeedFactor(minFactor);
+  } else {
+    setSpeedFactor(std::max(
+        minFactor, 1 - exp(-1.913 * (1 / density - 1 / maxDensity))));
+  }
 }
 
 void Agent::move(double h) {
   if (getType() == Ped::Tagent::ROBOT) {
-    if (CONFIG.robot_mode == RobotMode::TELEOPERATION) {
+    if ((CONFIG.robot_mode == RobotMode::KINEMATIC) && (drive != nullptr)) {
+      // → the drive follows the latest command over the crowd's time step
+      drive->step(h);
+      Ped::Tagent::setPosition(drive->getx(), drive->gety());
+      setvx(drive->getvx());
+      setvy(drive->getvy());
+    }
+
+    if ((CONFIG.robot_mode == RobotMode::TELEOPERATION) ||
+        (CONFIG.robot_mode == RobotMode::KINEMATIC)) {
       // NOTE: Moving is now done by setting x, y position directly in
-      // simulator.cpp
+      // simulator.cpp, or by the robot's drive
       // Robot's vx, vy will still be set for the social force model to work
       // properly wrt. other agents.
-
-      // FIXME: This is a very hacky way of making the robot "move" (=update
-      // position in hash tree) without actually moving it
-      const double vx = getvx();
-      const double vy = getvy();
-
-      setvx(0);
-      setvy(0);
-      Ped::Tagent::move(h);
-      setvx(vx);
-      setvy(vy);
+      // → only the tree is updated; the position stays where the pose
+      //   source or drive put it, even within a polygon
+      Ped::Tagent::keepPosition();
     } else if (CONFIG.robot_mode == RobotMode::CONTROLLED) {
       if (SCENE.getTime() >= CONFIG.robot_wait_time) {
         Ped::Tagent::move(h);
       }
     } else if (CONFIG.robot_mode == RobotMode::SOCIAL_DRIVE) {
-      Ped::Tagent::setForceFactorSocial(CONFIG.forceSocial * 0.7);
-      Ped::Tagent::setForceFactorObstacle(35);
-      Ped::Tagent::setForceFactorDesired(4.2);
-
-      Ped::Tagent::setVmax(1.6);
-      Ped::Tagent::SetRadius(0.4);
+      // NOTE: the social drive parameters come from the robot's profile
       Ped::Tagent::move(h);
     }
   } else {
     Ped::Tagent::move(h);
   }
 
-  if (getType() == Ped::Tagent::ELDER) {
-    // Old people slow!
-    Ped::Tagent::setVmax(0.9);
-    Ped::Tagent::setForceFactorDesired(0.5);
-  }
-
   // inform users
+  // → the position is followed by groups and queues
   emit positionChanged(getx(), gety());
-  emit velocityChanged(getvx(), getvy());
-  emit accelerationChanged(getax(), getay());
+  // → velocity and acceleration are only of interest for visualization
+  if (emitsForceSignals()) {
+    emit velocityChanged(getvx(), getvy());
+    emit accelerationChanged(getax(), getay());
+  }
 }
 
 const QList<Waypoint*>& Agent::getWaypoints() const { return destinations; }
@@ -263,25 +295,45 @@ void Agent::setWaypointPlanner(WaypointPlanner* plannerIn) {
   waypointplanner = plannerIn;
 }
 
+const QString& Agent::getName() const { return name; }
+
+void Agent::setName(const QString& nameIn) { name = nameIn; }
+
+RobotDrive* Agent::getDrive() const { return drive; }
+
+void Agent::setDrive(RobotDrive* driveIn) { drive = driveIn; }
+
 QList<const Agent*> Agent::getNeighbors() const {
-  // upcast neighbors
+  // all agents in the scene are Agents, see Scene::addAgent()
+  // note: prefer iterating getNeighborRange<Agent>() directly, which
+  //       doesn't copy
   QList<const Agent*> output;
-  for (const Ped::Tagent* neighbor : neighbors) {
-    const Agent* upNeighbor = dynamic_cast<const Agent*>(neighbor);
-    if (upNeighbor != nullptr) output.append(upNeighbor);
-  }
+  for (const Agent* neighbor : getNeighborRange<Agent>())
+    output.append(neighbor);
 
   return output;
 }
 
 void Agent::disableForce(const QString& forceNameIn) {
-  // disable force by adding it to the list of disabled forces
-  disabledForces.append(forceNameIn);
+  const int forceType = Force::typeFromName(forceNameIn);
+  if (forceType < 0) {
+    ROS_DEBUG("Cannot disable unknown force: %s",
+              forceNameIn.toStdString().c_str());
+    return;
+  }
+
+  // disable force by setting its bit
+  disabledForces |= (1u << forceType);
 }
 
 void Agent::enableAllForces() {
-  // remove all forces from disabled list
-  disabledForces.clear();
+  // clear all disabled bits
+  disabledForces = 0;
+}
+
+bool Agent::emitsForceSignals() const {
+  // per-force signals only feed a full visualization
+  return (CONFIG.visual_mode == VisualMode::FULL);
 }
 
 void Agent::setPosition(double xIn, double yIn) {
@@ -300,10 +352,31 @@ void Agent::setType(Ped::Tagent::AgentType typeIn) {
   // call super class' method
   Ped::Tagent::setType(typeIn);
 
+  // apply the parameters of the new type once
+  applyTypeProfile();
+
   // inform users
   emit typeChanged(typeIn);
 }
 
+/// Applies the parameter profile of the agent's type. This is done once when
+/// the type is set and whenever the profile or the global force weights
+/// change, never per tick.
+void Agent::applyTypeProfile() {
+  const AgentProfile& profile = CONFIG.getAgentProfile(getType());
+
+  // the sampled maximal speed unless the profile overrides it
+  Ped::Tagent::setVmax((profile.vmax > 0) ? profile.vmax : sampledVmax);
+  Ped::Tagent::SetRadius(profile.radius);
+
+  Ped::Tagent::setForceFactorDesired(profile.forceFactorDesired);
+  Ped::Tagent::setForceFactorSocial(CONFIG.forces().social *
+                                    profile.forceFactorSocial);
+  Ped::Tagent::setForceFactorObstacle(CONFIG.forces().obstacle *
+                                      profile.forceFactorObstacle);
+  forceSigmaObstacle = CONFIG.forces().sigmaObstacle;
+}
+
 Ped::Tvector Agent::getDesiredDirection() const { return desiredforce; }
 
 Ped::Tvector Agent::getWalkingDirection() const { return v; }
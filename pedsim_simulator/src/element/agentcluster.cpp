@@ -68,6 +68,10 @@ QList<Agent*> AgentCluster::dissolve() {
     a->setPosition(randomizedX, randomizedY);
     a->setType(agentType);
 
+    // → several agents of a named cluster are numbered
+    if (!name.isEmpty())
+      a->setName((count > 1) ? QString("%1_%2").arg(name).arg(i) : name);
+
     // add waypoints to the agent
     foreach (Waypoint* waypoint, waypoints)
       a->addWaypoint(waypoint);
@@ -159,6 +163,10 @@ void AgentCluster::setType(Ped::Tagent::AgentType typeIn) {
   emit typeChanged(agentType);
 }
 
+const QString& AgentCluster::getName() const { return name; }
+
+void AgentCluster::setName(const QString& nameIn) { name = nameIn; }
+
 bool AgentCluster::getShallCreateGroups() const {
   // TODO: actually use this
   return shallCreateGroups;
@@ -31,6 +31,41 @@
 
 #include <pedsim_simulator/element/areawaypoint.h>
 
+namespace {
+/// point of the circular area closest to posIn
+Ped::Tvector closestPointInArea(const Ped::Tvector& position, double radius,
+                                const Ped::Tvector& posIn,
+                                bool* withinWaypoint) {
+  Ped::Tvector diff = position - posIn;
+
+  if (diff.length() <= radius) {
+    if (withinWaypoint != NULL) *withinWaypoint = true;
+
+    return posIn;
+  } else {
+    if (withinWaypoint != NULL) *withinWaypoint = false;
+
+    Ped::Tvector direction = diff.normalized();
+    return position + radius * direction;
+  }
+}
+
+/// Detached copy for rollouts and forks, see Ped::Twaypoint::clone()
+class AreaWaypointCopy : public Ped::Twaypoint {
+ public:
+  AreaWaypointCopy(const Ped::Twaypoint& waypointIn)
+      : Ped::Twaypoint(waypointIn) {}
+
+  Ped::Tvector closestPoint(const Ped::Tvector& posIn,
+                            bool* withinWaypoint = NULL) const override {
+    return closestPointInArea(position, radius, posIn, withinWaypoint);
+  }
+  Ped::Twaypoint* clone() const override {
+    return new AreaWaypointCopy(*this);
+  }
+};
+}
+
 AreaWaypoint::AreaWaypoint(const QString& nameIn,
                            const Ped::Tvector& positionIn, double rIn)
     : Waypoint(nameIn, positionIn) {
@@ -58,18 +93,11 @@ bool AreaWaypoint::isWithinArea(const Ped::Tvector& posIn) {
 
 Ped::Tvector AreaWaypoint::closestPoint(const Ped::Tvector& posIn,
                                         bool* withinWaypoint) const {
-  Ped::Tvector diff = position - posIn;
-
-  if (diff.length() <= radius) {
-    if (withinWaypoint != NULL) *withinWaypoint = true;
-
-    return posIn;
-  } else {
-    if (withinWaypoint != NULL) *withinWaypoint = false;
+  return closestPointInArea(position, radius, posIn, withinWaypoint);
+}
 
-    Ped::Tvector direction = diff.normalized();
-    return position + radius * direction;
-  }
+Ped::Twaypoint* AreaWaypoint::clone() const {
+  return new AreaWaypointCopy(*this);
 }
 
 double AreaWaypoint::getRadius() const { 
@@ -0,0 +1,123 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <pedsim_simulator/element/dynamicobstacle.h>
+#include <pedsim_simulator/element/obstacle.h>
+
+#include <algorithm>
+#include <cmath>
+
+DynamicObstacle::DynamicObstacle(const QString& nameIn)
+    : name(nameIn), repeat(Repeat::ONCE), placed(false), pose{0, 0, 0, 0} {}
+
+DynamicObstacle::~DynamicObstacle() {
+  // note: the obstacles are deleted by the scene they were added to
+}
+
+void DynamicObstacle::addSegment(double ax, double ay, double bx,
+                                 double by) {
+  segments.insert(segments.end(), {ax, ay, bx, by});
+  obstacles.push_back(new Obstacle(ax, ay, bx, by));
+  placed = false;
+}
+
+void DynamicObstacle::addKeyframe(double time, double x, double y,
+                                  double theta) {
+  // keep the keyframes in order of time
+  const Keyframe keyframe{time, x, y, theta};
+  auto position = std::upper_bound(
+      keyframes.begin(), keyframes.end(), keyframe,
+      [](const Keyframe& a, const Keyframe& b) { return a.time < b.time; });
+  keyframes.insert(position, keyframe);
+  placed = false;
+}
+
+void DynamicObstacle::update(double time) {
+  if (keyframes.empty()) return;
+
+  const Keyframe next = getPose(time);
+  if (placed && (next.x == pose.x) && (next.y == pose.y) &&
+      (next.theta == pose.theta))
+    return;
+  pose = next;
+  placed = true;
+
+  const double c = std::cos(pose.theta);
+  const double s = std::sin(pose.theta);
+  for (size_t i = 0; i < obstacles.size(); ++i) {
+    const double* segment = &segments[4 * i];
+    obstacles[i]->setPosition(pose.x + c * segment[0] - s * segment[1],
+                              pose.y + s * segment[0] + c * segment[1],
+                              pose.x + c * segment[2] - s * segment[3],
+                              pose.y + s * segment[2] + c * segment[3]);
+  }
+}
+
+DynamicObstacle::Keyframe DynamicObstacle::getPose(double time) const {
+  const double start = keyframes.front().time;
+  const double duration = keyframes.back().time - start;
+
+  // map the time into the keyframes' range
+  if ((duration > 0) && (time > start + duration)) {
+    const double elapsed = time - start;
+    switch (repeat) {
+      case Repeat::ONCE:
+        time = start + duration;
+        break;
+      case Repeat::LOOP:
+        time = start + std::fmod(elapsed, duration);
+        break;
+      case Repeat::PINGPONG: {
+        const double phase = std::fmod(elapsed, 2 * duration);
+        time = start + ((phase <= duration) ? phase : 2 * duration - phase);
+        break;
+      }
+    }
+  }
+
+  // interpolate between the surrounding keyframes
+  auto after = std::upper_bound(
+      keyframes.begin(), keyframes.end(), time,
+      [](double t, const Keyframe& keyframe) { return t < keyframe.time; });
+  if (after == keyframes.begin()) return keyframes.front();
+  if (after == keyframes.end()) return keyframes.back();
+
+  const Keyframe& a = *(after - 1);
+  const Keyframe& b = *after;
+  const double f = (time - a.time) / (b.time - a.time);
+  return Keyframe{time, a.x + f * (b.x - a.x), a.y + f * (b.y - a.y),
+                  a.theta + f * (b.theta - a.theta)};
+}
+
+QString DynamicObstacle::toString() const {
+  return tr("DynamicObstacle '%1' (%2 segments, %3 keyframes)")
+      .arg(name)
+      .arg(obstacles.size())
+      .arg(keyframes.size());
+}
@@ -32,17 +32,11 @@
 #include <pedsim/ped_agent.h>
 #include <pedsim_simulator/element/queueingwaypoint.h>
 
-QueueingWaypoint::QueueingWaypoint(const QString& nameIn,
-                                   const Ped::Tvector& positionIn)
-    : Waypoint(nameIn, positionIn) {}
-
-QueueingWaypoint::~QueueingWaypoint() {}
-
-QString QueueingWaypoint::getName() const { return name; }
-
-Ped::Tvector QueueingWaypoint::getForce(const Ped::Tagent& agentIn,
-                                        Ped::Tvector* desiredDirectionOut,
-                                        bool* reached) const {
+namespace {
+/// Force towards the waypoint at position, slowing down within a meter
+Ped::Tvector queueingForce(const Ped::Tvector& position,
+                           const Ped::Tagent& agentIn,
+                           Ped::Tvector* desiredDirectionOut, bool* reached) {
   if (reached != nullptr) *reached = false;
 
   // compute the force
@@ -79,11 +73,46 @@ Ped::Tvector QueueingWaypoint::getForce(const Ped::Tagent& agentIn,
   }
 }
 
+/// Detached copy for rollouts and forks, see Ped::Twaypoint::clone()
+class QueueingWaypointCopy : public Ped::Twaypoint {
+ public:
+  QueueingWaypointCopy(const Ped::Twaypoint& waypointIn)
+      : Ped::Twaypoint(waypointIn) {}
+
+  Ped::Tvector getForce(const Ped::Tagent& agentIn,
+                        Ped::Tvector* desiredDirectionOut = NULL,
+                        bool* reached = NULL) const override {
+    return queueingForce(position, agentIn, desiredDirectionOut, reached);
+  }
+  Ped::Twaypoint* clone() const override {
+    return new QueueingWaypointCopy(*this);
+  }
+};
+}
+
+QueueingWaypoint::QueueingWaypoint(const QString& nameIn,
+                                   const Ped::Tvector& positionIn)
+    : Waypoint(nameIn, positionIn) {}
+
+QueueingWaypoint::~QueueingWaypoint() {}
+
+QString QueueingWaypoint::getName() const { return name; }
+
+Ped::Tvector QueueingWaypoint::getForce(const Ped::Tagent& agentIn,
+                                        Ped::Tvector* desiredDirectionOut,
+                                        bool* reached) const {
+  return queueingForce(position, agentIn, desiredDirectionOut, reached);
+}
+
 Ped::Tvector QueueingWaypoint::closestPoint(const Ped::Tvector& posIn,
                                             bool* withinWaypoint) const {
   return position;
 }
 
+Ped::Twaypoint* QueueingWaypoint::clone() const {
+  return new QueueingWaypointCopy(*this);
+}
+
 QPointF QueueingWaypoint::getVisiblePosition() const {
   return QPointF(getx(), gety());
 }
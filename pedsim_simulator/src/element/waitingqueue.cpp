@@ -35,6 +35,29 @@
 #include <pedsim_simulator/rng.h>
 #include <pedsim_simulator/scene.h>
 
+namespace {
+/// Detached copy for rollouts and forks, see Ped::Twaypoint::clone(). The
+/// queue isn't copied: agents head for the end of the queue at the time of
+/// the copy.
+class WaitingQueueCopy : public Ped::Twaypoint {
+ public:
+  WaitingQueueCopy(const Ped::Twaypoint& waypointIn,
+                   const Ped::Tvector& endPositionIn)
+      : Ped::Twaypoint(waypointIn), endPosition(endPositionIn) {}
+
+  Ped::Tvector closestPoint(const Ped::Tvector& p,
+                            bool* withinWaypoint = NULL) const override {
+    return endPosition;
+  }
+  Ped::Twaypoint* clone() const override {
+    return new WaitingQueueCopy(*this);
+  }
+
+ private:
+  Ped::Tvector endPosition;
+};
+}
+
 WaitingQueue::WaitingQueue(const QString& nameIn, Ped::Tvector positionIn,
                            Ped::Tangle directionIn)
     : Waypoint(nameIn, positionIn), direction(directionIn) {
@@ -236,6 +259,10 @@ Ped::Tvector WaitingQueue::closestPoint(const Ped::Tvector& p,
   return getQueueEndPosition();
 }
 
+Ped::Twaypoint* WaitingQueue::clone() const {
+  return new WaitingQueueCopy(*this, getQueueEndPosition());
+}
+
 QPointF WaitingQueue::getVisiblePosition() const {
   return QPointF(position.x, position.y);
 }
@@ -0,0 +1,159 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <pedsim_simulator/flowcounter.h>
+
+#include <pedsim/ped_obstacle.h>
+
+#include <algorithm>
+
+FlowCounter::FlowCounter()
+    : dwellBinWidth(10), dwellBinCount(30), updateCount(0) {}
+
+FlowCounter::~FlowCounter() { clear(); }
+
+void FlowCounter::clear() {
+  gates.clear();
+  gateIndex.clear();
+  for (Ped::Tobstacle* line : gateLines) delete line;
+  gateLines.clear();
+  gateLookup.clear();
+  zones.clear();
+  zoneAreas.clear();
+}
+
+/// Applies to zones added afterwards.
+/// \param   binWidth in seconds
+void FlowCounter::setDwellHistogram(double binWidth, size_t binCount) {
+  dwellBinWidth = std::max(binWidth, 1e-3);
+  dwellBinCount = std::max<size_t>(binCount, 1);
+}
+
+void FlowCounter::addGate(const std::string& name, const Ped::Tvector& start,
+                          const Ped::Tvector& end) {
+  Gate gate;
+  gate.name = name;
+  gate.start = start;
+  gate.end = end;
+  gate.forward = 0;
+  gate.backward = 0;
+  gates.push_back(gate);
+
+  // → the index works on obstacles, the line isn't one for the agents
+  Ped::Tobstacle* line = new Ped::Tobstacle(start.x, start.y, end.x, end.y);
+  gateLines.push_back(line);
+  gateLookup[line] = gates.size() - 1;
+  gateIndex.addObstacle(line);
+}
+
+void FlowCounter::addZone(const std::string& name,
+                          const std::vector<Ped::Tvector>& corners) {
+  Zone zone;
+  zone.name = name;
+  zone.entries = 0;
+  zone.visits = 0;
+  zone.dwellTimeSum = 0;
+  zone.dwellHistogram.assign(dwellBinCount, 0);
+  zones.push_back(zone);
+  zoneAreas.addPolygon(corners);
+}
+
+/// Accounts for one tick.
+/// \param   time the simulation time after the tick
+/// \param   agents all agents, already moved
+void FlowCounter::update(double time, const std::vector<Ped::Tagent*>& agents) {
+  if (isEmpty()) return;
+
+  ++updateCount;
+  for (const Ped::Tagent* agent : agents) {
+    if (agent->getType() == Ped::Tagent::ROBOT) continue;
+
+    const Ped::Tvector& position = agent->getPosition();
+    if (!gates.empty()) countCrossings(agent->getLastPosition(), position);
+
+    for (size_t i = 0; i < zones.size(); ++i) {
+      if (!zoneAreas.contains(i, position)) continue;
+
+      // note: emplace() would allocate a node even for known visitors
+      Zone& zone = zones[i];
+      auto visitorIter = zone.visitors.find(agent->getId());
+      if (visitorIter != zone.visitors.end()) {
+        visitorIter->second.lastSeen = updateCount;
+      } else {
+        zone.visitors[agent->getId()] = Visitor{time, updateCount};
+        ++zone.entries;
+      }
+    }
+  }
+
+  // → pedestrians not inside anymore, including removed ones, left the zone
+  for (Zone& zone : zones) {
+    for (auto iter = zone.visitors.begin(); iter != zone.visitors.end();) {
+      if (iter->second.lastSeen == updateCount) {
+        ++iter;
+        continue;
+      }
+      addVisit(zone, time - iter->second.entryTime);
+      iter = zone.visitors.erase(iter);
+    }
+  }
+}
+
+void FlowCounter::countCrossings(const Ped::Tvector& from,
+                                 const Ped::Tvector& to) {
+  const Ped::Tvector step = to - from;
+  if (step.lengthSquared() == 0) return;
+
+  const Ped::Tvector middle = from + 0.5 * step;
+  candidates.clear();
+  gateIndex.getObstacles(candidates, middle.x, middle.y, 0.5 * step.length());
+  for (const Ped::Tobstacle* line : candidates) {
+    if (!Ped::TsegmentGrid::intersects(from, to, line)) continue;
+
+    // → a position on the line counts as the left side, so that stopping
+    //   on it doesn't count twice
+    Gate& gate = gates[gateLookup[line]];
+    const Ped::Tvector direction = gate.end - gate.start;
+    const bool leftBefore =
+        Ped::Tvector::crossProduct(direction, from - gate.start).z >= 0;
+    const bool leftAfter =
+        Ped::Tvector::crossProduct(direction, to - gate.start).z >= 0;
+    if (!leftBefore && leftAfter)
+      ++gate.forward;
+    else if (leftBefore && !leftAfter)
+      ++gate.backward;
+  }
+}
+
+void FlowCounter::addVisit(Zone& zone, double duration) {
+  ++zone.visits;
+  zone.dwellTimeSum += duration;
+  const size_t bin = std::min(static_cast<size_t>(duration / dwellBinWidth),
+                              zone.dwellHistogram.size() - 1);
+  ++zone.dwellHistogram[bin];
+}
@@ -29,6 +29,7 @@
 * \author Sven Wehner <mail@svenwehner.de>
 */
 
+#include <pedsim/ped_waypoint.h>
 #include <pedsim_simulator/config.h>
 #include <pedsim_simulator/element/agent.h>
 #include <pedsim_simulator/element/obstacle.h>
@@ -43,16 +44,9 @@ AlongWallForce::AlongWallForce(Agent* agentIn) : Force(agentIn) {
   speedThreshold = 0.2;
   distanceThreshold = 0.6;
   angleThresholdDegree = 20;
-  setFactor(CONFIG.forceAlongWall);
-
-  // connect signals
-  connect(&CONFIG, SIGNAL(forceFactorAlongWallChanged(double)), this,
-          SLOT(onForceFactorChanged(double)));
 }
 
-void AlongWallForce::onForceFactorChanged(double valueIn) {
-  setFactor(valueIn);
-}
+double AlongWallForce::getFactor() const { return parameters.alongWall; }
 
 Ped::Tvector AlongWallForce::getForce(Ped::Tvector walkingDirection) {
   if (agent == nullptr) {
@@ -60,6 +54,11 @@ Ped::Tvector AlongWallForce::getForce(Ped::Tvector walkingDirection) {
     return Ped::Tvector();
   }
 
+  // agents following a flow field are led around walls already
+  const Ped::Twaypoint* waypoint = agent->getCurrentWaypoint();
+  if ((waypoint != nullptr) && (waypoint->getFlowField() != nullptr))
+    return Ped::Tvector();
+
   // check whether the agent is stuck
   // → doesn't move
   if (agent->getVelocity().length() > speedThreshold) return Ped::Tvector();
@@ -106,10 +105,10 @@ Ped::Tvector AlongWallForce::getForce(Ped::Tvector walkingDirection) {
   forceDirection.normalize();
 
   // scale force
-  force = factor * forceDirection;
+  force = getFactor() * forceDirection;
   return force;
 }
 
 QString AlongWallForce::toString() const {
-  return tr("AlongWallForce (factor: %2)").arg(factor);
+  return QString("AlongWallForce (factor: %2)").arg(getFactor());
 }
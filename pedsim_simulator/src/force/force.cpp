@@ -29,11 +29,24 @@
 * \author Sven Wehner <mail@svenwehner.de>
 */
 
+#include <pedsim_simulator/config.h>
 #include <pedsim_simulator/element/agent.h>
 #include <pedsim_simulator/force/force.h>
 
-Force::Force(Agent* agentIn) : agent(agentIn), factor(1) {}
+Force::Force(Agent* agentIn) : agent(agentIn), parameters(CONFIG.forces()) {}
 
-void Force::setFactor(double factorIn) { factor = factorIn; }
+Force::~Force() {}
 
-double Force::getFactor() const { return factor; }
+/// Maps a force name to its identifier
+/// \return the ForceType, or -1 for unknown names
+int Force::typeFromName(const QString& nameIn) {
+  if (nameIn == "Desired") return DESIRED;
+  if (nameIn == "Social") return SOCIAL;
+  if (nameIn == "Obstacle") return OBSTACLE;
+  if (nameIn == "Random") return RANDOM;
+  if (nameIn == "AlongWall") return ALONG_WALL;
+  if (nameIn == "GroupGaze") return GROUP_GAZE;
+  if (nameIn == "GroupCoherence") return GROUP_COHERENCE;
+  if (nameIn == "GroupRepulsion") return GROUP_REPULSION;
+  return -1;
+}
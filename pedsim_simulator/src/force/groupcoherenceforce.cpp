@@ -37,16 +37,11 @@
 
 GroupCoherenceForce::GroupCoherenceForce(Agent* agentIn) : Force(agentIn) {
   // initialize values
-  setFactor(CONFIG.forceGroupCoherence);
   usePaperVersion = true;
-
-  // connect signals
-  connect(&CONFIG, SIGNAL(forceFactorGroupCoherenceChanged(double)), this,
-          SLOT(onForceFactorGroupCoherenceChanged(double)));
 }
 
-void GroupCoherenceForce::onForceFactorGroupCoherenceChanged(double valueIn) {
-  setFactor(valueIn);
+double GroupCoherenceForce::getFactor() const {
+  return parameters.groupCoherence;
 }
 
 void GroupCoherenceForce::setGroup(AgentGroup* groupIn) { group = groupIn; }
@@ -80,7 +75,7 @@ Ped::Tvector GroupCoherenceForce::getForce(Ped::Tvector walkingDirection) {
       force = relativeCoM.normalized();
 
       // there is no factor for myForce, hence we have to do it
-      force *= factor;
+      force *= getFactor();
 
       return force;
     } else {
@@ -95,16 +90,17 @@ Ped::Tvector GroupCoherenceForce::getForce(Ped::Tvector walkingDirection) {
     // HACK: use smooth transition
     //      this doesn't follow the Moussaid paper, but it creates less abrupt
     //      changes
-    double softenedFactor = factor * (tanh(distance - maxDistance) + 1) / 2;
+    double softenedFactor =
+        getFactor() * (tanh(distance - maxDistance) + 1) / 2;
     force *= softenedFactor;
 
     ROS_DEBUG("softenedFactor = %f = %f * (tanh(%f - %f)+1) / 2",
-              softenedFactor, factor, distance, maxDistance);
+              softenedFactor, getFactor(), distance, maxDistance);
 
     return force;
   }
 }
 
 QString GroupCoherenceForce::toString() const {
-  return tr("GroupCoherenceForce (factor: %1)").arg(factor);
+  return QString("GroupCoherenceForce (factor: %1)").arg(getFactor());
 }
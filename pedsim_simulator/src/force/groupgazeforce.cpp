@@ -37,17 +37,10 @@
 
 GroupGazeForce::GroupGazeForce(Agent* agentIn) : Force(agentIn) {
   // initialize values
-  setFactor(CONFIG.forceGroupGaze);
   usePaperVersion = true;
-
-  // connect signals
-  connect(&CONFIG, SIGNAL(forceFactorGroupGazeChanged(double)), this,
-          SLOT(onForceFactorGroupGazeChanged(double)));
 }
 
-void GroupGazeForce::onForceFactorGroupGazeChanged(double valueIn) {
-  setFactor(valueIn);
-}
+double GroupGazeForce::getFactor() const { return parameters.groupGaze; }
 
 void GroupGazeForce::setGroup(AgentGroup* groupIn) { group = groupIn; }
 
@@ -108,7 +101,7 @@ Ped::Tvector GroupGazeForce::getForce(Ped::Tvector walkingDirection) {
     }
 
     // there is no factor for myForce, hence we have to do it
-    force *= factor;
+    force *= getFactor();
 
     return force;
   } else {
@@ -118,5 +111,5 @@ Ped::Tvector GroupGazeForce::getForce(Ped::Tvector walkingDirection) {
 }
 
 QString GroupGazeForce::toString() const {
-  return tr("GroupGazeForce (factor: %1)").arg(factor);
+  return QString("GroupGazeForce (factor: %1)").arg(getFactor());
 }
@@ -37,16 +37,11 @@
 
 GroupRepulsionForce::GroupRepulsionForce(Agent* agentIn) : Force(agentIn) {
   // initialize values
-  setFactor(CONFIG.forceGroupRepulsion);
   overlapDistance = 0.5;
-
-  // connect signals
-  connect(&CONFIG, SIGNAL(forceFactorGroupRepulsionChanged(double)), this,
-          SLOT(onForceFactorGroupRepulsionChanged(double)));
 }
 
-void GroupRepulsionForce::onForceFactorGroupRepulsionChanged(double valueIn) {
-  setFactor(valueIn);
+double GroupRepulsionForce::getFactor() const {
+  return parameters.groupRepulsion;
 }
 
 void GroupRepulsionForce::setGroup(AgentGroup* groupIn) { group = groupIn; }
@@ -76,11 +71,11 @@ Ped::Tvector GroupRepulsionForce::getForce(Ped::Tvector walkingDirection) {
   }
 
   // there is no factor for myForce, hence we have to do it
-  force *= factor;
+  force *= getFactor();
 
   return force;
 }
 
 QString GroupRepulsionForce::toString() const {
-  return tr("GroupRepulsionForce (factor: %1)").arg(factor);
+  return QString("GroupRepulsionForce (factor: %1)").arg(getFactor());
 }
@@ -29,7 +29,6 @@
 * \author Sven Wehner <mail@svenwehner.de>
 */
 
-#include <pedsim_simulator/config.h>
 #include <pedsim_simulator/force/randomforce.h>
 #include <pedsim_simulator/rng.h>
 #include <pedsim_simulator/scene.h>
@@ -38,16 +37,11 @@
 
 RandomForce::RandomForce(Agent* agentIn) : Force(agentIn) {
   // initialize values
-  setFactor(CONFIG.forceRandom);
   fadingDuration = 1;
   nextDeviation = computeNewDeviation();
-
-  // connect signals
-  connect(&CONFIG, SIGNAL(forceFactorRandomChanged(double)), this,
-          SLOT(onForceFactorChanged(double)));
 }
 
-void RandomForce::onForceFactorChanged(double valueIn) { setFactor(valueIn); }
+double RandomForce::getFactor() const { return parameters.random; }
 
 void RandomForce::setFadingTime(double durationIn) {
   // sanity checks
@@ -75,12 +69,14 @@ Ped::Tvector RandomForce::computeNewDeviation() {
 }
 
 Ped::Tvector RandomForce::getForce(Ped::Tvector walkingDirection) {
-  // use the current time to compute the fading progress
-  double time = SCENE.getTime();
-  double progress = fmod(time, fadingDuration);
+  // use the tick counter to compute the fading progress
+  // → each fading period starts on exactly one tick
+  const uint64_t period = SCENE.getTicks(fadingDuration);
+  const uint64_t phase = SCENE.getTick() % period;
+  const double progress = static_cast<double>(phase) / period;
 
   // create a new fading goal when necessary
-  if (progress < CONFIG.getTimeStepSize()) {
+  if (phase == 0) {
     lastDeviation = nextDeviation;
     nextDeviation = computeNewDeviation();
   }
@@ -90,13 +86,13 @@ Ped::Tvector RandomForce::getForce(Ped::Tvector walkingDirection) {
       (1 - progress) * lastDeviation + progress * nextDeviation;
 
   // scale force
-  force *= factor;
+  force *= getFactor();
 
   return force;
 }
 
 QString RandomForce::toString() const {
-  return tr("RandomForce (fading duration: %1; factor: %2)")
+  return QString("RandomForce (fading duration: %1; factor: %2)")
       .arg(fadingDuration)
-      .arg(factor);
+      .arg(getFactor());
 }
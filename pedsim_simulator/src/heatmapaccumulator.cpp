@@ -0,0 +1,262 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <pedsim_simulator/heatmapaccumulator.h>
+
+#include <ros/ros.h>
+#include <QImage>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// snapshots waiting for the worker before new ones are dropped
+const size_t maxQueuedSnapshots = 64;
+}
+
+void HeatmapAccumulator::Snapshot::clear() {
+  ids.clear();
+  x.clear();
+  y.clear();
+  speed.clear();
+}
+
+HeatmapAccumulator::HeatmapAccumulator()
+    : opened(false),
+      stopSpeed(0.2),
+      stopping(false),
+      busy(false),
+      droppedSnapshots(0) {}
+
+HeatmapAccumulator::~HeatmapAccumulator() { close(); }
+
+/// Starts accumulating over the given area; agents outside are ignored.
+/// \param   stopSpeed agents slower than this are standing
+/// \return  false if the area or the cell size is empty
+bool HeatmapAccumulator::open(double x, double y, double width, double height,
+                              double cellSize, double stopSpeedIn) {
+  close();
+  if ((width <= 0) || (height <= 0) || (cellSize <= 0)) return false;
+
+  grids.originX = x;
+  grids.originY = y;
+  grids.cellSize = cellSize;
+  grids.columns = std::ceil(width / cellSize);
+  grids.rows = std::ceil(height / cellSize);
+  grids.duration = 0;
+  const size_t cells = grids.columns * grids.rows;
+  grids.occupancy.assign(cells, 0);
+  grids.meanSpeed.assign(cells, 0);
+  grids.stops.assign(cells, 0);
+  speedSums.assign(cells, 0);
+  stopSpeed = stopSpeedIn;
+
+  current.reset(new Snapshot());
+  moving.clear();
+  droppedSnapshots = 0;
+  stopping = false;
+  busy = false;
+  worker = std::thread(&HeatmapAccumulator::run, this);
+  opened = true;
+  return true;
+}
+
+/// Accumulates the queued snapshots and stops the worker.
+void HeatmapAccumulator::close() {
+  if (!opened) return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_one();
+  worker.join();
+
+  current.reset();
+  spareSnapshots.clear();
+  opened = false;
+}
+
+/// \param   duration the simulation time the snapshot stands for
+void HeatmapAccumulator::beginSnapshot(double duration) {
+  if (!opened) return;
+
+  current->clear();
+  current->duration = duration;
+}
+
+void HeatmapAccumulator::addAgent(int id, double x, double y, double speed) {
+  if (!opened) return;
+
+  current->ids.push_back(id);
+  current->x.push_back((float)x);
+  current->y.push_back((float)y);
+  current->speed.push_back((float)speed);
+}
+
+/// Hands the snapshot to the worker and continues with a spare one, so the
+/// buffers keep their capacity.
+void HeatmapAccumulator::endSnapshot() {
+  if (!opened) return;
+
+  std::unique_ptr<Snapshot> next;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue.size() >= maxQueuedSnapshots) {
+      // → the worker is behind, drop this snapshot and reuse its buffers
+      ++droppedSnapshots;
+      return;
+    }
+
+    queue.push_back(std::move(current));
+    if (!spareSnapshots.empty()) {
+      next = std::move(spareSnapshots.back());
+      spareSnapshots.pop_back();
+    }
+  }
+  condition.notify_one();
+
+  if (next == nullptr) next.reset(new Snapshot());
+  current = std::move(next);
+}
+
+size_t HeatmapAccumulator::getDroppedSnapshots() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return droppedSnapshots;
+}
+
+/// Copies the grids, once the worker has accumulated all queued snapshots.
+void HeatmapAccumulator::getGrids(Grids& gridsOut) {
+  std::unique_lock<std::mutex> lock(mutex);
+  idleCondition.wait(lock,
+                     [this] { return !opened || (queue.empty() && !busy); });
+  gridsOut = grids;
+  for (size_t i = 0; i < speedSums.size(); ++i) {
+    gridsOut.meanSpeed[i] =
+        (grids.occupancy[i] > 0) ? speedSums[i] / grids.occupancy[i] : 0;
+  }
+}
+
+void HeatmapAccumulator::run() {
+#ifdef __linux__
+  // → lowest priority of this thread only; unlike an idle thread, it still
+  //   gets a share when the simulation keeps all cores busy
+  setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+#endif
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    condition.wait(lock, [this] { return stopping || !queue.empty(); });
+    if (queue.empty()) return;
+
+    std::unique_ptr<Snapshot> snapshot = std::move(queue.front());
+    queue.pop_front();
+    busy = true;
+
+    // the snapshot belongs to the worker now, the grids are guarded by the
+    // lock until accumulate() has finished
+    lock.unlock();
+    accumulate(*snapshot);
+    lock.lock();
+
+    busy = false;
+    spareSnapshots.push_back(std::move(snapshot));
+    if (queue.empty()) idleCondition.notify_all();
+  }
+}
+
+void HeatmapAccumulator::accumulate(const Snapshot& snapshot) {
+  nextMoving.clear();
+  // → the grids are only read by getGrids(), which waits while busy
+  grids.duration += snapshot.duration;
+  for (size_t i = 0; i < snapshot.ids.size(); ++i) {
+    const bool isMoving = snapshot.speed[i] >= stopSpeed;
+    auto lastIter = moving.find(snapshot.ids[i]);
+    const bool wasMoving = (lastIter != moving.end()) && lastIter->second;
+    nextMoving[snapshot.ids[i]] = isMoving;
+
+    const double column =
+        std::floor((snapshot.x[i] - grids.originX) / grids.cellSize);
+    const double row =
+        std::floor((snapshot.y[i] - grids.originY) / grids.cellSize);
+    if ((column < 0) || (column >= grids.columns) || (row < 0) ||
+        (row >= grids.rows))
+      continue;
+
+    const size_t cell = (size_t)row * grids.columns + (size_t)column;
+    grids.occupancy[cell] += snapshot.duration;
+    speedSums[cell] += snapshot.speed[i] * snapshot.duration;
+    if (wasMoving && !isMoving) ++grids.stops[cell];
+  }
+  moving.swap(nextMoving);
+}
+
+/// Writes one "x y occupancy mean_speed stops" line per visited cell, at
+/// its center.
+bool HeatmapAccumulator::writeCsv(const Grids& grids,
+                                  const std::string& filename) {
+  std::ofstream file(filename, std::ios::trunc);
+  file << "x,y,occupancy,mean_speed,stops\n";
+  for (size_t row = 0; row < grids.rows; ++row) {
+    for (size_t column = 0; column < grids.columns; ++column) {
+      const size_t cell = row * grids.columns + column;
+      if (grids.occupancy[cell] == 0) continue;
+
+      file << grids.originX + (column + 0.5) * grids.cellSize << ","
+           << grids.originY + (row + 0.5) * grids.cellSize << ","
+           << grids.occupancy[cell] << "," << grids.meanSpeed[cell] << ","
+           << grids.stops[cell] << "\n";
+    }
+  }
+  return bool(file);
+}
+
+/// Writes one of the grids as a gray scale image, white for the largest
+/// value, with north up.
+bool HeatmapAccumulator::writePng(const Grids& grids,
+                                  const std::vector<double>& values,
+                                  const std::string& filename) {
+  if (values.empty()) return false;
+
+  const double maxValue = *std::max_element(values.begin(), values.end());
+  const double scale = (maxValue > 0) ? 255 / maxValue : 0;
+  QImage image(grids.columns, grids.rows, QImage::Format_Grayscale8);
+  for (size_t row = 0; row < grids.rows; ++row) {
+    uchar* line = image.scanLine(grids.rows - 1 - row);
+    for (size_t column = 0; column < grids.columns; ++column)
+      line[column] = (uchar)(values[row * grids.columns + column] * scale);
+  }
+  return image.save(QString::fromStdString(filename), "PNG");
+}
@@ -0,0 +1,92 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <pedsim_simulator/overruncontroller.h>
+
+#include <algorithm>
+
+OverrunController::OverrunController() { reset(0.04, 1.0, 5.0, 0.7); }
+
+void OverrunController::reset(double budgetIn, double degradeTimeIn,
+                              double restoreTimeIn, double restoreLoadIn) {
+  budget = budgetIn;
+  degradeTime = degradeTimeIn;
+  restoreTime = restoreTimeIn;
+  restoreLoad = restoreLoadIn;
+  level = FULL;
+  load = 0;
+  overTime = 0;
+  underTime = 0;
+  overruns = 0;
+}
+
+bool OverrunController::update(double duration) {
+  if (budget <= 0) return false;
+  if (duration > budget) ++overruns;
+
+  // smooth over about a second of ticks
+  const double alpha = std::min(1.0, budget);
+  load += alpha * (duration / budget - load);
+
+  if (load > 1) {
+    underTime = 0;
+    overTime += budget;
+    if ((overTime < degradeTime) || (level == maxLevel)) return false;
+    ++level;
+    overTime = 0;
+    return true;
+  }
+
+  overTime = 0;
+  if (load >= restoreLoad) {
+    underTime = 0;
+    return false;
+  }
+  underTime += budget;
+  if ((underTime < restoreTime) || (level == FULL)) return false;
+  --level;
+  underTime = 0;
+  return true;
+}
+
+const char* OverrunController::getLevelName(int level) {
+  switch (level) {
+    case FULL:
+      return "full detail";
+    case NO_OPTIONAL_FORCES:
+      return "optional forces off";
+    case NEIGHBOR_REUSE:
+      return "neighbor reuse";
+    case REDUCED_FAR_DETAIL:
+      return "reduced detail far from robots";
+    case DECIMATED_PUBLISHING:
+      return "decimated publishing";
+  }
+  return "unknown";
+}
@@ -0,0 +1,76 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <pedsim_simulator/robotdrive.h>
+
+#include <cmath>
+
+RobotDrive::RobotDrive(Kinematics kinematicsIn, double xIn, double yIn,
+                       double thetaIn)
+    : kinematics(kinematicsIn),
+      x(xIn),
+      y(yIn),
+      theta(thetaIn),
+      vx(0),
+      vy(0),
+      forward(0),
+      lateral(0),
+      angular(0) {}
+
+void RobotDrive::setCommand(double forwardIn, double lateralIn,
+                            double angularIn) {
+  forward = forwardIn;
+  lateral = (kinematics == Kinematics::HOLONOMIC) ? lateralIn : 0;
+  angular = angularIn;
+}
+
+void RobotDrive::step(double h) {
+  if (h <= 0) return;
+
+  const double theta1 = theta + angular * h;
+  const double s0 = std::sin(theta), c0 = std::cos(theta);
+  const double s1 = std::sin(theta1), c1 = std::cos(theta1);
+
+  // displacement of the body velocity turning at a constant rate
+  // → straight on, the arc degenerates to a line
+  double dx, dy;
+  if (std::abs(angular * h) < 1e-9) {
+    dx = (forward * c0 - lateral * s0) * h;
+    dy = (forward * s0 + lateral * c0) * h;
+  } else {
+    dx = (forward * (s1 - s0) + lateral * (c1 - c0)) / angular;
+    dy = (forward * (c0 - c1) + lateral * (s1 - s0)) / angular;
+  }
+
+  x += dx;
+  y += dy;
+  theta = std::atan2(s1, c1);
+  vx = dx / h;
+  vy = dy / h;
+}
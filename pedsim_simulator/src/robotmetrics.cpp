@@ -0,0 +1,140 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <pedsim_simulator/robotmetrics.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+RobotMetrics::RobotMetrics() : hasGoal(false), goalTolerance(0) {
+  reset(1.2);
+}
+
+/// Starts over, e.g. for a new run.
+/// \param   personalSpaceRadiusIn center distance below which a pedestrian
+/// intrudes into the robot's personal space
+void RobotMetrics::reset(double personalSpaceRadiusIn) {
+  personalSpaceRadius = personalSpaceRadiusIn;
+  started = false;
+  startTime = 0;
+  duration = 0;
+  minDistance = std::numeric_limits<double>::infinity();
+  collisions = 0;
+  collisionTime = 0;
+  intrusions = 0;
+  intrusionTime = 0;
+  pathLength = 0;
+  timeToGoal = -1;
+  contacts.clear();
+  intruders.clear();
+}
+
+void RobotMetrics::setGoal(const Ped::Tvector& goalIn, double tolerance) {
+  hasGoal = true;
+  goal = goalIn;
+  goalTolerance = tolerance;
+}
+
+/// \return  the radius around the robot the neighbors must be taken from
+double RobotMetrics::getRange() const {
+  // → contact needs the pedestrian's radius, too
+  return std::max(personalSpaceRadius, 2.0);
+}
+
+/// Accounts for one tick.
+/// \param   time the simulation time after the tick
+/// \param   h the length of the tick
+/// \param   robot the robot, already moved
+/// \param   neighbors the agents within getRange() of the robot
+void RobotMetrics::update(double time, double h, const Ped::Tagent& robot,
+                          const std::vector<const Ped::Tagent*>& neighbors) {
+  const Ped::Tvector& position = robot.getPosition();
+  if (!started) {
+    started = true;
+    startTime = time - h;
+    start = last = end = position;
+  }
+  duration = time - startTime;
+
+  // → the path ends at the goal
+  if (timeToGoal < 0) {
+    pathLength += (position - last).length();
+    end = position;
+    if (hasGoal && ((goal - position).length() <= goalTolerance))
+      timeToGoal = duration;
+  }
+  last = position;
+
+  nextContacts.clear();
+  nextIntruders.clear();
+  for (const Ped::Tagent* agent : neighbors) {
+    if ((agent == &robot) || (agent->getType() == Ped::Tagent::ROBOT))
+      continue;
+
+    const double distance = (agent->getPosition() - position).length();
+    minDistance = std::min(minDistance, distance);
+
+    if (distance < robot.getRadius() + agent->getRadius()) {
+      nextContacts.insert(agent->getId());
+      if (contacts.count(agent->getId()) == 0) ++collisions;
+      collisionTime += h;
+    }
+    if (distance < personalSpaceRadius) {
+      nextIntruders.insert(agent->getId());
+      if (intruders.count(agent->getId()) == 0) ++intrusions;
+      intrusionTime += h;
+    }
+  }
+  contacts.swap(nextContacts);
+  intruders.swap(nextIntruders);
+}
+
+double RobotMetrics::getPathEfficiency() const {
+  if (pathLength <= 0) return 1;
+  return std::min(1.0, (end - start).length() / pathLength);
+}
+
+/// Writes the measures as YAML.
+void RobotMetrics::writeSummary(std::ostream& output) const {
+  output << "duration: " << duration << "\n";
+  // → .inf when no pedestrian came within range
+  if (std::isinf(minDistance))
+    output << "min_distance: .inf\n";
+  else
+    output << "min_distance: " << minDistance << "\n";
+  output << "collisions: " << collisions << "\n";
+  output << "collision_time: " << collisionTime << "\n";
+  output << "intrusions: " << intrusions << "\n";
+  output << "intrusion_time: " << intrusionTime << "\n";
+  output << "personal_space_radius: " << personalSpaceRadius << "\n";
+  output << "path_length: " << pathLength << "\n";
+  output << "path_efficiency: " << getPathEfficiency() << "\n";
+  output << "time_to_goal: " << timeToGoal << "\n";
+}
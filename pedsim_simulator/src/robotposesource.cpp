@@ -0,0 +1,112 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <pedsim_simulator/robotposesource.h>
+
+#include <tf/transform_datatypes.h>
+
+#include <cmath>
+
+VelocityEstimator::VelocityEstimator(double smoothingTimeIn)
+    : smoothingTime(smoothingTimeIn),
+      initialized(false),
+      lastStamp(0),
+      lastX(0),
+      lastY(0),
+      vx(0),
+      vy(0) {}
+
+bool VelocityEstimator::update(double stamp, double x, double y) {
+  if (!initialized) {
+    initialized = true;
+    lastStamp = stamp;
+    lastX = x;
+    lastY = y;
+    vx = vy = 0;
+    return true;
+  }
+
+  const double dt = stamp - lastStamp;
+  if (!(dt > 0)) return false;
+
+  // → the weight follows the time between the positions
+  const double weight =
+      (smoothingTime > 0) ? 1 - std::exp(-dt / smoothingTime) : 1;
+  vx += weight * ((x - lastX) / dt - vx);
+  vy += weight * ((y - lastY) / dt - vy);
+
+  lastStamp = stamp;
+  lastX = x;
+  lastY = y;
+  return true;
+}
+
+RobotPoseSource::RobotPoseSource(const ros::NodeHandle& node, Type type,
+                                 const std::string& topic,
+                                 double smoothingTime)
+    : nh(node), spinner(1, &queue), estimator(smoothingTime) {
+  nh.setCallbackQueue(&queue);
+  if (type == Type::ODOMETRY)
+    subscriber = nh.subscribe(topic, 1, &RobotPoseSource::onOdometry, this);
+  else
+    subscriber = nh.subscribe(topic, 1, &RobotPoseSource::onPose, this);
+  spinner.start();
+}
+
+RobotPoseSource::~RobotPoseSource() {
+  spinner.stop();
+  subscriber.shutdown();
+}
+
+void RobotPoseSource::onOdometry(const nav_msgs::Odometry::ConstPtr& odometry) {
+  // the twist is given in the robot's frame
+  const double yaw = tf::getYaw(odometry->pose.pose.orientation);
+  const double forward = odometry->twist.twist.linear.x;
+  const double sideways = odometry->twist.twist.linear.y;
+
+  RobotPose pose;
+  pose.stamp = odometry->header.stamp.toSec();
+  pose.x = odometry->pose.pose.position.x;
+  pose.y = odometry->pose.pose.position.y;
+  pose.vx = std::cos(yaw) * forward - std::sin(yaw) * sideways;
+  pose.vy = std::sin(yaw) * forward + std::cos(yaw) * sideways;
+  latest.store(pose);
+}
+
+void RobotPoseSource::onPose(const geometry_msgs::PoseStamped::ConstPtr& msg) {
+  RobotPose pose;
+  pose.stamp = msg->header.stamp.toSec();
+  pose.x = msg->pose.position.x;
+  pose.y = msg->pose.position.y;
+  if (!estimator.update(pose.stamp, pose.x, pose.y)) return;
+
+  pose.vx = estimator.getvx();
+  pose.vy = estimator.getvy();
+  latest.store(pose);
+}
@@ -0,0 +1,443 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <pedsim_simulator/runlog.h>
+
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+namespace {
+const char magic[4] = {'P', 'R', 'U', 'N'};
+const uint32_t version = 2;
+const double positionQuantum = 0.001;
+const double velocityQuantum = 0.001;
+
+template <typename T>
+void putValue(std::vector<uint8_t>& output, T value) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+  output.insert(output.end(), bytes, bytes + sizeof(T));
+}
+
+void putVarint(std::vector<uint8_t>& output, uint64_t value) {
+  while (value >= 0x80) {
+    output.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  output.push_back((uint8_t)value);
+}
+
+/// Zigzag encoding keeps small negative values short
+void putSigned(std::vector<uint8_t>& output, int64_t value) {
+  putVarint(output, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+/// Reads from a record payload; reading past its end yields zeros and
+/// clears ok
+struct Reader {
+  const uint8_t* position;
+  const uint8_t* end;
+  bool ok;
+
+  Reader(const uint8_t* begin, size_t size)
+      : position(begin), end(begin + size), ok(true) {}
+
+  template <typename T>
+  T getValue() {
+    T value = T();
+    if (end - position < (ptrdiff_t)sizeof(T)) {
+      ok = false;
+      return value;
+    }
+    memcpy(&value, position, sizeof(T));
+    position += sizeof(T);
+    return value;
+  }
+
+  uint64_t getVarint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (position == end) break;
+      const uint8_t byte = *position++;
+      value |= (uint64_t)(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) return value;
+    }
+    ok = false;
+    return 0;
+  }
+
+  int64_t getSigned() {
+    const uint64_t value = getVarint();
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+  }
+};
+}
+
+RunRecorder::RunRecorder()
+    : keyframeInterval(5), lastKeyframeTime(0), frameCount(0) {}
+
+RunRecorder::~RunRecorder() { close(); }
+
+/// \return  false if the file can't be created
+/// \param   keyframeInterval time between two frames holding all agents;
+/// seeking starts from the closest keyframe
+bool RunRecorder::open(const std::string& filename,
+                       double keyframeIntervalIn) {
+  close();
+
+  file.open(filename, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    ROS_WARN_STREAM("Could not create run log " << filename);
+    return false;
+  }
+
+  keyframeInterval = keyframeIntervalIn;
+  frameCount = 0;
+  lastStates.clear();
+
+  file.write(magic, 4);
+  payload.clear();
+  putValue<uint32_t>(payload, version);
+  putValue<double>(payload, positionQuantum);
+  putValue<double>(payload, velocityQuantum);
+  file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+  return true;
+}
+
+void RunRecorder::close() {
+  if (file.is_open()) file.close();
+}
+
+void RunRecorder::writeRecord(runlog::RecordType type, double time) {
+  std::vector<uint8_t> header;
+  header.reserve(13);
+  header.push_back(type);
+  putValue<double>(header, time);
+  putValue<uint32_t>(header, (uint32_t)payload.size());
+  file.write(reinterpret_cast<const char*>(header.data()), header.size());
+  file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+}
+
+void RunRecorder::writeObstacles(
+    double time, const std::vector<RecordedObstacle>& obstacles) {
+  if (!isOpen()) return;
+
+  payload.clear();
+  putVarint(payload, obstacles.size());
+  for (const RecordedObstacle& obstacle : obstacles) {
+    putValue<double>(payload, obstacle.ax);
+    putValue<double>(payload, obstacle.ay);
+    putValue<double>(payload, obstacle.bx);
+    putValue<double>(payload, obstacle.by);
+  }
+  writeRecord(runlog::OBSTACLES, time);
+}
+
+void RunRecorder::writeFrame(double time,
+                             const std::vector<RecordedAgent>& agents) {
+  if (!isOpen()) return;
+
+  ++frameCount;
+  const bool keyframe = (frameCount == 1) ||
+                        (time - lastKeyframeTime >= keyframeInterval - 1e-9);
+
+  payload.clear();
+  putVarint(payload, agents.size());
+  int previousId = 0;
+  for (const RecordedAgent& agent : agents) {
+    runlog::QuantizedAgent state;
+    state.x = llround(agent.x / positionQuantum);
+    state.y = llround(agent.y / positionQuantum);
+    state.vx = llround(agent.vx / velocityQuantum);
+    state.vy = llround(agent.vy / velocityQuantum);
+    state.type = agent.type;
+    state.state = agent.state;
+    state.frame = frameCount;
+
+    putSigned(payload, (int64_t)agent.id - previousId);
+    previousId = agent.id;
+
+    // → keyframes and new agents start from zero
+    runlog::QuantizedAgent base = runlog::QuantizedAgent();
+    bool attributes = true;
+    auto iter = lastStates.find(agent.id);
+    if (!keyframe) {
+      if (iter != lastStates.end()) {
+        base = iter->second;
+        attributes =
+            (base.type != state.type) || (base.state != state.state);
+      }
+      payload.push_back(attributes ? 1 : 0);
+    }
+    if (attributes) {
+      payload.push_back((uint8_t)state.type);
+      payload.push_back((uint8_t)state.state);
+    }
+    putSigned(payload, state.x - base.x);
+    putSigned(payload, state.y - base.y);
+    putSigned(payload, state.vx - base.vx);
+    putSigned(payload, state.vy - base.vy);
+
+    if (iter != lastStates.end())
+      iter->second = state;
+    else
+      lastStates.emplace(agent.id, state);
+  }
+
+  // → forget removed agents
+  for (auto iter = lastStates.begin(); iter != lastStates.end();) {
+    if (iter->second.frame != frameCount)
+      iter = lastStates.erase(iter);
+    else
+      ++iter;
+  }
+
+  writeRecord(keyframe ? runlog::KEYFRAME : runlog::DELTA, time);
+  if (keyframe) lastKeyframeTime = time;
+}
+
+void RunRecorder::writeEvent(const RecordedEvent& event) {
+  if (!isOpen()) return;
+
+  payload.clear();
+  payload.push_back((uint8_t)event.type);
+  putValue<double>(payload, event.x);
+  putValue<double>(payload, event.y);
+  putValue<double>(payload, event.vx);
+  putValue<double>(payload, event.vy);
+  putValue<int32_t>(payload, event.id);
+  putValue<int32_t>(payload, event.count);
+  writeRecord(runlog::EVENT, event.time);
+}
+
+RunReplayer::RunReplayer()
+    : positionQuantum(::positionQuantum),
+      velocityQuantum(::velocityQuantum),
+      nextRecord(0),
+      time(0),
+      frameCount(0) {}
+
+RunReplayer::~RunReplayer() {}
+
+/// Loads and indexes a run log.
+/// \return  false if the file can't be read or isn't a run log; a truncated
+/// last record is ignored
+bool RunReplayer::open(const std::string& filename) {
+  records.clear();
+  keyframes.clear();
+
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    ROS_WARN_STREAM("Could not open run log " << filename);
+    return false;
+  }
+  data.assign(std::istreambuf_iterator<char>(file),
+              std::istreambuf_iterator<char>());
+
+  Reader header(data.data(), data.size());
+  char magicIn[4];
+  for (char& c : magicIn) c = header.getValue<char>();
+  const uint32_t versionIn = header.getValue<uint32_t>();
+  positionQuantum = header.getValue<double>();
+  velocityQuantum = header.getValue<double>();
+  if (!header.ok || (memcmp(magicIn, magic, 4) != 0) ||
+      (versionIn != version)) {
+    ROS_WARN_STREAM(filename << " is no run log of version " << version);
+    return false;
+  }
+
+  size_t offset = header.position - data.data();
+  while (true) {
+    Reader reader(data.data() + offset, data.size() - offset);
+    Record record;
+    record.type = (runlog::RecordType)reader.getValue<uint8_t>();
+    record.time = reader.getValue<double>();
+    record.size = reader.getValue<uint32_t>();
+    record.offset = reader.position - data.data();
+    if (!reader.ok || (record.size > data.size() - record.offset)) break;
+
+    if (record.type == runlog::KEYFRAME) keyframes.push_back(records.size());
+    records.push_back(record);
+    offset = record.offset + record.size;
+  }
+
+  if (keyframes.empty()) {
+    ROS_WARN_STREAM(filename << " holds no frames");
+    records.clear();
+    return false;
+  }
+
+  seek(getStartTime());
+  return true;
+}
+
+double RunReplayer::getStartTime() const {
+  return keyframes.empty() ? 0 : records[keyframes.front()].time;
+}
+
+double RunReplayer::getEndTime() const {
+  return records.empty() ? 0 : records.back().time;
+}
+
+/// Restores the state at the given time from the closest keyframe before.
+void RunReplayer::seek(double timeIn) {
+  if (!isOpen()) return;
+
+  auto keyframe = std::upper_bound(
+      keyframes.begin(), keyframes.end(), timeIn,
+      [this](double t, size_t index) { return t < records[index].time; });
+  if (keyframe != keyframes.begin()) --keyframe;
+
+  // → the walls of that time, recorded before the keyframe
+  obstacles.clear();
+  for (size_t i = *keyframe; i-- > 0;) {
+    if (records[i].type == runlog::OBSTACLES) {
+      apply(records[i], false);
+      break;
+    }
+  }
+
+  nextRecord = *keyframe;
+  while ((nextRecord < records.size()) &&
+         ((nextRecord == *keyframe) || (records[nextRecord].time <= timeIn)))
+    apply(records[nextRecord++], false);
+  events.clear();
+}
+
+/// Applies the records up to the given time. Events on the way are kept
+/// for takeEvents().
+void RunReplayer::advanceTo(double timeIn) {
+  if (!isOpen()) return;
+
+  // → going back, or passing more than one keyframe, is faster from a
+  //   keyframe; the events on the way are dropped then
+  auto nextKeyframe =
+      std::lower_bound(keyframes.begin(), keyframes.end(), nextRecord);
+  const bool skipsKeyframe = (nextKeyframe != keyframes.end()) &&
+                             (nextKeyframe + 1 != keyframes.end()) &&
+                             (records[*(nextKeyframe + 1)].time <= timeIn);
+  if ((timeIn < time) || skipsKeyframe) {
+    seek(timeIn);
+    return;
+  }
+
+  while ((nextRecord < records.size()) &&
+         (records[nextRecord].time <= timeIn))
+    apply(records[nextRecord++], true);
+}
+
+std::vector<RecordedEvent> RunReplayer::takeEvents() {
+  std::vector<RecordedEvent> result;
+  result.swap(events);
+  return result;
+}
+
+void RunReplayer::apply(const Record& record, bool collectEvents) {
+  Reader reader(data.data() + record.offset, record.size);
+
+  switch (record.type) {
+    case runlog::OBSTACLES: {
+      obstacles.resize(reader.getVarint());
+      for (RecordedObstacle& obstacle : obstacles) {
+        obstacle.ax = reader.getValue<double>();
+        obstacle.ay = reader.getValue<double>();
+        obstacle.bx = reader.getValue<double>();
+        obstacle.by = reader.getValue<double>();
+      }
+      break;
+    }
+    case runlog::KEYFRAME:
+    case runlog::DELTA: {
+      const bool keyframe = (record.type == runlog::KEYFRAME);
+      if (keyframe) lastStates.clear();
+      ++frameCount;
+      time = record.time;
+
+      agents.resize(reader.getVarint());
+      int previousId = 0;
+      for (RecordedAgent& agent : agents) {
+        agent.id = previousId + (int)reader.getSigned();
+        previousId = agent.id;
+
+        runlog::QuantizedAgent base = runlog::QuantizedAgent();
+        auto iter = lastStates.find(agent.id);
+        if (iter != lastStates.end()) base = iter->second;
+        const bool attributes = keyframe || (reader.getValue<uint8_t>() != 0);
+
+        runlog::QuantizedAgent state;
+        state.type = attributes ? reader.getValue<uint8_t>() : base.type;
+        state.state = attributes ? reader.getValue<uint8_t>() : base.state;
+        state.x = base.x + reader.getSigned();
+        state.y = base.y + reader.getSigned();
+        state.vx = base.vx + reader.getSigned();
+        state.vy = base.vy + reader.getSigned();
+        state.frame = frameCount;
+
+        agent.type = state.type;
+        agent.state = state.state;
+        agent.x = state.x * positionQuantum;
+        agent.y = state.y * positionQuantum;
+        agent.vx = state.vx * velocityQuantum;
+        agent.vy = state.vy * velocityQuantum;
+
+        if (iter != lastStates.end())
+          iter->second = state;
+        else
+          lastStates.emplace(agent.id, state);
+      }
+
+      for (auto iter = lastStates.begin(); iter != lastStates.end();) {
+        if (iter->second.frame != frameCount)
+          iter = lastStates.erase(iter);
+        else
+          ++iter;
+      }
+      break;
+    }
+    case runlog::EVENT: {
+      RecordedEvent event;
+      event.type = (RecordedEvent::Type)reader.getValue<uint8_t>();
+      event.time = record.time;
+      event.x = reader.getValue<double>();
+      event.y = reader.getValue<double>();
+      event.vx = reader.getValue<double>();
+      event.vy = reader.getValue<double>();
+      event.id = reader.getValue<int32_t>();
+      event.count = reader.getValue<int32_t>();
+      if (collectEvents) events.push_back(event);
+      break;
+    }
+  }
+
+  if (!reader.ok)
+    ROS_WARN_STREAM_THROTTLE(10, "Corrupt run log record at " << record.time);
+}
@@ -29,15 +29,18 @@
 * \author Sven Wehner <mail@svenwehner.de>
 */
 
+#include <pedsim_simulator/config.h>
 #include <pedsim_simulator/element/agent.h>
 #include <pedsim_simulator/element/agentcluster.h>
 #include <pedsim_simulator/element/areawaypoint.h>
 #include <pedsim_simulator/element/attractionarea.h>
+#include <pedsim_simulator/element/dynamicobstacle.h>
 #include <pedsim_simulator/element/obstacle.h>
 #include <pedsim_simulator/element/waitingqueue.h>
 #include <pedsim_simulator/scenarioreader.h>
 
 #include <QFile>
+#include <cmath>
 #include <iostream>
 
 #include <ros/ros.h>
@@ -46,6 +49,8 @@ ScenarioReader::ScenarioReader() {
   // initialize values
   currentAgents = nullptr;
   currentSpawnArea = nullptr;
+  currentDynamicObstacle = nullptr;
+  inPolygon = false;
 }
 
 bool ScenarioReader::readFromFile(const QString& filename) {
@@ -91,6 +96,61 @@ void ScenarioReader::processData() {
       const double y2 = elementAttributes.value("y2").toString().toDouble();
       Obstacle* obs = new Obstacle(x1, y1, x2, y2);
       SCENE.addObstacle(obs);
+    } else if (elementName == "polygon") {
+      currentPolygon.clear();
+      inPolygon = true;
+    } else if (elementName == "zone") {
+      currentZone = elementAttributes.value("id").toString();
+      currentPolygon.clear();
+      inPolygon = true;
+    } else if (elementName == "gate") {
+      const QString id = elementAttributes.value("id").toString();
+      const double x1 = elementAttributes.value("x1").toString().toDouble();
+      const double y1 = elementAttributes.value("y1").toString().toDouble();
+      const double x2 = elementAttributes.value("x2").toString().toDouble();
+      const double y2 = elementAttributes.value("y2").toString().toDouble();
+      SCENE.addGate(id, Ped::Tvector(x1, y1), Ped::Tvector(x2, y2));
+    } else if (elementName == "corner") {
+      if (!inPolygon) {
+        ROS_DEBUG("Invalid <corner> element outside of polygon or zone!");
+        return;
+      }
+
+      const double x = elementAttributes.value("x").toString().toDouble();
+      const double y = elementAttributes.value("y").toString().toDouble();
+      currentPolygon.push_back(Ped::Tvector(x, y));
+    } else if (elementName == "dynamicobstacle") {
+      const QString id = elementAttributes.value("id").toString();
+      const QString repeat = elementAttributes.value("repeat").toString();
+      currentDynamicObstacle = new DynamicObstacle(id);
+      if (repeat == "loop")
+        currentDynamicObstacle->setRepeat(DynamicObstacle::Repeat::LOOP);
+      else if (repeat == "pingpong")
+        currentDynamicObstacle->setRepeat(DynamicObstacle::Repeat::PINGPONG);
+    } else if (elementName == "segment") {
+      if (currentDynamicObstacle == nullptr) {
+        ROS_DEBUG("Invalid <segment> element outside of dynamicobstacle!");
+        return;
+      }
+
+      const double x1 = elementAttributes.value("x1").toString().toDouble();
+      const double y1 = elementAttributes.value("y1").toString().toDouble();
+      const double x2 = elementAttributes.value("x2").toString().toDouble();
+      const double y2 = elementAttributes.value("y2").toString().toDouble();
+      currentDynamicObstacle->addSegment(x1, y1, x2, y2);
+    } else if (elementName == "keyframe") {
+      if (currentDynamicObstacle == nullptr) {
+        ROS_DEBUG("Invalid <keyframe> element outside of dynamicobstacle!");
+        return;
+      }
+
+      const double t = elementAttributes.value("t").toString().toDouble();
+      const double x = elementAttributes.value("x").toString().toDouble();
+      const double y = elementAttributes.value("y").toString().toDouble();
+      // → in degrees, not wrapped: 0 to 360 is a full turn
+      const double theta =
+          elementAttributes.value("theta").toString().toDouble();
+      currentDynamicObstacle->addKeyframe(t, x, y, theta * M_PI / 180.0);
     } else if (elementName == "waypoint") {
       const QString id = elementAttributes.value("id").toString();
       const double x = elementAttributes.value("x").toString().toDouble();
@@ -140,9 +200,10 @@ void ScenarioReader::processData() {
       AgentCluster* agentCluster = new AgentCluster(x, y, n);
       agentCluster->setDistribution(dx, dy);
 
-      /// TODO - change agents Vmax distribution based on agent type
-      /// and other force parameters to realize different behaviours
+      // speed and force parameters follow the type's <agentprofile>
       agentCluster->setType(static_cast<Ped::Tagent::AgentType>(type));
+      // → robots are told apart by name, see Simulator::setupRobots()
+      agentCluster->setName(elementAttributes.value("name").toString());
       SCENE.addAgentCluster(agentCluster);
       currentAgents = agentCluster;
     } else if (elementName == "source") {
@@ -161,6 +222,27 @@ void ScenarioReader::processData() {
       SpawnArea* spawn_area = new SpawnArea(x, y, n, dx, dy);
       SCENE.addSpawnArea(spawn_area);
       currentSpawnArea = spawn_area;
+    } else if (elementName == "agentprofile") {
+      const int type = elementAttributes.value("type").toString().toInt();
+
+      // missing attributes keep the current profile values
+      AgentProfile profile = CONFIG.getAgentProfile(type);
+      auto readValue = [&elementAttributes](const QString& name,
+                                            double& valueOut) {
+        if (elementAttributes.hasAttribute(name))
+          valueOut = elementAttributes.value(name).toString().toDouble();
+      };
+      readValue("vmax", profile.vmax);
+      readValue("radius", profile.radius);
+      readValue("desired", profile.forceFactorDesired);
+      readValue("social", profile.forceFactorSocial);
+      readValue("obstacle", profile.forceFactorObstacle);
+      const QString model = elementAttributes.value("model").toString();
+      if (model == "orca")
+        profile.motionModel = MotionModel::ORCA;
+      else if (model == "social_force")
+        profile.motionModel = MotionModel::SOCIAL_FORCE;
+      CONFIG.setAgentProfile(type, profile);
     } else if (elementName == "addwaypoint") {
       if (currentAgents == nullptr) {
         ROS_DEBUG("Invalid <addwaypoint> element outside of agent element!");
@@ -192,6 +274,22 @@ void ScenarioReader::processData() {
 
     if (elementName == "agent") {
       currentAgents = nullptr;
+    } else if (elementName == "polygon") {
+      // → stored as one closed ring, not as separate walls
+      if (currentPolygon.size() >= 3)
+        SCENE.addPolygon(currentPolygon);
+      else
+        ROS_DEBUG("Ignoring <polygon> with less than three corners");
+      inPolygon = false;
+    } else if (elementName == "zone") {
+      if (currentPolygon.size() >= 3)
+        SCENE.addZone(currentZone, currentPolygon);
+      else
+        ROS_DEBUG("Ignoring <zone> with less than three corners");
+      inPolygon = false;
+    } else if (elementName == "dynamicobstacle") {
+      SCENE.addDynamicObstacle(currentDynamicObstacle);
+      currentDynamicObstacle = nullptr;
     }
   }
 }
@@ -32,28 +32,65 @@
 #include <pedsim_simulator/config.h>
 #include <pedsim_simulator/scene.h>
 
+#include <pedsim/ped_densitygrid.h>
+#include <pedsim/ped_fork.h>
+#include <pedsim/ped_flowfield.h>
+#include <pedsim/ped_orca.h>
+#include <pedsim/ped_rollout.h>
 #include <pedsim/ped_tree.h>
+#include <pedsim/ped_visibilitygraph.h>
 #include <pedsim_simulator/element/agent.h>
 #include <pedsim_simulator/element/agentcluster.h>
 #include <pedsim_simulator/element/areawaypoint.h>
 #include <pedsim_simulator/element/attractionarea.h>
+#include <pedsim_simulator/element/dynamicobstacle.h>
 #include <pedsim_simulator/element/obstacle.h>
+#include <pedsim_simulator/element/queueingwaypoint.h>
 #include <pedsim_simulator/element/waitingqueue.h>
+#include <pedsim_simulator/agentstatemachine.h>
 #include <pedsim_simulator/force/alongwallforce.h>
 #include <pedsim_simulator/force/groupcoherenceforce.h>
 #include <pedsim_simulator/force/groupgazeforce.h>
 #include <pedsim_simulator/force/grouprepulsionforce.h>
 #include <pedsim_simulator/force/randomforce.h>
+#include <pedsim_simulator/rng.h>
+#include <QDir>
 #include <QGraphicsScene>
 
 #include <ros/ros.h>
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
 // initialize static value
 Scene* Scene::Scene::instance = nullptr;
 
+namespace {
+/// neighbor lookup radius with full and with reduced detail, in meters
+const double fullNeighborhoodRadius = 10.0;
+const double reducedNeighborhoodRadius = 3.0;
+
+/// bounding box of an obstacle, never empty
+QRectF getBounds(const Obstacle* obstacle) {
+  return QRectF(QPointF(obstacle->getax(), obstacle->getay()),
+                QPointF(obstacle->getbx(), obstacle->getby()))
+      .normalized()
+      .adjusted(-0.01, -0.01, 0.01, 0.01);
+}
+}
+
 Scene::Scene(QObject* parent) {
   // initialize values
+  tick = 0;
+  epochTick = 0;
+  epochTime = 0;
   sceneTime = 0;
+  schedulePeriodicTasks();
+  orcaModel = nullptr;
+  continuum = nullptr;
+  obstacleRevision = 0;
+  reducedDetailDistance = 0;
 
   // TODO: create this dynamically according to scenario
   QRect area(-500, -500, 1000, 1000);
@@ -63,11 +100,18 @@ Scene::Scene(QObject* parent) {
       new Ped::Ttree(this, 0, area.x(), area.y(), area.width(), area.height());
 
   obstacle_cells_.clear();
+
+  // re-apply agent type profiles when they change
+  connect(&CONFIG, SIGNAL(agentProfileChanged(int)), this,
+          SLOT(onAgentProfileChanged(int)));
 }
 
 Scene::~Scene() {
   // clean up
   clear();
+  clearVisibilityGraph();
+  clearDensityGrid();
+  delete orcaModel;
 }
 
 Scene& Scene::getInstance() {
@@ -77,12 +121,17 @@ Scene& Scene::getInstance() {
 }
 
 void Scene::clear() {
+  // remove the flow fields, the waypoints referring to them are deleted next
+  clearFlowFields();
+  clearContinuum();
+
   // remove all elements from the scene
   Ped::Tscene::clear();
 
   // remove all agents
   // note: we don't need to delete them, because Ped::Tscene did so already
   agents.clear();
+  robots.clear();
 
   // remove all waypoints
   // note: we don't need to delete them, because Ped::Tscene did so already
@@ -91,6 +140,16 @@ void Scene::clear() {
   // remove all obstacles
   // note: we don't need to delete them, because Ped::Tscene did so already
   obstacles.clear();
+  obstacleBounds.clear();
+  ++obstacleRevision;
+
+  // remove all dynamic obstacles, their segments are gone already
+  foreach (DynamicObstacle* obstacle, dynamicObstacles)
+    delete obstacle;
+  dynamicObstacles.clear();
+
+  // remove all gates and zones
+  flowCounter.clear();
 
   // remove all agents groups
   foreach (AttractionArea* attraction, attractions)
@@ -110,7 +169,12 @@ void Scene::clear() {
   // don't clear the grid, because we can reuse it
 
   // reset time
+  tick = 0;
+  epochTick = 0;
+  epochTime = 0;
   sceneTime = 0;
+  scheduler.clear();
+  schedulePeriodicTasks();
   emit sceneTimeChanged(sceneTime);
 }
 
@@ -175,7 +239,9 @@ QRectF Scene::itemsBoundingRect() const {
 
 const QList<Agent*>& Scene::getAgents() const { return agents; }
 
-QList<AgentGroup*> Scene::getGroups() { return agentGroups; }
+const QList<Agent*>& Scene::getRobots() const { return robots; }
+
+const QList<AgentGroup*>& Scene::getGroups() const { return agentGroups; }
 
 QMap<QString, AttractionArea*> Scene::getAttractions() { return attractions; }
 
@@ -244,7 +310,12 @@ AttractionArea* Scene::getClosestAttraction(const Ped::Tvector& positionIn,
 
 double Scene::getTime() const { return sceneTime; }
 
-bool Scene::hasStarted() const { return (sceneTime == 0); }
+bool Scene::hasStarted() const { return (tick == 0); }
+
+void Scene::schedulePeriodicTasks() {
+  // clean up the scene every 2 s, starting with the first tick
+  scheduler.schedule(2.0, [this]() { cleanupScene(); });
+}
 
 void Scene::dissolveClusters() {
   foreach (AgentCluster* cluster, agentClusters) {
@@ -299,6 +370,7 @@ void Scene::dissolveClusters() {
 void Scene::addAgent(Agent* agent) {
   // keep track of the agent
   agents.append(agent);
+  if (agent->getType() == Ped::Tagent::ROBOT) robots.append(agent);
 
   // add the agent to the PedSim scene
   Ped::Tscene::addAgent(agent);
@@ -318,14 +390,55 @@ void Scene::addAgent(Agent* agent) {
 void Scene::addObstacle(Obstacle* obstacle) {
   // keep track of the obstacle
   obstacles.append(obstacle);
+  obstacleBounds.insert(obstacle, getBounds(obstacle));
+  ++obstacleRevision;
 
   // add the obstacle to the PedSim scene
   Ped::Tscene::addObstacle(obstacle);
 
+  // keep routing up to date when it moves
+  connect(obstacle, SIGNAL(positionChanged()), this, SLOT(onObstacleMoved()));
+
   // inform users
   emit obstacleAdded(obstacle->getid());
 }
 
+size_t Scene::addPolygon(const std::vector<Ped::Tvector>& corners) {
+  const size_t polygon = Ped::Tscene::addPolygon(corners);
+  ++obstacleRevision;
+
+  // → flow fields and the continuum set up already are repaired where it
+  //   stands
+  Ped::Tvector minCorner, maxCorner;
+  getPolygons().getBounds(polygon, &minCorner, &maxCorner);
+  const QRectF bounds = QRectF(QPointF(minCorner.x, minCorner.y),
+                               QPointF(maxCorner.x, maxCorner.y))
+                            .adjusted(-0.01, -0.01, 0.01, 0.01);
+  if (!flowFields.isEmpty()) flowFieldChanges |= bounds;
+  if (continuum != nullptr) continuumChanges |= bounds;
+
+  return polygon;
+}
+
+void Scene::addGate(const QString& name, const Ped::Tvector& start,
+                    const Ped::Tvector& end) {
+  flowCounter.addGate(name.toStdString(), start, end);
+}
+
+void Scene::addZone(const QString& name,
+                    const std::vector<Ped::Tvector>& corners) {
+  flowCounter.addZone(name.toStdString(), corners);
+}
+
+void Scene::addDynamicObstacle(DynamicObstacle* obstacle) {
+  // keep track of the obstacle, it's moved every tick
+  dynamicObstacles.append(obstacle);
+
+  // its segments are ordinary obstacles, placed where they start
+  obstacle->update(sceneTime);
+  for (Obstacle* segment : obstacle->getObstacles()) addObstacle(segment);
+}
+
 void Scene::addWaypoint(Waypoint* waypoint) {
   // keep track of the waypoints
   waypoints.insert(waypoint->getName(), waypoint);
@@ -376,20 +489,21 @@ void Scene::addAttraction(AttractionArea* attractionIn) {
 bool Scene::removeAgent(Agent* agent) {
   // don't keep track of agent anymore
   agents.removeAll(agent);
+  robots.removeAll(agent);
 
   // remove agent from all groups
-  QList<AgentGroup*> groupsToRemove;
+  Ped::TarenaVector<AgentGroup*> groupsToRemove(tickArena);
   foreach (AgentGroup* currentGroup, agentGroups) {
     currentGroup->removeMember(agent);
 
     // check whether the group is empty and can be removed
-    if (currentGroup->isEmpty()) groupsToRemove.append(currentGroup);
+    if (currentGroup->isEmpty()) groupsToRemove.push_back(currentGroup);
   }
 
   // remove unnecessary groups
   // note: use QObject::deleteLater() to keep the group valid till after the
   // agent's destructor
-  foreach (AgentGroup* currentGroup, groupsToRemove) {
+  for (AgentGroup* currentGroup : groupsToRemove) {
     agentGroups.removeAll(currentGroup);
     currentGroup->deleteLater();
   }
@@ -404,6 +518,13 @@ bool Scene::removeAgent(Agent* agent) {
 bool Scene::removeObstacle(Obstacle* obstacle) {
   // don't keep track of obstacle anymore
   obstacles.removeAll(obstacle);
+  ++obstacleRevision;
+
+  // flow fields are repaired where the obstacle was, once per tick, see
+  // updateFlowFields()
+  const QRectF bounds = obstacleBounds.take(obstacle);
+  if (!flowFields.isEmpty()) flowFieldChanges |= bounds;
+  if (continuum != nullptr) continuumChanges |= bounds;
 
   // inform users
   emit obstacleRemoved(obstacle->getid());
@@ -415,6 +536,18 @@ bool Scene::removeObstacle(Obstacle* obstacle) {
 bool Scene::removeWaypoint(Waypoint* waypoint) {
   // don't keep track of waypoint anymore
   waypoints.remove(waypoint->getName());
+  flowFields.remove(waypoint->getName());
+  waypoint->setFlowField(nullptr);
+
+  // aggregated pedestrians can't be re-routed
+  for (const ContinuumPopulation& population : continuumPopulations) {
+    if (population.route.contains(waypoint)) {
+      ROS_WARN("Dropping %.0f aggregated pedestrians, their route changed",
+               continuum->getTotalMass());
+      clearContinuum();
+      break;
+    }
+  }
 
   // remove waypoint from all agent clusters
   // (it is also removed from all agents in Ped::Tscene::removeWaypoint())
@@ -491,38 +624,461 @@ bool Scene::removeAttraction(AttractionArea* attractionInIn) {
   return true;
 }
 
-std::set<const Ped::Tagent*> Scene::getNeighbors(double x, double y,
-                                                 double maxDist) {
-  std::set<const Ped::Tagent*> potentialNeighbours =
-      Ped::Tscene::getNeighbors(x, y, maxDist);
-  Ped::Tvector position(x, y);
-
-  // filter according to euclidean distance
-  auto agentIter = potentialNeighbours.begin();
-  while (agentIter != potentialNeighbours.end()) {
-    const Ped::Tagent& candidate = **agentIter;
-    Ped::Tvector candidatePos = candidate.getPosition();
-    double distance = (candidatePos - position).length();
-
-    // remove distant neighbors
-    if (distance > maxDist) {
-      potentialNeighbours.erase(agentIter++);
-    } else {
-      ++agentIter;
+void Scene::computeFlowFields() {
+  clearFlowFields();
+
+  // the fields cover all obstacles and waypoints
+  const std::vector<Ped::Tobstacle*>& walls = Ped::Tscene::obstacles;
+  QRectF bounds;
+  foreach (Obstacle* obstacle, obstacles) {
+    bounds |= QRectF(QPointF(obstacle->getax(), obstacle->getay()),
+                     QPointF(obstacle->getbx(), obstacle->getby()))
+                  .normalized()
+                  .adjusted(-0.01, -0.01, 0.01, 0.01);
+  }
+  const Ped::Tpolygons& polygons = getPolygons();
+  for (size_t i = 0; i < polygons.getPolygonCount(); ++i) {
+    Ped::Tvector minCorner, maxCorner;
+    polygons.getBounds(i, &minCorner, &maxCorner);
+    bounds |= QRectF(QPointF(minCorner.x, minCorner.y),
+                     QPointF(maxCorner.x, maxCorner.y));
+  }
+  foreach (Waypoint* waypoint, waypoints) {
+    bounds |= QRectF(waypoint->getx() - 0.5, waypoint->gety() - 0.5, 1, 1);
+  }
+  // → leave room to walk around the outermost walls
+  const double margin = 2.0;
+  bounds.adjust(-margin, -margin, margin, margin);
+
+  // one field per destination
+  // note: queueing waypoints steer agents themselves
+  QList<Waypoint*> destinations;
+  QList<std::shared_ptr<Ped::TflowField>> fields;
+  foreach (Waypoint* waypoint, waypoints) {
+    if (dynamic_cast<QueueingWaypoint*>(waypoint) != nullptr) continue;
+
+    auto field = std::make_shared<Ped::TflowField>(
+        bounds.left(), bounds.top(), bounds.width(), bounds.height(),
+        CONFIG.flow_field_resolution);
+    field->setTarget(waypoint->getPosition(), waypoint->getRadius());
+    flowFields.insert(waypoint->getName(), field);
+    destinations.append(waypoint);
+    fields.append(field);
+  }
+
+  // cache computed fields on disk, keyed by everything they depend on
+  const QString cacheDir = QString::fromStdString(CONFIG.flow_field_cache_dir);
+  const bool useCache = !cacheDir.isEmpty() && QDir().mkpath(cacheDir);
+  const double clearance = CONFIG.flow_field_clearance;
+
+  // compute the fields in parallel, they are independent of each other
+  std::atomic<int> cachedCount(0);
+  flowFieldWorkers.run(fields.size(), [&](size_t i) {
+    Ped::TflowField* field = fields.at(i).get();
+    const uint64_t fingerprint =
+        field->getFingerprint(walls, clearance, &polygons);
+    const QString baseName =
+        QString("%1.flow").arg(fingerprint, 16, 16, QChar('0'));
+    const std::string fileName =
+        QDir(cacheDir).filePath(baseName).toStdString();
+
+    if (useCache && field->load(fileName, fingerprint)) {
+      cachedCount++;
+      return;
+    }
+
+    field->compute(walls, clearance, &polygons);
+    if (useCache && !field->save(fileName, fingerprint))
+      ROS_WARN("Could not cache flow field: %s", fileName.c_str());
+  });
+
+  // hand the fields to their waypoints
+  for (int i = 0; i < destinations.size(); ++i)
+    destinations[i]->setFlowField(fields[i]);
+
+  ROS_INFO("Prepared %d flow fields (%d from cache, %dx%d cells)",
+           flowFields.size(), cachedCount.load(),
+           flowFields.isEmpty() ? 0 : flowFields.first()->getColumns(),
+           flowFields.isEmpty() ? 0 : flowFields.first()->getRows());
+}
+
+/// Repairs the flow fields around the obstacles moved since the last call.
+void Scene::updateFlowFields() {
+  if (flowFieldChanges.isNull()) return;
+
+  const std::vector<Ped::Tobstacle*>& walls = Ped::Tscene::obstacles;
+  const Ped::Tvector changedMin(flowFieldChanges.left(),
+                                flowFieldChanges.top());
+  const Ped::Tvector changedMax(flowFieldChanges.right(),
+                                flowFieldChanges.bottom());
+  flowFieldChanges = QRectF();
+
+  // snapshots taken for forks must not see the fields change
+  // → copy the fields still referenced by one; the scene and the waypoint
+  //   hold the other two references
+  for (auto iter = flowFields.begin(); iter != flowFields.end(); ++iter) {
+    if (iter.value().use_count() <= 2) continue;
+
+    iter.value() = std::make_shared<Ped::TflowField>(*iter.value());
+    Waypoint* waypoint = waypoints.value(iter.key());
+    if (waypoint != nullptr) waypoint->setFlowField(iter.value());
+  }
+
+  // the fields are independent of each other
+  const QList<std::shared_ptr<Ped::TflowField>> fields = flowFields.values();
+  flowFieldWorkers.run(fields.size(), [&](size_t i) {
+    fields.at(i)->update(walls, CONFIG.flow_field_clearance, changedMin,
+                         changedMax, &getPolygons());
+  });
+}
+
+void Scene::clearFlowFields() {
+  foreach (Waypoint* waypoint, waypoints)
+    waypoint->setFlowField(nullptr);
+
+  flowFields.clear();
+  flowFieldChanges = QRectF();
+}
+
+void Scene::buildVisibilityGraph() {
+  clearVisibilityGraph();
+
+  Ped::TvisibilityGraph* graph =
+      new Ped::TvisibilityGraph(CONFIG.visibility_graph_clearance);
+  setVisibilityGraph(graph);
+
+  // cache the routes between all waypoints
+  graph->precomputeRoutes(Ped::Tscene::waypoints);
+
+  ROS_INFO("Built visibility graph with %zu corners and %zu edges",
+           graph->getNodeCount(), graph->getEdgeCount());
+}
+
+void Scene::clearVisibilityGraph() {
+  Ped::TvisibilityGraph* graph = getVisibilityGraph();
+  setVisibilityGraph(nullptr);
+  delete graph;
+}
+
+/// Looks up the agents within radius of center. The result may contain
+/// agents slightly further away.
+void Scene::getNeighbors(std::vector<const Ped::Tagent*>& neighbors,
+                         const Ped::Tvector& center, double radius) const {
+  neighbors.clear();
+  Ped::Tscene::getNeighbors(neighbors, center.x, center.y, radius);
+}
+
+/// Finds the count agents closest to center, sorted by distance. The search
+/// radius is doubled until enough agents are within it; agents outside the
+/// radius can't be closer than those inside.
+void Scene::getNearestAgents(std::vector<const Ped::Tagent*>& nearest,
+                             const Ped::Tvector& center, size_t count) const {
+  nearest.clear();
+  count = std::min(count, Ped::Tscene::agents.size());
+  if (count == 0) return;
+
+  auto distance = [&center](const Ped::Tagent* agent) {
+    return (agent->getPosition() - center).lengthSquared();
+  };
+
+  std::vector<const Ped::Tagent*> candidates;
+  for (double radius = 4.0;; radius *= 2) {
+    candidates.clear();
+    Ped::Tscene::getNeighbors(candidates, center.x, center.y, radius);
+    nearest.clear();
+    for (const Ped::Tagent* agent : candidates) {
+      if (distance(agent) <= radius * radius) nearest.push_back(agent);
     }
+    if ((nearest.size() >= count) ||
+        (candidates.size() >= Ped::Tscene::agents.size()))
+      break;
+  }
+
+  std::sort(nearest.begin(), nearest.end(),
+            [&distance](const Ped::Tagent* a, const Ped::Tagent* b) {
+              return distance(a) < distance(b);
+            });
+  if (nearest.size() > count) nearest.resize(count);
+}
+
+/// Finds the agents inside a polygon, given by its corners.
+void Scene::getAgentsInPolygon(std::vector<const Ped::Tagent*>& inside,
+                               const std::vector<Ped::Tvector>& corners) const {
+  inside.clear();
+  if (corners.size() < 3) return;
+
+  Ped::Tpolygons area;
+  area.addPolygon(corners);
+  Ped::Tvector minCorner, maxCorner;
+  area.getBounds(0, &minCorner, &maxCorner);
+
+  // → the neighbor index searches a square around the center of the bounds
+  Ped::Tvector center = 0.5 * (minCorner + maxCorner);
+  double extent =
+      std::max(maxCorner.x - minCorner.x, maxCorner.y - minCorner.y);
+  std::vector<const Ped::Tagent*> candidates;
+  Ped::Tscene::getNeighbors(candidates, center.x, center.y, 0.5 * extent);
+  for (const Ped::Tagent* agent : candidates) {
+    if (area.contains(0, agent->getPosition())) inside.push_back(agent);
+  }
+}
+
+/// Finds the closest point on any wall or polygon outline.
+/// \param   maxDistance walls farther away are skipped, 0 for no limit
+/// \return  false if there is no wall within maxDistance
+bool Scene::getNearestWall(const Ped::Tvector& point, double maxDistance,
+                           Ped::Tvector* closestOut) const {
+  std::vector<const Ped::Tobstacle*> walls;
+  if (maxDistance > 0) {
+    Ped::Tscene::getObstacles(walls, point.x, point.y, maxDistance);
+  } else {
+    maxDistance = std::numeric_limits<double>::infinity();
+    walls.assign(Ped::Tscene::obstacles.begin(), Ped::Tscene::obstacles.end());
+  }
+
+  bool found = false;
+  double bestDistance = maxDistance;
+  for (const Ped::Tobstacle* wall : walls) {
+    Ped::Tvector closest = wall->closestPoint(point);
+    double distance = (closest - point).length();
+    if (distance <= bestDistance) {
+      bestDistance = distance;
+      *closestOut = closest;
+      found = true;
+    }
+  }
+
+  Ped::Tvector closest;
+  if (getPolygons().getClosestPoint(point, bestDistance, &closest)) {
+    *closestOut = closest;
+    found = true;
+  }
+  return found;
+}
+
+/// Copies the agents within radius of center, and the obstacles around them,
+/// for predicting their trajectories (see Ped::Trollout). The copies use the
+/// same motion models, but no additional forces and no randomness.
+std::unique_ptr<Ped::Trollout> Scene::createRollout(const Ped::Tvector& center,
+                                                    double radius) const {
+  std::unique_ptr<Ped::Trollout> rollout(new Ped::Trollout());
+
+  std::vector<const Ped::Tagent*> nearAgents;
+  Ped::Tscene::getNeighbors(nearAgents, center.x, center.y, radius);
+  for (const Ped::Tagent* agent : nearAgents) {
+    if ((agent->getPosition() - center).length() <= radius)
+      rollout->addAgent(*agent);
+  }
+
+  // → the agents may walk beyond the radius during the rollout
+  std::vector<const Ped::Tobstacle*> nearObstacles;
+  Ped::Tscene::getObstacles(nearObstacles, center.x, center.y, 2 * radius);
+  for (const Ped::Tobstacle* obstacle : nearObstacles)
+    rollout->addObstacle(*obstacle);
+  const Ped::Tpolygons& polygons = getPolygons();
+  for (size_t i = 0; i < polygons.getPolygonCount(); ++i) {
+    if (polygons.isNear(i, center, 2 * radius))
+      rollout->addPolygon(polygons.getCorners(i));
+  }
+
+  for (int type = Ped::Tagent::ADULT; type <= Ped::Tagent::ELDER; ++type) {
+    const Ped::TmotionModel* model = getMotionModel(type);
+    if (model != nullptr) rollout->setMotionModel(type, *model);
+  }
+
+  return rollout;
+}
+
+/// Takes a snapshot of the current state for planners that try out robot
+/// actions in forks of it (see Ped::TsceneFork). Call it from the simulation
+/// thread; the snapshot and its forks can then be used on any thread. The
+/// forks don't apply the additional forces.
+std::shared_ptr<const Ped::TsceneSnapshot> Scene::createSnapshot() const {
+  return std::make_shared<const Ped::TsceneSnapshot>(
+      static_cast<const Ped::Tscene&>(*this));
+}
+
+/// Keeps track of the crowd density. The grid covers the scene; it is updated
+/// while the agents move.
+void Scene::setupDensityGrid() {
+  clearDensityGrid();
+
+  const double margin = 2.0;
+  QRectF bounds =
+      itemsBoundingRect().adjusted(-margin, -margin, margin, margin);
+  setDensityGrid(new Ped::TdensityGrid(bounds.left(), bounds.top(),
+                                       bounds.width(), bounds.height(),
+                                       CONFIG.density_grid_resolution));
+}
+
+void Scene::clearDensityGrid() {
+  Ped::TdensityGrid* grid = densityGrid;
+  setDensityGrid(nullptr);
+  delete grid;
+}
+
+/// Starts the hybrid mode: agents far outside the region of interest are
+/// replaced by a density grid (see Ped::Tcontinuum), and agents are created
+/// again where the density flows into the region.
+void Scene::setupContinuum() {
+  clearContinuum();
+
+  // → leave room to walk around the outermost walls
+  const double margin = 2.0;
+  QRectF bounds =
+      itemsBoundingRect().adjusted(-margin, -margin, margin, margin);
+  continuum = new Ped::Tcontinuum(bounds.left(), bounds.top(), bounds.width(),
+                                  bounds.height(), CONFIG.hybrid_cell_size);
+  continuum->updatePassages(*this);
+  continuumChanges = QRectF();
+  continuum->setRegionOfInterest(
+      CONFIG.hybrid_region_x, CONFIG.hybrid_region_y,
+      CONFIG.hybrid_region_width, CONFIG.hybrid_region_height);
+
+  ROS_INFO("Hybrid mode: %dx%d continuum cells outside the region of interest",
+           continuum->getColumns(), continuum->getRows());
+}
+
+void Scene::clearContinuum() {
+  delete continuum;
+  continuum = nullptr;
+  continuumPopulations.clear();
+}
+
+/// Only individually walking pedestrians are aggregated. Robots, groups,
+/// and agents queueing or shopping stay microscopic.
+bool Scene::isAggregatable(const Agent* agent) const {
+  if (agent->getType() == Ped::Tagent::ROBOT) return false;
+  if (agent->isInGroup()) return false;
+  if (agent->getStateMachine()->getCurrentState() !=
+      AgentStateMachine::StateWalking)
+    return false;
+
+  // → heading to the first waypoint of the route
+  const QList<Waypoint*>& route = agent->getWaypoints();
+  return !route.isEmpty() && (agent->getCurrentWaypoint() == route.first());
+}
+
+size_t Scene::getContinuumPopulation(const QList<Waypoint*>& route,
+                                     Ped::Tagent::AgentType type) {
+  for (size_t i = 0; i < continuumPopulations.size(); ++i) {
+    const ContinuumPopulation& population = continuumPopulations[i];
+    if ((population.type == type) && (population.route == route)) return i;
+  }
+
+  ContinuumPopulation population;
+  population.route = route;
+  population.type = type;
+  continuumPopulations.push_back(population);
+  return continuum->addPopulation(route.first());
+}
+
+void Scene::updateContinuum() {
+  // hand agents far from the region of interest over
+  Ped::TarenaVector<Agent*> aggregatedAgents(tickArena);
+  foreach (Agent* agent, agents) {
+    if (!continuum->isFarFromRegionOfInterest(agent->getx(), agent->gety()))
+      continue;
+    if (!isAggregatable(agent)) continue;
+
+    size_t population =
+        getContinuumPopulation(agent->getWaypoints(), agent->getType());
+    if (continuum->deposit(population, agent->getx(), agent->gety()))
+      aggregatedAgents.push_back(agent);
+  }
+  for (Agent* agent : aggregatedAgents) removeAgent(agent);
+
+  // → walls that moved since the last step
+  if (!continuumChanges.isNull()) {
+    continuum->updatePassages(
+        *this, Ped::Tvector(continuumChanges.left(), continuumChanges.top()),
+        Ped::Tvector(continuumChanges.right(), continuumChanges.bottom()));
+    continuumChanges = QRectF();
   }
+  continuum->advance(CONFIG.getTimeStepSize());
+
+  // pedestrians at their destination continue their route like agents do,
+  // or leave at a sink
+  // → at a waypoint within the region of interest, they come back as agents
+  const size_t populationCount = continuumPopulations.size();
+  for (size_t i = 0; i < populationCount; ++i) {
+    const double arrived = continuum->takeArrived(i);
+    if (arrived <= 0) continue;
+
+    QList<Waypoint*> route = continuumPopulations[i].route;
+    Waypoint* destination = route.first();
+    if (destination->getBehavior() == Ped::Twaypoint::Behavior::SINK) continue;
+
+    route.append(route.takeFirst());
+    size_t next = getContinuumPopulation(route, continuumPopulations[i].type);
+    if (!continuum->deposit(next, destination->getx(), destination->gety(),
+                            arrived))
+      ROS_WARN_THROTTLE(5.0, "Continuum: waypoint %s is outside the grid",
+                        destination->getName().toStdString().c_str());
+  }
+
+  // re-create agents where pedestrians entered the region of interest
+  continuumEntries.clear();
+  continuum->takeEntering(continuumEntries);
+  const double halfCell = continuum->getCellSize() / 2;
+  std::uniform_real_distribution<double> jitter(-halfCell, halfCell);
+  for (const Ped::Tcontinuum::Tentry& entry : continuumEntries) {
+    const ContinuumPopulation& population =
+        continuumPopulations[entry.population];
+
+    Agent* agent = new Agent();
+    agent->setPosition(entry.position.x + jitter(RNG()),
+                       entry.position.y + jitter(RNG()));
+    agent->setType(population.type);
+    agent->setWaypoints(population.route);
+    addAgent(agent);
+    agent->setvx(entry.velocity.x);
+    agent->setvy(entry.velocity.y);
+  }
+
+  ROS_DEBUG_THROTTLE(5.0, "Continuum: %.1f aggregated pedestrians",
+                     continuum->getTotalMass());
+}
 
-  return potentialNeighbours;
+void Scene::onObstacleMoved() {
+  Obstacle* obstacle = qobject_cast<Obstacle*>(sender());
+  if (obstacle == nullptr) return;
+
+  // only the corners and edges around the obstacle are updated
+  updateObstacle(obstacle);
+
+  // flow fields are repaired around the old and the new position, once
+  // per tick, see updateFlowFields()
+  const QRectF bounds = getBounds(obstacle);
+  if (!flowFields.isEmpty())
+    flowFieldChanges |= obstacleBounds.value(obstacle) | bounds;
+  if (continuum != nullptr)
+    continuumChanges |= obstacleBounds.value(obstacle) | bounds;
+  obstacleBounds.insert(obstacle, bounds);
+  ++obstacleRevision;
 }
 
 void Scene::moveAllAgents() {
   // inform users when there is going to be the first update
-  if (sceneTime == 0) emit aboutToStart();
+  if (tick == 0) emit aboutToStart();
+
+  // a new time step starts a new epoch, within one the time is exact
+  const double h = CONFIG.getTimeStepSize();
+  if (h != scheduler.getTimeStep()) {
+    epochTick = tick;
+    epochTime = sceneTime;
+    scheduler.setTimeStep(h);
+  }
+
+  // run periodic tasks, e.g. the clean up of the scene
+  scheduler.run(tick);
 
-  // clean up scene if necessary
-  double cleanupInterval = 2.0;
-  if (fmod(sceneTime, cleanupInterval) < CONFIG.getTimeStepSize())
-    cleanupScene();
+  // activate force parameters changed since the last tick
+  // → per-agent factors are resolved from the agent type profiles
+  if (CONFIG.commitForceParameters()) {
+    foreach (Agent* agent, agents)
+      agent->applyTypeProfile();
+  }
 
   // inform users that there will be an update
   emit aboutToMoveAgents();
@@ -531,11 +1087,21 @@ void Scene::moveAllAgents() {
   if (!agentClusters.isEmpty()) dissolveClusters();
 
   // update scene time
-  sceneTime += CONFIG.getTimeStepSize();
+  ++tick;
+  sceneTime = epochTime + (tick - epochTick) * h;
   emit sceneTimeChanged(sceneTime);
 
+  // move scripted obstacles first, the agents react to where they are now
+  foreach (DynamicObstacle* obstacle, dynamicObstacles)
+    obstacle->update(sceneTime);
+  updateFlowFields();
+
   // move the agents
-  Ped::Tscene::moveAgents(CONFIG.getTimeStepSize());
+  if (reducedDetailDistance > 0) updateNeighborhoods();
+  Ped::Tscene::moveAgents(h);
+
+  // count gate crossings before pedestrians at sinks are removed
+  flowCounter.update(sceneTime, Ped::Tscene::agents);
 
   auto Dist = [](const double ax, const double ay, const double bx,
                  const double by) -> double {
@@ -543,6 +1109,8 @@ void Scene::moveAllAgents() {
   };
 
   // For every agents, if next WP is sink and 'close', call removeAgent.
+  // → collect them first, removing modifies the agent list
+  Ped::TarenaVector<Agent*> arrivedAgents(tickArena);
   for (auto agent : getAgents()) {
     const auto agent_next_wp = agent->getCurrentWaypoint();
     // skip agents without any waypoint
@@ -556,15 +1124,76 @@ void Scene::moveAllAgents() {
 
     const double d = Dist(agent_next_wp->getx(), agent_next_wp->gety(),
                           agent->getx(), agent->gety());
-    if (d < agent_next_wp->getRadius()) {
-      // At sink waypoint.
-      ROS_DEBUG_STREAM("Killing agent: " << agent->getId());
-      removeAgent(agent);
-    }
+    if (d < agent_next_wp->getRadius()) arrivedAgents.push_back(agent);
   }
+  for (Agent* agent : arrivedAgents) {
+    // At sink waypoint.
+    ROS_DEBUG_STREAM("Killing agent: " << agent->getId());
+    removeAgent(agent);
+  }
+
+  // exchange agents with the continuum outside the region of interest
+  if (continuum != nullptr) updateContinuum();
 
   // inform users
   emit movedAgents();
+
+  // release the scratch memory of this time step
+  // → in steady state, the arena doesn't need to grow anymore
+  ROS_DEBUG_THROTTLE(5.0, "Tick arena: %zu bytes used, %zu bytes capacity",
+                     tickArena.getUsedBytes(), tickArena.getCapacity());
+  tickArena.reset();
 }
 
 void Scene::cleanupScene() { Ped::Tscene::cleanup(); }
+
+/// Agents farther than the distance from every robot look up their neighbors,
+/// and so feel the social force, only within a few meters. Close to the
+/// robots, the crowd keeps its full detail.
+/// \param   distance from the robots, 0 for full detail everywhere
+void Scene::setReducedDetailDistance(double distance) {
+  reducedDetailDistance = distance;
+  if (distance > 0) return;
+
+  foreach (Agent* agent, agents)
+    agent->setNeighborhoodRadius(fullNeighborhoodRadius);
+}
+
+void Scene::updateNeighborhoods() {
+  const double distanceSquared = reducedDetailDistance * reducedDetailDistance;
+  foreach (Agent* agent, agents) {
+    bool nearRobot = false;
+    foreach (const Agent* robot, robots) {
+      const Ped::Tvector diff = agent->getPosition() - robot->getPosition();
+      if (diff.lengthSquared() <= distanceSquared) {
+        nearRobot = true;
+        break;
+      }
+    }
+    agent->setNeighborhoodRadius(nearRobot ? fullNeighborhoodRadius
+                                           : reducedNeighborhoodRadius);
+  }
+}
+
+void Scene::onAgentProfileChanged(int type) {
+  applyMotionModel(type);
+
+  foreach (Agent* agent, agents) {
+    if (agent->getType() == type) agent->applyTypeProfile();
+  }
+}
+
+void Scene::applyMotionModel(int type) {
+  if (CONFIG.getAgentProfile(type).motionModel != MotionModel::ORCA) {
+    setMotionModel(type, nullptr);
+    return;
+  }
+
+  if (orcaModel == nullptr) {
+    orcaModel = new Ped::TorcaModel(
+        CONFIG.orca_time_horizon, CONFIG.orca_obstacle_time_horizon,
+        std::max(1, CONFIG.orca_max_neighbors),
+        std::max(0, CONFIG.orca_threads));
+  }
+  setMotionModel(type, orcaModel);
+}
@@ -30,9 +30,16 @@
 */
 
 #include <QApplication>
+#include <QDir>
 #include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
 
+#include <pedsim/ped_densitygrid.h>
+#include <pedsim/ped_rollout.h>
 #include <pedsim_simulator/element/agentcluster.h>
+#include <pedsim_simulator/force/force.h>
 #include <pedsim_simulator/scene.h>
 #include <pedsim_simulator/simulator.h>
 
@@ -51,19 +58,24 @@ Simulator::~Simulator() {
   pub_obstacles_.shutdown();
   pub_agent_states_.shutdown();
   pub_agent_groups_.shutdown();
-  pub_robot_position_.shutdown();
   pub_waypoints_.shutdown();
 
   srv_pause_simulation_.shutdown();
   srv_unpause_simulation_.shutdown();
 
-  delete robot_;
+  if (CONFIG.metrics_enabled) writeMetrics();
+  if (heatmap_accumulator_.isOpen() && !CONFIG.heatmap_directory.empty()) {
+    HeatmapAccumulator::Grids grids;
+    heatmap_accumulator_.getGrids(grids);
+    writeHeatmaps(grids);
+  }
+
   QCoreApplication::exit(0);
 }
 
 bool Simulator::initializeSimulation() {
-  int queue_size = 0;
-  nh_.param<int>("default_queue_size", queue_size, 1);
+  nh_.param<int>("default_queue_size", queue_size_, 1);
+  const int queue_size = queue_size_;
   ROS_INFO_STREAM("Using default queue size of "
                   << queue_size << " for publisher queues... "
                   << (queue_size == 0
@@ -71,28 +83,211 @@ bool Simulator::initializeSimulation() {
                           : ""));
 
   // setup ros publishers
-  pub_obstacles_ =
-      nh_.advertise<pedsim_msgs::LineObstacles>("simulated_walls", queue_size);
+  // → walls are only published when they change, late subscribers get the
+  //   latest ones
+  pub_obstacles_ = nh_.advertise<pedsim_msgs::LineObstacles>(
+      "simulated_walls", queue_size, true);
+  published_obstacle_revision_ = std::numeric_limits<uint64_t>::max();
+  recorded_obstacle_revision_ = std::numeric_limits<uint64_t>::max();
   pub_agent_states_ =
       nh_.advertise<pedsim_msgs::AgentStates>("simulated_agents", queue_size);
   pub_agent_groups_ =
       nh_.advertise<pedsim_msgs::AgentGroups>("simulated_groups", queue_size);
-  pub_robot_position_ =
-      nh_.advertise<nav_msgs::Odometry>("robot_position", queue_size);
   pub_waypoints_ =
     nh_.advertise<pedsim_msgs::Waypoints>("simulated_waypoints", queue_size);
+  pub_density_grid_ =
+      nh_.advertise<pedsim_msgs::DensityGrid>("density_grid", queue_size);
+  pub_predicted_trajectories_ = nh_.advertise<pedsim_msgs::AgentTrajectories>(
+      "predicted_trajectories", queue_size);
+  pub_robot_metrics_ =
+      nh_.advertise<pedsim_msgs::RobotMetrics>("robot_metrics", queue_size);
+  pub_flow_measurements_ = nh_.advertise<pedsim_msgs::FlowMeasurements>(
+      "flow_measurements", queue_size);
+  pub_agent_spawns_ =
+      nh_.advertise<pedsim_msgs::AgentSpawn>("agent_spawns", queue_size);
 
   // services
   srv_pause_simulation_ = nh_.advertiseService(
       "pause_simulation", &Simulator::onPauseSimulation, this);
   srv_unpause_simulation_ = nh_.advertiseService(
       "unpause_simulation", &Simulator::onUnpauseSimulation, this);
+  srv_query_scene_ =
+      nh_.advertiseService("query_scene", &Simulator::onQueryScene, this);
 
   // setup TF listener and other pointers
   transform_listener_.reset(new tf::TransformListener());
-  robot_ = nullptr;
+  transform_broadcaster_.reset(new tf::TransformBroadcaster());
 
   // load additional parameters
+  nh_.param<bool>("enable_groups", CONFIG.groups_enabled, true);
+  nh_.param<double>("max_robot_speed", CONFIG.max_robot_speed, 1.5);
+  nh_.param<double>("update_rate", CONFIG.updateRate, 25.0);
+  nh_.param<double>("simulation_factor", CONFIG.simulationFactor, 1.0);
+
+  int op_mode = 1;
+  nh_.param<int>("robot_mode", op_mode, 1);
+  CONFIG.robot_mode = static_cast<RobotMode>(op_mode);
+
+  // per-force Qt signals are only emitted in full visual mode
+  int visual_mode = static_cast<int>(CONFIG.visual_mode);
+  nh_.param<int>("visual_mode", visual_mode, visual_mode);
+  CONFIG.visual_mode = static_cast<VisualMode>(visual_mode);
+
+  // flow fields lead agents around obstacles towards their waypoints
+  nh_.param<bool>("enable_flow_fields", CONFIG.flow_fields_enabled, false);
+  nh_.param<double>("flow_field_resolution", CONFIG.flow_field_resolution,
+                    CONFIG.flow_field_resolution);
+  nh_.param<double>("flow_field_clearance", CONFIG.flow_field_clearance,
+                    CONFIG.flow_field_clearance);
+  nh_.param<std::string>("flow_field_cache_dir", CONFIG.flow_field_cache_dir,
+                         CONFIG.flow_field_cache_dir);
+
+  // alternatively, a visibility graph routes agents from corner to corner
+  nh_.param<bool>("enable_visibility_graph", CONFIG.visibility_graph_enabled,
+                  false);
+  nh_.param<double>("visibility_graph_clearance",
+                    CONFIG.visibility_graph_clearance,
+                    CONFIG.visibility_graph_clearance);
+
+  // agent types can be driven by ORCA instead of social forces
+  nh_.param<double>("orca_time_horizon", CONFIG.orca_time_horizon,
+                    CONFIG.orca_time_horizon);
+  nh_.param<double>("orca_obstacle_time_horizon",
+                    CONFIG.orca_obstacle_time_horizon,
+                    CONFIG.orca_obstacle_time_horizon);
+  nh_.param<int>("orca_max_neighbors", CONFIG.orca_max_neighbors,
+                 CONFIG.orca_max_neighbors);
+  nh_.param<int>("orca_threads", CONFIG.orca_threads, CONFIG.orca_threads);
+
+  // local crowd density, published and optionally slowing agents down
+  nh_.param<bool>("enable_density_grid", CONFIG.density_grid_enabled,
+                  CONFIG.density_grid_enabled);
+  nh_.param<double>("density_grid_resolution", CONFIG.density_grid_resolution,
+                    CONFIG.density_grid_resolution);
+  nh_.param<bool>("density_speed_scaling", CONFIG.density_speed_scaling,
+                  CONFIG.density_speed_scaling);
+
+  // predicted trajectories of the agents around the robot
+  nh_.param<bool>("enable_prediction", CONFIG.prediction_enabled,
+                  CONFIG.prediction_enabled);
+  nh_.param<double>("prediction_horizon", CONFIG.prediction_horizon,
+                    CONFIG.prediction_horizon);
+  nh_.param<double>("prediction_radius", CONFIG.prediction_radius,
+                    CONFIG.prediction_radius);
+  nh_.param<double>("prediction_sample_interval",
+                    CONFIG.prediction_sample_interval,
+                    CONFIG.prediction_sample_interval);
+
+  // agent states streamed to disk, e.g. as training data
+  nh_.param<bool>("enable_export", CONFIG.export_enabled,
+                  CONFIG.export_enabled);
+  nh_.param<std::string>("export_directory", CONFIG.export_directory,
+                         CONFIG.export_directory);
+  nh_.param<std::string>("export_format", CONFIG.export_format,
+                         CONFIG.export_format);
+  nh_.param<double>("export_interval", CONFIG.export_interval,
+                    CONFIG.export_interval);
+  nh_.param<int>("export_chunk_frames", CONFIG.export_chunk_frames,
+                 CONFIG.export_chunk_frames);
+  nh_.param<std::vector<double>>("export_regions", CONFIG.export_regions,
+                                 CONFIG.export_regions);
+
+  // externally driven robots follow TF, or a pose topic; robots named in
+  // the scenario take their own under robots/<name>/, see createRobot()
+  nh_.param<std::string>("robot_pose_source", CONFIG.robot_pose_source,
+                         CONFIG.robot_pose_source);
+  nh_.param<std::string>("robot_pose_topic", CONFIG.robot_pose_topic,
+                         CONFIG.robot_pose_topic);
+  nh_.param<double>("robot_velocity_smoothing",
+                    CONFIG.robot_velocity_smoothing,
+                    CONFIG.robot_velocity_smoothing);
+
+  // detail is given up step by step when ticks overrun their budget
+  nh_.param<bool>("enable_overrun_control", CONFIG.overrun_control_enabled,
+                  CONFIG.overrun_control_enabled);
+  nh_.param<double>("overrun_degrade_time", CONFIG.overrun_degrade_time,
+                    CONFIG.overrun_degrade_time);
+  nh_.param<double>("overrun_restore_time", CONFIG.overrun_restore_time,
+                    CONFIG.overrun_restore_time);
+  nh_.param<double>("overrun_restore_load", CONFIG.overrun_restore_load,
+                    CONFIG.overrun_restore_load);
+
+  // kinematic robots are stepped with the crowd from their cmd_vel
+  nh_.param<std::string>("robot_kinematics", CONFIG.robot_kinematics,
+                         CONFIG.robot_kinematics);
+  nh_.param<std::string>("robot_cmd_vel_topic", CONFIG.robot_cmd_vel_topic,
+                         CONFIG.robot_cmd_vel_topic);
+
+  // safety and comfort measures of the robot's run
+  nh_.param<bool>("enable_metrics", CONFIG.metrics_enabled,
+                  CONFIG.metrics_enabled);
+  nh_.param<double>("metrics_personal_space", CONFIG.metrics_personal_space,
+                    CONFIG.metrics_personal_space);
+  nh_.param<double>("metrics_publish_interval",
+                    CONFIG.metrics_publish_interval,
+                    CONFIG.metrics_publish_interval);
+  nh_.param<std::string>("metrics_file", CONFIG.metrics_file,
+                         CONFIG.metrics_file);
+  nh_.param<std::vector<double>>("metrics_goal", CONFIG.metrics_goal,
+                                 CONFIG.metrics_goal);
+  nh_.param<double>("metrics_goal_tolerance", CONFIG.metrics_goal_tolerance,
+                    CONFIG.metrics_goal_tolerance);
+
+  // counts at gates and dwell times in zones declared by the scenario
+  nh_.param<double>("flow_publish_interval", CONFIG.flow_publish_interval,
+                    CONFIG.flow_publish_interval);
+  nh_.param<double>("flow_dwell_bin_width", CONFIG.flow_dwell_bin_width,
+                    CONFIG.flow_dwell_bin_width);
+  nh_.param<int>("flow_dwell_bins", CONFIG.flow_dwell_bins,
+                 CONFIG.flow_dwell_bins);
+
+  // occupancy, speed and stop heatmaps of the whole run
+  nh_.param<bool>("enable_heatmaps", CONFIG.heatmap_enabled,
+                  CONFIG.heatmap_enabled);
+  nh_.param<double>("heatmap_cell_size", CONFIG.heatmap_cell_size,
+                    CONFIG.heatmap_cell_size);
+  nh_.param<double>("heatmap_stop_speed", CONFIG.heatmap_stop_speed,
+                    CONFIG.heatmap_stop_speed);
+  nh_.param<std::string>("heatmap_directory", CONFIG.heatmap_directory,
+                         CONFIG.heatmap_directory);
+
+  // runs can be recorded, and replayed without simulating them
+  nh_.param<std::string>("record_file", CONFIG.record_file,
+                         CONFIG.record_file);
+  nh_.param<double>("record_keyframe_interval",
+                    CONFIG.record_keyframe_interval,
+                    CONFIG.record_keyframe_interval);
+  nh_.param<std::string>("replay_file", CONFIG.replay_file,
+                         CONFIG.replay_file);
+  nh_.param<double>("replay_speed", CONFIG.replay_speed, CONFIG.replay_speed);
+
+  // far away from the region of interest, pedestrians can be simulated as
+  // a continuum
+  nh_.param<bool>("enable_hybrid", CONFIG.hybrid_enabled, false);
+  nh_.param<double>("hybrid_cell_size", CONFIG.hybrid_cell_size,
+                    CONFIG.hybrid_cell_size);
+  nh_.param<double>("hybrid_region_x", CONFIG.hybrid_region_x,
+                    CONFIG.hybrid_region_x);
+  nh_.param<double>("hybrid_region_y", CONFIG.hybrid_region_y,
+                    CONFIG.hybrid_region_y);
+  nh_.param<double>("hybrid_region_width", CONFIG.hybrid_region_width,
+                    CONFIG.hybrid_region_width);
+  nh_.param<double>("hybrid_region_height", CONFIG.hybrid_region_height,
+                    CONFIG.hybrid_region_height);
+
+  replaying_ = !CONFIG.replay_file.empty();
+  if (replaying_) return initializeReplay();
+
+  // the robot's profile depends on how it is driven
+  if (CONFIG.robot_mode == RobotMode::SOCIAL_DRIVE) {
+    CONFIG.setAgentProfile(Ped::Tagent::ROBOT,
+                           AgentProfile(1.6, 0.4, 4.2, 0.7, 3.5));
+  } else {
+    AgentProfile robot_profile;
+    robot_profile.vmax = 2 * CONFIG.max_robot_speed;
+    CONFIG.setAgentProfile(Ped::Tagent::ROBOT, robot_profile);
+  }
+
   std::string scene_file_param;
   nh_.param<std::string>("scene_file", scene_file_param, "");
   if (scene_file_param == "") {
@@ -102,6 +297,10 @@ bool Simulator::initializeSimulation() {
 
   ROS_INFO_STREAM("Loading scene [" << scene_file_param << "] for simulation");
 
+  // → the zones get their histograms when they are read
+  SCENE.getFlowCounter().setDwellHistogram(CONFIG.flow_dwell_bin_width,
+                                           CONFIG.flow_dwell_bins);
+
   const QString scenefile = QString::fromStdString(scene_file_param);
   ScenarioReader scenario_reader;
   if (scenario_reader.readFromFile(scenefile) == false) {
@@ -112,20 +311,24 @@ bool Simulator::initializeSimulation() {
     return false;
   }
 
-  nh_.param<bool>("enable_groups", CONFIG.groups_enabled, true);
-  nh_.param<double>("max_robot_speed", CONFIG.max_robot_speed, 1.5);
-  nh_.param<double>("update_rate", CONFIG.updateRate, 25.0);
-  nh_.param<double>("simulation_factor", CONFIG.simulationFactor, 1.0);
-
-  int op_mode = 1;
-  nh_.param<int>("robot_mode", op_mode, 1);
-  CONFIG.robot_mode = static_cast<RobotMode>(op_mode);
+  // agent type profiles given as parameters override the scenario
+  loadAgentProfiles();
+
+  if (CONFIG.flow_fields_enabled) SCENE.computeFlowFields();
+  if (CONFIG.visibility_graph_enabled) SCENE.buildVisibilityGraph();
+  if (CONFIG.density_grid_enabled) SCENE.setupDensityGrid();
+  // → after the flow fields, the continuum follows them
+  if (CONFIG.hybrid_enabled) SCENE.setupContinuum();
+  if (CONFIG.export_enabled) setupExport();
+  if (!CONFIG.record_file.empty()) setupRecording();
+  if (CONFIG.metrics_enabled) setupMetrics();
+  if (!SCENE.getFlowCounter().isEmpty()) setupFlowMeasurements();
+  if (CONFIG.heatmap_enabled) setupHeatmaps();
+  setupOverrunControl();
 
   double spawn_period;
   nh_.param<double>("spawn_period", spawn_period, 5.0);
   nh_.param<std::string>("frame_id", frame_id_, "odom");
-  nh_.param<std::string>("robot_base_frame_id", robot_base_frame_id_,
-      "base_footprint");
 
   paused_ = false;
 
@@ -136,29 +339,51 @@ bool Simulator::initializeSimulation() {
 }
 
 void Simulator::runSimulation() {
+  if (replaying_) {
+    runReplay();
+    return;
+  }
+
   ros::Rate r(CONFIG.updateRate);
 
   while (ros::ok()) {
-    if (!robot_) {
-      // setup the robot
-      for (Agent* agent : SCENE.getAgents()) {
-        if (agent->getType() == Ped::Tagent::ROBOT) {
-          robot_ = agent;
-          last_robot_orientation_ =
-              poseFrom2DVelocity(robot_->getvx(), robot_->getvy());
-        }
-      }
-    }
+    setupRobots();
 
     if (!paused_) {
-      updateRobotPositionFromTF();
+      const ros::WallTime tick_start = ros::WallTime::now();
+      const uint64_t tick_allocations = AllocationCounter::getCount();
+      for (auto& robot : robots_) updateRobotPosition(*robot);
       SCENE.moveAllAgents();
-
-      publishAgents();
-      publishGroups();
-      publishRobotPosition();
-      publishObstacles();
-      publishWaypoints();
+      recordFrame();
+      accumulateHeatmaps();
+      updateMetrics();
+
+      // → the crowd is published less often when ticks overrun, robots
+      //   always
+      const bool publish_crowd = (SCENE.getTick() % publish_decimation_) == 0;
+      if (publish_crowd) {
+        publishAgents();
+        publishGroups();
+      }
+      for (auto& robot : robots_) {
+        const Agent* agent = robot->agent;
+        publishRobotPosition(*robot, agent->getx(), agent->gety(),
+                             agent->getvx(), agent->getvy());
+      }
+      if (publish_crowd) {
+        publishObstacles();
+        publishWaypoints();
+        publishDensityGrid();
+      }
+      updatePredictions();
+      exportFrame();
+      updateOverrunControl((ros::WallTime::now() - tick_start).toSec());
+      if (AllocationCounter::isEnabled()) {
+        ROS_DEBUG_THROTTLE(
+            5.0, "Heap allocations in the last tick: %llu",
+            static_cast<unsigned long long>(AllocationCounter::getCount() -
+                                            tick_allocations));
+      }
     }
     ros::spinOnce();
     r.sleep();
@@ -202,6 +427,128 @@ bool Simulator::onUnpauseSimulation(std_srvs::Empty::Request& request,
   return true;
 }
 
+/// Answers a batch of spatial queries. Service calls are handled by
+/// ros::spinOnce() in runSimulation(), between two ticks, so all queries of
+/// a batch see the same state of the scene.
+bool Simulator::onQueryScene(pedsim_srvs::QueryScene::Request& request,
+                             pedsim_srvs::QueryScene::Response& response) {
+  // → the replayed states aren't part of the scene
+  if (replaying_) return false;
+
+  response.time = SCENE.getTime();
+  response.results.resize(request.queries.size());
+  for (size_t i = 0; i < request.queries.size(); ++i)
+    answerQuery(request.queries[i], response.results[i]);
+  return true;
+}
+
+void Simulator::answerQuery(const pedsim_msgs::SpatialQuery& query,
+                            pedsim_msgs::SpatialQueryResult& result) const {
+  const Ped::Tvector point(query.point.x, query.point.y);
+  auto toPoint = [](const Ped::Tvector& v) {
+    geometry_msgs::Point p;
+    p.x = v.x;
+    p.y = v.y;
+    return p;
+  };
+
+  std::vector<const Ped::Tagent*> agents;
+  result.success = true;
+  switch (query.type) {
+    case pedsim_msgs::SpatialQuery::AGENTS_IN_RADIUS:
+      SCENE.getNeighbors(agents, point, query.radius);
+      agents.erase(std::remove_if(agents.begin(), agents.end(),
+                                  [&](const Ped::Tagent* a) {
+                                    return (a->getPosition() - point).length() >
+                                           query.radius;
+                                  }),
+                   agents.end());
+      break;
+    case pedsim_msgs::SpatialQuery::AGENTS_IN_POLYGON: {
+      std::vector<Ped::Tvector> corners;
+      for (const auto& corner : query.polygon)
+        corners.emplace_back(corner.x, corner.y);
+      result.success = corners.size() >= 3;
+      SCENE.getAgentsInPolygon(agents, corners);
+      break;
+    }
+    case pedsim_msgs::SpatialQuery::NEAREST_AGENTS:
+      SCENE.getNearestAgents(agents, point, query.k);
+      break;
+    case pedsim_msgs::SpatialQuery::NEAREST_WALL: {
+      Ped::Tvector closest;
+      result.found = SCENE.getNearestWall(point, query.radius, &closest);
+      if (result.found) {
+        result.wall_point = toPoint(closest);
+        result.wall_distance = (closest - point).length();
+      }
+      return;
+    }
+    case pedsim_msgs::SpatialQuery::LINE_OF_SIGHT:
+      result.visible =
+          SCENE.isVisible(point, Ped::Tvector(query.end.x, query.end.y));
+      return;
+    default:
+      ROS_WARN_STREAM("Unknown spatial query type " << int(query.type));
+      result.success = false;
+      return;
+  }
+
+  std::sort(agents.begin(), agents.end(),
+            [&point](const Ped::Tagent* a, const Ped::Tagent* b) {
+              return (a->getPosition() - point).lengthSquared() <
+                     (b->getPosition() - point).lengthSquared();
+            });
+  result.agent_ids.reserve(agents.size());
+  result.agent_positions.reserve(agents.size());
+  result.agent_distances.reserve(agents.size());
+  for (const Ped::Tagent* agent : agents) {
+    result.agent_ids.push_back(agent->getId());
+    result.agent_positions.push_back(toPoint(agent->getPosition()));
+    result.agent_distances.push_back((agent->getPosition() - point).length());
+  }
+}
+
+void Simulator::loadAgentProfiles() {
+  const std::vector<std::pair<std::string, int>> type_names = {
+      {"adult", Ped::Tagent::ADULT},
+      {"child", Ped::Tagent::CHILD},
+      {"robot", Ped::Tagent::ROBOT},
+      {"elder", Ped::Tagent::ELDER}};
+
+  for (const auto& type_name : type_names) {
+    const std::string prefix = "agent_profiles/" + type_name.first + "/";
+    if (!nh_.hasParam("agent_profiles/" + type_name.first)) continue;
+
+    // unset values keep the profile from the scenario or the defaults
+    AgentProfile profile = CONFIG.getAgentProfile(type_name.second);
+    nh_.param<double>(prefix + "vmax", profile.vmax, profile.vmax);
+    nh_.param<double>(prefix + "radius", profile.radius, profile.radius);
+    nh_.param<double>(prefix + "force_desired", profile.forceFactorDesired,
+                      profile.forceFactorDesired);
+    nh_.param<double>(prefix + "force_social", profile.forceFactorSocial,
+                      profile.forceFactorSocial);
+    nh_.param<double>(prefix + "force_obstacle", profile.forceFactorObstacle,
+                      profile.forceFactorObstacle);
+
+    std::string motion_model;
+    if (nh_.getParam(prefix + "motion_model", motion_model)) {
+      if (motion_model == "orca")
+        profile.motionModel = MotionModel::ORCA;
+      else if (motion_model == "social_force")
+        profile.motionModel = MotionModel::SOCIAL_FORCE;
+      else
+        ROS_WARN_STREAM("Unknown motion model for agent type "
+                        << type_name.first << ": " << motion_model);
+    }
+    CONFIG.setAgentProfile(type_name.second, profile);
+
+    ROS_INFO_STREAM("Using parameter profile for agent type "
+                    << type_name.first << ": vmax=" << profile.vmax
+                    << " radius=" << profile.radius);
+  }
+}
+
 void Simulator::spawnCallback(const ros::TimerEvent& event) {
   ROS_DEBUG_STREAM("Spawning new agents.");
 
@@ -215,76 +562,260 @@ void Simulator::spawnCallback(const ros::TimerEvent& event) {
     }
 
     SCENE.addAgentCluster(agentCluster);
+
+    RecordedEvent spawn = RecordedEvent();
+    spawn.type = RecordedEvent::SPAWN;
+    spawn.time = SCENE.getTime();
+    spawn.x = sa->x;
+    spawn.y = sa->y;
+    spawn.count = sa->n;
+    run_recorder_.writeEvent(spawn);
+    publishSpawn(spawn);
   }
 }
 
-void Simulator::updateRobotPositionFromTF() {
-  if (!robot_) return;
+void Simulator::publishSpawn(const RecordedEvent& spawn) {
+  pedsim_msgs::AgentSpawn msg;
+  msg.header = createMsgHeader();
+  msg.position.x = spawn.x;
+  msg.position.y = spawn.y;
+  msg.count = spawn.count;
+  pub_agent_spawns_.publish(msg);
+}
 
-  if (CONFIG.robot_mode == RobotMode::TELEOPERATION ||
-      CONFIG.robot_mode == RobotMode::CONTROLLED) {
-    robot_->setTeleop(true);
-    robot_->setVmax(2 * CONFIG.max_robot_speed);
+/// Keeps one Robot per robot agent of the scene, in the scene's order.
+/// Robots that are still there keep their pose source and state.
+void Simulator::setupRobots() {
+  // the scene keeps an index of its robots, no need to scan the agents
+  const QList<Agent*>& agents = SCENE.getRobots();
+  bool changed = (robots_.size() != static_cast<size_t>(agents.size()));
+  for (size_t i = 0; !changed && (i < robots_.size()); ++i)
+    changed = (robots_[i]->agent != agents[i]);
+  if (!changed) return;
+
+  std::vector<std::unique_ptr<Robot>> robots;
+  robots.reserve(agents.size());
+  for (Agent* agent : agents) {
+    auto known = std::find_if(
+        robots_.begin(), robots_.end(),
+        [agent](const std::unique_ptr<Robot>& r) { return r->agent == agent; });
+    if (known != robots_.end()) {
+      robots.push_back(std::move(*known));
+      continue;
+    }
 
-    // Get robot position via TF
-    tf::StampedTransform tfTransform;
-    try {
-      transform_listener_->lookupTransform(frame_id_, robot_base_frame_id_,
-                                           ros::Time(0), tfTransform);
-    } catch (tf::TransformException& e) {
-      ROS_WARN_STREAM_THROTTLE(
-          5.0,
-          "TF lookup from " << robot_base_frame_id_ << " to " << frame_id_
-          << " failed. Reason: " << e.what());
-      return;
+    // externally driven robots are moved by their pose source or drive
+    if (CONFIG.robot_mode == RobotMode::TELEOPERATION ||
+        CONFIG.robot_mode == RobotMode::CONTROLLED ||
+        CONFIG.robot_mode == RobotMode::KINEMATIC) {
+      agent->setTeleop(true);
     }
+    robots.push_back(createRobot(robots.size(), agent));
+  }
+  robots_.swap(robots);
+}
+
+/// Sets up the topics and frame of a robot, and its pose source or drive.
+/// Without a name, the first robot uses the global ones, the others are
+/// named robot_<index>. While replaying, there is no agent.
+std::unique_ptr<Simulator::Robot> Simulator::createRobot(size_t index,
+                                                         Agent* agent) {
+  std::unique_ptr<Robot> robot(new Robot());
+  robot->agent = agent;
+  robot->id = (agent != nullptr) ? agent->getId() : -1;
+  robot->last_orientation =
+      (agent != nullptr) ? poseFrom2DVelocity(agent->getvx(), agent->getvy())
+                         : poseFrom2DVelocity(0, 0);
+
+  const std::string name =
+      (agent != nullptr) ? agent->getName().toStdString() : std::string();
+  std::string prefix = "robot_";
+  std::string pose_source = CONFIG.robot_pose_source;
+  std::string pose_topic = CONFIG.robot_pose_topic;
+  if (name.empty() && (index == 0)) {
+    nh_.param<std::string>("robot_base_frame_id", robot->base_frame_id,
+                           "base_footprint");
+    robot->pub_position =
+        nh_.advertise<nav_msgs::Odometry>("robot_position", queue_size_);
+  } else {
+    robot->name = name.empty() ? "robot_" + std::to_string(index) : name;
+    prefix = "robots/" + robot->name + "/";
+    nh_.param<std::string>(prefix + "base_frame_id", robot->base_frame_id,
+                           robot->name + "/base_footprint");
+    nh_.param<std::string>(prefix + "pose_source", pose_source, pose_source);
+    nh_.param<std::string>(prefix + "pose_topic", pose_topic,
+                           robot->name + "/" + CONFIG.robot_pose_topic);
+    robot->pub_position = nh_.advertise<nav_msgs::Odometry>(
+        robot->name + "/robot_position", queue_size_);
+  }
+  if (replaying_) return robot;
+  if (CONFIG.robot_mode == RobotMode::KINEMATIC) {
+    setupRobotDrive(*robot, prefix);
+    return robot;
+  }
 
-    const double x = tfTransform.getOrigin().x();
-    const double y = tfTransform.getOrigin().y();
-    const double dx = x - last_robot_pose_.getOrigin().x(),
-                 dy = y - last_robot_pose_.getOrigin().y();
-    const double dt =
-        tfTransform.stamp_.toSec() - last_robot_pose_.stamp_.toSec();
-    double vx = dx / dt, vy = dy / dt;
+  robot->velocity_estimator.setSmoothingTime(CONFIG.robot_velocity_smoothing);
 
-    if (!std::isfinite(vx)) vx = 0;
-    if (!std::isfinite(vy)) vy = 0;
+  RobotPoseSource::Type type;
+  if (pose_source == "odometry") {
+    type = RobotPoseSource::Type::ODOMETRY;
+  } else if (pose_source == "pose") {
+    type = RobotPoseSource::Type::POSE;
+  } else {
+    if (pose_source != "tf")
+      ROS_WARN_STREAM("Unknown robot pose source " << pose_source
+                                                   << ", using tf");
+    ROS_INFO_STREAM("Robot " << robot->base_frame_id << " pose from tf");
+    return robot;
+  }
 
-    ROS_DEBUG_STREAM("rx, ry: " << robot_->getx() << ", " << robot_->gety() << " vs: " << x << ", " << y);
+  robot->pose_source.reset(new RobotPoseSource(
+      nh_, type, pose_topic, CONFIG.robot_velocity_smoothing));
+  ROS_INFO_STREAM("Robot " << robot->base_frame_id << " pose from "
+                           << pose_source << " on " << pose_topic);
+  return robot;
+}
 
-    robot_->setX(x);
-    robot_->setY(y);
-    robot_->setvx(vx);
-    robot_->setvy(vy);
+/// Drives a kinematic robot from its cmd_vel. Commands are taken on the
+/// simulation thread by ros::spinOnce(), so the drive always integrates the
+/// latest one over the same time step as the crowd. Parameters are
+/// <prefix>kinematics, <prefix>cmd_vel_topic and <prefix>initial_theta.
+void Simulator::setupRobotDrive(Robot& robot, const std::string& prefix) {
+  std::string kinematics = CONFIG.robot_kinematics;
+  std::string cmd_vel_topic = CONFIG.robot_cmd_vel_topic;
+  double theta = 0;
+  nh_.param<std::string>(prefix + "kinematics", kinematics, kinematics);
+  if (!robot.name.empty()) cmd_vel_topic = robot.name + "/cmd_vel";
+  nh_.param<std::string>(prefix + "cmd_vel_topic", cmd_vel_topic,
+                         cmd_vel_topic);
+  nh_.param<double>(prefix + "initial_theta", theta, theta);
+
+  RobotDrive::Kinematics type = RobotDrive::Kinematics::DIFFERENTIAL;
+  if (kinematics == "holonomic") {
+    type = RobotDrive::Kinematics::HOLONOMIC;
+  } else if (kinematics != "diff_drive") {
+    ROS_WARN_STREAM("Unknown robot kinematics " << kinematics
+                                                << ", using diff_drive");
+  }
 
+  Agent* agent = robot.agent;
+  robot.drive.reset(new RobotDrive(type, agent->getx(), agent->gety(), theta));
+  agent->setDrive(robot.drive.get());
+  robot.last_orientation = angleToQuaternion(theta);
+
+  RobotDrive* drive = robot.drive.get();
+  boost::function<void(const geometry_msgs::Twist::ConstPtr&)> callback =
+      [drive](const geometry_msgs::Twist::ConstPtr& twist) {
+        drive->setCommand(twist->linear.x, twist->linear.y, twist->angular.z);
+      };
+  robot.sub_cmd_vel =
+      nh_.subscribe<geometry_msgs::Twist>(cmd_vel_topic, 1, callback);
+  ROS_INFO_STREAM("Robot " << robot.base_frame_id << " driven as "
+                           << kinematics << " by " << cmd_vel_topic);
+}
 
-    ROS_DEBUG_STREAM("Robot speed: " << std::hypot(vx, vy) << " dt: " << dt);
+Simulator::Robot* Simulator::getRobotById(int id) {
+  for (auto& robot : robots_)
+    if (robot->id == id) return robot.get();
+  return nullptr;
+}
 
-    last_robot_pose_ = tfTransform;
+/// Moves externally driven robots to their latest pose, from the pose
+/// source or else from TF.
+void Simulator::updateRobotPosition(Robot& robot) {
+  if (CONFIG.robot_mode != RobotMode::TELEOPERATION &&
+      CONFIG.robot_mode != RobotMode::CONTROLLED)
+    return;
+
+  if (robot.pose_source == nullptr) {
+    updateRobotPositionFromTF(robot);
+    return;
   }
+
+  // → keep the last pose until a new one arrives
+  RobotPose pose;
+  if (robot.pose_source->takeLatest(&pose)) setRobotPose(robot, pose);
 }
 
-void Simulator::publishRobotPosition() {
-  if (robot_ == nullptr) return;
+void Simulator::updateRobotPositionFromTF(Robot& robot) {
+  // Get robot position via TF
+  tf::StampedTransform tfTransform;
+  try {
+    transform_listener_->lookupTransform(frame_id_, robot.base_frame_id,
+                                         ros::Time(0), tfTransform);
+  } catch (tf::TransformException& e) {
+    ROS_WARN_STREAM_THROTTLE(
+        5.0,
+        "TF lookup from " << robot.base_frame_id << " to " << frame_id_
+        << " failed. Reason: " << e.what());
+    return;
+  }
 
-  nav_msgs::Odometry robot_location;
-  robot_location.header = createMsgHeader();
-  robot_location.child_frame_id = robot_base_frame_id_;
+  RobotPose pose;
+  pose.stamp = tfTransform.stamp_.toSec();
+  pose.x = tfTransform.getOrigin().x();
+  pose.y = tfTransform.getOrigin().y();
 
-  robot_location.pose.pose.position.x = robot_->getx();
-  robot_location.pose.pose.position.y = robot_->gety();
-  if (hypot(robot_->getvx(), robot_->getvy()) < 0.05) {
-    robot_location.pose.pose.orientation = last_robot_orientation_;
-  } else {
-    robot_location.pose.pose.orientation =
-        poseFrom2DVelocity(robot_->getvx(), robot_->getvy());
-    last_robot_orientation_ = robot_location.pose.pose.orientation;
-  }
+  // → a repeated stamp is the same pose again
+  if (!robot.velocity_estimator.update(pose.stamp, pose.x, pose.y)) return;
+  pose.vx = robot.velocity_estimator.getvx();
+  pose.vy = robot.velocity_estimator.getvy();
+  setRobotPose(robot, pose);
+}
 
-  robot_location.twist.twist.linear.x = robot_->getvx();
-  robot_location.twist.twist.linear.y = robot_->getvy();
+void Simulator::setRobotPose(Robot& robot, const RobotPose& pose) {
+  Agent* agent = robot.agent;
+  ROS_DEBUG_STREAM("rx, ry: " << agent->getx() << ", " << agent->gety()
+                              << " vs: " << pose.x << ", " << pose.y);
+
+  agent->setX(pose.x);
+  agent->setY(pose.y);
+  agent->setvx(pose.vx);
+  agent->setvy(pose.vy);
+
+  RecordedEvent event = RecordedEvent();
+  event.type = RecordedEvent::ROBOT_POSE;
+  event.time = SCENE.getTime();
+  event.x = pose.x;
+  event.y = pose.y;
+  event.vx = pose.vx;
+  event.vy = pose.vy;
+  event.id = robot.id;
+  run_recorder_.writeEvent(event);
+
+  ROS_DEBUG_STREAM("Robot speed: " << std::hypot(pose.vx, pose.vy));
+}
 
-  pub_robot_position_.publish(robot_location);
+/// Publishes the robot's odometry. Standing still, it keeps its last
+/// heading; kinematic robots have their own.
+void Simulator::publishRobotPosition(Robot& robot, double x, double y,
+                                     double vx, double vy) {
+  nav_msgs::Odometry robot_location;
+  robot_location.header = createMsgHeader();
+  robot_location.child_frame_id = robot.base_frame_id;
+
+  robot_location.pose.pose.position.x = x;
+  robot_location.pose.pose.position.y = y;
+  if (robot.drive != nullptr)
+    robot.last_orientation = angleToQuaternion(robot.drive->getTheta());
+  else if (hypot(vx, vy) >= 0.05)
+    robot.last_orientation = poseFrom2DVelocity(vx, vy);
+  robot_location.pose.pose.orientation = robot.last_orientation;
+
+  robot_location.twist.twist.linear.x = vx;
+  robot_location.twist.twist.linear.y = vy;
+
+  robot.pub_position.publish(robot_location);
+
+  // → kinematic robots replace the external driving controller, which
+  //   provided the robot's frame
+  if (robot.drive != nullptr) {
+    tf::Transform pose;
+    pose.setOrigin(tf::Vector3(x, y, 0));
+    pose.setRotation(tf::createQuaternionFromYaw(robot.drive->getTheta()));
+    transform_broadcaster_->sendTransform(tf::StampedTransform(
+        pose, robot_location.header.stamp, frame_id_, robot.base_frame_id));
+  }
 }
 
 void Simulator::publishAgents() {
@@ -292,8 +823,11 @@ void Simulator::publishAgents() {
     return;
   }
 
-  pedsim_msgs::AgentStates all_status;
-  all_status.header = createMsgHeader();
+  // → the message is kept between ticks, its vectors and strings keep
+  //   their capacity
+  pedsim_msgs::AgentStates& all_status = agent_states_msg_;
+  all_status.header.stamp = ros::Time::now();
+  all_status.header.frame_id = frame_id_;
 
   auto VecToMsg = [](const Ped::Tvector& v) {
     geometry_msgs::Vector3 gv;
@@ -303,9 +837,17 @@ void Simulator::publishAgents() {
     return gv;
   };
 
+  size_t count = 0;
   for (const Agent* a : SCENE.getAgents()) {
-    pedsim_msgs::AgentState state;
-    state.header = createMsgHeader();
+    // Skip robot.
+    if (a->getType() == Ped::Tagent::ROBOT) {
+      continue;
+    }
+
+    if (count == all_status.agent_states.size())
+      all_status.agent_states.emplace_back();
+    pedsim_msgs::AgentState& state = all_status.agent_states[count++];
+    state.header = all_status.header;
 
     state.id = a->getId();
     state.type = a->getType();
@@ -325,13 +867,8 @@ void Simulator::publishAgents() {
       state.social_state = pedsim_msgs::AgentState::TYPE_STANDING;
     }
 
-    // Skip robot.
-    if (a->getType() == Ped::Tagent::ROBOT) {
-      continue;
-    }
-
     // Forces.
-    pedsim_msgs::AgentForce agent_forces;
+    pedsim_msgs::AgentForce& agent_forces = state.forces;
     agent_forces.desired_force = VecToMsg(a->getDesiredDirection());
     agent_forces.obstacle_force = VecToMsg(a->getObstacleForce());
     agent_forces.social_force = VecToMsg(a->getSocialForce());
@@ -339,11 +876,8 @@ void Simulator::publishAgents() {
     // agent_forces.group_gaze_force = a->getSocialForce();
     // agent_forces.group_repulsion_force = a->getSocialForce();
     // agent_forces.random_force = a->getSocialForce();
-
-    state.forces = agent_forces;
-
-    all_status.agent_states.push_back(state);
   }
+  all_status.agent_states.resize(count);
 
   pub_agent_states_.publish(all_status);
 }
@@ -359,30 +893,39 @@ void Simulator::publishGroups() {
     return;
   }
 
-  pedsim_msgs::AgentGroups sim_groups;
-  sim_groups.header = createMsgHeader();
+  // → kept between ticks like the agent states
+  pedsim_msgs::AgentGroups& sim_groups = agent_groups_msg_;
+  sim_groups.header.stamp = ros::Time::now();
+  sim_groups.header.frame_id = frame_id_;
 
+  size_t count = 0;
   for (const auto& ped_group : SCENE.getGroups()) {
     if (ped_group->memberCount() <= 1) continue;
 
-    pedsim_msgs::AgentGroup group;
+    if (count == sim_groups.groups.size()) sim_groups.groups.emplace_back();
+    pedsim_msgs::AgentGroup& group = sim_groups.groups[count++];
     group.group_id = ped_group->getId();
     group.age = 10;
     const Ped::Tvector com = ped_group->getCenterOfMass();
     group.center_of_mass.position.x = com.x;
     group.center_of_mass.position.y = com.y;
 
+    group.members.clear();
     for (const auto& member : ped_group->getMembers()) {
       group.members.emplace_back(member->getId());
     }
-    sim_groups.groups.emplace_back(group);
   }
+  sim_groups.groups.resize(count);
   pub_agent_groups_.publish(sim_groups);
 }
 
 void Simulator::publishObstacles() {
+  if (SCENE.getObstacleRevision() == published_obstacle_revision_) return;
+  published_obstacle_revision_ = SCENE.getObstacleRevision();
+
   pedsim_msgs::LineObstacles sim_obstacles;
   sim_obstacles.header = createMsgHeader();
+  sim_obstacles.obstacles.reserve(SCENE.getObstacles().size());
   for (const auto& obstacle : SCENE.getObstacles()) {
     pedsim_msgs::LineObstacle line_obstacle;
     line_obstacle.start.x = obstacle->getax();
@@ -393,37 +936,646 @@ void Simulator::publishObstacles() {
     line_obstacle.end.z = 0.0;
     sim_obstacles.obstacles.push_back(line_obstacle);
   }
+  // → polygons are expanded into their edges for the message only
+  const Ped::Tpolygons& polygons = SCENE.getPolygons();
+  for (size_t i = 0; i < polygons.getPolygonCount(); ++i) {
+    const std::vector<Ped::Tvector> corners = polygons.getCorners(i);
+    for (size_t j = 0; j < corners.size(); ++j) {
+      const Ped::Tvector& end = corners[(j + 1) % corners.size()];
+      pedsim_msgs::LineObstacle line_obstacle;
+      line_obstacle.start.x = corners[j].x;
+      line_obstacle.start.y = corners[j].y;
+      line_obstacle.end.x = end.x;
+      line_obstacle.end.y = end.y;
+      sim_obstacles.obstacles.push_back(line_obstacle);
+    }
+  }
   pub_obstacles_.publish(sim_obstacles);
 }
 
 void Simulator::publishWaypoints() {
-  pedsim_msgs::Waypoints sim_waypoints;
-  sim_waypoints.header = createMsgHeader();
+  // → kept between ticks like the agent states
+  pedsim_msgs::Waypoints& sim_waypoints = waypoints_msg_;
+  sim_waypoints.header.stamp = ros::Time::now();
+  sim_waypoints.header.frame_id = frame_id_;
+  sim_waypoints.waypoints.resize(SCENE.getWaypoints().size());
+  size_t i = 0;
   for (const auto& waypoint : SCENE.getWaypoints()) {
-    pedsim_msgs::Waypoint wp;
-    wp.name = waypoint->getName().toStdString();
+    pedsim_msgs::Waypoint& wp = sim_waypoints.waypoints[i++];
+    // → names rarely change, comparing them doesn't allocate
+    if (waypoint->getName() != QLatin1String(wp.name.c_str(), wp.name.size()))
+      wp.name = waypoint->getName().toStdString();
     wp.behavior = waypoint->getBehavior();
     wp.radius = waypoint->getRadius();
     wp.position.x = waypoint->getPosition().x;
     wp.position.y = waypoint->getPosition().y;
-    sim_waypoints.waypoints.push_back(wp);
   }
   pub_waypoints_.publish(sim_waypoints);
 }
 
-std::string Simulator::agentStateToActivity(
+void Simulator::publishDensityGrid() {
+  const Ped::TdensityGrid* grid = SCENE.getDensityGrid();
+  if (grid == nullptr) return;
+  if (pub_density_grid_.getNumSubscribers() == 0) return;
+
+  // → kept between ticks like the agent states
+  pedsim_msgs::DensityGrid& density_grid = density_grid_msg_;
+  density_grid.header.stamp = ros::Time::now();
+  density_grid.header.frame_id = frame_id_;
+  density_grid.origin.x = grid->getLeft();
+  density_grid.origin.y = grid->getTop();
+  density_grid.resolution = grid->getCellSize();
+  density_grid.width = grid->getColumns();
+  density_grid.height = grid->getRows();
+
+  const std::vector<int>& cells = grid->getOccupiedCells();
+  density_grid.cells.clear();
+  density_grid.density.clear();
+  density_grid.velocity_x.clear();
+  density_grid.velocity_y.clear();
+  for (int cell : cells) {
+    const Ped::Tvector velocity = grid->getMeanVelocity(cell);
+    density_grid.cells.push_back(cell);
+    density_grid.density.push_back(grid->getDensity(cell));
+    density_grid.velocity_x.push_back(velocity.x);
+    density_grid.velocity_y.push_back(velocity.y);
+  }
+  pub_density_grid_.publish(density_grid);
+}
+
+void Simulator::updatePredictions() {
+  if (!CONFIG.prediction_enabled || robots_.empty()) return;
+  if (pub_predicted_trajectories_.getNumSubscribers() == 0) return;
+
+  // publish the rollout finished since the last tick
+  std::unique_ptr<Ped::Trollout> rollout = trajectory_predictor_.takeResult();
+  if (rollout != nullptr) publishPredictions(*rollout);
+
+  // start the next one from the current state, unless the last one is
+  // still running
+  if (trajectory_predictor_.isBusy()) return;
+
+  rollout = SCENE.createRollout(robots_.front()->agent->getPosition(),
+                                CONFIG.prediction_radius);
+  if (trajectory_predictor_.start(
+          std::move(rollout), CONFIG.prediction_horizon,
+          CONFIG.getTimeStepSize(), CONFIG.prediction_sample_interval))
+    prediction_stamp_ = ros::Time::now();
+}
+
+void Simulator::publishPredictions(const Ped::Trollout& rollout) {
+  pedsim_msgs::AgentTrajectories predictions;
+  predictions.header = createMsgHeader();
+  predictions.header.stamp = prediction_stamp_;
+  predictions.time_step = rollout.getSampleInterval();
+  predictions.trajectories.reserve(rollout.getAgentCount());
+  for (size_t i = 0; i < rollout.getAgentCount(); ++i) {
+    pedsim_msgs::AgentTrajectory trajectory;
+    trajectory.id = rollout.getAgentId(i);
+    trajectory.type = rollout.getAgentType(i);
+    trajectory.positions.reserve(rollout.getTrajectory(i).size());
+    for (const Ped::Tvector& position : rollout.getTrajectory(i)) {
+      geometry_msgs::Point point;
+      point.x = position.x;
+      point.y = position.y;
+      trajectory.positions.push_back(point);
+    }
+    predictions.trajectories.push_back(trajectory);
+  }
+  pub_predicted_trajectories_.publish(predictions);
+}
+
+void Simulator::setupExport() {
+  DatasetExporter::Format format = DatasetExporter::Format::COLUMNAR;
+  if (CONFIG.export_format == "eth_ucy")
+    format = DatasetExporter::Format::ETH_UCY;
+  else if (CONFIG.export_format != "columnar")
+    ROS_WARN_STREAM("Unknown export format " << CONFIG.export_format
+                                             << ", using columnar");
+
+  if (CONFIG.export_directory.empty() ||
+      !dataset_exporter_.open(CONFIG.export_directory, format,
+                              CONFIG.export_chunk_frames)) {
+    ROS_WARN_STREAM("Dataset export disabled, no usable export_directory");
+    return;
+  }
+
+  if (CONFIG.export_regions.size() % 4 != 0)
+    ROS_WARN("export_regions needs 4 values per region, ignoring the rest");
+  for (size_t i = 0; i + 3 < CONFIG.export_regions.size(); i += 4) {
+    dataset_exporter_.addRegion(
+        CONFIG.export_regions[i], CONFIG.export_regions[i + 1],
+        CONFIG.export_regions[i + 2], CONFIG.export_regions[i + 3]);
+  }
+  last_export_time_ = -1;
+}
+
+void Simulator::exportFrame() {
+  if (!dataset_exporter_.isOpen()) return;
+
+  // → export_interval of 0 exports every tick
+  const double time = SCENE.getTime();
+  if ((last_export_time_ >= 0) &&
+      (time - last_export_time_ < CONFIG.export_interval - 1e-6))
+    return;
+  last_export_time_ = time;
+
+  dataset_exporter_.beginFrame(time);
+  for (const Agent* agent : SCENE.getAgents()) {
+    dataset_exporter_.addAgent(agent->getId(), agent->getType(),
+                               agent->getx(), agent->gety(), agent->getvx(),
+                               agent->getvy());
+  }
+  dataset_exporter_.endFrame();
+
+  const size_t dropped = dataset_exporter_.getDroppedChunks();
+  if (dropped > 0)
+    ROS_WARN_STREAM_THROTTLE(10, "Dataset export is falling behind, "
+                                     << dropped << " chunks dropped");
+}
+
+void Simulator::setupRecording() {
+  if (!run_recorder_.open(CONFIG.record_file,
+                          CONFIG.record_keyframe_interval))
+    return;
+
+  recordObstacles();
+  ROS_INFO_STREAM("Recording the run to " << CONFIG.record_file);
+}
+
+/// Writes the current walls to the run log. Called again whenever they
+/// change, e.g. by scripted obstacles.
+void Simulator::recordObstacles() {
+  recorded_obstacle_revision_ = SCENE.getObstacleRevision();
+
+  std::vector<RecordedObstacle> obstacles;
+  for (const auto& obstacle : SCENE.getObstacles()) {
+    obstacles.push_back(RecordedObstacle{obstacle->getax(), obstacle->getay(),
+                                         obstacle->getbx(),
+                                         obstacle->getby()});
+  }
+  const Ped::Tpolygons& polygons = SCENE.getPolygons();
+  for (size_t i = 0; i < polygons.getPolygonCount(); ++i) {
+    const std::vector<Ped::Tvector> corners = polygons.getCorners(i);
+    for (size_t j = 0; j < corners.size(); ++j) {
+      const Ped::Tvector& end = corners[(j + 1) % corners.size()];
+      obstacles.push_back(
+          RecordedObstacle{corners[j].x, corners[j].y, end.x, end.y});
+    }
+  }
+  run_recorder_.writeObstacles(SCENE.getTime(), obstacles);
+}
+
+void Simulator::recordFrame() {
+  if (!run_recorder_.isOpen()) return;
+
+  // → the walls come before the frame, so that seeking finds them
+  if (SCENE.getObstacleRevision() != recorded_obstacle_revision_)
+    recordObstacles();
+
+  recorded_agents_.clear();
+  for (const Agent* a : SCENE.getAgents()) {
+    RecordedAgent agent;
+    agent.id = a->getId();
+    agent.type = a->getType();
+    agent.state = a->getStateMachine()->getCurrentState();
+    agent.x = a->getx();
+    agent.y = a->gety();
+    agent.vx = a->getvx();
+    agent.vy = a->getvy();
+    recorded_agents_.push_back(agent);
+  }
+  run_recorder_.writeFrame(SCENE.getTime(), recorded_agents_);
+}
+
+bool Simulator::initializeReplay() {
+  if (!run_replayer_.open(CONFIG.replay_file)) {
+    ROS_ERROR_STREAM("Could not load the run log " << CONFIG.replay_file);
+    return false;
+  }
+
+  nh_.param<std::string>("frame_id", frame_id_, "odom");
+
+  srv_seek_replay_ =
+      nh_.advertiseService("seek_replay", &Simulator::onSeekReplay, this);
+
+  replay_time_ = run_replayer_.getStartTime();
+  paused_ = false;
+  ROS_INFO_STREAM("Replaying " << CONFIG.replay_file << " from "
+                               << run_replayer_.getStartTime() << " s to "
+                               << run_replayer_.getEndTime() << " s");
+  return true;
+}
+
+/// Publishes the recorded states at replay_speed times the recorded pace.
+/// The model isn't stepped.
+void Simulator::runReplay() {
+  ros::Rate r(CONFIG.updateRate);
+
+  while (ros::ok()) {
+    const double end = run_replayer_.getEndTime();
+    if (!paused_ && (replay_time_ < end)) {
+      replay_time_ = std::min(
+          end, replay_time_ + CONFIG.getTimeStepSize() * CONFIG.replay_speed);
+      run_replayer_.advanceTo(replay_time_);
+      for (const RecordedEvent& event : run_replayer_.takeEvents()) {
+        if (event.type == RecordedEvent::SPAWN) publishSpawn(event);
+      }
+      publishReplayState();
+
+      if (replay_time_ >= end) ROS_INFO("Replay finished");
+    }
+    ros::spinOnce();
+    r.sleep();
+  }
+}
+
+bool Simulator::onSeekReplay(pedsim_srvs::SeekReplay::Request& request,
+                             pedsim_srvs::SeekReplay::Response& response) {
+  if (!replaying_) {
+    response.success = false;
+    return true;
+  }
+
+  replay_time_ = std::max(run_replayer_.getStartTime(),
+                          std::min(request.time, run_replayer_.getEndTime()));
+  run_replayer_.seek(replay_time_);
+  publishReplayState();
+  response.success = true;
+  return true;
+}
+
+/// Like publishAgents(), publishObstacles() and publishRobotPosition(), from
+/// the recorded states. Forces aren't recorded.
+void Simulator::publishReplayState() {
+  pedsim_msgs::AgentStates all_status;
+  all_status.header = createMsgHeader();
+  all_status.agent_states.reserve(run_replayer_.getAgents().size());
+
+  for (const RecordedAgent& a : run_replayer_.getAgents()) {
+    if (a.type == Ped::Tagent::ROBOT) {
+      // → the scenario isn't loaded, robots are numbered as they appear
+      Robot* robot = getRobotById(a.id);
+      if (robot == nullptr) {
+        robots_.push_back(createRobot(robots_.size(), nullptr));
+        robot = robots_.back().get();
+        robot->id = a.id;
+      }
+      publishRobotPosition(*robot, a.x, a.y, a.vx, a.vy);
+      continue;
+    }
+
+    pedsim_msgs::AgentState state;
+    state.header = createMsgHeader();
+    state.id = a.id;
+    state.type = a.type;
+    state.pose.position.x = a.x;
+    state.pose.position.y = a.y;
+    state.pose.orientation =
+        pedsim::angleToQuaternion(std::atan2(a.vy, a.vx));
+    state.twist.linear.x = a.vx;
+    state.twist.linear.y = a.vy;
+    state.social_state = agentStateToActivity(
+        static_cast<AgentStateMachine::AgentState>(a.state));
+    if (a.type == Ped::Tagent::ELDER)
+      state.social_state = pedsim_msgs::AgentState::TYPE_STANDING;
+    all_status.agent_states.push_back(state);
+  }
+  pub_agent_states_.publish(all_status);
+
+  pedsim_msgs::LineObstacles sim_obstacles;
+  sim_obstacles.header = createMsgHeader();
+  for (const RecordedObstacle& obstacle : run_replayer_.getObstacles()) {
+    pedsim_msgs::LineObstacle line_obstacle;
+    line_obstacle.start.x = obstacle.ax;
+    line_obstacle.start.y = obstacle.ay;
+    line_obstacle.end.x = obstacle.bx;
+    line_obstacle.end.y = obstacle.by;
+    sim_obstacles.obstacles.push_back(line_obstacle);
+  }
+  pub_obstacles_.publish(sim_obstacles);
+}
+
+void Simulator::setupMetrics() {
+  robot_metrics_.reset(CONFIG.metrics_personal_space);
+  if (CONFIG.metrics_goal.size() == 2) {
+    robot_metrics_.setGoal(
+        Ped::Tvector(CONFIG.metrics_goal[0], CONFIG.metrics_goal[1]),
+        CONFIG.metrics_goal_tolerance);
+  } else if (!CONFIG.metrics_goal.empty()) {
+    ROS_WARN("metrics_goal needs x and y, time to goal not measured");
+  }
+
+  // → runs at the start of a tick, with the measures up to the last one
+  SCENE.getScheduler().schedule(CONFIG.metrics_publish_interval, [this]() {
+    // nothing measured before the first tick
+    if (SCENE.getTick() == 0 || robots_.empty()) return;
+    publishMetrics();
+  });
+}
+
+/// Accounts for the last tick, from the agents around the first robot.
+void Simulator::updateMetrics() {
+  if (!CONFIG.metrics_enabled || robots_.empty()) return;
+
+  const Agent& robot = *robots_.front()->agent;
+  SCENE.getNeighbors(metrics_neighbors_, robot.getPosition(),
+                     robot_metrics_.getRange());
+  robot_metrics_.update(SCENE.getTime(), CONFIG.getTimeStepSize(), robot,
+                        metrics_neighbors_);
+}
+
+void Simulator::publishMetrics() {
+  pedsim_msgs::RobotMetrics metrics;
+  metrics.header = createMsgHeader();
+  metrics.duration = robot_metrics_.getDuration();
+  metrics.min_distance = robot_metrics_.getMinDistance();
+  metrics.collisions = robot_metrics_.getCollisions();
+  metrics.collision_time = robot_metrics_.getCollisionTime();
+  metrics.intrusions = robot_metrics_.getIntrusions();
+  metrics.intrusion_time = robot_metrics_.getIntrusionTime();
+  metrics.path_length = robot_metrics_.getPathLength();
+  metrics.path_efficiency = robot_metrics_.getPathEfficiency();
+  metrics.time_to_goal = robot_metrics_.getTimeToGoal();
+  pub_robot_metrics_.publish(metrics);
+}
+
+/// Publishes the gate counts and zone occupancies every
+/// flow_publish_interval seconds of simulation time, at the start of a tick.
+void Simulator::setupFlowMeasurements() {
+  last_flow_publish_time_ = 0;
+  published_gate_counts_.clear();
+  SCENE.getScheduler().schedule(CONFIG.flow_publish_interval,
+                                [this]() { publishFlowMeasurements(); });
+}
+
+/// Rates are taken over the time since the last call.
+void Simulator::publishFlowMeasurements() {
+  // nothing counted before the first tick
+  if (SCENE.getTick() == 0) return;
+
+  const FlowCounter& counter = SCENE.getFlowCounter();
+  const double interval = SCENE.getTime() - last_flow_publish_time_;
+  last_flow_publish_time_ = SCENE.getTime();
+
+  pedsim_msgs::FlowMeasurements measurements;
+  measurements.header = createMsgHeader();
+  measurements.interval = interval;
+
+  const std::vector<FlowCounter::Gate>& gates = counter.getGates();
+  published_gate_counts_.resize(gates.size(), std::make_pair(0u, 0u));
+  for (size_t i = 0; i < gates.size(); ++i) {
+    const FlowCounter::Gate& gate = gates[i];
+    pedsim_msgs::GateCount count;
+    count.id = gate.name;
+    count.start.x = gate.start.x;
+    count.start.y = gate.start.y;
+    count.end.x = gate.end.x;
+    count.end.y = gate.end.y;
+    count.forward = gate.forward;
+    count.backward = gate.backward;
+    count.forward_rate =
+        (gate.forward - published_gate_counts_[i].first) / interval;
+    count.backward_rate =
+        (gate.backward - published_gate_counts_[i].second) / interval;
+    published_gate_counts_[i] = std::make_pair(gate.forward, gate.backward);
+    measurements.gates.push_back(count);
+  }
+
+  for (const FlowCounter::Zone& zone : counter.getZones()) {
+    pedsim_msgs::ZoneOccupancy occupancy;
+    occupancy.id = zone.name;
+    occupancy.occupancy = zone.visitors.size();
+    occupancy.entries = zone.entries;
+    occupancy.visits = zone.visits;
+    occupancy.mean_dwell_time =
+        (zone.visits > 0) ? zone.dwellTimeSum / zone.visits : 0;
+    occupancy.dwell_bin_width = counter.getDwellBinWidth();
+    occupancy.dwell_histogram = zone.dwellHistogram;
+    measurements.zones.push_back(occupancy);
+  }
+
+  pub_flow_measurements_.publish(measurements);
+}
+
+/// The heatmaps cover the scenario's extent; agents walking outside of it
+/// aren't accumulated.
+void Simulator::setupHeatmaps() {
+  const QRectF area = SCENE.itemsBoundingRect();
+  if (!heatmap_accumulator_.open(area.x(), area.y(), area.width(),
+                                 area.height(), CONFIG.heatmap_cell_size,
+                                 CONFIG.heatmap_stop_speed)) {
+    ROS_WARN("Heatmaps disabled, heatmap_cell_size must be positive");
+    return;
+  }
+
+  pub_heatmap_occupancy_ =
+      nh_.advertise<nav_msgs::OccupancyGrid>("heatmap_occupancy", 1, true);
+  pub_heatmap_speed_ =
+      nh_.advertise<nav_msgs::OccupancyGrid>("heatmap_speed", 1, true);
+  pub_heatmap_stops_ =
+      nh_.advertise<nav_msgs::OccupancyGrid>("heatmap_stops", 1, true);
+  srv_dump_heatmaps_ =
+      nh_.advertiseService("dump_heatmaps", &Simulator::onDumpHeatmaps, this);
+}
+
+/// Hands the pedestrians of this tick to the heatmap worker.
+void Simulator::accumulateHeatmaps() {
+  if (!heatmap_accumulator_.isOpen()) return;
+
+  heatmap_accumulator_.beginSnapshot(CONFIG.getTimeStepSize());
+  for (const Agent* agent : SCENE.getAgents()) {
+    if (agent->getType() == Ped::Tagent::ROBOT) continue;
+    heatmap_accumulator_.addAgent(agent->getId(), agent->getx(),
+                                  agent->gety(),
+                                  std::hypot(agent->getvx(), agent->getvy()));
+  }
+  heatmap_accumulator_.endSnapshot();
+
+  const size_t dropped = heatmap_accumulator_.getDroppedSnapshots();
+  if (dropped > 0)
+    ROS_WARN_STREAM_THROTTLE(10, "Heatmaps are falling behind, "
+                                     << dropped << " ticks dropped");
+}
+
+/// Publishes the heatmaps accumulated so far, and writes them to
+/// heatmap_directory if given.
+bool Simulator::onDumpHeatmaps(std_srvs::Trigger::Request& request,
+                               std_srvs::Trigger::Response& response) {
+  if (!heatmap_accumulator_.isOpen()) {
+    response.success = false;
+    response.message = "heatmaps are disabled";
+    return true;
+  }
+
+  HeatmapAccumulator::Grids grids;
+  heatmap_accumulator_.getGrids(grids);
+  publishHeatmaps(grids);
+
+  response.success = true;
+  if (!CONFIG.heatmap_directory.empty()) {
+    response.success = writeHeatmaps(grids);
+    response.message = CONFIG.heatmap_directory;
+  }
+  return true;
+}
+
+/// Each grid is scaled to 0 - 100 by its largest value; speeds of cells
+/// nobody walked through are unknown (-1).
+void Simulator::publishHeatmaps(const HeatmapAccumulator::Grids& grids) {
+  auto toGrid = [&](const std::vector<double>& values, bool visitedOnly) {
+    nav_msgs::OccupancyGrid grid;
+    grid.header = createMsgHeader();
+    grid.info.map_load_time = grid.header.stamp;
+    grid.info.resolution = grids.cellSize;
+    grid.info.width = grids.columns;
+    grid.info.height = grids.rows;
+    grid.info.origin.position.x = grids.originX;
+    grid.info.origin.position.y = grids.originY;
+    grid.info.origin.orientation.w = 1;
+
+    double maxValue = 0;
+    for (double value : values) maxValue = std::max(maxValue, value);
+    const double scale = (maxValue > 0) ? 100 / maxValue : 0;
+    grid.data.resize(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      if (visitedOnly && (grids.occupancy[i] == 0))
+        grid.data[i] = -1;
+      else
+        grid.data[i] = static_cast<int8_t>(std::round(values[i] * scale));
+    }
+    return grid;
+  };
+
+  const std::vector<double> stops(grids.stops.begin(), grids.stops.end());
+  pub_heatmap_occupancy_.publish(toGrid(grids.occupancy, false));
+  pub_heatmap_speed_.publish(toGrid(grids.meanSpeed, true));
+  pub_heatmap_stops_.publish(toGrid(stops, false));
+}
+
+/// Writes heatmap.csv and one image per grid to heatmap_directory.
+bool Simulator::writeHeatmaps(const HeatmapAccumulator::Grids& grids) {
+  const std::string& directory = CONFIG.heatmap_directory;
+  if (!QDir().mkpath(QString::fromStdString(directory))) {
+    ROS_WARN_STREAM("Could not create heatmap directory " << directory);
+    return false;
+  }
+
+  const std::vector<double> stops(grids.stops.begin(), grids.stops.end());
+  const bool written =
+      HeatmapAccumulator::writeCsv(grids, directory + "/heatmap.csv") &&
+      HeatmapAccumulator::writePng(grids, grids.occupancy,
+                                   directory + "/heatmap_occupancy.png") &&
+      HeatmapAccumulator::writePng(grids, grids.meanSpeed,
+                                   directory + "/heatmap_speed.png") &&
+      HeatmapAccumulator::writePng(grids, stops,
+                                   directory + "/heatmap_stops.png");
+  if (!written) ROS_WARN_STREAM("Could not write heatmaps to " << directory);
+  return written;
+}
+
+/// Writes the summary of the run to metrics_file, if given.
+void Simulator::writeMetrics() {
+  if (CONFIG.metrics_file.empty() || !robot_metrics_.hasStarted()) return;
+
+  std::ofstream file(CONFIG.metrics_file, std::ios::trunc);
+  robot_metrics_.writeSummary(file);
+  if (!file)
+    ROS_WARN_STREAM("Could not write metrics to " << CONFIG.metrics_file);
+}
+
+void Simulator::setupOverrunControl() {
+  publish_decimation_ = 1;
+  if (!CONFIG.overrun_control_enabled) return;
+
+  overrun_controller_.reset(1.0 / CONFIG.updateRate,
+                            CONFIG.overrun_degrade_time,
+                            CONFIG.overrun_restore_time,
+                            CONFIG.overrun_restore_load);
+  pub_diagnostics_ =
+      nh_.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+  last_diagnostics_time_ = ros::WallTime::now();
+}
+
+/// Accounts for the work of the last tick, without the sleep. Transitions
+/// are reported right away, the state once per second.
+void Simulator::updateOverrunControl(double duration) {
+  if (!CONFIG.overrun_control_enabled) return;
+
+  // → the update rate may have been reconfigured
+  overrun_controller_.setBudget(1.0 / CONFIG.updateRate);
+  const int previous_level = overrun_controller_.getLevel();
+  if (overrun_controller_.update(duration)) {
+    const int level = overrun_controller_.getLevel();
+    applyDegradation(level);
+    ROS_WARN_STREAM("Tick load " << overrun_controller_.getLoad() << ", now "
+                                 << OverrunController::getLevelName(level));
+    publishDiagnostics(previous_level);
+  } else if ((ros::WallTime::now() - last_diagnostics_time_).toSec() >= 1.0) {
+    publishDiagnostics(previous_level);
+  }
+}
+
+/// Levels include the ones below them, see OverrunController::Level.
+void Simulator::applyDegradation(int level) {
+  CONFIG.setSuppressedForces(
+      (level >= OverrunController::NO_OPTIONAL_FORCES)
+          ? ((1u << Force::RANDOM) | (1u << Force::ALONG_WALL))
+          : 0);
+  SCENE.setNeighborReuse(
+      (level >= OverrunController::NEIGHBOR_REUSE) ? 4 : 1);
+  SCENE.setReducedDetailDistance(
+      (level >= OverrunController::REDUCED_FAR_DETAIL) ? 10.0 : 0);
+  publish_decimation_ =
+      (level >= OverrunController::DECIMATED_PUBLISHING) ? 4 : 1;
+}
+
+void Simulator::publishDiagnostics(int previousLevel) {
+  const int level = overrun_controller_.getLevel();
+  auto keyValue = [](const std::string& key, const std::string& value) {
+    diagnostic_msgs::KeyValue pair;
+    pair.key = key;
+    pair.value = value;
+    return pair;
+  };
+
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = "pedsim_simulator: tick budget";
+  status.hardware_id = "pedsim_simulator";
+  status.level = (level == OverrunController::FULL)
+                     ? diagnostic_msgs::DiagnosticStatus::OK
+                     : diagnostic_msgs::DiagnosticStatus::WARN;
+  status.message = OverrunController::getLevelName(level);
+  if (level != previousLevel) {
+    status.message += std::string(" (was ") +
+                      OverrunController::getLevelName(previousLevel) + ")";
+  }
+  status.values.push_back(
+      keyValue("load", std::to_string(overrun_controller_.getLoad())));
+  status.values.push_back(
+      keyValue("budget", std::to_string(overrun_controller_.getBudget())));
+  status.values.push_back(
+      keyValue("overruns", std::to_string(overrun_controller_.getOverruns())));
+  status.values.push_back(keyValue("level", std::to_string(level)));
+
+  diagnostic_msgs::DiagnosticArray diagnostics;
+  diagnostics.header.stamp = ros::Time::now();
+  diagnostics.status.push_back(status);
+  pub_diagnostics_.publish(diagnostics);
+  last_diagnostics_time_ = ros::WallTime::now();
+}
+
+const std::string& Simulator::agentStateToActivity(
     const AgentStateMachine::AgentState& state) const {
-  std::string activity = "Unknown";
+  // → constants, so that filling a message doesn't build a string
+  static const std::string unknown = "Unknown";
   switch (state) {
     case AgentStateMachine::AgentState::StateWalking:
-      activity = pedsim_msgs::AgentState::TYPE_INDIVIDUAL_MOVING;
-      break;
+      return pedsim_msgs::AgentState::TYPE_INDIVIDUAL_MOVING;
     case AgentStateMachine::AgentState::StateGroupWalking:
-      activity = pedsim_msgs::AgentState::TYPE_GROUP_MOVING;
-      break;
+      return pedsim_msgs::AgentState::TYPE_GROUP_MOVING;
     case AgentStateMachine::AgentState::StateQueueing:
-      activity = pedsim_msgs::AgentState::TYPE_WAITING_IN_QUEUE;
-      break;
+      return pedsim_msgs::AgentState::TYPE_WAITING_IN_QUEUE;
     case AgentStateMachine::AgentState::StateShopping:
       break;
     case AgentStateMachine::AgentState::StateNone:
@@ -431,7 +1583,7 @@ std::string Simulator::agentStateToActivity(
     case AgentStateMachine::AgentState::StateWaiting:
       break;
   }
-  return activity;
+  return unknown;
 }
 
 std_msgs::Header Simulator::createMsgHeader() const {
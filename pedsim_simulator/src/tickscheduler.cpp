@@ -0,0 +1,82 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <pedsim_simulator/tickscheduler.h>
+
+#include <algorithm>
+#include <cmath>
+
+TickScheduler::TickScheduler() : timeStep(1), lastId(0) {}
+
+void TickScheduler::setTimeStep(double h) {
+  if (h <= 0) return;
+  timeStep = h;
+  for (auto& entry : entries)
+    entry.second.period = toTicks(entry.second.interval);
+}
+
+uint64_t TickScheduler::toTicks(double interval) const {
+  const double ticks = std::round(interval / timeStep);
+  return (ticks < 1) ? 1 : static_cast<uint64_t>(ticks);
+}
+
+int TickScheduler::schedule(double interval, const Task& task,
+                            uint64_t firstTick) {
+  const int id = ++lastId;
+  Entry entry;
+  entry.interval = interval;
+  entry.period = toTicks(interval);
+  entry.task = task;
+  entries[id] = entry;
+  due.push(Due(firstTick, id));
+  return id;
+}
+
+bool TickScheduler::cancel(int id) { return (entries.erase(id) > 0); }
+
+void TickScheduler::clear() {
+  entries.clear();
+  due = decltype(due)();
+}
+
+void TickScheduler::run(uint64_t tick) {
+  while (!due.empty() && (due.top().first <= tick)) {
+    const Due next = due.top();
+    due.pop();
+
+    auto entry = entries.find(next.second);
+    if (entry == entries.end()) continue;
+
+    // → reschedule first, the task may cancel itself
+    due.push(Due(std::max(next.first, tick) + entry->second.period,
+                 next.second));
+    const Task task = entry->second.task;
+    task();
+  }
+}
@@ -0,0 +1,99 @@
+/**
+* Copyright 2014 Social Robotics Lab, University of Freiburg
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+*    # Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*    # Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*    # Neither the name of the University of Freiburg nor the names of its
+*       contributors may be used to endorse or promote products derived from
+*       this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+* INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+* CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+* POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <pedsim_simulator/trajectorypredictor.h>
+
+#include <pedsim/ped_rollout.h>
+
+TrajectoryPredictor::TrajectoryPredictor()
+    : stopping(false),
+      computing(false),
+      horizon(0),
+      stepSize(0),
+      sampleInterval(0) {
+  worker = std::thread(&TrajectoryPredictor::run, this);
+}
+
+TrajectoryPredictor::~TrajectoryPredictor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_one();
+  worker.join();
+}
+
+bool TrajectoryPredictor::isBusy() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return (pending != nullptr) || computing;
+}
+
+/// \return  false if the previous rollout hasn't finished yet; the new one
+/// is dropped then
+bool TrajectoryPredictor::start(std::unique_ptr<Ped::Trollout> rollout,
+                                double horizonIn, double stepSizeIn,
+                                double sampleIntervalIn) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if ((pending != nullptr) || computing) return false;
+
+    pending = std::move(rollout);
+    horizon = horizonIn;
+    stepSize = stepSizeIn;
+    sampleInterval = sampleIntervalIn;
+  }
+  condition.notify_one();
+  return true;
+}
+
+/// \return  the last finished rollout, or nullptr if there is no new one
+std::unique_ptr<Ped::Trollout> TrajectoryPredictor::takeResult() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::move(result);
+}
+
+void TrajectoryPredictor::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    condition.wait(lock, [this] { return stopping || (pending != nullptr); });
+    if (stopping) return;
+
+    std::unique_ptr<Ped::Trollout> rollout = std::move(pending);
+    computing = true;
+    const double h = stepSize, horizonNow = horizon,
+                 interval = sampleInterval;
+
+    // the rollout only touches its own copies
+    lock.unlock();
+    rollout->run(horizonNow, h, interval);
+    lock.lock();
+
+    result = std::move(rollout);
+    computing = false;
+  }
+}
@@ -74,5 +74,5 @@ bool GroupWaypointPlanner::hasCompletedDestination() const {
 }
 
 QString GroupWaypointPlanner::name() const {
-  return tr("GroupWaypointPlanner");
+  return QString("GroupWaypointPlanner");
 }
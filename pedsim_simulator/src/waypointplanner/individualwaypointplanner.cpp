@@ -75,5 +75,5 @@ bool IndividualWaypointPlanner::hasCompletedDestination() const {
 }
 
 QString IndividualWaypointPlanner::name() const {
-  return tr("IndividualWaypointPlanner");
+  return QString("IndividualWaypointPlanner");
 }
@@ -29,11 +29,13 @@
 * \author Sven Wehner <mail@svenwehner.de>
 */
 
+#include <pedsim_simulator/agentstatemachine.h>
 #include <pedsim_simulator/rng.h>
 #include <pedsim_simulator/scene.h>
 #include <pedsim_simulator/waypointplanner/shoppingplanner.h>
 
 #include <pedsim_simulator/element/agent.h>
+#include <pedsim_simulator/element/agentgroup.h>
 #include <pedsim_simulator/element/areawaypoint.h>
 #include <pedsim_simulator/element/attractionarea.h>
 
@@ -43,6 +45,7 @@ ShoppingPlanner::ShoppingPlanner() {
   currentWaypoint = nullptr;
   attraction = nullptr;
   timeReached = 0;
+  informGroup = false;
 }
 
 void ShoppingPlanner::loseAttraction() {
@@ -52,8 +55,14 @@ void ShoppingPlanner::loseAttraction() {
   attraction = nullptr;
   timeReached = 0;
 
-  // inform users
-  emit lostAttraction();
+  // inform the other group members
+  if (!informGroup || (agent == nullptr)) return;
+  AgentGroup* group = agent->getGroup();
+  if (group == nullptr) return;
+  foreach (Agent* member, group->getMembers()) {
+    if (member == agent) continue;
+    member->getStateMachine()->loseAttraction();
+  }
 }
 
 bool ShoppingPlanner::setAgent(Agent* agentIn) {
@@ -74,6 +83,10 @@ bool ShoppingPlanner::setAgent(Agent* agentIn) {
   return true;
 }
 
+void ShoppingPlanner::setInformGroup(bool informGroupIn) {
+  informGroup = informGroupIn;
+}
+
 AttractionArea* ShoppingPlanner::getAttraction() const { return attraction; }
 
 bool ShoppingPlanner::setAttraction(AttractionArea* attractionIn) {
@@ -201,4 +214,6 @@ Ped::Tvector ShoppingPlanner::createRandomOffset() const {
   return randomOffset;
 }
 
-QString ShoppingPlanner::name() const { return tr("ShoppingPlanner"); }
+QString ShoppingPlanner::name() const {
+  return QString("ShoppingPlanner");
+}
@@ -32,3 +32,5 @@
 #include <pedsim_simulator/waypointplanner/waypointplanner.h>
 
 WaypointPlanner::WaypointPlanner() {}
+
+WaypointPlanner::~WaypointPlanner() {}